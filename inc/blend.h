@@ -0,0 +1,113 @@
+#ifndef PAINT_INC_BLEND_H_
+#define PAINT_INC_BLEND_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pixel.h"
+
+namespace paint
+{
+    /**
+     * @brief Multiplies 2 channels and divides the product by 255, rounded to the nearest integer.
+     *
+     * Exact for all the products of 8-bit channels (no division is done).
+     *
+     */
+    constexpr uint8_t MulDiv255(unsigned c1, unsigned c2)
+    {
+        const unsigned t = c1 * c2 + 128;
+        return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+    }
+
+    /**
+     * @brief Multiplies the color channels by the alpha (straight color -> premultiplied color).
+     *
+     * The PixelBGRA8888 pixels of the images (ColorBGRA8888) have premultiplied alpha:
+     *  - blending is the same multiply and add for every channel (no division, the channels of opaque pixels are unchanged),
+     *  - the color of a pixel with any alpha over black are its color channels.
+     *
+     */
+    constexpr PixelBGRA8888 PremultiplyPixel(const PixelBGRA8888 &pixel)
+    {
+        return PixelBGRA8888{MulDiv255(pixel.b, pixel.a), MulDiv255(pixel.g, pixel.a), MulDiv255(pixel.r, pixel.a), pixel.a};
+    }
+
+    /**
+     * @brief Divides the color channels by the alpha (premultiplied color -> straight color, i.e. for the BMP files).
+     *
+     * Fully transparent pixels become transparent black.
+     * Premultiplying the result gives pixel again, so the pixels survive saving and loading.
+     *
+     */
+    constexpr PixelBGRA8888 UnpremultiplyPixel(const PixelBGRA8888 &pixel)
+    {
+        if (pixel.a == 0)
+            return PixelBGRA8888{0, 0, 0, 0};
+
+        auto divide = [&pixel](unsigned c) {
+            const unsigned straight = (c * 255 + pixel.a / 2) / pixel.a;
+            return static_cast<uint8_t>(straight > 255 ? 255 : straight);
+        };
+
+        return PixelBGRA8888{divide(pixel.b), divide(pixel.g), divide(pixel.r), pixel.a};
+    }
+
+    /**
+     * @brief Composites src over dst (both premultiplied).
+     *
+     * Every channel (alpha included) is src + dst * (255 - src.a) / 255, saturated at 255.
+     *
+     */
+    constexpr PixelBGRA8888 BlendPixel(const PixelBGRA8888 &src, const PixelBGRA8888 &dst)
+    {
+        const unsigned inverse_alpha = 255 - src.a;
+        auto over = [inverse_alpha](unsigned s, unsigned d) {
+            const unsigned c = s + MulDiv255(d, inverse_alpha);
+            return static_cast<uint8_t>(c > 255 ? 255 : c);
+        };
+
+        return PixelBGRA8888{over(src.b, dst.b), over(src.g, dst.g), over(src.r, dst.r), over(src.a, dst.a)};
+    }
+
+    /**
+     * @brief Multiplies all the channels of a premultiplied pixel by coverage / 255 (i.e. the edge pixels of antialiased lines).
+     *
+     */
+    constexpr PixelBGRA8888 ScalePixel(const PixelBGRA8888 &pixel, uint8_t coverage)
+    {
+        return PixelBGRA8888{MulDiv255(pixel.b, coverage), MulDiv255(pixel.g, coverage), MulDiv255(pixel.r, coverage), MulDiv255(pixel.a, coverage)};
+    }
+
+    /**
+     * @brief Premultiplies n pixels (see PremultiplyPixel()), src and dst can be the same.
+     *
+     */
+    void PremultiplySpan(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n);
+
+    /**
+     * @brief Unpremultiplies n pixels (see UnpremultiplyPixel()), src and dst can be the same.
+     *
+     */
+    void UnpremultiplySpan(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n);
+
+    /**
+     * @brief Composites n premultiplied pixels of src over the pixels of dst (see BlendPixel()).
+     *
+     * The SIMD kernels (SSE4.1 - 4 pixels, AVX2 - 8 pixels at once) are selected by GetSimdLevel()
+     * and give the same result as BlendPixel().
+     *
+     * @param src the first source pixel (i.e. of an overlay).
+     * @param dst the first destination pixel.
+     * @param n number of pixels.
+     */
+    void BlendSpan(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n);
+
+    /**
+     * @brief Composites the premultiplied color over n pixels of dst (i.e. drawing with a translucent color).
+     *
+     */
+    void BlendSpanSolid(const PixelBGRA8888 &color, PixelBGRA8888 *dst, size_t n);
+}
+
+#endif // PAINT_INC_BLEND_H_
@@ -0,0 +1,123 @@
+#ifndef PAINT_INC_BUFFER_POOL_H_
+#define PAINT_INC_BUFFER_POOL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace paint
+{
+    /**
+     * @brief A pool of aligned buffers for the pixel data.
+     *
+     * Editing operations (Crop, Resize, Rotate, undo history, ...) allocate and release buffers of the same sizes
+     * over and over. The pool keeps released buffers and gives them out again, so the steady state does not allocate
+     * new memory (and does not page fault on freshly mapped pages).
+     *
+     * The requested sizes are rounded up to size classes (4 classes per power of 2), so buffers of similar sizes can be reused.
+     * At most BufferPool::GetCapacity() bytes are kept, the rest of the released buffers is freed.
+     *
+     * The buffers are returned as std::shared_ptr, whose deleter returns the buffer into the pool
+     * (and keeps the pool alive). The pool is thread safe.
+     *
+     */
+    class BufferPool : public std::enable_shared_from_this<BufferPool>
+    {
+    public:
+        /**
+         * @brief Constants of the pool.
+         *
+         */
+        enum : size_t
+        {
+            kDefaultCapacity = 256 << 20, /// Default number of bytes kept in the pool.
+            kMinSizeClass = 64,           /// The smallest size class.
+        };
+
+        /**
+         * @brief Statistics of the pool since creation or the last BufferPool::ResetStatistics().
+         *
+         */
+        struct Statistics
+        {
+            size_t hit_count = 0;         /// Allocations served from the pool.
+            size_t miss_count = 0;        /// Allocations that had to allocate new memory.
+            size_t release_count = 0;     /// Buffers returned into the pool.
+            size_t discard_count = 0;     /// Released buffers freed because the pool was full.
+            size_t cached_byte_count = 0; /// Bytes currently kept in the pool.
+        };
+
+        /**
+         * @brief Creates a pool, has to be owned by std::shared_ptr (use std::make_shared).
+         *
+         * @param capacity maximum number of bytes kept in the pool.
+         */
+        explicit BufferPool(size_t capacity = kDefaultCapacity) : capacity_(capacity) {}
+        BufferPool(const BufferPool &other) = delete;
+        BufferPool &operator=(const BufferPool &other) = delete;
+        ~BufferPool();
+
+        /**
+         * @brief Returns the pool used for all DataPixels.
+         *
+         */
+        static const std::shared_ptr<BufferPool> &GetDefault();
+
+        /**
+         * @brief Returns the size of buffer actually allocated for byte_count bytes.
+         *
+         */
+        static size_t GetSizeClass(size_t byte_count);
+
+        /**
+         * @brief Allocates a buffer of at least byte_count bytes, the content is uninitialized.
+         *
+         * @param byte_count size of the buffer.
+         * @param alignment alignment of the buffer (power of 2).
+         * @return std::shared_ptr<uint8_t> the buffer, it is returned into the pool when released.
+         */
+        std::shared_ptr<uint8_t> Allocate(size_t byte_count, size_t alignment);
+
+        /**
+         * @brief Sets the maximum number of bytes kept in the pool and frees the buffers above it.
+         *
+         */
+        void SetCapacity(size_t capacity);
+        size_t GetCapacity() const;
+
+        Statistics GetStatistics() const;
+        void ResetStatistics();
+
+        /**
+         * @brief Frees all the buffers kept in the pool.
+         *
+         */
+        void Clear();
+
+    private:
+        using SizeClassKey = std::pair<size_t, size_t>; /// Size class and alignment.
+
+        /**
+         * @brief Returns the buffer into the pool (or frees it if the pool is full).
+         *
+         */
+        void Release(uint8_t *data, SizeClassKey key);
+
+        /**
+         * @brief Frees the cached buffers till cached_byte_count fits into the capacity (mutex_ has to be locked).
+         *
+         */
+        void Trim(size_t capacity);
+
+        mutable std::mutex mutex_;                                   /// Guards all the members below.
+        size_t capacity_;                                            /// Maximum number of bytes kept in the pool.
+        Statistics statistics_;                                      /// Statistics of the pool.
+        std::map<SizeClassKey, std::vector<uint8_t *>> free_buffers_; /// Released buffers by their size class.
+    };
+}
+
+#endif // PAINT_INC_BUFFER_POOL_H_
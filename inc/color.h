@@ -17,6 +17,26 @@ namespace paint
     class ColorBGR888;
     class ColorGrayscale;
     class ColorBW;
+    class ColorBGRA8888;
+    class ColorPalette;
+
+    /**
+     * @brief Enum describing the pixel format of a Color.
+     * 
+     * Used to select the right typed code path (see DataPixelsView) once per operation instead of once per pixel.
+     * 
+     */
+    enum class ColorFormat
+    {
+        kRGB565,    /// ColorRGB565 (PixelRGB565).
+        kBGR565,    /// ColorBGR565 (PixelBGR565).
+        kRGB888,    /// ColorRGB888 (PixelRGB888).
+        kBGR888,    /// ColorBGR888 (PixelBGR888).
+        kGrayscale, /// ColorGrayscale (PixelGrayscale).
+        kBW,        /// ColorBW (PixelBW).
+        kBGRA8888,  /// ColorBGRA8888 (PixelBGRA8888, premultiplied alpha).
+        kIndexed8,  /// ColorPalette (PixelIndexed8).
+    };
 
     class Color
     {
@@ -32,6 +52,7 @@ namespace paint
         virtual ColorBGR888 ToBGR888() const = 0;
         virtual ColorGrayscale ToGrayscale() const = 0;
         virtual ColorBW ToBW() const = 0;
+        virtual ColorBGRA8888 ToBGRA8888() const = 0;
 
         virtual void SetColor(const Color &other) = 0;
         virtual void InvertColor() = 0;
@@ -41,6 +62,7 @@ namespace paint
         virtual void *GetData() = 0;
         virtual size_t GetDataSize() const = 0;
         virtual size_t GetDataSizeBits() const = 0;
+        virtual ColorFormat GetColorFormat() const = 0;
     };
 }
 
@@ -16,6 +16,7 @@ namespace paint
     {
     public:
         ColorBGR565() = default;
+        explicit ColorBGR565(const PixelBGR565 &pixel) : pixel_{pixel} {}
         ColorBGR565(uint8_t blue, uint8_t green, uint8_t red) : pixel_{blue, green, red} {}
         virtual ~ColorBGR565() override {}
         virtual ColorBGR565 *clone() const override { return new ColorBGR565{*this}; }
@@ -35,6 +36,7 @@ namespace paint
         virtual ColorBGR888 ToBGR888() const override;
         virtual ColorGrayscale ToGrayscale() const override;
         virtual ColorBW ToBW() const override;
+        virtual ColorBGRA8888 ToBGRA8888() const override;
 
         virtual void SetFromData(const void *data) override
         {
@@ -69,6 +71,7 @@ namespace paint
         virtual void *GetData() override { return reinterpret_cast<void *>(&pixel_); };
         virtual size_t GetDataSize() const override { return sizeof(PixelBGR565); };
         virtual size_t GetDataSizeBits() const override { return 16; };
+        virtual ColorFormat GetColorFormat() const override { return ColorFormat::kBGR565; };
 
     private:
         PixelBGR565 pixel_;
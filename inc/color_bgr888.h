@@ -16,6 +16,7 @@ namespace paint
     {
     public:
         ColorBGR888() = default;
+        explicit ColorBGR888(const PixelBGR888 &pixel) : pixel_{pixel} {}
         ColorBGR888(uint8_t blue, uint8_t green, uint8_t red) : pixel_{blue, green, red} {}
         virtual ~ColorBGR888() override{};
         virtual ColorBGR888 *clone() const override { return new ColorBGR888{*this}; }
@@ -33,6 +34,7 @@ namespace paint
         virtual ColorBGR888 ToBGR888() const override;
         virtual ColorGrayscale ToGrayscale() const override;
         virtual ColorBW ToBW() const override;
+        virtual ColorBGRA8888 ToBGRA8888() const override;
 
         virtual void SetColor(const Color &other) { *this = std::move(other.ToBGR888()); };
         void SetColor(uint8_t blue, uint8_t green, uint8_t red)
@@ -67,6 +69,7 @@ namespace paint
         virtual void *GetData() override { return reinterpret_cast<void *>(&pixel_); };
         virtual size_t GetDataSize() const override { return sizeof(PixelBGR888); };
         virtual size_t GetDataSizeBits() const override { return 24; };
+        virtual ColorFormat GetColorFormat() const override { return ColorFormat::kBGR888; };
 
     private:
         PixelBGR888 pixel_;
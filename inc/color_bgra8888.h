@@ -0,0 +1,95 @@
+#ifndef PAINT_INC_COLOR_BGRA8888_H_
+#define PAINT_INC_COLOR_BGRA8888_H_
+
+#include <utility>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <memory>
+
+#include "pixel.h"
+#include "color.h"
+#include "blend.h"
+
+namespace paint
+{
+    /**
+     * @brief A color with opacity (alpha).
+     *
+     * The pixel has premultiplied alpha (see blend.h), only the constructor and SetColor() with the channels
+     * take the straight color. Converting into the other colors drops the alpha (the color over black),
+     * the other colors convert into opaque colors. Drawing with a translucent color blends it over the image.
+     *
+     */
+    class ColorBGRA8888 : public Color
+    {
+    public:
+        ColorBGRA8888() = default;
+        explicit ColorBGRA8888(const PixelBGRA8888 &pixel) : pixel_{pixel} {}
+        ColorBGRA8888(uint8_t blue, uint8_t green, uint8_t red, uint8_t alpha) : pixel_{PremultiplyPixel(PixelBGRA8888{blue, green, red, alpha})} {}
+        virtual ~ColorBGRA8888() override{};
+        virtual ColorBGRA8888 *clone() const override { return new ColorBGRA8888{*this}; }
+
+        ColorBGRA8888(const ColorBGRA8888 &other) : pixel_{other.pixel_} {}
+        ColorBGRA8888(const Color &other) { *this = std::move(other.ToBGRA8888()); }
+        ColorBGRA8888(ColorBGRA8888 &&other) = default;
+
+        ColorBGRA8888 &operator=(const ColorBGRA8888 &other) = default;
+        bool operator==(const ColorBGRA8888 &other) const { return pixel_ == other.pixel_; }
+
+        virtual ColorRGB565 ToRGB565() const override;
+        virtual ColorBGR565 ToBGR565() const override;
+        virtual ColorRGB888 ToRGB888() const override;
+        virtual ColorBGR888 ToBGR888() const override;
+        virtual ColorGrayscale ToGrayscale() const override;
+        virtual ColorBW ToBW() const override;
+        virtual ColorBGRA8888 ToBGRA8888() const override;
+
+        virtual void SetColor(const Color &other) { *this = std::move(other.ToBGRA8888()); };
+        void SetColor(uint8_t blue, uint8_t green, uint8_t red, uint8_t alpha)
+        {
+            pixel_ = PremultiplyPixel(PixelBGRA8888{blue, green, red, alpha});
+        }
+
+        /**
+         * @brief Inverts the straight color and keeps the alpha (premultiplied: alpha - channel).
+         *
+         */
+        virtual void InvertColor() override
+        {
+            pixel_.b = pixel_.a - pixel_.b;
+            pixel_.g = pixel_.a - pixel_.g;
+            pixel_.r = pixel_.a - pixel_.r;
+        }
+
+        virtual void Interpolate(const std::shared_ptr<Color> &c1, const std::shared_ptr<Color> &c2, float percent_c1) override
+        {
+            ColorBGRA8888 c1_BGRA8888(c1->ToBGRA8888());
+            ColorBGRA8888 c2_BGRA8888(c2->ToBGRA8888());
+
+            // Interpolate the color (premultiplied colors interpolate with the alpha)
+            pixel_.b = c1_BGRA8888.pixel_.b * percent_c1 + c2_BGRA8888.pixel_.b * (1 - percent_c1);
+            pixel_.g = c1_BGRA8888.pixel_.g * percent_c1 + c2_BGRA8888.pixel_.g * (1 - percent_c1);
+            pixel_.r = c1_BGRA8888.pixel_.r * percent_c1 + c2_BGRA8888.pixel_.r * (1 - percent_c1);
+            pixel_.a = c1_BGRA8888.pixel_.a * percent_c1 + c2_BGRA8888.pixel_.a * (1 - percent_c1);
+        };
+
+        virtual void SetFromData(const void *data) override
+        {
+            std::copy_n(reinterpret_cast<const PixelBGRA8888 *>(data), 1, &pixel_);
+        };
+        virtual void *GetData() override { return reinterpret_cast<void *>(&pixel_); };
+        virtual size_t GetDataSize() const override { return sizeof(PixelBGRA8888); };
+        virtual size_t GetDataSizeBits() const override { return 32; };
+        virtual ColorFormat GetColorFormat() const override { return ColorFormat::kBGRA8888; };
+
+        uint8_t GetAlpha() const { return pixel_.a; }
+        bool IsOpaque() const { return pixel_.a == 255; }
+        const PixelBGRA8888 &GetPixel() const { return pixel_; }
+
+    private:
+        PixelBGRA8888 pixel_; /// Premultiplied pixel.
+    };
+}
+
+#endif // PAINT_INC_COLOR_BGRA8888_H_
@@ -19,6 +19,7 @@ namespace paint
     {
     public:
         ColorBW() = default;
+        explicit ColorBW(const PixelBW &pixel) : pixel_{pixel} {}
         ColorBW(uint8_t white) : pixel_{white} {}
         virtual ~ColorBW() override {}
         virtual ColorBW *clone() const override { return new ColorBW{*this}; }
@@ -40,6 +41,7 @@ namespace paint
         virtual ColorBGR888 ToBGR888() const override;
         virtual ColorGrayscale ToGrayscale() const override;
         virtual ColorBW ToBW() const override;
+        virtual ColorBGRA8888 ToBGRA8888() const override;
 
         virtual void SetColor(const Color &other) { *this = std::move(other.ToBW()); }
         void SetColor(uint8_t white)
@@ -68,6 +70,7 @@ namespace paint
         virtual void *GetData() override { return reinterpret_cast<void *>(&pixel_); }
         virtual size_t GetDataSize() const override { return sizeof(PixelBW); }
         virtual size_t GetDataSizeBits() const override { return 1; };
+        virtual ColorFormat GetColorFormat() const override { return ColorFormat::kBW; };
 
     private:
         PixelBW pixel_;
@@ -0,0 +1,81 @@
+#ifndef PAINT_INC_COLOR_MATCH_H_
+#define PAINT_INC_COLOR_MATCH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "unit.h"
+#include "data_pixels.h"
+#include "raster.h"
+
+namespace paint
+{
+    /**
+     * @brief Finds the pixels of the rows that are within a tolerance of a color (i.e. the bucket fill with a tolerance and ReplaceColor()).
+     *
+     * A pixel matches when none of its channels differs from the channel of the color by more than the tolerance
+     * (the largest difference of the 8-bit channels, so the tolerance 0 matches only the same pixel).
+     *
+     *  - The pixels made of 8-bit channels (RGB888, BGR888, grayscale, premultiplied BGRA8888 and the planes of planar data)
+     *    are compared by bytes. The SIMD kernels (SSE4.1 - 16, AVX2 - 32 bytes at once) are selected by GetSimdLevel().
+     *  - The other pixels (565, BW and indexed) look up their value in a table of all their values,
+     *    made from their RGB888 colors (indexed pixels by the colors of the palette).
+     *  - The packed BW rows are compared by words.
+     *
+     * The matching pixels of a row are returned as a packed row of bits (see packed_bits.h), so the runs are found by words.
+     * The matcher keeps its buffers, so every thread needs its own matcher.
+     *
+     */
+    class ColorMatcher
+    {
+    public:
+        /**
+         * @brief Constructs the matcher.
+         *
+         * @param data the image.
+         * @param pixel the color as the pixel of data (sizeof the pixel structure, i.e. from DataPixels::CopyPixelTo()).
+         * @param tolerance the largest difference of a channel of a matching pixel.
+         */
+        ColorMatcher(DataPixels &data, const void *pixel, uint8_t tolerance);
+
+        /**
+         * @brief Get the size of the bits of a row in bytes (whole 64-bit words, see packed_bits.h).
+         *
+         */
+        size_t GetRowSize() const { return row_words_ * sizeof(uint64_t); }
+
+        /**
+         * @brief Sets the bits of the matching pixels of the row, the other bits (and the bits after the row) are cleared.
+         *
+         * @param y the row.
+         * @param bits the packed row of GetRowSize() bytes.
+         */
+        void MatchRow(Unit y, uint8_t *bits);
+
+        /**
+         * @brief Appends the runs of the matching pixels of the rows [row_begin, row_end) to spans (sorted).
+         *
+         */
+        void FindRuns(Unit row_begin, Unit row_end, std::vector<RowSpan> &spans);
+
+    private:
+        // Sets the bits [x, x + count) from the bytes of the pixels (a pixel matches when all its bytes match)
+        void MatchSegment(const uint8_t *pixels, Unit x, Unit count, uint8_t *bits);
+
+        DataPixels &data_;
+        ColorFormat format_;
+        PixelLayout layout_;
+        size_t pixel_size_;
+        size_t row_words_;
+        uint8_t tolerance_;
+        uint8_t pixel_[4] = {};
+
+        std::vector<uint8_t> patterns_[4]; // Bytes of the pixel repeated over a block of the SIMD kernels (a pattern for each plane of planar data)
+        std::vector<bool> table_;          // Whether each value of the pixel matches (565, BW and indexed pixels)
+        std::vector<uint8_t> flags_;       // Whether each byte of a row segment matches
+        std::vector<uint8_t> plane_flags_; // Flags of the next plane of a planar row
+        std::vector<uint8_t> bits_;        // Bits of a row (FindRuns())
+    };
+}
+
+#endif // PAINT_INC_COLOR_MATCH_H_
@@ -1,11 +1,84 @@
 #ifndef PAINT_INC_COLOR_PALETTE_H_
 #define PAINT_INC_COLOR_PALETTE_H_
 
+#include <utility>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <memory>
+
+#include "pixel.h"
+#include "color.h"
+#include "palette.h"
+
 namespace paint
 {
-    class ColorPalette
+    /**
+     * @brief A color stored as an index into a Palette.
+     *
+     * Converting into the other colors reads the palette entry, setting the color picks the nearest palette entry.
+     * The palette is shared (and never changed), so copying the color is cheap.
+     *
+     */
+    class ColorPalette : public Color
     {
+    public:
+        explicit ColorPalette(std::shared_ptr<const Palette> palette, uint8_t index = 0) : palette_{std::move(palette)}, pixel_{index} {}
+        virtual ~ColorPalette() override {}
+        virtual ColorPalette *clone() const override { return new ColorPalette{*this}; }
+
+        ColorPalette(const ColorPalette &other) = default;
+        ColorPalette(ColorPalette &&other) = default;
+
+        ColorPalette &operator=(const ColorPalette &other) = default;
+        bool operator==(const ColorPalette &other) const { return pixel_ == other.pixel_ && *palette_ == *other.palette_; }
+
+        virtual ColorRGB565 ToRGB565() const override;
+        virtual ColorBGR565 ToBGR565() const override;
+        virtual ColorRGB888 ToRGB888() const override;
+        virtual ColorBGR888 ToBGR888() const override;
+        virtual ColorGrayscale ToGrayscale() const override;
+        virtual ColorBW ToBW() const override;
+        virtual ColorBGRA8888 ToBGRA8888() const override;
+
+        /**
+         * @brief Sets the index of the palette color nearest to other.
+         *
+         */
+        virtual void SetColor(const Color &other) override;
+        void SetIndex(uint8_t index)
+        {
+            pixel_.i = index;
+        }
+
+        /**
+         * @brief Sets the index of the palette color nearest to the inverted color.
+         *
+         */
+        virtual void InvertColor() override;
+
+        /**
+         * @brief Sets the index of the palette color nearest to the interpolated color.
+         *
+         */
+        virtual void Interpolate(const std::shared_ptr<Color> &c1, const std::shared_ptr<Color> &c2, float percent_c1) override;
+
+        virtual void SetFromData(const void *data) override
+        {
+            std::copy_n(reinterpret_cast<const PixelIndexed8 *>(data), 1, &pixel_);
         };
+        virtual void *GetData() override { return reinterpret_cast<void *>(&pixel_); };
+        virtual size_t GetDataSize() const override { return sizeof(PixelIndexed8); };
+        virtual size_t GetDataSizeBits() const override { return 8; };
+        virtual ColorFormat GetColorFormat() const override { return ColorFormat::kIndexed8; };
+
+        uint8_t GetIndex() const { return pixel_.i; }
+        const std::shared_ptr<const Palette> &GetPalette() const { return palette_; }
+
+    private:
+        std::shared_ptr<const Palette> palette_;
+        PixelIndexed8 pixel_;
+    };
 }
 
-#endif // PAINT_INC_COLOR_PALETTE_H_
\ No newline at end of file
+#endif // PAINT_INC_COLOR_PALETTE_H_
@@ -16,6 +16,7 @@ namespace paint
     {
     public:
         ColorRGB565() = default;
+        explicit ColorRGB565(const PixelRGB565 &pixel) : pixel_{pixel} {}
         ColorRGB565(uint8_t red, uint8_t green, uint8_t blue) : pixel_{red, green, blue} {}
         virtual ~ColorRGB565() override {}
         virtual ColorRGB565 *clone() const override { return new ColorRGB565{*this}; }
@@ -35,6 +36,7 @@ namespace paint
         virtual ColorBGR888 ToBGR888() const override;
         virtual ColorGrayscale ToGrayscale() const override;
         virtual ColorBW ToBW() const override;
+        virtual ColorBGRA8888 ToBGRA8888() const override;
 
         virtual void SetFromData(const void *data) override
         {
@@ -70,6 +72,7 @@ namespace paint
         virtual void *GetData() override { return reinterpret_cast<void *>(&pixel_); };
         virtual size_t GetDataSize() const override { return sizeof(PixelRGB565); };
         virtual size_t GetDataSizeBits() const override { return 16; };
+        virtual ColorFormat GetColorFormat() const override { return ColorFormat::kRGB565; };
 
     private:
         PixelRGB565 pixel_;
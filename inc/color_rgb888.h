@@ -16,6 +16,7 @@ namespace paint
     {
     public:
         ColorRGB888() = default;
+        explicit ColorRGB888(const PixelRGB888 &pixel) : pixel_{pixel} {}
         ColorRGB888(uint8_t red, uint8_t green, uint8_t blue) : pixel_{red, green, blue} {}
         virtual ~ColorRGB888() override{};
         virtual ColorRGB888 *clone() const override { return new ColorRGB888{*this}; }
@@ -33,6 +34,7 @@ namespace paint
         virtual ColorBGR888 ToBGR888() const override;
         virtual ColorGrayscale ToGrayscale() const override;
         virtual ColorBW ToBW() const override;
+        virtual ColorBGRA8888 ToBGRA8888() const override;
 
         virtual void SetColor(const Color &other) { *this = std::move(other.ToRGB888()); };
         void SetColor(uint8_t red, uint8_t green, uint8_t blue)
@@ -68,6 +70,7 @@ namespace paint
         virtual void *GetData() override { return reinterpret_cast<void *>(&pixel_); };
         virtual size_t GetDataSize() const override { return sizeof(PixelRGB888); };
         virtual size_t GetDataSizeBits() const override { return 24; };
+        virtual ColorFormat GetColorFormat() const override { return ColorFormat::kRGB888; };
 
     private:
         PixelRGB888 pixel_;
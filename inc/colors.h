@@ -10,5 +10,7 @@
 #include "color_bgr888.h"
 #include "color_grayscale.h"
 #include "color_bw.h"
+#include "color_bgra8888.h"
+#include "color_palette.h"
 
 #endif // PAINT_INC_COLORS_H_
\ No newline at end of file
@@ -9,7 +9,10 @@
 #include "point.h"
 #include "color.h"
 #include "image.h"
+#include "image_bmp.h"
 #include "rotation.h"
+#include "dither.h"
+#include "resample.h"
 
 namespace paint
 {
@@ -43,8 +46,26 @@ namespace paint
             return path_to_file_;
         }
 
+        void AddLoadMode(LoadMode load_mode) { load_mode_ = load_mode; };
+
+        LoadMode GetLoadMode() const
+        {
+            return load_mode_.value_or(LoadMode::kRead);
+        }
+
+        void AddPixelLayout(PixelLayout pixel_layout) { pixel_layout_ = pixel_layout; };
+
+        std::optional<PixelLayout> GetPixelLayout() const
+        {
+            return pixel_layout_;
+        }
+
     private:
         std::filesystem::path path_to_file_;
+
+        // Optional parameters
+        std::optional<LoadMode> load_mode_;
+        std::optional<PixelLayout> pixel_layout_;
     };
 
     class SaveCommand : public Command
@@ -84,6 +105,29 @@ namespace paint
         std::filesystem::path path_to_file_;
     };
 
+    class PyramidCommand : public Command
+    {
+    public:
+        PyramidCommand(size_t level_count, std::filesystem::path path_to_file) : Command("PyramidCommand"), level_count_(level_count), path_to_file_(path_to_file){};
+        virtual ~PyramidCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            im.SavePyramid(level_count_, path_to_file_);
+        }
+
+        size_t GetLevelCount() const { return level_count_; }
+
+        std::filesystem::path FilePath() const
+        {
+            return path_to_file_;
+        }
+
+    private:
+        size_t level_count_;
+        std::filesystem::path path_to_file_;
+    };
+
     class ColorCommand : public Command
     {
     public:
@@ -109,11 +153,12 @@ namespace paint
 
         virtual void Invoke(Image &im) override
         {
-            im.painter.DrawLine(*start_point_, *end_point_, line_color_, line_width_);
+            im.painter.DrawLine(*start_point_, *end_point_, line_color_, line_width_, antialias_.value_or(false));
         };
 
         void AddLineColor(std::shared_ptr<Color> &&color) { line_color_.emplace(std::move(color)); };
         void AddLineWidth(Unit color) { line_width_.emplace(color); };
+        void SetLineAntialias(bool antialias) { antialias_ = antialias; };
 
     private:
         std::shared_ptr<BasePoint> start_point_;
@@ -122,6 +167,7 @@ namespace paint
         // Optional parameters
         std::optional<std::shared_ptr<Color>> line_color_;
         std::optional<Unit> line_width_;
+        std::optional<bool> antialias_;
     };
 
     class CircleCommand : public Command
@@ -173,17 +219,46 @@ namespace paint
 
         virtual void Invoke(Image &im) override
         {
-            im.painter.DrawBucket(*point_, fill_color_);
+            im.painter.DrawBucket(*point_, fill_color_, tolerance_);
         };
 
         void AddFillColor(std::shared_ptr<Color> &&color) { fill_color_ = std::make_optional<std::shared_ptr<Color>>(std::move(color)); };
         void AddFillColor(const Color &color) { fill_color_ = std::make_optional<std::shared_ptr<Color>>(color.clone()); };
+        void AddTolerance(uint8_t tolerance) { tolerance_ = tolerance; };
+
+        uint8_t GetTolerance() const { return tolerance_; }
 
     private:
         std::shared_ptr<BasePoint> point_;
 
         // Optional parameters
         std::optional<std::shared_ptr<Color>> fill_color_;
+        uint8_t tolerance_ = 0;
+    };
+
+    class ReplaceColorCommand : public Command
+    {
+    public:
+        explicit ReplaceColorCommand(std::shared_ptr<Color> &&color) : Command("ReplaceColorCommand"), color_{std::move(color)} {};
+        virtual ~ReplaceColorCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            im.painter.ReplaceColor(*color_, fill_color_, tolerance_);
+        };
+
+        void AddFillColor(std::shared_ptr<Color> &&color) { fill_color_ = std::make_optional<std::shared_ptr<Color>>(std::move(color)); };
+        void AddTolerance(uint8_t tolerance) { tolerance_ = tolerance; };
+
+        const Color &GetColor() const { return *color_; }
+        uint8_t GetTolerance() const { return tolerance_; }
+
+    private:
+        std::shared_ptr<Color> color_;
+
+        // Optional parameters
+        std::optional<std::shared_ptr<Color>> fill_color_;
+        uint8_t tolerance_ = 0;
     };
 
     class CropCommand : public Command
@@ -212,11 +287,18 @@ namespace paint
 
         virtual void Invoke(Image &im) override
         {
-            im.painter.Resize(*new_size_);
+            im.painter.Resize(*new_size_, filter_);
         };
 
+        void AddFilter(ResampleFilter filter) { filter_ = filter; };
+
+        ResampleFilter GetFilter() const { return filter_; }
+
     private:
         std::shared_ptr<BasePoint> new_size_;
+
+        // Optional parameters
+        ResampleFilter filter_ = ResampleFilter::kInterpolate; // Set the bilinear interpolation as default
     };
 
     // TODO RotateCommand
@@ -259,6 +341,128 @@ namespace paint
         };
     };
 
+    class LinearLightCommand : public Command
+    {
+    public:
+        explicit LinearLightCommand(bool linear_light) : Command("LinearLightCommand"), linear_light_(linear_light){};
+        virtual ~LinearLightCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            im.painter.SetLinearLight(linear_light_);
+        };
+
+        bool IsLinearLight() const { return linear_light_; }
+
+    private:
+        bool linear_light_;
+    };
+
+    class DeferCommand : public Command
+    {
+    public:
+        explicit DeferCommand(bool deferred_drawing) : Command("DeferCommand"), deferred_drawing_(deferred_drawing){};
+        virtual ~DeferCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            im.painter.SetDeferredDrawing(deferred_drawing_);
+        };
+
+        bool IsDeferredDrawing() const { return deferred_drawing_; }
+
+    private:
+        bool deferred_drawing_;
+    };
+
+    class ParallelFillCommand : public Command
+    {
+    public:
+        explicit ParallelFillCommand(PixelIndex parallel_fill_pixels) : Command("ParallelFillCommand"), parallel_fill_pixels_(parallel_fill_pixels){};
+        virtual ~ParallelFillCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            im.painter.SetParallelFillPixels(parallel_fill_pixels_);
+        };
+
+        PixelIndex GetParallelFillPixels() const { return parallel_fill_pixels_; }
+
+    private:
+        PixelIndex parallel_fill_pixels_;
+    };
+
+    class QuantizeCommand : public Command
+    {
+    public:
+        explicit QuantizeCommand(size_t max_colors) : Command("QuantizeCommand"), max_colors_(max_colors){};
+        virtual ~QuantizeCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            im.painter.Quantize(max_colors_);
+        };
+
+        size_t GetMaxColors() const { return max_colors_; }
+
+    private:
+        size_t max_colors_;
+    };
+
+    class DitherCommand : public Command
+    {
+    public:
+        explicit DitherCommand(ColorFormat target_format) : Command("DitherCommand"), target_format_(target_format){};
+        virtual ~DitherCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            if (target_format_ == ColorFormat::kBW)
+                im.painter.ConvertToBW(dither_method_);
+            else
+                im.painter.ConvertToRGB565(dither_method_);
+        };
+
+        ColorFormat GetTargetFormat() const { return target_format_; }
+
+        void AddDitherMethod(DitherMethod dither_method) { dither_method_ = dither_method; };
+
+        DitherMethod GetDitherMethod() const { return dither_method_; }
+
+    private:
+        ColorFormat target_format_;
+
+        // Optional parameters
+        DitherMethod dither_method_ = DitherMethod::kFloydSteinberg; // Set Floyd-Steinberg as default
+    };
+
+    class OverlayCommand : public Command
+    {
+    public:
+        explicit OverlayCommand(std::shared_ptr<BasePoint> &&position, std::filesystem::path path_to_file) : Command("OverlayCommand"),
+                                                                                                            position_(std::move(position)),
+                                                                                                            path_to_file_(path_to_file){};
+        virtual ~OverlayCommand(){};
+
+        virtual void Invoke(Image &im) override
+        {
+            // The overlay is loaded once and blended over every image of the batch
+            if (!overlay_)
+            {
+                overlay_ = std::make_unique<image_bmp::ImageBMP>(path_to_file_);
+                overlay_->LoadImage();
+            }
+
+            im.painter.DrawOverlay(*overlay_->GetImageData(), *position_);
+        };
+
+    private:
+        std::shared_ptr<BasePoint> position_;
+        std::filesystem::path path_to_file_;
+
+        std::unique_ptr<Image> overlay_;
+    };
+
     class UndoCommand : public Command
     {
     public:
@@ -0,0 +1,66 @@
+#ifndef PAINT_INC_CONVERT_SPAN_H_
+#define PAINT_INC_CONVERT_SPAN_H_
+
+#include <cstddef>
+
+#include "color.h"
+
+namespace paint
+{
+    /**
+     * @brief Instruction sets used by the ConvertSpan() and BlendSpan() kernels.
+     *
+     */
+    enum class SimdLevel
+    {
+        kScalar, /// Plain C++ kernels.
+        kSSE41,  /// SSE4.1 kernels.
+        kAVX2,   /// AVX2 kernels (SSE4.1 kernels where there is no AVX2 version).
+        kAVX512, /// AVX-512 kernels (AVX2 kernels where there is no AVX-512 version).
+    };
+
+    /**
+     * @brief Returns the instruction set used by ConvertSpan() and BlendSpan().
+     *
+     * The best level supported by the CPU (from CPUID) is selected when the program starts.
+     * All the levels give the same result.
+     *
+     */
+    SimdLevel GetSimdLevel();
+
+    /**
+     * @brief Selects the instruction set used by ConvertSpan() and BlendSpan() (i.e. to compare the kernels).
+     *
+     * @param level the requested level, levels not supported by the CPU are lowered to the best supported one.
+     * @return SimdLevel the selected level.
+     */
+    SimdLevel SetSimdLevel(SimdLevel level);
+
+    /**
+     * @brief Converts n continuous pixels from src_format into dst_format.
+     *
+     * The pixels are stored one pixel structure after another (as in a linear row), BW pixels are one byte each.
+     * The result is the same as converting every pixel with Color::SetColor(), but the format pair is selected once per span.
+     * Pairs with a simple byte layout (the same format, 24-bit color -> grayscale or BW, grayscale -> BW)
+     * have dedicated kernels working on the channel bytes, the other pairs use the PixelTraits conversions.
+     * 24-bit color and 565 to grayscale or BW have SIMD kernels selected by GetSimdLevel().
+     * Grayscale to 565 and BW to 565 or grayscale use precomputed lookup tables.
+     * Indexed pixels (kIndexed8) are only copied, their colors are converted by Palette::ConvertIndices()
+     * (any other pair with kIndexed8 throws std::invalid_argument).
+     *
+     * @param src_format format of the source pixels.
+     * @param dst_format format of the destination pixels.
+     * @param src the first source pixel.
+     * @param dst the first destination pixel (must not overlap src unless the formats are the same).
+     * @param n number of pixels.
+     */
+    void ConvertSpan(ColorFormat src_format, ColorFormat dst_format, const void *src, void *dst, size_t n);
+
+    /**
+     * @brief Returns the size of the pixel structure of format in bytes.
+     *
+     */
+    size_t PixelSize(ColorFormat format);
+}
+
+#endif // PAINT_INC_CONVERT_SPAN_H_
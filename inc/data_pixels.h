@@ -2,15 +2,21 @@
 #define PAINT_INC_DATA_PIXEL_H
 
 #include <exception>
+#include <algorithm>
+#include <stdexcept>
 #include <memory>
+#include <vector>
 #include <cstring>
 
 #include "unit.h"
 #include "point.h"
 #include "color.h"
+#include "dither.h"
 
 namespace paint
 {
+    class Palette;
+
     /**
      * @brief A exception class
      * 
@@ -26,37 +32,102 @@ namespace paint
         virtual const char *what() const noexcept override { return "Copying data with different underlying structure"; }
     };
 
+    /**
+     * @brief Layout of the pixels in memory.
+     * 
+     */
+    enum class PixelLayout
+    {
+        kLinear, /// Rows stored one after another.
+        kTiled,  /// Square tiles of DataPixels::kTileSize pixels, each stored row after row.
+        kPlanar, /// Each 8-bit channel in its own plane of rows (see DataPixels::IsPlanarSupported()).
+        kPacked, /// 1-bit pixels (ColorBW) packed 8 per byte, rows stored one after another.
+    };
+
     /**
      * @brief A class used for storing and access of the pixel data
      * 
      * This class is used for storing and access of the pixel data without any color information, just the size of a single pixel.
      * 
-     * DataPixels gives the option to access the underlying pixels with DataPixels::operator[] or DataPixels::at().
+     * Each row of pixels starts at a multiple of the row alignment (see DataPixels::GetRowStride()),
+     * the bytes between the end of the row and the start of the next row are padding (always 0).
+     * The row alignment is set when DataPixels is created. BMP images use 4 byte alignment, so that the rows
+     * have the same layout as the BMP pixel array. The default alignment is a cache line,
+     * so that row kernels start on a cache line boundary.
+     * 
+     * The pixels are stored either row after row (PixelLayout::kLinear), or in square tiles of DataPixels::kTileSize pixels
+     * (PixelLayout::kTiled), where each tile is stored as a small linear image. Tiles keep pixels that are close in both directions
+     * close in memory, so operations that walk the image by columns (i.e. Rotate) do not thrash the cache on large images.
+     * In the tiled layout the row stride is the stride of a row inside of a tile.
+     * 
+     * Pixels made of 8-bit channels (RGB888, BGR888, grayscale) can also be stored in planes (PixelLayout::kPlanar):
+     * the n-th byte of every pixel is stored in the n-th plane, which is a linear image of bytes. Per-channel operations
+     * then work on continuous bytes. In the planar layout the row stride is the stride of a row of a plane.
+     * 
+     * BW pixels can be packed 8 per byte (PixelLayout::kPacked), the first pixel in the most significant bit, so the rows
+     * are the same as the BMP 1bpp rows. The packed rows are aligned to at least 8 bytes, so the kernels can process
+     * them by 64-bit words (see packed_bits.h). The bits after the last pixel of a packed row are always 0.
+     * 
+     * DataPixels gives the option to access the underlying pixels with DataPixels::operator[], DataPixels::at() or DataPixels::RowPtr().
      * DataPixels::at() performs bounds checking and throws std::out_of_range if arguments are out of bounds.
+     * DataPixels::RowPtr() is only valid for the linear layout, use DataPixels::CopyRowTo() and DataPixels::CopyRowFrom() for any layout.
+     * The planar and packed layouts have no addressable pixels, so only DataPixels::CopyRowTo(), DataPixels::CopyRowFrom(), DataPixels::CopyPixelTo(),
+     * DataPixels::CopyPixelFrom() and DataPixels::PlaneRowPtr() (or DataPixels::PackedRowPtr()) can be used with them.
+     * 
+     * DataPixel also implements DataPixels::iterator used in range-based for loop (it skips the row padding).
      * 
-     * DataPixel also implements DataPixels::iterator used in range-based for loop
+     * The pixels are stored in chunks: a tile in the tiled layout, or a band of DataPixels::kTileSize rows in the linear layout
+     * or in a plane (rows inside of a band are continuous, so DataPixels::RowPtr() works as before). The chunks are reference counted,
+     * copy of DataPixels shares all of them (i.e. the undo history) and a shared chunk is cloned only when it is written to.
+     * Chunks can also be read-only data owned by someone else (i.e. memory mapped file).
+     * DataPixels::MakeWritable() has to be called for the changed region before the pixels are changed in place.
      *  
      */
     class DataPixels
     {
     public:
-        DataPixels(Point image_size, std::unique_ptr<Color> &&color_type) : pixel_struct_size_byte_(color_type->GetDataSize()),
-                                                                            image_size_(image_size),
-                                                                            pixel_count_(image_size.x * image_size.y),
-                                                                            data_color_(std::move(color_type)),
-                                                                            data_(std::unique_ptr<uint8_t[]>(new uint8_t[pixel_count_ * pixel_struct_size_byte_]))
+        /**
+         * @brief Constants for the row alignment.
+         * 
+         */
+        enum
         {
-        }
+            kCacheLineRowAlignment = 64, /// Rows start on a cache line (default).
+        };
 
-        DataPixels(const DataPixels &other) : pixel_struct_size_byte_(other.data_color_->GetDataSize()),
-                                              image_size_(other.image_size_),
-                                              pixel_count_(other.pixel_count_),
-                                              data_color_(std::unique_ptr<Color>(other.data_color_->clone()))
+        /**
+         * @brief Constants for the tiled layout.
+         * 
+         */
+        enum
         {
-            size_t byte_count = pixel_count_ * pixel_struct_size_byte_;
-            data_ = std::unique_ptr<uint8_t[]>(new uint8_t[byte_count]);
-            std::copy_n(reinterpret_cast<uint8_t *>(other.data_.get()), byte_count, reinterpret_cast<uint8_t *>(data_.get()));
-        }
+            kTileSizeShift = 6,                 /// log2 of kTileSize.
+            kTileSize = 1 << kTileSizeShift,    /// Width and height of a tile in pixels.
+            kTileSizeMask = kTileSize - 1,      /// Mask of the position inside of a tile.
+        };
+
+        DataPixels(Point image_size, std::unique_ptr<Color> &&color_type, size_t row_alignment = kCacheLineRowAlignment);
+        DataPixels(Point image_size, std::unique_ptr<Color> &&color_type, PixelLayout layout, size_t row_alignment = kCacheLineRowAlignment);
+
+        /**
+         * @brief Creates linear DataPixels on top of read-only pixel data owned by someone else (i.e. a mapped file).
+         * 
+         * The data is not copied until DataPixels::MakeWritable() is called for the region, copies of this DataPixels share the same data.
+         * read_only_data has to hold image_size.y rows of DataPixels::GetRowStride() bytes (row size rounded up to row_alignment).
+         * The row padding of read_only_data does not have to be 0.
+         * 
+         * @param image_size dimensions of the pixel data.
+         * @param color_type color type of the pixels.
+         * @param read_only_data the first pixel, the shared pointer keeps the data alive.
+         * @param row_alignment alignment of the rows in read_only_data.
+         */
+        DataPixels(Point image_size, std::unique_ptr<Color> &&color_type, std::shared_ptr<const uint8_t> read_only_data, size_t row_alignment);
+
+        /**
+         * @brief Creates DataPixels sharing all the chunks of other (no pixels are copied).
+         * 
+         */
+        DataPixels(const DataPixels &other);
 
         ~DataPixels(){};
 
@@ -64,19 +135,36 @@ namespace paint
         /**
          * @brief A DataPixels iterator.
          * 
+         * Iterates the pixels row by row and skips the padding at the end of each row.
+         * In the tiled layout the row is walked through segments that lie in the same tile.
+         * 
          */
         class iterator
         {
         public:
-            iterator(uint8_t *ptr, size_t pixel_struct_size_byte) : ptr_(ptr), pixel_struct_size_byte_(pixel_struct_size_byte) {}
-            iterator(const iterator &other) : ptr_(other.ptr_), pixel_struct_size_byte_(other.pixel_struct_size_byte_) {}
+            iterator(DataPixels &data, Unit y) : data_(&data), ptr_(nullptr), segment_end_(nullptr), x_(0), y_(y) { SetSegment(); }
+            iterator(const iterator &other) = default;
 
             void *operator*() { return ptr_; }
 
             // Pre-increment
             iterator &operator++()
             {
-                ptr_ += pixel_struct_size_byte_;
+                ptr_ += data_->pixel_struct_size_byte_;
+
+                // Reached the end of row segment -> move to the next one (skips the padding)
+                if (ptr_ == segment_end_)
+                {
+                    x_ += data_->GetSegmentLength(x_);
+                    if (x_ >= data_->image_size_.x)
+                    {
+                        x_ = 0;
+                        y_++;
+                    }
+
+                    SetSegment();
+                }
+
                 return *this;
             }
 
@@ -91,19 +179,41 @@ namespace paint
             bool operator!=(const iterator &other) { return !(*this == other); }
 
         private:
-            uint8_t *ptr_;                  /// Pointer to the current position in pixel data.
-            size_t pixel_struct_size_byte_; /// Size of a single pixel in bytes.
+            /**
+             * @brief Points the iterator at the row segment starting at (x_, y_), the rows after the last one are the end (nullptr).
+             * 
+             */
+            void SetSegment()
+            {
+                if (y_ >= data_->image_size_.y)
+                {
+                    ptr_ = segment_end_ = nullptr;
+                    return;
+                }
+
+                ptr_ = data_->PixelPtr(x_, y_);
+                segment_end_ = ptr_ + data_->GetSegmentLength(x_) * data_->pixel_struct_size_byte_;
+            }
+
+            DataPixels *data_;     /// Iterated DataPixels.
+            uint8_t *ptr_;         /// Pointer to the current position in pixel data.
+            uint8_t *segment_end_; /// Pointer to the end of the current row segment (without padding).
+            Unit x_;               /// Column of the first pixel in the current row segment.
+            Unit y_;               /// Current row.
         };
 
         /**
          * @brief A random access operator for pixels in DataPixels.
          * 
+         * Prefer DataPixels::RowPtr(), this operator has to split pos into the row and column.
+         * 
          * @param pos the position of pixels (represented as linear array of pixels).
          * @return void* pointer to the pixel at \ref pos.
          */
         void *operator[](size_t pos)
         {
-            return &data_[pos * pixel_struct_size_byte_];
+            size_t width = static_cast<size_t>(image_size_.x);
+            return PixelPtr(pos % width, pos / width);
         }
         /**
          * @brief A random access method with position as coordinates.
@@ -120,7 +230,118 @@ namespace paint
             {
                 throw std::out_of_range("Accesssing data pixels out of range.");
             }
-            return &data_[(y * image_size_.x + x) * pixel_struct_size_byte_];
+            return PixelPtr(x, y);
+        }
+        /**
+         * @brief Returns the pointer to the first pixel of a row.
+         * 
+         * No bounds checking is done. The pointer is aligned to the row alignment.
+         * Valid only for PixelLayout::kLinear, the rows of tiled data are not continuous.
+         * The next rows follow the row for DataPixels::GetContinuousRows() rows.
+         * 
+         * @param y the row.
+         * @return void* pointer to the first pixel of row y.
+         */
+        void *RowPtr(Unit y) { return PixelPtr(0, y); }
+
+        /**
+         * @brief Get the number of rows stored one after another starting at row y (linear layout only).
+         * 
+         * @param y the first row.
+         * @return Unit number of continuous rows (till the end of the row band).
+         */
+        Unit GetContinuousRows(Unit y) const { return std::min<Unit>(kTileSize - (y & kTileSizeMask), image_size_.y - y); }
+
+        /**
+         * @brief Copies the pixels of row y into dst (in any layout).
+         * 
+         * @param y the row.
+         * @param dst buffer for DataPixels::GetRowSize() bytes.
+         */
+        void CopyRowTo(Unit y, void *dst) const;
+
+        /**
+         * @brief Copies the pixels from src into row y (in any layout).
+         * 
+         * @param y the row.
+         * @param src buffer with DataPixels::GetRowSize() bytes.
+         */
+        void CopyRowFrom(Unit y, const void *src);
+
+        /**
+         * @brief Copies the pixels of row y into dst converted into format (in any layout).
+         * 
+         * Indexed pixels are converted by their Palette, other pixels by ConvertSpan().
+         * Pixels can only be converted into kIndexed8 if they are indexed already.
+         * 
+         * @param y the row.
+         * @param format format of the destination pixels.
+         * @param dst buffer for a row of pixels of format (BW pixels are one byte each).
+         */
+        void ConvertRowTo(Unit y, ColorFormat format, void *dst) const;
+
+        /**
+         * @brief Copies the pixel at (x, y) into dst (in any layout, no bounds checking).
+         * 
+         * @param dst buffer for a single pixel.
+         */
+        void CopyPixelTo(Unit x, Unit y, void *dst) const;
+
+        /**
+         * @brief Copies the pixel from src to (x, y) (in any layout, no bounds checking).
+         * 
+         * The pixel has to be writable (see DataPixels::MakeWritable()).
+         * 
+         * @param src buffer with a single pixel.
+         */
+        void CopyPixelFrom(Unit x, Unit y, const void *src);
+
+        /**
+         * @brief Returns the pointer to the first byte of row y in the plane (planar layout only, no bounds checking).
+         * 
+         * @param plane the plane (index of the byte in the interleaved pixel).
+         * @param y the row.
+         * @return void* pointer to the first byte of the row.
+         */
+        void *PlaneRowPtr(size_t plane, Unit y) { return PlanePtr(plane, 0, y); }
+
+        /**
+         * @brief Returns the pointer to the first byte of the packed row y (packed layout only, no bounds checking).
+         * 
+         * The row has DataPixels::GetRowStride() bytes, which is a multiple of 8.
+         * 
+         * @param y the row.
+         * @return void* pointer to the first byte of the row.
+         */
+        void *PackedRowPtr(Unit y) { return PixelPtr(0, y); }
+
+        /**
+         * @brief Get the number of planes (1 for the interleaved layouts).
+         * 
+         */
+        size_t GetPlaneCount() const { return layout_ == PixelLayout::kPlanar ? chunk_count_.x : 1; }
+
+        /**
+         * @brief Whether the pixels of the format can be stored in PixelLayout::kPlanar (pixels made of 8-bit channels).
+         * 
+         */
+        static bool IsPlanarSupported(ColorFormat format)
+        {
+            return format == ColorFormat::kRGB888 || format == ColorFormat::kBGR888 || format == ColorFormat::kGrayscale;
+        }
+
+        /**
+         * @brief Whether the pixels of the format can be stored in the layout.
+         * 
+         */
+        static bool IsLayoutSupported(PixelLayout layout, ColorFormat format)
+        {
+            if (layout == PixelLayout::kPlanar)
+                return IsPlanarSupported(format);
+            if (layout == PixelLayout::kPacked)
+                return format == ColorFormat::kBW;
+
+            return true;
         }
 
         /**
@@ -128,30 +349,33 @@ namespace paint
          * 
          * @return iterator to the beginning of the DataPixels.
          */
-        iterator begin() { return iterator(data_.get(), pixel_struct_size_byte_); }
+        iterator begin() { return iterator(*this, 0); }
         /**
          * @brief Returns the iterator to the one pixel after the end of the DataPixels.
          * 
          * @return iterator to the one after the last pixel of the DataPixels.
          */
-        iterator end() { return iterator(data_.get() + pixel_count_ * pixel_struct_size_byte_, pixel_struct_size_byte_); }
+        iterator end() { return iterator(*this, image_size_.y); }
 
         /**
          * @brief Coppies data from another DataPixels.
          * 
          * If \ref other does not have the same size of the data or different size of pixel
          * then this method throws \ref error_data_mismatch.
+         * The chunks of other are shared, they are cloned once either of the DataPixels writes to them.
          * 
          * @param other where to copy the data from.
          */
         void CopyData(DataPixels &other)
         {
-            // Other does not have the same size of the data or different size of pixel -> throw
-            if ((pixel_struct_size_byte_ != other.pixel_struct_size_byte_) || (pixel_count_ != other.pixel_count_))
+            // Other does not have the same size of the data, different size of pixel or different layout -> throw
+            if ((pixel_struct_size_byte_ != other.pixel_struct_size_byte_) || (pixel_count_ != other.pixel_count_) ||
+                (row_stride_byte_ != other.row_stride_byte_) || (layout_ != other.layout_) || !(image_size_ == other.image_size_))
                 throw error_data_mismatch();
 
-            // Copy all the data
-            std::copy_n(reinterpret_cast<uint8_t *>(other.data_.get()), pixel_struct_size_byte_ * pixel_count_, reinterpret_cast<uint8_t *>(data_.get()));
+            // Share all the data
+            chunks_ = other.chunks_;
+            chunk_data_ = other.chunk_data_;
         }
 
         /**
@@ -161,55 +385,105 @@ namespace paint
          * 
          * @return std::unique_ptr<Color> a clone of Color instance.
          */
-        std::unique_ptr<Color> GetColorType() { return std::unique_ptr<Color>(data_color_->clone()); }
+        std::unique_ptr<Color> GetColorType() const { return std::unique_ptr<Color>(data_color_->clone()); }
+
+        /**
+         * @brief Get the ColorFormat of the pixels.
+         * 
+         * @return ColorFormat format of the Color associated with this DataPixels.
+         */
+        ColorFormat GetColorFormat() const { return data_color_->GetColorFormat(); }
+
+        /**
+         * @brief Get the Palette of indexed pixels.
+         * 
+         * @return std::shared_ptr<const Palette> palette of the ColorPalette associated with this DataPixels (nullptr for other colors).
+         */
+        std::shared_ptr<const Palette> GetPalette() const;
 
         /**
          * @brief Transforms DataPixels to new color type.
          * 
          * Allocates space for new pixel data and then transforms each pixel to the new color.
+         * The layout is kept, planar and packed data becomes linear if the new color cannot be stored in the layout.
+         * Pixels transformed into ColorPalette get the nearest colors of its palette (see PaletteMapper).
          * 
          * @param new_color \ref Color to tranform to.
          */
-        void TransformToColorType(const std::unique_ptr<Color> &new_color)
-        {
-            size_t new_pixel_size = new_color->GetDataSize();
+        void TransformToColorType(const std::unique_ptr<Color> &new_color);
 
-            // Allocate space for pixel data
-            std::unique_ptr<uint8_t[]> new_data(new uint8_t[pixel_count_ * new_pixel_size]);
-
-            // Create iterators to old pixel data
-            iterator it_old = begin();
-            iterator it_old_end = end();
+        /**
+         * @brief Transforms DataPixels to new color type and dithers the pixels.
+         * 
+         * The pixels are converted to grayscale (for BW) or RGB888 (for 565), dithered with DitherPixels() and converted to the new color.
+         * Colors that do not lose any levels (see IsDitherFormat()) are transformed without dithering.
+         * 
+         * @param new_color \ref Color to tranform to.
+         * @param dither dithering method.
+         */
+        void TransformToColorType(const std::unique_ptr<Color> &new_color, DitherMethod dither);
 
-            // Create iterator to new pixel data
-            iterator it_new(new_data.get(), new_pixel_size);
+        /**
+         * @brief Whether any of the pixel data is read-only data owned by someone else (i.e. a mapped file).
+         * 
+         */
+        bool IsReadOnly() const;
 
-            // Saves the pointer to the color data that will change inside for loop
-            // There is no need to call Color::GetData() each loop,
-            //      because the address does not change, only data inside Color changes
-            void *old_color_data_ptr = data_color_->GetData();
-            void *new_color_data_ptr = new_color->GetData();
+        /**
+         * @brief Get the number of chunks shared with other DataPixels or owned by someone else.
+         * 
+         * @return size_t number of chunks that would be cloned by DataPixels::MakeWritable().
+         */
+        size_t GetSharedChunkCount() const;
 
-            // For each pixel: load the color, tranform the color and then save the color
-            for (; it_old != it_old_end; it_old++, it_new++)
-            {
-                // Copy from data_ to old_color
-                std::copy_n(reinterpret_cast<uint8_t *>(*it_old), pixel_struct_size_byte_, reinterpret_cast<uint8_t *>(old_color_data_ptr));
+        /**
+         * @brief Clones all the shared chunks into own buffers (copy-on-write).
+         * 
+         * Has to be called before the pixels are changed in place. Does nothing if the data is already writable.
+         * 
+         */
+        void MakeWritable();
 
-                // Set grayscale_color from old_color
-                new_color->SetColor(*data_color_);
+        /**
+         * @brief Clones the shared chunks covering the pixels in [p1, p2) (copy-on-write).
+         * 
+         * The region is clipped to the image, the other chunks stay shared.
+         * 
+         * @param p1 the first pixel of the region.
+         * @param p2 one after the last pixel of the region (in both directions).
+         */
+        void MakeWritable(Point p1, Point p2);
 
-                // Copy grayscale_color data to new_data
-                std::copy_n(reinterpret_cast<uint8_t *>(new_color_data_ptr), new_pixel_size, reinterpret_cast<uint8_t *>(*it_new));
+        /**
+         * @brief Clones the shared chunks containing the pixel at (x, y) (copy-on-write, no bounds checking).
+         * 
+         */
+        void MakeWritable(Unit x, Unit y)
+        {
+            // All the planes of the pixel
+            size_t chunk = ChunkIndex(x, y);
+            for (size_t last = chunk + GetPlaneCount(); chunk < last; chunk++)
+            {
+                if (!IsChunkWritable(chunk))
+                    CloneChunk(chunk);
             }
+        }
 
-            // Update the DataPixels to new color type
-            pixel_struct_size_byte_ = new_color->GetDataSize();
-            data_color_ = std::unique_ptr<Color>(new_color->clone());
+        /**
+         * @brief Get the layout of the pixels in memory.
+         * 
+         * @return PixelLayout the current layout.
+         */
+        PixelLayout GetLayout() const { return layout_; }
 
-            // Swap the old data of DataPixels with new data
-            data_.swap(new_data);
-        }
+        /**
+         * @brief Rearranges the pixels into the new layout.
+         * 
+         * Allocates space for new pixel data and copies the pixels tile by tile.
+         * 
+         * @param layout the new layout.
+         */
+        void ConvertLayout(PixelLayout layout);
 
         /**
          * @brief Get the dimensions of data.
@@ -218,6 +492,59 @@ namespace paint
          */
         Point GetSize() { return image_size_; }
 
+        /**
+         * @brief Get the number of pixels (may not fit into Unit for large images).
+         * 
+         * @return size_t number of pixels.
+         */
+        size_t GetPixelCount() const { return pixel_count_; }
+
+        /**
+         * @brief Get the distance between the starts of 2 rows.
+         * 
+         * In the tiled layout this is the distance between 2 rows inside of a tile.
+         * 
+         * @return size_t row stride in bytes (row size + padding).
+         */
+        size_t GetRowStride() const { return row_stride_byte_; }
+
+        /**
+         * @brief Get the size of the pixels in one row (without padding).
+         * 
+         * This is the size of the row copied by DataPixels::CopyRowTo(), the planar and packed rows are stored differently.
+         * 
+         * @return size_t row size in bytes.
+         */
+        size_t GetRowSize() const { return static_cast<size_t>(image_size_.x) * pixel_struct_size_byte_; }
+
+        /**
+         * @brief Get the size of the bytes with pixels in one packed row (without padding).
+         * 
+         * @return size_t packed row size in bytes.
+         */
+        size_t GetPackedRowSize() const { return (static_cast<size_t>(image_size_.x) + 7) / 8; }
+
+        /**
+         * @brief Get the alignment of the rows.
+         * 
+         * @return size_t the row alignment in bytes.
+         */
+        size_t GetRowAlignment() const { return row_alignment_byte_; }
+
+        /**
+         * @brief Get the size of the whole pixel data (including the row padding).
+         * 
+         * @return size_t size of pixel data in bytes.
+         */
+        size_t GetDataSize() const
+        {
+            if (layout_ == PixelLayout::kTiled)
+                return static_cast<size_t>(chunk_count_.x) * chunk_count_.y * GetChunkSize(0);
+
+            // Linear layout has 1 plane
+            return static_cast<size_t>(chunk_count_.x) * image_size_.y * row_stride_byte_;
+        }
+
         /**
          * @brief Swaps the DataPixel objects.
          * 
@@ -228,19 +555,147 @@ namespace paint
             std::swap(pixel_struct_size_byte_, other.pixel_struct_size_byte_);
             std::swap(image_size_, other.image_size_);
             std::swap(pixel_count_, other.pixel_count_);
+            std::swap(row_alignment_byte_, other.row_alignment_byte_);
+            std::swap(row_stride_byte_, other.row_stride_byte_);
+            std::swap(layout_, other.layout_);
+            std::swap(chunk_count_, other.chunk_count_);
             std::swap(data_color_, other.data_color_);
-            std::swap(data_, other.data_);
+            std::swap(chunks_, other.chunks_);
+            std::swap(chunk_data_, other.chunk_data_);
         }
 
     private:
-        size_t pixel_struct_size_byte_;     /// Size of single pixel.
-        Point image_size_;                  /// Dimensions of pixel data (rows, columns).
-        size_t pixel_count_;                /// Number of total pixels.
-        std::unique_ptr<Color> data_color_; /// Color type associated with this DataPixels.
-        std::unique_ptr<uint8_t[]> data_;   /// Pointer to pixel data.
+        /**
+         * @brief A reference counted block of pixels (a tile or a band of rows).
+         * 
+         * The chunk can be written in place only if it is owned and nobody else shares it.
+         * 
+         */
+        struct Chunk
+        {
+            std::shared_ptr<const void> owner; /// Keeps the pixels alive (own buffer or shared read-only data).
+            bool is_owned;                     /// The pixels are in a buffer allocated by DataPixels (not read-only data).
+        };
+
+        /**
+         * @brief Computes the row stride and number of chunks from the dimensions, layout and row alignment.
+         * 
+         * Throws std::invalid_argument if the row alignment is not power of 2
+         * or if the layout cannot store the pixels (see DataPixels::IsLayoutSupported()).
+         * 
+         */
+        void InitLayout();
+
+        /**
+         * @brief Allocates all the chunks with row_alignment_byte_ and sets the row padding to 0.
+         * 
+         */
+        void AllocateData();
+
+        /**
+         * @brief Allocates a buffer for a chunk from BufferPool::GetDefault(), the pixels are left uninitialized.
+         * 
+         */
+        std::shared_ptr<uint8_t> AllocateChunk(size_t chunk) const;
+
+        /**
+         * @brief Replaces the chunk with its own copy.
+         * 
+         */
+        void CloneChunk(size_t chunk);
+
+        /**
+         * @brief Whether the chunk is owned and not shared with anyone.
+         * 
+         */
+        bool IsChunkWritable(size_t chunk) const { return chunks_[chunk].is_owned && chunks_[chunk].owner.use_count() == 1; }
+
+        /**
+         * @brief Get the size of a chunk in bytes (the last row band can be shorter).
+         * 
+         */
+        size_t GetChunkSize(size_t chunk) const
+        {
+            if (layout_ == PixelLayout::kTiled)
+                return row_stride_byte_ * kTileSize;
+
+            Unit band = static_cast<Unit>(chunk / chunk_count_.x);
+            Unit rows = std::min<Unit>(kTileSize, image_size_.y - (band << kTileSizeShift));
+            return rows * row_stride_byte_;
+        }
+
+        /**
+         * @brief Returns index of the chunk containing the pixel at (x, y) (the first plane for the planar layout).
+         * 
+         */
+        size_t ChunkIndex(Unit x, Unit y) const
+        {
+            if (layout_ == PixelLayout::kTiled)
+                return static_cast<size_t>(y >> kTileSizeShift) * chunk_count_.x + (x >> kTileSizeShift);
+
+            return static_cast<size_t>(y >> kTileSizeShift) * chunk_count_.x;
+        }
+
+        /**
+         * @brief Returns pointer to the pixel at (x, y) in the current layout (no bounds checking).
+         * 
+         */
+        uint8_t *PixelPtr(Unit x, Unit y) const
+        {
+            // Pointer to the byte with the pixel for the packed layout
+            if (layout_ == PixelLayout::kPacked)
+                return chunk_data_[ChunkIndex(x, y)] + (y & kTileSizeMask) * row_stride_byte_ + (x >> 3);
+
+            Unit x_in_chunk = layout_ == PixelLayout::kTiled ? (x & kTileSizeMask) : x;
+            return chunk_data_[ChunkIndex(x, y)] + (y & kTileSizeMask) * row_stride_byte_ + x_in_chunk * pixel_struct_size_byte_;
+        }
+
+        /**
+         * @brief Returns pointer to the byte of the pixel at (x, y) in the plane (planar layout only, no bounds checking).
+         * 
+         */
+        uint8_t *PlanePtr(size_t plane, Unit x, Unit y) const
+        {
+            return chunk_data_[static_cast<size_t>(y >> kTileSizeShift) * chunk_count_.x + plane] + (y & kTileSizeMask) * row_stride_byte_ + x;
+        }
+
+        /**
+         * @brief Copies the pixels row by row into new_data while transforming them into the color of new_data.
+         * 
+         * Used for planar, packed and indexed data (or indexed new_data).
+         * 
+         */
+        void TransformRows(DataPixels &new_data) const;
+
+        /**
+         * @brief Returns the number of continuous pixels in the row starting at column x.
+         * 
+         */
+        Unit GetSegmentLength(Unit x) const
+        {
+            if (layout_ == PixelLayout::kTiled)
+                return std::min<Unit>(kTileSize - (x & kTileSizeMask), image_size_.x - x);
+
+            return image_size_.x - x;
+        }
+
+        size_t pixel_struct_size_byte_;                   /// Size of single pixel.
+        Point image_size_;                                /// Dimensions of pixel data (rows, columns).
+        size_t pixel_count_;                              /// Number of total pixels.
+        size_t row_alignment_byte_;                       /// Alignment of each row.
+        size_t row_stride_byte_;                          /// Distance between the starts of 2 rows (row size + padding).
+        PixelLayout layout_;                              /// Layout of the pixels in memory.
+        Point chunk_count_;                               /// Number of chunks in each direction (1 column of row bands for the linear layout, a column for each plane for the planar layout).
+        std::unique_ptr<Color> data_color_;               /// Color type associated with this DataPixels.
+        std::vector<Chunk> chunks_;                       /// Owners of the chunks (row of chunks after row of chunks).
+        std::vector<uint8_t *> chunk_data_;               /// Pointer to the first pixel of each chunk.
 
         // The Painter can edit PixelData
         friend class Painter;
+
+        // Typed views access the pixel data directly
+        template <typename PixelT>
+        friend class DataPixelsView;
     };
 }
 
@@ -0,0 +1,420 @@
+#ifndef PAINT_INC_DATA_PIXELS_VIEW_H_
+#define PAINT_INC_DATA_PIXELS_VIEW_H_
+
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <type_traits>
+
+#include "unit.h"
+#include "point.h"
+#include "pixel.h"
+#include "pixel_ops.h"
+#include "data_pixels.h"
+
+namespace paint
+{
+    /**
+     * @brief A typed rectangular block of pixels inside DataPixels.
+     * 
+     * The tile is at most DataPixels::kTileSize x DataPixels::kTileSize pixels (smaller at the right and bottom edge of the image).
+     * Rows of the tile are continuous in memory, so the tile can be walked with plain pointers
+     * regardless of the layout of DataPixels.
+     * 
+     * Coordinates passed to DataPixelsTile are relative to the tile origin.
+     * 
+     * @tparam PixelT pixel structure (see pixel.h).
+     */
+    template <typename PixelT>
+    class DataPixelsTile
+    {
+    public:
+        using pixel_type = PixelT;
+
+        DataPixelsTile(uint8_t *data, size_t row_stride_byte, Point origin, Point size) : data_(data),
+                                                                                          row_stride_byte_(row_stride_byte),
+                                                                                          origin_(origin),
+                                                                                          size_(size) {}
+
+        /**
+         * @brief Returns the pointer to the first pixel of a row of the tile.
+         * 
+         * @param y the row (relative to the tile origin).
+         * @return PixelT* pointer to the first pixel of the row.
+         */
+        PixelT *Row(Unit y) const { return reinterpret_cast<PixelT *>(data_ + y * row_stride_byte_); }
+
+        /**
+         * @brief Access the pixel at (x, y) relative to the tile origin without bounds checking.
+         * 
+         */
+        PixelT &operator()(Unit x, Unit y) const { return Row(y)[x]; }
+
+        Point GetOrigin() const { return origin_; }
+        Point GetSize() const { return size_; }
+        Unit Width() const { return size_.x; }
+        Unit Height() const { return size_.y; }
+
+    private:
+        uint8_t *data_;          /// Pointer to the first pixel of the tile.
+        size_t row_stride_byte_; /// Distance between 2 rows in bytes.
+        Point origin_;           /// Position of the first pixel in the image.
+        Point size_;             /// Dimensions of the tile.
+    };
+
+    /**
+     * @brief A typed view of the pixels inside DataPixels.
+     * 
+     * DataPixels only knows the size of a single pixel, so every access returns a 'void *'.
+     * DataPixelsView knows the pixel structure at compile time, so the pixels can be read and written
+     * as plain structures without any Color object or virtual call in between.
+     * 
+     * The view works with both layouts of DataPixels:
+     * - operator()(), at(), FillRow() and ForEachRowSegment() work with any layout.
+     * - Row() is only valid for PixelLayout::kLinear.
+     * - Tile() and ForEachTile() split the image into DataPixels::kTileSize blocks in any layout.
+     *   For the tiled layout the blocks are the stored tiles, for the linear layout the blocks
+     *   are just cache friendly parts of the rows.
+     * 
+     * Planar data (PixelLayout::kPlanar) with more than one plane has no interleaved pixels,
+     * it is viewed one plane at a time as PixelGrayscale bytes (see DispatchChannelViews()).
+     * Packed data (PixelLayout::kPacked) has no addressable pixels and cannot be viewed (see packed_bits.h).
+     * 
+     * The view does not own the data. It is valid only as long as the viewed DataPixels is alive
+     * and its data is not reallocated (i.e. DataPixels::SwapData() or DataPixels::TransformToColorType()).
+     * The view follows the chunks cloned by DataPixels::MakeWritable(), but pointers returned before the call
+     * (rows, tiles, segments) still point to the old chunk.
+     * Writing through the view requires writable data (see DataPixels::MakeWritable()).
+     * 
+     * Use DispatchDataPixelsView() to create the view with the right PixelT.
+     * 
+     * @tparam PixelT pixel structure (see pixel.h) matching the Color of the DataPixels.
+     */
+    template <typename PixelT>
+    class DataPixelsView
+    {
+    public:
+        using pixel_type = PixelT;
+
+        explicit DataPixelsView(DataPixels &data) : chunk_data_(data.chunk_data_.data()),
+                                                    image_size_(data.image_size_),
+                                                    row_stride_byte_(data.row_stride_byte_),
+                                                    is_tiled_(data.layout_ == PixelLayout::kTiled),
+                                                    chunk_count_x_(data.chunk_count_.x),
+                                                    plane_(0)
+        {
+            if (data.pixel_struct_size_byte_ != sizeof(PixelT) || data.GetPlaneCount() != 1 || data.layout_ == PixelLayout::kPacked)
+                throw error_data_mismatch();
+        }
+
+        /**
+         * @brief Creates a view of a single plane of planar data (PixelT has to be a single byte).
+         * 
+         * @param data the planar DataPixels.
+         * @param plane the viewed plane.
+         */
+        DataPixelsView(DataPixels &data, size_t plane) : chunk_data_(data.chunk_data_.data()),
+                                                         image_size_(data.image_size_),
+                                                         row_stride_byte_(data.row_stride_byte_),
+                                                         is_tiled_(false),
+                                                         chunk_count_x_(data.chunk_count_.x),
+                                                         plane_(plane)
+        {
+            if (data.layout_ != PixelLayout::kPlanar || sizeof(PixelT) != 1 || plane >= data.GetPlaneCount())
+                throw error_data_mismatch();
+        }
+
+        /**
+         * @brief Returns the pointer to the first pixel of a row.
+         * 
+         * Valid only for PixelLayout::kLinear.
+         * 
+         * @param y the row.
+         * @return PixelT* pointer to the first pixel of the row.
+         */
+        PixelT *Row(Unit y) const { return reinterpret_cast<PixelT *>(Ptr(0, y)); }
+
+        /**
+         * @brief Access the pixel at (x, y) without bounds checking.
+         * 
+         * @param x the x coordinate of pixel.
+         * @param y the y coordinate of pixel.
+         * @return PixelT& the pixel at (x, y).
+         */
+        PixelT &operator()(Unit x, Unit y) const { return *reinterpret_cast<PixelT *>(Ptr(x, y)); }
+
+        /**
+         * @brief Access the pixel at (x, y) with bounds checking.
+         * 
+         * Throws std::out_of_range if coordinates are out of bounds.
+         * 
+         * @param x the x coordinate of pixel.
+         * @param y the y coordinate of pixel.
+         * @return PixelT& the pixel at (x, y).
+         */
+        PixelT &at(Unit x, Unit y) const
+        {
+            if (x < 0 || y < 0 || x >= image_size_.x || y >= image_size_.y)
+            {
+                throw std::out_of_range("Accesssing data pixels view out of range.");
+            }
+            return (*this)(x, y);
+        }
+
+        /**
+         * @brief Calls fn for each continuous part of the pixels [x_begin, x_end) in row y.
+         * 
+         * For the linear layout fn is called once.
+         * 
+         * @param y the row.
+         * @param x_begin the first pixel.
+         * @param x_end one after the last pixel.
+         * @param fn callable taking (PixelT *segment, Unit x, Unit count), where x is the column of the first pixel in segment.
+         */
+        template <typename Function>
+        void ForEachRowSegment(Unit y, Unit x_begin, Unit x_end, Function &&fn) const
+        {
+            if (!is_tiled_)
+            {
+                if (x_begin < x_end)
+                    fn(Row(y) + x_begin, x_begin, x_end - x_begin);
+                return;
+            }
+
+            for (Unit x = x_begin; x < x_end;)
+            {
+                Unit count = std::min<Unit>(DataPixels::kTileSize - (x & DataPixels::kTileSizeMask), x_end - x);
+                fn(&(*this)(x, y), x, count);
+                x += count;
+            }
+        }
+
+        /**
+         * @brief Fills the pixels [x_begin, x_end) in row y with pixel.
+         * 
+         * @param y the row.
+         * @param x_begin the first pixel to fill.
+         * @param x_end one after the last pixel to fill.
+         * @param pixel the pixel to fill with.
+         */
+        void FillRow(Unit y, Unit x_begin, Unit x_end, const PixelT &pixel) const
+        {
+            ForEachRowSegment(y, x_begin, x_end, [&pixel](PixelT *segment, Unit, Unit count) {
+                FillPixels(segment, count, pixel);
+            });
+        }
+
+        /**
+         * @brief Get the number of tiles in each direction.
+         * 
+         * @return Point number of tiles (columns, rows).
+         */
+        Point GetTileCount() const
+        {
+            return Point{(image_size_.x + DataPixels::kTileSizeMask) >> DataPixels::kTileSizeShift,
+                         (image_size_.y + DataPixels::kTileSizeMask) >> DataPixels::kTileSizeShift};
+        }
+
+        /**
+         * @brief Returns the tile at tile coordinates (tile_x, tile_y).
+         * 
+         */
+        DataPixelsTile<PixelT> Tile(Unit tile_x, Unit tile_y) const
+        {
+            Point origin{tile_x << DataPixels::kTileSizeShift, tile_y << DataPixels::kTileSizeShift};
+            Point size{std::min<Unit>(DataPixels::kTileSize, image_size_.x - origin.x),
+                       std::min<Unit>(DataPixels::kTileSize, image_size_.y - origin.y)};
+
+            return DataPixelsTile<PixelT>(Ptr(origin.x, origin.y), row_stride_byte_, origin, size);
+        }
+
+        /**
+         * @brief Returns the tile containing the pixel at position.
+         * 
+         */
+        DataPixelsTile<PixelT> TileAt(Point position) const
+        {
+            return Tile(position.x >> DataPixels::kTileSizeShift, position.y >> DataPixels::kTileSizeShift);
+        }
+
+        /**
+         * @brief Calls fn for each tile of the image (row of tiles after row of tiles).
+         * 
+         * @param fn callable taking DataPixelsTile<PixelT>.
+         */
+        template <typename Function>
+        void ForEachTile(Function &&fn) const
+        {
+            Point tile_count = GetTileCount();
+            for (Unit tile_y = 0; tile_y < tile_count.y; tile_y++)
+            {
+                for (Unit tile_x = 0; tile_x < tile_count.x; tile_x++)
+                    fn(Tile(tile_x, tile_y));
+            }
+        }
+
+        bool IsTiled() const { return is_tiled_; }
+        Point GetSize() const { return image_size_; }
+        Unit Width() const { return image_size_.x; }
+        Unit Height() const { return image_size_.y; }
+
+    private:
+        /**
+         * @brief Pointer to the pixel at (x, y) inside of its chunk (same as DataPixels::PixelPtr()).
+         * 
+         */
+        uint8_t *Ptr(Unit x, Unit y) const
+        {
+            if (is_tiled_)
+            {
+                size_t chunk = static_cast<size_t>(y >> DataPixels::kTileSizeShift) * chunk_count_x_ + (x >> DataPixels::kTileSizeShift);
+                return chunk_data_[chunk] + (y & DataPixels::kTileSizeMask) * row_stride_byte_ + (x & DataPixels::kTileSizeMask) * sizeof(PixelT);
+            }
+
+            // Linear layout has a single column of chunks, the planar layout a column for each plane
+            size_t chunk = static_cast<size_t>(y >> DataPixels::kTileSizeShift) * chunk_count_x_ + plane_;
+            return chunk_data_[chunk] + (y & DataPixels::kTileSizeMask) * row_stride_byte_ + x * sizeof(PixelT);
+        }
+
+        uint8_t *const *chunk_data_; /// Pointers to the first pixel of each chunk (owned by DataPixels).
+        Point image_size_;           /// Dimensions of the viewed data.
+        size_t row_stride_byte_;     /// Distance between 2 rows in bytes (inside of a tile for the tiled layout).
+        bool is_tiled_;              /// Whether the data uses PixelLayout::kTiled.
+        Unit chunk_count_x_;         /// Number of chunks in a row of chunks (1 for the linear layout, number of planes for the planar layout).
+        size_t plane_;               /// The viewed plane (planar layout only).
+    };
+
+    /**
+     * @brief A tag carrying the pixel type selected by DispatchPixelType().
+     * 
+     */
+    template <typename PixelT>
+    struct PixelTag
+    {
+        using type = PixelT;
+    };
+
+    /**
+     * @brief Calls fn with PixelTag of the pixel structure used by format.
+     * 
+     * The switch is done once and fn is instantiated for every pixel structure,
+     * so the code inside fn works with concrete types.
+     * 
+     * @param format the color format to dispatch on.
+     * @param fn a generic callable taking PixelTag<PixelT>.
+     * @return whatever fn returns (must be the same type for all pixel types).
+     */
+    template <typename Function>
+    decltype(auto) DispatchPixelType(ColorFormat format, Function &&fn)
+    {
+        switch (format)
+        {
+        case ColorFormat::kRGB565:
+            return fn(PixelTag<PixelRGB565>{});
+        case ColorFormat::kBGR565:
+            return fn(PixelTag<PixelBGR565>{});
+        case ColorFormat::kRGB888:
+            return fn(PixelTag<PixelRGB888>{});
+        case ColorFormat::kBGR888:
+            return fn(PixelTag<PixelBGR888>{});
+        case ColorFormat::kGrayscale:
+            return fn(PixelTag<PixelGrayscale>{});
+        case ColorFormat::kBW:
+            return fn(PixelTag<PixelBW>{});
+        case ColorFormat::kBGRA8888:
+            return fn(PixelTag<PixelBGRA8888>{});
+        case ColorFormat::kIndexed8:
+            return fn(PixelTag<PixelIndexed8>{});
+        }
+
+        throw std::invalid_argument("Unknown color format.");
+    }
+
+    /**
+     * @brief Calls fn with DataPixelsView matching the color type of data.
+     * 
+     * @param data the DataPixels to view.
+     * @param fn a generic callable taking DataPixelsView<PixelT>.
+     * @return whatever fn returns (must be the same type for all pixel types).
+     */
+    template <typename Function>
+    decltype(auto) DispatchDataPixelsView(DataPixels &data, Function &&fn)
+    {
+        return DispatchPixelType(data.GetColorFormat(), [&](auto tag) {
+            return fn(DataPixelsView<typename decltype(tag)::type>(data));
+        });
+    }
+
+    /**
+     * @brief Calls fn with views of data for operations that treat every channel the same way (copy, invert, interpolate...).
+     * 
+     * Interleaved data is viewed once with the pixel structure (plane 0), planar data is viewed
+     * one plane at a time as PixelGrayscale bytes.
+     * 
+     * @param data the DataPixels to view.
+     * @param fn a generic callable taking (DataPixelsView<PixelT>, size_t plane).
+     */
+    template <typename Function>
+    void DispatchChannelViews(DataPixels &data, Function &&fn)
+    {
+        if (data.GetLayout() != PixelLayout::kPlanar)
+        {
+            DispatchDataPixelsView(data, [&](auto view) { fn(view, size_t{0}); });
+            return;
+        }
+
+        for (size_t plane = 0; plane < data.GetPlaneCount(); plane++)
+            fn(DataPixelsView<PixelGrayscale>(data, plane), plane);
+    }
+
+    /**
+     * @brief Calls fn with the views of the same channels of 2 DataPixels (see DispatchChannelViews()).
+     * 
+     * Both DataPixels have to have the same color and layout (the dimensions can differ).
+     * 
+     * @param data the first DataPixels (i.e. the source).
+     * @param other the second DataPixels (i.e. the destination).
+     * @param fn a generic callable taking (DataPixelsView<PixelT> view, DataPixelsView<PixelT> other_view).
+     */
+    template <typename Function>
+    void DispatchChannelViews(DataPixels &data, DataPixels &other, Function &&fn)
+    {
+        if (data.GetColorFormat() != other.GetColorFormat() || data.GetLayout() != other.GetLayout())
+            throw error_data_mismatch();
+
+        DispatchChannelViews(data, [&](auto view, size_t plane) {
+            using PixelT = typename decltype(view)::pixel_type;
+
+            if (data.GetLayout() == PixelLayout::kPlanar)
+                fn(view, DataPixelsView<PixelT>(other, plane));
+            else
+                fn(view, DataPixelsView<PixelT>(other));
+        });
+    }
+
+    /**
+     * @brief Returns the part of pixel stored in the view with ChannelT pixels (see DispatchChannelViews()).
+     * 
+     * @tparam ChannelT pixel type of the view (PixelT or PixelGrayscale for a plane).
+     * @param pixel the whole pixel.
+     * @param plane the plane of the view.
+     * @return ChannelT the pixel itself or its byte in the plane.
+     */
+    template <typename ChannelT, typename PixelT>
+    ChannelT GetChannelPixel(const PixelT &pixel, size_t plane)
+    {
+        if constexpr (std::is_same_v<ChannelT, PixelT>)
+        {
+            return pixel;
+        }
+        else
+        {
+            ChannelT channel;
+            std::memcpy(&channel, reinterpret_cast<const uint8_t *>(&pixel) + plane, sizeof(ChannelT));
+            return channel;
+        }
+    }
+}
+
+#endif // PAINT_INC_DATA_PIXELS_VIEW_H_
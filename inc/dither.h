@@ -0,0 +1,61 @@
+#ifndef PAINT_INC_DITHER_H_
+#define PAINT_INC_DITHER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "color.h"
+#include "point.h"
+
+namespace paint
+{
+    /**
+     * @brief Methods used to hide the quantization error when reducing the bit depth.
+     *
+     */
+    enum class DitherMethod
+    {
+        kBayer,          /// Ordered dithering with 8x8 Bayer threshold matrix.
+        kFloydSteinberg, /// Error diffusion with Floyd-Steinberg weights (7, 3, 5, 1) / 16.
+        kAtkinson,       /// Error diffusion with Atkinson weights (six neighbours get 1 / 8 each, 2 / 8 of the error is lost).
+    };
+
+    /**
+     * @brief Returns whether dithering to format does anything.
+     *
+     * Only the BW and the 565 formats have fewer levels per channel than the 24-bit color.
+     *
+     */
+    bool IsDitherFormat(ColorFormat format);
+
+    /**
+     * @brief Returns the format of the rows passed to DitherPixels() for target format.
+     *
+     * BW is dithered from grayscale rows and the 565 formats from RGB888 rows.
+     *
+     */
+    ColorFormat DitherSourceFormat(ColorFormat target_format);
+
+    /**
+     * @brief Dithers the pixels in place to the levels that target_format can hold.
+     *
+     * The pixels are rows of DitherSourceFormat(target_format) and after dithering every channel holds
+     * one of the values the target format converts back to (0 or 255 for BW, multiples of 8 or 4 for 565),
+     * so ConvertSpan() into target_format stores them without any further loss.
+     *
+     * Bayer dithering splits the rows between the threads.
+     * Error diffusion runs as a wavefront: every thread takes the next row and follows
+     * the row above it two pixels behind, so all the errors of the pixels above are already diffused.
+     * The errors are summed as integers, so the result does not depend on the number of threads.
+     *
+     * @param method dithering method.
+     * @param target_format BW, RGB565 or BGR565.
+     * @param pixels the first pixel of the first row.
+     * @param stride distance between the rows in bytes.
+     * @param size width and height of the image.
+     * @param thread_count number of threads (0 = std::thread::hardware_concurrency()).
+     */
+    void DitherPixels(DitherMethod method, ColorFormat target_format, uint8_t *pixels, size_t stride, Point size, unsigned thread_count = 0);
+}
+
+#endif // PAINT_INC_DITHER_H_
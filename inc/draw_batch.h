@@ -0,0 +1,193 @@
+#ifndef PAINT_INC_DRAW_BATCH_H_
+#define PAINT_INC_DRAW_BATCH_H_
+
+#include <cstdint>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include "unit.h"
+#include "point.h"
+#include "pixel.h"
+#include "color.h"
+#include "data_pixels.h"
+#include "raster.h"
+#include "row_blender.h"
+
+namespace paint
+{
+    /**
+     * @brief A color of a primitive converted for DataPixels of one color format.
+     *
+     * The color is converted once when the primitive is created (i.e. the nearest palette color is searched once).
+     *
+     */
+    struct PrimitiveColor
+    {
+        /**
+         * @brief Converts the color.
+         *
+         * @param data the image the primitive is drawn into (its color format and palette).
+         * @param color the color.
+         * @param blend whether the color is blended even if opaque (i.e. by the coverage of antialiased pixels).
+         */
+        PrimitiveColor(const DataPixels &data, const Color &color, bool blend = false);
+
+        bool blend;                 /// Whether the color is blended over the image (translucent color or blend).
+        PixelBGRA8888 blend_pixel;  /// Premultiplied color to blend.
+        uint8_t pixel[4];           /// The color as the pixel of data (opaque color).
+    };
+
+    /**
+     * @brief A line ready to be drawn into DataPixels of one color format.
+     *
+     */
+    struct LinePrimitive
+    {
+        /**
+         * @brief Constructs the line.
+         *
+         * @param data the image the line is drawn into (its color format and palette).
+         * @param start start point of the line (in the rows of data).
+         * @param end end point of the line (in the rows of data).
+         * @param width width of the line.
+         * @param antialias whether the edges of the line are antialiased.
+         * @param color color of the line.
+         */
+        LinePrimitive(const DataPixels &data, Point start, Point end, Unit width, bool antialias, const Color &color);
+
+        Point start;
+        Point end;
+        Unit width;
+        bool antialias;
+        PrimitiveColor color;
+        Point box_begin; /// Bounding box [box_begin, box_end) of the pixels the line can cover (not clipped).
+        Point box_end;
+    };
+
+    /**
+     * @brief A circle ready to be drawn into DataPixels of one color format (see CircleRasterizer).
+     *
+     */
+    struct CirclePrimitive
+    {
+        /**
+         * @brief Constructs the circle.
+         *
+         * @param data the image the circle is drawn into (its color format and palette).
+         * @param center center of the circle (in the rows of data).
+         * @param radius radius of the middle of the border.
+         * @param border_width width of the border.
+         * @param fill whether the inside of the circle is filled.
+         * @param fill_color color of the inside.
+         * @param border_color color of the border.
+         */
+        CirclePrimitive(const DataPixels &data, Point center, Unit radius, Unit border_width, bool fill, const Color &fill_color, const Color &border_color);
+
+        Point center;
+        Unit radius;
+        Unit border_width;
+        bool fill;
+        PrimitiveColor fill_color;
+        PrimitiveColor border_color;
+        Point box_begin; /// Bounding box [box_begin, box_end) of the pixels the circle can cover (not clipped).
+        Point box_end;
+    };
+
+    /**
+     * @brief Draws the primitives into one DataPixels (one thread).
+     *
+     * The runs of the opaque primitives are filled with the pixel (see FillPixels()), the translucent
+     * and antialiased runs are blended (see RowBlender).
+     * The buffers are kept between the primitives, so drawing many primitives allocates nothing.
+     *
+     */
+    class PrimitiveRenderer
+    {
+    public:
+        /**
+         * @brief Constructs the renderer.
+         *
+         * @param data the image to draw into.
+         * @param make_writable whether the renderer copies the shared chunks under the runs before drawing them
+         *                      (see DataPixels::MakeWritable()), otherwise the rows have to be writable already.
+         */
+        PrimitiveRenderer(DataPixels &data, bool make_writable);
+
+        /**
+         * @brief Draws the rows [row_begin, row_end) of the line.
+         *
+         */
+        void Draw(const LinePrimitive &line, Unit row_begin, Unit row_end);
+
+        /**
+         * @brief Draws the whole line.
+         *
+         */
+        void Draw(const LinePrimitive &line) { Draw(line, 0, data_.GetSize().y); }
+
+        /**
+         * @brief Draws the rows [row_begin, row_end) of the circle (the inside first).
+         *
+         */
+        void Draw(const CirclePrimitive &circle, Unit row_begin, Unit row_end);
+
+        /**
+         * @brief Draws the whole circle.
+         *
+         */
+        void Draw(const CirclePrimitive &circle) { Draw(circle, 0, data_.GetSize().y); }
+
+        /**
+         * @brief Fills the runs with the opaque color, or blends the translucent color over them (i.e. the region of DrawBucket()).
+         *
+         */
+        void FillSpans(const std::vector<RowSpan> &spans, const PrimitiveColor &color);
+
+    private:
+        DataPixels &data_;
+        bool make_writable_;
+        std::optional<RowBlender> blender_; // Created by the first blended color (indexed data maps the colors to its palette)
+        std::vector<RowSpan> spans_;
+        std::vector<RowSpan> fill_spans_;
+        std::vector<PixelBGRA8888> row_pixels_; // Color scaled by the coverage of an antialiased row
+    };
+
+    /**
+     * @brief Records lines and circles and draws them all at once on multiple threads.
+     *
+     * The image is split into bands of DataPixels::kTileSize rows (the chunks of DataPixels) and every primitive is binned
+     * into the bands its bounding box crosses. The bands are drawn in parallel, each by one thread,
+     * with the primitives of the band in the order they were added, so they overlap the same way as when drawn one by one.
+     * A primitive crossing many bands is rasterized only in the rows of each band (see LineRasterizer::ClipRows()).
+     *
+     */
+    class DrawBatch
+    {
+    public:
+        static constexpr Unit kBandHeight = DataPixels::kTileSize; /// Height of the bands drawn by one thread.
+
+        void Add(const LinePrimitive &line) { primitives_.emplace_back(line); }
+        void Add(const CirclePrimitive &circle) { primitives_.emplace_back(circle); }
+
+        bool IsEmpty() const { return primitives_.empty(); }
+        size_t GetSize() const { return primitives_.size(); }
+
+        void Clear() { primitives_.clear(); }
+
+        /**
+         * @brief Draws all the primitives into data and clears the batch.
+         *
+         * The chunks of the bands with some primitives are copied first (see DataPixels::MakeWritable()).
+         *
+         * @param data the image the primitives were created for.
+         * @param thread_count number of threads (0 = DefaultThreadCount()).
+         */
+        void Render(DataPixels &data, unsigned thread_count = 0);
+
+    private:
+        std::vector<std::variant<LinePrimitive, CirclePrimitive>> primitives_;
+    };
+}
+
+#endif // PAINT_INC_DRAW_BATCH_H_
@@ -0,0 +1,60 @@
+#ifndef PAINT_INC_FLOOD_FILL_H_
+#define PAINT_INC_FLOOD_FILL_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "unit.h"
+#include "point.h"
+#include "data_pixels.h"
+#include "raster.h"
+
+namespace paint
+{
+    /// Number of the found pixels after which FindRegion() searches the region in parallel by default.
+    constexpr PixelIndex kParallelFillPixels = PixelIndex{1} << 22;
+
+    /**
+     * @brief Finds the 4-connected region of the pixels with the color of the seed pixel (scanline flood fill).
+     *
+     * The region is searched by runs: the run of the seed is extended to the left and to the right in its row,
+     * then the rows above and below the run are searched for runs of the color, which are extended the same way
+     * (an explicit stack of the runs to search). The found runs are marked in a map with 1 bit per pixel,
+     * so the data is only read and the map skips the found runs by whole words.
+     *
+     * The pixels are compared as the pixel structures of the format (see DispatchPixelType()), planar pixels
+     * by their bytes in the planes and packed pixels by words (see packed_bits.h).
+     * With a tolerance the rows are first matched into bits by ColorMatcher (only the rows the search reads).
+     *
+     * A huge region is found faster by all the threads: once the search finds more than parallel_pixel_count pixels
+     * (and more than the pixels of the image divided by the threads, the part of the image each thread reads in parallel),
+     * it stops and the region is searched again by FindRegionParallel().
+     *
+     * @param data the image.
+     * @param seed the first pixel of the region (has to be inside of data).
+     * @param spans the runs of the region (cleared first), sorted by the rows and the columns, no pixel twice.
+     * @param tolerance the largest difference of a channel of the region pixels from the seed pixel (see ColorMatcher).
+     * @param parallel_pixel_count number of the found pixels after which the region is searched in parallel.
+     * @param thread_count number of threads (0 = DefaultThreadCount(), 1 = never in parallel).
+     */
+    void FindRegion(DataPixels &data, Point seed, std::vector<RowSpan> &spans, uint8_t tolerance = 0, PixelIndex parallel_pixel_count = kParallelFillPixels, unsigned thread_count = 0);
+
+    /**
+     * @brief Finds the same region as FindRegion() on multiple threads.
+     *
+     * The image is split into strips of whole bands of chunks. Each thread finds all the runs of the color in its strips
+     * and joins the touching runs of the neighbouring rows into sets (union-find), then the sets touching across
+     * the borders of the strips are joined. The runs in the set of the run with the seed are the region.
+     *
+     * Every pixel of the image is read once, so it is faster than FindRegion() only for a region covering a big part of the image.
+     *
+     * @param data the image.
+     * @param seed the first pixel of the region (has to be inside of data).
+     * @param spans the runs of the region (cleared first), sorted by the rows and the columns, no pixel twice.
+     * @param tolerance the largest difference of a channel of the region pixels from the seed pixel (see ColorMatcher).
+     * @param thread_count number of threads (0 = DefaultThreadCount()).
+     */
+    void FindRegionParallel(DataPixels &data, Point seed, std::vector<RowSpan> &spans, uint8_t tolerance = 0, unsigned thread_count = 0);
+}
+
+#endif // PAINT_INC_FLOOD_FILL_H_
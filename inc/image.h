@@ -4,6 +4,7 @@
 #include <deque>
 #include <memory>
 #include <functional>
+#include <optional>
 
 #include "file.h"
 #include "data_pixels.h"
@@ -11,6 +12,16 @@
 
 namespace paint
 {
+    /**
+     * @brief How the image pixels are loaded from file.
+     * 
+     */
+    enum class LoadMode
+    {
+        kRead, /// Read the pixels into own memory (default).
+        kMap,  /// Map the file into memory and use its pixels directly where the format allows it (copied on first edit).
+    };
+
     /**
     * @brief Abtract class for image
     * 
@@ -60,6 +71,37 @@ namespace paint
         }
         void DumpImageHistory();
 
+        /**
+         * @brief Saves the halvings of the image (see Painter::MakePyramid()), the image stays the same.
+         * 
+         * The level n is saved as 'name_n.ext' next to the output file (name.ext), or next to path if given.
+         * A path with only a directory or with the name '*' keeps the name of the output file.
+         * 
+         * @param level_count number of the halvings.
+         * @param path the file the names of the levels are made from.
+         */
+        void SavePyramid(size_t level_count, const std::filesystem::path &path = std::filesystem::path());
+
+        /**
+         * @brief Get the current image data (i.e. to draw it over another image).
+         * 
+         */
+        std::shared_ptr<const DataPixels> GetImageData() const { return image_data_; }
+
+        /**
+         * @brief Sets how the pixels are loaded by the next Image::LoadImage().
+         * 
+         */
+        void SetLoadMode(LoadMode load_mode) { load_mode_ = load_mode; }
+
+        /**
+         * @brief Sets the layout of the pixels loaded by the next Image::LoadImage() (by default chosen by the image size).
+         * 
+         * A layout that cannot store the pixels of the image (i.e. planar layout for RGB565) is ignored.
+         * 
+         */
+        void SetPixelLayout(std::optional<PixelLayout> pixel_layout) { pixel_layout_ = pixel_layout; }
+
         /**
          * @brief Sets the output image path
          * 
@@ -92,7 +134,6 @@ namespace paint
         std::shared_ptr<DataPixels> image_data_;                          /// Stores the current image data.
         std::deque<std::shared_ptr<DataPixels>> image_data_undo_history_; /// Stores the image history.
         std::deque<std::shared_ptr<DataPixels>> image_data_redo_history_; /// Stores the previously undone images.
-        std::unique_ptr<uint8_t[]> unprocessed_data;                      /// Storage for data before saving/loading pixel data from/to file.
 
         // TODO: get rid of has_fixed_size_ & has_image_
         bool has_fixed_size_ = false;
@@ -100,6 +141,9 @@ namespace paint
 
         bool undo_was_last_command_ = false;
 
+        LoadMode load_mode_ = LoadMode::kRead;     /// How the pixels are loaded from file.
+        std::optional<PixelLayout> pixel_layout_; /// Requested layout of the loaded pixels (chosen by the image size if not set).
+
         /**
          * @brief Constant that sets thge size of the image history buffers.
          * 
@@ -6,6 +6,7 @@
 
 #include "image.h"
 #include "file.h"
+#include "palette.h"
 
 namespace paint
 {
@@ -25,6 +26,21 @@ namespace paint
          */
         const uint16_t kPlanes = 1;
 
+        /**
+         * @brief Alignment of pixel rows in BMP pixel array (in bytes).
+         * 
+         */
+        const size_t kRowAlignment = 4;
+
+        /**
+         * @brief Images with at least this many pixels are stored with PixelLayout::kTiled.
+         * 
+         * Smaller images are read and written with a single call, larger images need the tiles for
+         * column-wise operations (i.e. rotation) not to thrash the cache.
+         * 
+         */
+        const size_t kTiledLayoutMinPixels = 4096 * 4096;
+
         /**
          * @brief Number of bits per pixel.
          * 
@@ -36,6 +52,7 @@ namespace paint
             k8bpPX = 8,   /// 8 bits per pixel
             k16bpPX = 16, /// 16 bits per pixel
             k24bpPX = 24, /// 24 bits per pixel
+            k32bpPX = 32, /// 32 bits per pixel (straight alpha in the 4th byte)
         };
 
         /**
@@ -152,8 +169,9 @@ namespace paint
             virtual bool IsTopDown() const { return false; }
 
         private:
-            HeaderBMP header_bmp_;          /// BMP header struct.
-            HeaderBMPInfo header_bmp_info_; /// BMP info header struct.
+            HeaderBMP header_bmp_;                       /// BMP header struct.
+            HeaderBMPInfo header_bmp_info_;              /// BMP info header struct.
+            std::shared_ptr<const Palette> color_table_; /// Colors of the BMP color table (nullptr if the image has none or the default one).
             friend class ImageIOBMP;
 
             /**
@@ -178,12 +196,25 @@ namespace paint
              */
             virtual void CreateDataBuffer() override;
 
+            /**
+             * @brief Create the Color matching the pixels described by \ref header_bmp_info_.
+             * 
+             * Images up to 8 bits per pixel with a color table other than black & white (1bpp) or the gray ramp (8bpp)
+             * are indexed (ColorPalette with \ref color_table_).
+             * 
+             * @return std::unique_ptr<Color> color of the image pixels.
+             */
+            std::unique_ptr<Color> CreateColorType();
+
             /**
              * @brief Generates new headers.
              * 
              * Takes the info in data buffer Image::image_data_ 
              * and updates the headers \ref header_bmp & \ref header_bmp_info_
              * 
+             * Indexed images are saved with their palette as the color table and with the fewest bits per pixel
+             * the palette fits in (1, 4 or 8).
+             * 
              */
             virtual void GenerateMetadata() override;
         };
@@ -20,8 +20,28 @@ namespace paint
         public:
             static void ReadHeaderBMP(std::ifstream &file, ImageBMP &image);
             static void ReadHeaderBMPInfo(std::ifstream &file, ImageBMP &image);
+
+            /**
+             * @brief Reads the color table of images up to 8 bits per pixel into ImageBMP::color_table_.
+             * 
+             * The table follows the info header, it has bi_clrUsed colors (2^n colors if 0)
+             * and is cut at the start of the pixel data.
+             * 
+             * @param image the image with read headers.
+             */
+            static void ReadColorTable(std::ifstream &file, ImageBMP &image);
             static void ReadPixelData(std::ifstream &file, ImageBMP &image);
 
+            /**
+             * @brief Maps the file and uses its pixel array as the image data (no copy).
+             * 
+             * Only for pixels with size multiple of byte, the headers have to be read already.
+             * Throws std::ios_base::failure if the file cannot be mapped or is too short.
+             * 
+             * @param image the image with read headers.
+             */
+            static void MapPixelData(ImageBMP &image);
+
             static void WriteHeaderBMP(std::ofstream &file, ImageBMP &image);
             static void WriteHeaderBMPInfo(std::ofstream &file, ImageBMP &image);
             static void WriteColorTable(std::ofstream &file, ImageBMP &image);
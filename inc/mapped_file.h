@@ -0,0 +1,53 @@
+#ifndef PAINT_INC_MAPPED_FILE_H_
+#define PAINT_INC_MAPPED_FILE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+namespace paint
+{
+    /**
+     * @brief A read-only memory mapping of a whole file.
+     * 
+     * The pages of the file are loaded by the OS on first access, so mapping even a multi-GB file is almost instant
+     * and only the parts that are really read are loaded into memory.
+     * 
+     * Throws std::ios_base::failure if the file cannot be opened or mapped.
+     * 
+     * The file must not be truncated while it is mapped.
+     * 
+     */
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::filesystem::path &path);
+        MappedFile(const MappedFile &other) = delete;
+        MappedFile &operator=(const MappedFile &other) = delete;
+        ~MappedFile();
+
+        /**
+         * @brief Whether memory mapped files are supported on this platform.
+         * 
+         */
+        static bool IsSupported();
+
+        /**
+         * @brief Returns the pointer to the first byte of the file.
+         * 
+         */
+        const uint8_t *GetData() const { return data_; }
+
+        /**
+         * @brief Returns the size of the file in bytes.
+         * 
+         */
+        size_t GetSize() const { return size_; }
+
+    private:
+        const uint8_t *data_ = nullptr; /// Mapped content of the file.
+        size_t size_ = 0;               /// Size of the file.
+    };
+}
+
+#endif // PAINT_INC_MAPPED_FILE_H_
@@ -0,0 +1,219 @@
+#ifndef PAINT_INC_PACKED_BITS_H_
+#define PAINT_INC_PACKED_BITS_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+#include "unit.h"
+
+namespace paint
+{
+    /**
+     * Kernels for rows of 1-bit pixels packed 8 per byte (see PixelLayout::kPacked).
+     *
+     * The first pixel of a byte is in its most significant bit (the same as BMP 1bpp rows).
+     * The kernels read and write the row by 64-bit words, a word loaded with LoadPackedWord() holds
+     * the pixel 64 * word in its most significant bit. The rows have to be a whole number of words long.
+     *
+     */
+
+    /**
+     * @brief Number of pixels in a packed word.
+     *
+     */
+    constexpr Unit kPackedWordBits = 64;
+
+    /**
+     * @brief Loads the word of the row, the first pixel is in the most significant bit.
+     *
+     */
+    inline uint64_t LoadPackedWord(const uint8_t *row, size_t word)
+    {
+        uint64_t w;
+        std::memcpy(&w, row + word * sizeof(uint64_t), sizeof(uint64_t));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return w;
+#else
+        return __builtin_bswap64(w);
+#endif
+    }
+
+    /**
+     * @brief Stores the word into the row (inverse of LoadPackedWord()).
+     *
+     */
+    inline void StorePackedWord(uint8_t *row, size_t word, uint64_t w)
+    {
+#if !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        w = __builtin_bswap64(w);
+#endif
+        std::memcpy(row + word * sizeof(uint64_t), &w, sizeof(uint64_t));
+    }
+
+    /**
+     * @brief Returns the mask of count pixels starting at the pixel bit of a word (count > 0, bit + count <= 64).
+     *
+     */
+    inline uint64_t PackedWordMask(Unit bit, Unit count)
+    {
+        uint64_t mask = count == kPackedWordBits ? ~uint64_t{0} : ((uint64_t{1} << count) - 1);
+        return mask << (kPackedWordBits - bit - count);
+    }
+
+    inline bool GetPackedBit(const uint8_t *row, Unit x)
+    {
+        return (row[x >> 3] >> (7 - (x & 7))) & 1;
+    }
+
+    inline void SetPackedBit(uint8_t *row, Unit x, bool value)
+    {
+        uint8_t mask = 0x80 >> (x & 7);
+        row[x >> 3] = value ? (row[x >> 3] | mask) : (row[x >> 3] & ~mask);
+    }
+
+    /**
+     * @brief Sets the pixels [x_begin, x_end) of the row to value.
+     *
+     */
+    inline void FillPackedBits(uint8_t *row, Unit x_begin, Unit x_end, bool value)
+    {
+        for (Unit x = x_begin; x < x_end;)
+        {
+            size_t word = x / kPackedWordBits;
+            Unit bit = x % kPackedWordBits;
+            Unit count = std::min<Unit>(kPackedWordBits - bit, x_end - x);
+
+            uint64_t mask = PackedWordMask(bit, count);
+            uint64_t w = LoadPackedWord(row, word);
+            StorePackedWord(row, word, value ? (w | mask) : (w & ~mask));
+
+            x += count;
+        }
+    }
+
+    /**
+     * @brief Inverts the pixels [0, width) of the row, the bits after width stay 0.
+     *
+     */
+    inline void InvertPackedBits(uint8_t *row, Unit width)
+    {
+        size_t words = (width + kPackedWordBits - 1) / kPackedWordBits;
+        for (size_t word = 0; word < words; word++)
+            StorePackedWord(row, word, ~LoadPackedWord(row, word));
+
+        FillPackedBits(row, width, static_cast<Unit>(words * kPackedWordBits), false);
+    }
+
+    /**
+     * @brief Returns the first pixel in [x, x_end) that is not value (or x_end if there is none).
+     *
+     */
+    inline Unit FindPackedRunEnd(const uint8_t *row, Unit x, Unit x_end, bool value)
+    {
+        while (x < x_end)
+        {
+            Unit bit = x % kPackedWordBits;
+
+            // Set bits are the pixels different from value, pixel x is moved to the most significant bit
+            uint64_t different = LoadPackedWord(row, x / kPackedWordBits);
+            if (value)
+                different = ~different;
+            different <<= bit;
+
+            if (different != 0)
+            {
+                Unit run = __builtin_clzll(different);
+                if (run < kPackedWordBits - bit)
+                    return std::min(x + run, x_end);
+            }
+
+            x += kPackedWordBits - bit;
+        }
+
+        return x_end;
+    }
+
+    /**
+     * @brief Returns the first pixel of the run of value pixels ending at pixel x (pixel x has to be value).
+     *
+     */
+    inline Unit FindPackedRunStart(const uint8_t *row, Unit x, bool value)
+    {
+        while (true)
+        {
+            Unit bit = x % kPackedWordBits;
+
+            // Set bits are the pixels different from value, pixel x is moved to the least significant bit
+            uint64_t different = LoadPackedWord(row, x / kPackedWordBits);
+            if (value)
+                different = ~different;
+            different >>= kPackedWordBits - 1 - bit;
+
+            if (different != 0)
+            {
+                Unit run = __builtin_ctzll(different);
+                if (run <= bit)
+                    return x - run + 1;
+            }
+
+            // The whole word up to pixel x is value -> continue in the previous word
+            if (x < kPackedWordBits)
+                return 0;
+            x -= bit + 1;
+        }
+    }
+
+    /**
+     * @brief Copies the pixels [src_x, src_x + count) of src into the pixels [0, count) of dst, the bits after count are 0.
+     *
+     * @param src the source row.
+     * @param src_words number of words in the source row.
+     * @param src_x the first copied pixel.
+     * @param dst the destination row (with at least (count + 63) / 64 words).
+     * @param count number of copied pixels.
+     */
+    inline void CopyPackedBits(const uint8_t *src, size_t src_words, Unit src_x, uint8_t *dst, Unit count)
+    {
+        size_t words = (count + kPackedWordBits - 1) / kPackedWordBits;
+        Unit shift = src_x % kPackedWordBits;
+
+        for (size_t word = 0; word < words; word++)
+        {
+            // The destination word is made of 2 neighbouring source words
+            size_t src_word = src_x / kPackedWordBits + word;
+            uint64_t w = LoadPackedWord(src, src_word) << shift;
+            if (shift != 0 && src_word + 1 < src_words)
+                w |= LoadPackedWord(src, src_word + 1) >> (kPackedWordBits - shift);
+
+            // Cut the pixels after count
+            Unit remaining = count - static_cast<Unit>(word * kPackedWordBits);
+            if (remaining < kPackedWordBits)
+                w &= PackedWordMask(0, remaining);
+
+            StorePackedWord(dst, word, w);
+        }
+    }
+
+    /**
+     * @brief Transposes 8x8 block of pixels.
+     *
+     * The rows of the block are the bytes of block, the first row in the most significant byte.
+     * Returns the columns in the same format (the first column in the most significant byte).
+     *
+     */
+    inline uint64_t TransposePackedBlock(uint64_t block)
+    {
+        uint64_t t;
+        t = (block ^ (block >> 7)) & 0x00AA00AA00AA00AAULL;
+        block = block ^ t ^ (t << 7);
+        t = (block ^ (block >> 14)) & 0x0000CCCC0000CCCCULL;
+        block = block ^ t ^ (t << 14);
+        t = (block ^ (block >> 28)) & 0x00000000F0F0F0F0ULL;
+        block = block ^ t ^ (t << 28);
+        return block;
+    }
+}
+
+#endif // PAINT_INC_PACKED_BITS_H_
@@ -153,7 +153,6 @@ namespace paint
 
     private:
         std::filesystem::path commands_file_path_;
-        std::vector<std::unique_ptr<Image>> images_;
     };
 
     /**
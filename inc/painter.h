@@ -1,9 +1,11 @@
 #ifndef PAINT_INC_PAINTER_H_
 #define PAINT_INC_PAINTER_H_
 
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <functional>
+#include <vector>
 
 #include "unit.h"
 #include "point.h"
@@ -11,6 +13,10 @@
 #include "color.h"
 #include "rotation.h"
 #include "data_pixels.h"
+#include "dither.h"
+#include "draw_batch.h"
+#include "flood_fill.h"
+#include "resample.h"
 
 namespace paint
 {
@@ -40,6 +46,7 @@ namespace paint
          */
         void AttachImageData(const std::weak_ptr<DataPixels> &image_data)
         {
+            Flush();
             image_data_ = image_data;
         }
         /**
@@ -48,6 +55,7 @@ namespace paint
          */
         void DetachImageData()
         {
+            Flush();
             image_data_.reset();
         }
 
@@ -58,10 +66,66 @@ namespace paint
          */
         void SetHorizontalOrientation(bool is_bottom_up) { draw_bottom_up_ = is_bottom_up; }
 
+        /**
+         * @brief Set whether the colors are mixed in linear light.
+         * 
+         * The pixels are sRGB encoded, mixing the encoded values darkens the mixed colors.
+         * In the linear light mode Resize() interpolates and ConvertToGrayscale() weights the decoded channels (see srgb.h).
+         * 
+         * @param linear_light if the colors are mixed in linear light (default = false).
+         */
+        void SetLinearLight(bool linear_light) { linear_light_ = linear_light; }
+
+        /**
+         * @brief Whether the colors are mixed in linear light (see Painter::SetLinearLight()).
+         * 
+         */
+        bool IsLinearLight() const { return linear_light_; }
+
+        /**
+         * @brief Set whether the lines and circles are drawn later all at once.
+         * 
+         * In the deferred mode DrawLine() and DrawCircle() only record the primitives into a DrawBatch, Flush() draws them on multiple threads
+         * and notifies Image once (a single history step for the whole batch).
+         * The other edits (and Image before undo, redo and saving) flush the recorded primitives first, so they are never lost or reordered.
+         * 
+         * @param deferred_drawing if the primitives are deferred (default = false), turning it off flushes the recorded primitives.
+         */
+        void SetDeferredDrawing(bool deferred_drawing);
+
+        /**
+         * @brief Whether the lines and circles are deferred (see Painter::SetDeferredDrawing()).
+         * 
+         */
+        bool IsDeferredDrawing() const { return deferred_drawing_; }
+
+        /**
+         * @brief Set the size of the region DrawBucket() searches in parallel.
+         * 
+         * The region is searched by the scanline flood fill on a single thread, once it has more than parallel_fill_pixels pixels
+         * it is searched again by all the threads (see FindRegion()).
+         * 
+         * @param parallel_fill_pixels number of the found pixels after which the region is searched in parallel (default = kParallelFillPixels).
+         */
+        void SetParallelFillPixels(PixelIndex parallel_fill_pixels) { parallel_fill_pixels_ = parallel_fill_pixels; }
+
+        /**
+         * @brief Get the size of the region DrawBucket() searches in parallel (see Painter::SetParallelFillPixels()).
+         * 
+         */
+        PixelIndex GetParallelFillPixels() const { return parallel_fill_pixels_; }
+
+        /**
+         * @brief Draws the deferred lines and circles (see Painter::SetDeferredDrawing()).
+         * 
+         */
+        void Flush();
+
         /**
          * @brief Sets the global color.
          * 
          * Sets the global color that is used for drawing when no color is specified when drawing.
+         * Translucent colors (ColorBGRA8888 with alpha below 255) are blended over the image by ClearImage(), DrawLine(), DrawCircle() and DrawBucket().
          * 
          * @param color new global color.
          */
@@ -72,18 +136,28 @@ namespace paint
         /**
          * @brief Draws a line from start to end.
          * 
+         * The line is drawn by runs of pixels in each row (see LineRasterizer).
+         * 1px wide lines are Bresenham lines, wider lines cover the pixels inside the rectangle around the line.
+         * Antialiased lines blend the color over the edge pixels by their coverage.
+         * In the deferred mode the line is only recorded (see Painter::SetDeferredDrawing()).
+         * 
          * @param start start point.
          * @param end end point.
          * @param line_color_ color of the line (default = global color).
          * @param line_width_ width of the line (default = 1px).
+         * @param antialias to antialias the edges of the line (default = false).
          */
         virtual void DrawLine(const BasePoint &start,
                               const BasePoint &end,
                               const std::optional<std::shared_ptr<Color>> &line_color_ = std::nullopt,
-                              const std::optional<Unit> &line_width_ = std::nullopt);
+                              const std::optional<Unit> &line_width_ = std::nullopt,
+                              bool antialias = false);
         /**
          * @brief Draws a circle.
          * 
+         * The circle is drawn by runs of pixels in each row (see CircleRasterizer), the border is border_width wide around radius.
+         * In the deferred mode the circle is only recorded (see Painter::SetDeferredDrawing()).
+         * 
          * @param center center of the circle.
          * @param radius radius of the circle.
          * @param fill to fill or not to fill the circle (default = false).
@@ -103,10 +177,35 @@ namespace paint
          * Finds all connected pixels with the color of the pixel located at point.
          * A connected pixel must touch an edge of another pixel -> not through a corner.
          * 
+         * With a tolerance the connected pixels can differ from the picked color by up to tolerance in each channel
+         * (i.e. the noise of a scanned background, see ColorMatcher).
+         * 
          * @param point point where to start and pick a color.
          * @param fill_color color with which to replace selected color (default = global color).
+         * @param tolerance the largest difference of a channel of the filled pixels from the picked color (default = 0, the same color).
+         */
+        virtual void DrawBucket(const BasePoint &point, const std::optional<std::shared_ptr<Color>> &fill_color = std::nullopt, uint8_t tolerance = 0);
+        /**
+         * @brief Replaces a color everywhere in the image (the pixels do not have to be connected).
+         * 
+         * The rows are matched by ColorMatcher and the matching runs are filled by bands of rows on multiple threads.
+         * 
+         * @param color the replaced color (converted to the color of the image first, i.e. the nearest palette color).
+         * @param fill_color color with which to replace the color (default = global color).
+         * @param tolerance the largest difference of a channel of the replaced pixels from color (default = 0, the same color).
+         */
+        virtual void ReplaceColor(const Color &color, const std::optional<std::shared_ptr<Color>> &fill_color = std::nullopt, uint8_t tolerance = 0);
+        /**
+         * @brief Blends an image over the image.
+         * 
+         * The overlay is converted into premultiplied BGRA8888 rows (other formats are opaque) and composited
+         * over the image by BlendSpan(), the part outside of the image is clipped.
+         * The rows of the overlay have to be stored in the same order as the rows of the image (i.e. both are BMP images).
+         * 
+         * @param overlay the pixels to blend over the image.
+         * @param position position of the top left corner of the overlay.
          */
-        virtual void DrawBucket(const BasePoint &point, const std::optional<std::shared_ptr<Color>> &fill_color = std::nullopt);
+        virtual void DrawOverlay(const DataPixels &overlay, const BasePoint &position);
 
         // Crop, Resize and Rotate modifies the headers
         /**
@@ -121,11 +220,23 @@ namespace paint
         /**
          * @brief Resizes the image.
          * 
-         * Resizes the image using bilinear interpolation.
+         * Resizes the image using bilinear interpolation (in linear light if Painter::IsLinearLight(), except BW, indexed and BGRA8888 images).
+         * The other filters resample the image by Resample() on multiple threads (antialiased when downscaling).
+         * A target size without pixels (e.g. 1% of a small image) leaves the image unchanged.
          * 
          * @param new_size target size.
+         * @param filter the filter (see ResampleFilter).
          */
-        virtual void Resize(const BasePoint &new_size);
+        virtual void Resize(const BasePoint &new_size, ResampleFilter filter = ResampleFilter::kInterpolate);
+        /**
+         * @brief Makes the halvings of the image (the image is not edited).
+         * 
+         * The levels are averaged by MakePyramid() on multiple threads (in linear light if Painter::IsLinearLight(), except BW, indexed and BGRA8888 images).
+         * 
+         * @param level_count number of the halvings.
+         * @return std::vector<std::shared_ptr<DataPixels>> the halved images, the biggest first.
+         */
+        virtual std::vector<std::shared_ptr<DataPixels>> MakePyramid(size_t level_count);
         /**
          * @brief Rotates the image.
          * 
@@ -147,7 +258,7 @@ namespace paint
         /**
          * @brief Converts the color to grayscale.
          * 
-         * Converts every pixel to grayscale color.
+         * Converts every pixel to grayscale color (the luminance of the linear light if Painter::IsLinearLight()).
          * 
          */
         virtual void ConvertToGrayscale();
@@ -156,8 +267,25 @@ namespace paint
          * 
          * Converts every pixel to black & white color.
          * 
+         * @param dither dithering method (default = no dithering, every pixel is thresholded).
+         */
+        virtual void ConvertToBW(const std::optional<DitherMethod> &dither = std::nullopt);
+        /**
+         * @brief Converts the color to RGB565.
+         * 
+         * Converts every pixel to RGB565 color.
+         * 
+         * @param dither dithering method (default = no dithering, the low bits are cut off).
          */
-        virtual void ConvertToBW();
+        virtual void ConvertToRGB565(const std::optional<DitherMethod> &dither = std::nullopt);
+        /**
+         * @brief Converts the color to indexed color with a palette made for the image.
+         * 
+         * The palette is created by OctreeQuantizer and every pixel gets the nearest palette color.
+         * 
+         * @param max_colors maximum number of palette colors (1 - 256).
+         */
+        virtual void Quantize(size_t max_colors);
 
     private:
         std::shared_ptr<Color> next_command_color_; /// Global color used when no color is specified.
@@ -166,6 +294,12 @@ namespace paint
         std::function<void()> image_edit_callback_; /// Imgage::ImageEditCallback() used to notify Image of the data change after editing.
 
         bool draw_bottom_up_;
+        bool linear_light_ = false; /// Mix the colors in linear light instead of sRGB.
+
+        bool deferred_drawing_ = false; /// Record the lines and circles instead of drawing them.
+        DrawBatch deferred_;            /// The recorded primitives (drawn by Painter::Flush()).
+
+        PixelIndex parallel_fill_pixels_ = kParallelFillPixels; /// Size of the region DrawBucket() searches in parallel.
     };
 }
 
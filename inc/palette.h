@@ -0,0 +1,192 @@
+#ifndef PAINT_INC_PALETTE_H_
+#define PAINT_INC_PALETTE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "color.h"
+#include "pixel.h"
+
+namespace paint
+{
+    /**
+     * @brief A table of up to 256 colors addressed by PixelIndexed8 (i.e. the BMP color table).
+     *
+     * The palette never changes once created, so it is shared by all the copies of the indexed image (undo history included).
+     *
+     * - Palette::FindNearest() searches a k-d tree of the colors.
+     * - The colors are converted into every ColorFormat once (256 entries each), so indexed pixels
+     *   are converted by a table lookup (see Palette::ConvertIndices()).
+     *
+     */
+    class Palette
+    {
+    public:
+        /**
+         * @brief Maximum number of colors (the range of PixelIndexed8).
+         *
+         */
+        static constexpr size_t kMaxColors = 256;
+
+        /**
+         * @brief Create the palette.
+         *
+         * Throws std::invalid_argument if there are no colors or more than Palette::kMaxColors.
+         *
+         * @param colors the colors in the order of their indices.
+         */
+        explicit Palette(std::vector<PixelRGB888> colors);
+
+        bool operator==(const Palette &other) const { return colors_ == other.colors_; }
+        bool operator!=(const Palette &other) const { return !(*this == other); }
+
+        /**
+         * @brief Get the number of colors.
+         *
+         */
+        size_t GetSize() const { return colors_.size(); }
+
+        /**
+         * @brief Get all the colors.
+         *
+         */
+        const std::vector<PixelRGB888> &GetColors() const { return colors_; }
+
+        /**
+         * @brief Get the color at index (black for the indices past the end of the palette).
+         *
+         */
+        PixelRGB888 GetColor(uint8_t index) const { return index < colors_.size() ? colors_[index] : PixelRGB888{0, 0, 0}; }
+
+        /**
+         * @brief Returns the index of the color closest to color (squared euclidean distance in RGB).
+         *
+         * Of equally close colors the lowest index is returned, so the result is the same as of the linear search.
+         *
+         * @param color the color to look up.
+         * @return uint8_t index of the nearest color.
+         */
+        uint8_t FindNearest(const PixelRGB888 &color) const;
+
+        /**
+         * @brief Converts n indices into pixels of format.
+         *
+         * The indices are only looked up in the table of the palette colors converted into format,
+         * the same conversion as Color::SetColor() is done once per palette entry.
+         *
+         * @param indices the first index.
+         * @param format format of the destination pixels (kIndexed8 copies the indices).
+         * @param dst the first destination pixel (BW pixels are one byte each).
+         * @param n number of pixels.
+         */
+        void ConvertIndices(const uint8_t *indices, ColorFormat format, void *dst, size_t n) const;
+
+        /**
+         * @brief Returns the palette with every color inverted (same as Color::InvertColor()).
+         *
+         */
+        Palette Inverted() const;
+
+    private:
+        /**
+         * @brief A node of the k-d tree (the color at the median of its subtree).
+         *
+         */
+        struct KdNode
+        {
+            PixelRGB888 color; /// The color splitting the subtree.
+            uint8_t index;     /// Index of the color in the palette.
+            uint8_t axis;      /// Channel splitting the subtree (0 - red, 1 - green, 2 - blue).
+            int16_t left;      /// The subtree with smaller values of the channel (-1 if empty).
+            int16_t right;     /// The subtree with larger or equal values of the channel (-1 if empty).
+        };
+
+        /**
+         * @brief Builds the k-d tree of the colors at indices [begin, end), returns the index of the root node.
+         *
+         */
+        int16_t BuildKdTree(std::vector<uint8_t> &indices, size_t begin, size_t end);
+
+        /**
+         * @brief Searches the subtree of node for a color closer than best_distance.
+         *
+         */
+        void SearchKdTree(int16_t node, const PixelRGB888 &color, int &best_distance, uint8_t &best_index) const;
+
+        std::vector<PixelRGB888> colors_;          /// Colors of the palette.
+        std::vector<KdNode> kd_nodes_;             /// Nodes of the k-d tree.
+        int16_t kd_root_;                          /// Index of the root node of the k-d tree.
+        std::vector<std::vector<uint8_t>> lookup_; /// Palette converted into every ColorFormat before kIndexed8 (Palette::kMaxColors pixels each).
+    };
+
+    /**
+     * @brief Maps colors to the indices of the nearest palette colors during one operation.
+     *
+     * Images have long runs of the same color and only few different colors, so the last color and
+     * a direct mapped cache of the recently mapped colors are checked before Palette::FindNearest().
+     *
+     */
+    class PaletteMapper
+    {
+    public:
+        explicit PaletteMapper(const Palette &palette);
+
+        /**
+         * @brief Returns the index of the nearest palette color.
+         *
+         */
+        uint8_t Map(const PixelRGB888 &color);
+
+        /**
+         * @brief Maps n RGB888 pixels to the indices of the nearest palette colors.
+         *
+         */
+        void MapSpan(const PixelRGB888 *src, uint8_t *dst, size_t n);
+
+    private:
+        static constexpr size_t kCacheBits = 12; /// 4096 cached colors
+
+        const Palette &palette_;
+        std::vector<uint32_t> cache_keys_;   /// Cached colors (0xRRGGBB, all bits set if the slot is empty).
+        std::vector<uint8_t> cache_indices_; /// Indices of the cached colors.
+    };
+
+    /**
+     * @brief Creates a palette for the colors of an image with octree quantization.
+     *
+     * The colors are counted in a histogram of 32 levels per channel (the octree is 5 levels deep).
+     * The leaves of the octree are merged, deepest first and the least used of them first,
+     * until there are at most max_colors of them and every leaf becomes the average color of its pixels.
+     * Images with at most max_colors distinct colors (at 5 bits per channel) keep their colors.
+     *
+     */
+    class OctreeQuantizer
+    {
+    public:
+        OctreeQuantizer();
+
+        /**
+         * @brief Counts n pixels into the histogram.
+         *
+         */
+        void AddColors(const PixelRGB888 *pixels, size_t n);
+
+        /**
+         * @brief Creates the palette with at most max_colors colors (1 - Palette::kMaxColors).
+         *
+         */
+        Palette CreatePalette(size_t max_colors) const;
+
+    private:
+        static constexpr size_t kLevelBits = 5;                    /// Bits per channel of the histogram.
+        static constexpr size_t kBinCount = 1 << (3 * kLevelBits); /// Number of histogram bins.
+
+        std::vector<uint64_t> count_; /// Pixels in every bin.
+        std::vector<uint64_t> red_;   /// Sum of red of the pixels in every bin.
+        std::vector<uint64_t> green_; /// Sum of green of the pixels in every bin.
+        std::vector<uint64_t> blue_;  /// Sum of blue of the pixels in every bin.
+    };
+}
+
+#endif // PAINT_INC_PALETTE_H_
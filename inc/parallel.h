@@ -0,0 +1,55 @@
+#ifndef PAINT_INC_PARALLEL_H_
+#define PAINT_INC_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace paint
+{
+    /**
+     * @brief Get the default number of threads (std::thread::hardware_concurrency(), at least 1).
+     *
+     */
+    inline unsigned DefaultThreadCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /**
+     * @brief Runs worker on thread_count threads and waits for all of them.
+     *
+     * The calling thread is one of the threads, so no thread is started for thread_count <= 1.
+     * Each thread has its own local variables of worker (i.e. its buffers), the captured variables are shared.
+     *
+     */
+    template <typename Worker>
+    void RunOnThreads(unsigned thread_count, Worker &&worker)
+    {
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < thread_count; i++)
+            threads.emplace_back([&worker]() { worker(); });
+
+        worker();
+
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    /**
+     * @brief Calls fn(i) for every i in [0, count), the indices are taken in order by thread_count threads.
+     *
+     */
+    template <typename Index, typename Function>
+    void ParallelFor(Index count, unsigned thread_count, Function &&fn)
+    {
+        std::atomic<Index> next{0};
+        RunOnThreads(thread_count, [&]() {
+            for (Index i = next++; i < count; i = next++)
+                fn(i);
+        });
+    }
+}
+
+#endif // PAINT_INC_PARALLEL_H_
@@ -4,6 +4,7 @@
 #include <regex>
 #include <exception>
 #include <cstring>
+#include <cstdint>
 
 #include <gtest/gtest.h>
 
@@ -85,6 +86,7 @@ namespace paint
 
     private:
         FRIEND_TEST(parser, parse_optional_args); /// Make the Parser::ParseOptionalArgs() and  Painter::ParseColorVal() accessible to google test.
+        FRIEND_TEST(parser, parse_color);         /// Make the Parser::ParseColorVal() accessible to google test.
 
         /**
          * @brief Returns vector of pairs, that contain oprional args in a pair: <argument>, <value>.
@@ -99,29 +101,47 @@ namespace paint
         /**
          * @brief Parses the color argument.
          * 
-         * Parses the argument 'color: {r: ..., g: ..., b: ...}' with RGB888 color format.
+         * Parses the argument 'color: {r: ..., g: ..., b: ...}' with RGB888 color format
+         * or 'color: {r: ..., g: ..., b: ..., a: ...}' with the opacity (255 is opaque).
          * 
          * @param color_arg a string in color format.
-         * @return ColorRGB888 the parsed color.
+         * @return std::shared_ptr<Color> the parsed color (ColorRGB888, or ColorBGRA8888 if it is translucent).
          */
-        static ColorRGB888 ParseColorVal(const std::string &color_arg);
+        static std::shared_ptr<Color> ParseColorVal(const std::string &color_arg);
+        /**
+         * @brief Parses the tolerance argument.
+         * 
+         * Parses the value of 'tolerance: ...', the largest difference of a channel of the matching colors (0 - 255).
+         * 
+         * @param tolerance_arg a string with the number.
+         * @return uint8_t the parsed tolerance.
+         */
+        static uint8_t ParseToleranceVal(const std::string &tolerance_arg);
 
         static std::regex re_save_;          /// RegEx for save command.
+        static std::regex re_pyramid_;       /// RegEx for pyramid command.
         static std::regex re_load_;          /// RegEx for load command.
         static std::regex re_color_;         /// RegEx for color command.
         static std::regex re_line_;          /// RegEx for line command.
         static std::regex re_circle_;        /// RegEx for circle command.
         static std::regex re_bucket_;        /// RegEx for bucket command.
+        static std::regex re_replace_color_; /// RegEx for replacecolor command.
         static std::regex re_resize_;        /// RegEx for resize command.
         static std::regex re_rotate_;        /// RegEx for rotate command.
         static std::regex re_invert_colors_; /// RegEx for invercolor command.
         static std::regex re_grayscale_;     /// RegEx for grayscale command.
+        static std::regex re_dither_;        /// RegEx for dither command.
+        static std::regex re_linear_light_;  /// RegEx for linearlight command.
+        static std::regex re_defer_;         /// RegEx for defer command.
+        static std::regex re_parallel_fill_; /// RegEx for parallelfill command.
+        static std::regex re_quantize_;      /// RegEx for quantize command.
+        static std::regex re_overlay_;       /// RegEx for overlay command.
         static std::regex re_crop_;          /// RegEx for crop command.
         static std::regex re_undo_;          /// RegEx for undo command.
         static std::regex re_redo_;          /// RegEx for redo command.
         static std::regex re_param_delim_;   /// RegEx for tokenizing optional arguments.
         static std::regex re_param_;         /// RegEx for spliting optional argument into <arg>, <value> pair.
-        static std::regex re_param_color_;   /// RegEx for parsing RGB888 color.
+        static std::regex re_param_color_;   /// RegEx for parsing RGB888 color (with optional alpha).
     };
 }
 
@@ -22,7 +22,7 @@ namespace paint
         uint8_t r : 8; /// Red color
         uint8_t a : 8; /// Alpha color
 
-        bool operator==(const PixelBGRA8888 &other) const
+        constexpr bool operator==(const PixelBGRA8888 &other) const
         {
             return r == other.r && g == other.g && b == other.b && a == other.a;
         }
@@ -43,7 +43,7 @@ namespace paint
         uint8_t g : 8; /// Green color
         uint8_t b : 8; /// Blue color
 
-        bool operator==(const PixelRGB888 &other) const
+        constexpr bool operator==(const PixelRGB888 &other) const
         {
             return r == other.r && g == other.g && b == other.b;
         }
@@ -64,7 +64,7 @@ namespace paint
         uint8_t g : 8; /// Green color
         uint8_t r : 8; /// Red color
 
-        bool operator==(const PixelBGR888 &other) const
+        constexpr bool operator==(const PixelBGR888 &other) const
         {
             return r == other.r && g == other.g && b == other.b;
         }
@@ -85,7 +85,7 @@ namespace paint
         uint16_t g : 6; /// Green color
         uint16_t b : 5; /// Blue color
 
-        bool operator==(const PixelRGB565 &other) const
+        constexpr bool operator==(const PixelRGB565 &other) const
         {
             return r == other.r && g == other.g && b == other.b;
         }
@@ -106,7 +106,7 @@ namespace paint
         uint16_t g : 6; /// Green color
         uint16_t r : 5; /// Red color
 
-        bool operator==(const PixelBGR565 &other) const
+        constexpr bool operator==(const PixelBGR565 &other) const
         {
             return r == other.r && g == other.g && b == other.b;
         }
@@ -123,7 +123,7 @@ namespace paint
     {
         uint8_t w : 8; /// Grayscale color
 
-        bool operator==(const PixelGrayscale &other) const
+        constexpr bool operator==(const PixelGrayscale &other) const
         {
             return w == other.w;
         }
@@ -140,11 +140,28 @@ namespace paint
     {
         uint8_t w : 1; /// Grayscale color
 
-        bool operator==(const PixelBW &other) const
+        constexpr bool operator==(const PixelBW &other) const
         {
             return w == other.w;
         }
     };
+
+    /**
+     * @brief A structure for storing 1 byte wide index into a color palette.
+     * 
+     * This structure saves the index of the color in 1 byte:
+     *  8 bits for the index (see Palette)
+     * 
+     */
+    struct PixelIndexed8
+    {
+        uint8_t i : 8; /// Index of the color in the palette
+
+        constexpr bool operator==(const PixelIndexed8 &other) const
+        {
+            return i == other.i;
+        }
+    };
 }
 
 #endif // PAINT_INC_PIXEL_H_
\ No newline at end of file
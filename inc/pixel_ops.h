@@ -0,0 +1,291 @@
+#ifndef PAINT_INC_PIXEL_OPS_H_
+#define PAINT_INC_PIXEL_OPS_H_
+
+#include <algorithm>
+#include <cstring>
+
+#include "pixel.h"
+#include "pixel_traits.h"
+#include "colors.h"
+
+namespace paint
+{
+    /**
+     * @brief Maps a pixel structure to the Color class that stores it.
+     * 
+     * PixelColorType<PixelT>::type is the Color class with PixelT as its data.
+     * PixelColorType<PixelT>::kFormat is the ColorFormat of that Color class.
+     * 
+     */
+    template <typename PixelT>
+    struct PixelColorType;
+
+    template <>
+    struct PixelColorType<PixelRGB565>
+    {
+        using type = ColorRGB565;
+        static constexpr ColorFormat kFormat = kPixelFormat<PixelRGB565>;
+        static ColorRGB565 From(const Color &color) { return color.ToRGB565(); }
+    };
+
+    template <>
+    struct PixelColorType<PixelBGR565>
+    {
+        using type = ColorBGR565;
+        static constexpr ColorFormat kFormat = kPixelFormat<PixelBGR565>;
+        static ColorBGR565 From(const Color &color) { return color.ToBGR565(); }
+    };
+
+    template <>
+    struct PixelColorType<PixelRGB888>
+    {
+        using type = ColorRGB888;
+        static constexpr ColorFormat kFormat = kPixelFormat<PixelRGB888>;
+        static ColorRGB888 From(const Color &color) { return color.ToRGB888(); }
+    };
+
+    template <>
+    struct PixelColorType<PixelBGR888>
+    {
+        using type = ColorBGR888;
+        static constexpr ColorFormat kFormat = kPixelFormat<PixelBGR888>;
+        static ColorBGR888 From(const Color &color) { return color.ToBGR888(); }
+    };
+
+    template <>
+    struct PixelColorType<PixelGrayscale>
+    {
+        using type = ColorGrayscale;
+        static constexpr ColorFormat kFormat = kPixelFormat<PixelGrayscale>;
+        static ColorGrayscale From(const Color &color) { return color.ToGrayscale(); }
+    };
+
+    template <>
+    struct PixelColorType<PixelBW>
+    {
+        using type = ColorBW;
+        static constexpr ColorFormat kFormat = kPixelFormat<PixelBW>;
+        static ColorBW From(const Color &color) { return color.ToBW(); }
+    };
+
+    template <>
+    struct PixelColorType<PixelBGRA8888>
+    {
+        using type = ColorBGRA8888;
+        static constexpr ColorFormat kFormat = kPixelFormat<PixelBGRA8888>;
+        static ColorBGRA8888 From(const Color &color) { return color.ToBGRA8888(); }
+    };
+
+    /**
+     * @brief Positions of the 8-bit channels inside of a pixel (the planes of PixelLayout::kPlanar).
+     * 
+     * PixelChannels<PixelT>::kCount is the number of 8-bit channels (0 if the pixel is not made of 8-bit channels).
+     * kRed, kGreen and kBlue are the indices of the color channel bytes.
+     * 
+     */
+    template <typename PixelT>
+    struct PixelChannels
+    {
+        static constexpr size_t kCount = 0;
+    };
+
+    template <>
+    struct PixelChannels<PixelRGB888>
+    {
+        static constexpr size_t kCount = 3;
+        static constexpr size_t kRed = 0;
+        static constexpr size_t kGreen = 1;
+        static constexpr size_t kBlue = 2;
+    };
+
+    template <>
+    struct PixelChannels<PixelBGR888>
+    {
+        static constexpr size_t kCount = 3;
+        static constexpr size_t kRed = 2;
+        static constexpr size_t kGreen = 1;
+        static constexpr size_t kBlue = 0;
+    };
+
+    template <>
+    struct PixelChannels<PixelGrayscale>
+    {
+        static constexpr size_t kCount = 1;
+    };
+
+    /**
+     * @brief Converts any Color to a pixel of type PixelT.
+     * 
+     * Meant to be called once per operation (e.g. for the drawing color), not per pixel.
+     * 
+     * @param color the color to convert.
+     * @return PixelT the converted pixel.
+     */
+    template <typename PixelT>
+    inline PixelT PixelFromColor(const Color &color)
+    {
+        auto converted = PixelColorType<PixelT>::From(color);
+        return *reinterpret_cast<const PixelT *>(converted.GetData());
+    }
+
+    /**
+     * @brief Inverts the pixel color (same as Color::InvertColor()).
+     * 
+     */
+    inline void InvertPixel(PixelRGB565 &p)
+    {
+        p.r = ~p.r;
+        p.g = ~p.g;
+        p.b = ~p.b;
+    }
+
+    inline void InvertPixel(PixelBGR565 &p)
+    {
+        p.r = ~p.r;
+        p.g = ~p.g;
+        p.b = ~p.b;
+    }
+
+    inline void InvertPixel(PixelRGB888 &p)
+    {
+        p.r = ~p.r;
+        p.g = ~p.g;
+        p.b = ~p.b;
+    }
+
+    inline void InvertPixel(PixelBGR888 &p)
+    {
+        p.r = ~p.r;
+        p.g = ~p.g;
+        p.b = ~p.b;
+    }
+
+    inline void InvertPixel(PixelGrayscale &p)
+    {
+        p.w = ~p.w;
+    }
+
+    inline void InvertPixel(PixelBW &p)
+    {
+        p.w = ~p.w;
+    }
+
+    // Premultiplied -> the straight color is inverted, the alpha is kept
+    inline void InvertPixel(PixelBGRA8888 &p)
+    {
+        p.r = p.a - p.r;
+        p.g = p.a - p.g;
+        p.b = p.a - p.b;
+    }
+
+    /**
+     * @brief Interpolates 2 pixels (same as Color::Interpolate()).
+     * 
+     * @param c1 first pixel.
+     * @param c2 second pixel.
+     * @param percent_c1 weight of the first pixel (0.0f - 1.0f).
+     * @return interpolated pixel.
+     */
+    inline PixelRGB565 InterpolatePixel(const PixelRGB565 &c1, const PixelRGB565 &c2, float percent_c1)
+    {
+        PixelRGB565 p;
+        p.r = c1.r * percent_c1 + c2.r * (1 - percent_c1);
+        p.g = c1.g * percent_c1 + c2.g * (1 - percent_c1);
+        p.b = c1.b * percent_c1 + c2.b * (1 - percent_c1);
+        return p;
+    }
+
+    inline PixelBGR565 InterpolatePixel(const PixelBGR565 &c1, const PixelBGR565 &c2, float percent_c1)
+    {
+        PixelBGR565 p;
+        p.r = c1.r * percent_c1 + c2.r * (1 - percent_c1);
+        p.g = c1.g * percent_c1 + c2.g * (1 - percent_c1);
+        p.b = c1.b * percent_c1 + c2.b * (1 - percent_c1);
+        return p;
+    }
+
+    inline PixelRGB888 InterpolatePixel(const PixelRGB888 &c1, const PixelRGB888 &c2, float percent_c1)
+    {
+        PixelRGB888 p;
+        p.r = c1.r * percent_c1 + c2.r * (1 - percent_c1);
+        p.g = c1.g * percent_c1 + c2.g * (1 - percent_c1);
+        p.b = c1.b * percent_c1 + c2.b * (1 - percent_c1);
+        return p;
+    }
+
+    inline PixelBGR888 InterpolatePixel(const PixelBGR888 &c1, const PixelBGR888 &c2, float percent_c1)
+    {
+        PixelBGR888 p;
+        p.r = c1.r * percent_c1 + c2.r * (1 - percent_c1);
+        p.g = c1.g * percent_c1 + c2.g * (1 - percent_c1);
+        p.b = c1.b * percent_c1 + c2.b * (1 - percent_c1);
+        return p;
+    }
+
+    inline PixelGrayscale InterpolatePixel(const PixelGrayscale &c1, const PixelGrayscale &c2, float percent_c1)
+    {
+        PixelGrayscale p;
+        p.w = c1.w * percent_c1 + c2.w * (1 - percent_c1);
+        return p;
+    }
+
+    inline PixelBW InterpolatePixel(const PixelBW &c1, const PixelBW &c2, float percent_c1)
+    {
+        PixelBW p;
+        p.w = static_cast<uint8_t>(c1.w * percent_c1 + c2.w * (1 - percent_c1));
+        return p;
+    }
+
+    inline PixelBGRA8888 InterpolatePixel(const PixelBGRA8888 &c1, const PixelBGRA8888 &c2, float percent_c1)
+    {
+        PixelBGRA8888 p;
+        p.r = c1.r * percent_c1 + c2.r * (1 - percent_c1);
+        p.g = c1.g * percent_c1 + c2.g * (1 - percent_c1);
+        p.b = c1.b * percent_c1 + c2.b * (1 - percent_c1);
+        p.a = c1.a * percent_c1 + c2.a * (1 - percent_c1);
+        return p;
+    }
+
+    // Indices cannot be mixed -> the pixel with the larger weight is taken (nearest neighbour)
+    inline PixelIndexed8 InterpolatePixel(const PixelIndexed8 &c1, const PixelIndexed8 &c2, float percent_c1)
+    {
+        return percent_c1 >= 0.5f ? c1 : c2;
+    }
+
+    /**
+     * @brief Fills count pixels with pixel.
+     * 
+     * The 3 byte pixels are not a power of 2 wide, so runs of them are not filled by std::fill_n() (one pixel at a time),
+     * but by copying a block of 16 pixels (48 bytes, copied by a few vector stores) after each other.
+     * 
+     */
+    template <typename PixelT>
+    inline void FillPixels(PixelT *dst, size_t count, const PixelT &pixel)
+    {
+        if constexpr (sizeof(PixelT) == 3)
+        {
+            constexpr size_t kBlockPixels = 16;
+
+            // Short runs (i.e. the rows of steep lines) are faster pixel by pixel
+            if (count < kBlockPixels)
+            {
+                std::fill_n(dst, count, pixel);
+                return;
+            }
+
+            PixelT block[kBlockPixels];
+            std::fill_n(block, kBlockPixels, pixel);
+
+            // The last block overlaps the previous one instead of copying the rest pixel by pixel
+            for (size_t filled = 0; filled + kBlockPixels < count; filled += kBlockPixels)
+                std::memcpy(dst + filled, block, sizeof(block));
+            std::memcpy(dst + count - kBlockPixels, block, sizeof(block));
+        }
+        else
+        {
+            std::fill_n(dst, count, pixel);
+        }
+    }
+}
+
+#endif // PAINT_INC_PIXEL_OPS_H_
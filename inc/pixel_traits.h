@@ -0,0 +1,364 @@
+#ifndef PAINT_INC_PIXEL_TRAITS_H_
+#define PAINT_INC_PIXEL_TRAITS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pixel.h"
+#include "color.h"
+
+namespace paint
+{
+    extern const PixelBGRA8888 grayscale_palette[256];
+    extern const PixelBGRA8888 bw_palette[2];
+
+    /**
+     * @brief Position of a channel inside of a pixel.
+     *
+     * The bits are counted from the least significant bit of the pixel structure.
+     *
+     */
+    struct PixelChannel
+    {
+        size_t offset_bits; /// First bit of the channel.
+        size_t width_bits;  /// Number of bits of the channel.
+    };
+
+    /**
+     * @brief Builds pixels from channel values, the values are cut to the channel width (the same as the Color constructors).
+     *
+     */
+    constexpr PixelRGB565 MakePixelRGB565(unsigned red, unsigned green, unsigned blue)
+    {
+        PixelRGB565 p{};
+        p.r = red;
+        p.g = green;
+        p.b = blue;
+        return p;
+    }
+
+    constexpr PixelBGR565 MakePixelBGR565(unsigned blue, unsigned green, unsigned red)
+    {
+        PixelBGR565 p{};
+        p.b = blue;
+        p.g = green;
+        p.r = red;
+        return p;
+    }
+
+    constexpr PixelRGB888 MakePixelRGB888(unsigned red, unsigned green, unsigned blue)
+    {
+        PixelRGB888 p{};
+        p.r = red;
+        p.g = green;
+        p.b = blue;
+        return p;
+    }
+
+    constexpr PixelBGR888 MakePixelBGR888(unsigned blue, unsigned green, unsigned red)
+    {
+        PixelBGR888 p{};
+        p.b = blue;
+        p.g = green;
+        p.r = red;
+        return p;
+    }
+
+    constexpr PixelBGRA8888 MakePixelBGRA8888(unsigned blue, unsigned green, unsigned red, unsigned alpha)
+    {
+        PixelBGRA8888 p{};
+        p.b = blue;
+        p.g = green;
+        p.r = red;
+        p.a = alpha;
+        return p;
+    }
+
+    constexpr PixelGrayscale MakePixelGrayscale(unsigned white)
+    {
+        PixelGrayscale p{};
+        p.w = white;
+        return p;
+    }
+
+    constexpr PixelBW MakePixelBW(unsigned white)
+    {
+        PixelBW p{};
+        p.w = white;
+        return p;
+    }
+
+    /// Fractional bits of the luminance weights.
+    constexpr int kLuminanceBits = 15;
+    /// Luminance weights 0.2125, 0.7154 and 0.0721 in fixed point (they add up to 1 << kLuminanceBits, so white stays 255).
+    constexpr int kLuminanceRed = 6963;
+    constexpr int kLuminanceGreen = 23442;
+    constexpr int kLuminanceBlue = 2363;
+
+    /**
+     * @brief Luminance of 8-bit RGB rounded to the nearest integer.
+     *
+     * https://stackoverflow.com/questions/14330/rgb-to-monochrome-conversion
+     * Computed in fixed point, so the SIMD kernels (see ConvertSpan()) give exactly the same result for all the inputs.
+     *
+     */
+    constexpr uint8_t RoundedLuminance(unsigned red, unsigned green, unsigned blue)
+    {
+        return static_cast<uint8_t>((kLuminanceRed * red + kLuminanceGreen * green + kLuminanceBlue * blue + (1u << (kLuminanceBits - 1))) >> kLuminanceBits);
+    }
+
+    /**
+     * @brief Compile-time description of a pixel format.
+     *
+     * Each specialization contains:
+     *  pixel_type - the pixel structure of the format.
+     *  kBitsPerPixel - number of bits of a pixel (as stored in the image files).
+     *  kRed, kGreen, kBlue (or kWhite) and kAlpha - the channels of the pixel.
+     *  kPalette, kPaletteSize - the color table of the format (nullptr and 0 for formats with the color stored in the pixel).
+     *  ToRGB565(), ToBGR565(), ToRGB888(), ToBGR888(), ToGrayscale(), ToBW(), ToBGRA8888() - conversions of a pixel to every other format.
+     *
+     * The conversions are the only implementation of the color conversions, Color::ToRGB565() etc. use them too.
+     * Kernels specialized on the pixel types call them directly, so the compiler can inline every format pair.
+     *
+     */
+    template <ColorFormat Format>
+    struct PixelTraits;
+
+    template <>
+    struct PixelTraits<ColorFormat::kRGB565>
+    {
+        using pixel_type = PixelRGB565;
+        static constexpr size_t kBitsPerPixel = 16;
+        static constexpr PixelChannel kRed{0, 5};
+        static constexpr PixelChannel kGreen{5, 6};
+        static constexpr PixelChannel kBlue{11, 5};
+        static constexpr const PixelBGRA8888 *kPalette = nullptr;
+        static constexpr size_t kPaletteSize = 0;
+
+        static constexpr PixelRGB565 ToRGB565(const PixelRGB565 &p) { return p; }
+        static constexpr PixelBGR565 ToBGR565(const PixelRGB565 &p) { return MakePixelBGR565(p.b, p.g, p.r); }
+        static constexpr PixelRGB888 ToRGB888(const PixelRGB565 &p) { return MakePixelRGB888(p.r << 3, p.g << 2, p.b << 3); }
+        static constexpr PixelBGR888 ToBGR888(const PixelRGB565 &p) { return MakePixelBGR888(p.b << 3, p.g << 2, p.r << 3); }
+        static constexpr PixelGrayscale ToGrayscale(const PixelRGB565 &p) { return MakePixelGrayscale(((p.r << 3) + (p.g << 2) + (p.b << 3)) / 3); }
+        static constexpr PixelBW ToBW(const PixelRGB565 &p) { return MakePixelBW(p.r > 15 || p.g > 31 || p.b > 15); }
+        static constexpr PixelBGRA8888 ToBGRA8888(const PixelRGB565 &p) { return MakePixelBGRA8888(p.b << 3, p.g << 2, p.r << 3, 255); }
+    };
+
+    template <>
+    struct PixelTraits<ColorFormat::kBGR565>
+    {
+        using pixel_type = PixelBGR565;
+        static constexpr size_t kBitsPerPixel = 16;
+        static constexpr PixelChannel kRed{11, 5};
+        static constexpr PixelChannel kGreen{5, 6};
+        static constexpr PixelChannel kBlue{0, 5};
+        static constexpr const PixelBGRA8888 *kPalette = nullptr;
+        static constexpr size_t kPaletteSize = 0;
+
+        static constexpr PixelRGB565 ToRGB565(const PixelBGR565 &p) { return MakePixelRGB565(p.r, p.g, p.b); }
+        static constexpr PixelBGR565 ToBGR565(const PixelBGR565 &p) { return p; }
+        static constexpr PixelRGB888 ToRGB888(const PixelBGR565 &p) { return MakePixelRGB888(p.r << 3, p.g << 2, p.b << 3); }
+        static constexpr PixelBGR888 ToBGR888(const PixelBGR565 &p) { return MakePixelBGR888(p.b << 3, p.g << 2, p.r << 3); }
+        static constexpr PixelGrayscale ToGrayscale(const PixelBGR565 &p) { return MakePixelGrayscale(((p.r << 3) + (p.g << 2) + (p.b << 3)) / 3); }
+        static constexpr PixelBW ToBW(const PixelBGR565 &p) { return MakePixelBW(p.r > 15 || p.g > 31 || p.b > 15); }
+        static constexpr PixelBGRA8888 ToBGRA8888(const PixelBGR565 &p) { return MakePixelBGRA8888(p.b << 3, p.g << 2, p.r << 3, 255); }
+    };
+
+    template <>
+    struct PixelTraits<ColorFormat::kRGB888>
+    {
+        using pixel_type = PixelRGB888;
+        static constexpr size_t kBitsPerPixel = 24;
+        static constexpr PixelChannel kRed{0, 8};
+        static constexpr PixelChannel kGreen{8, 8};
+        static constexpr PixelChannel kBlue{16, 8};
+        static constexpr const PixelBGRA8888 *kPalette = nullptr;
+        static constexpr size_t kPaletteSize = 0;
+
+        static constexpr PixelRGB565 ToRGB565(const PixelRGB888 &p) { return MakePixelRGB565(p.r >> 3, p.g >> 2, p.b >> 3); }
+        static constexpr PixelBGR565 ToBGR565(const PixelRGB888 &p) { return MakePixelBGR565(p.b >> 3, p.g >> 2, p.r >> 3); }
+        static constexpr PixelRGB888 ToRGB888(const PixelRGB888 &p) { return p; }
+        static constexpr PixelBGR888 ToBGR888(const PixelRGB888 &p) { return MakePixelBGR888(p.b, p.g, p.r); }
+        static constexpr PixelGrayscale ToGrayscale(const PixelRGB888 &p) { return MakePixelGrayscale(RoundedLuminance(p.r, p.g, p.b)); }
+        static constexpr PixelBW ToBW(const PixelRGB888 &p) { return MakePixelBW(p.r > 127 || p.g > 127 || p.b > 127); }
+        static constexpr PixelBGRA8888 ToBGRA8888(const PixelRGB888 &p) { return MakePixelBGRA8888(p.b, p.g, p.r, 255); }
+    };
+
+    template <>
+    struct PixelTraits<ColorFormat::kBGR888>
+    {
+        using pixel_type = PixelBGR888;
+        static constexpr size_t kBitsPerPixel = 24;
+        static constexpr PixelChannel kRed{16, 8};
+        static constexpr PixelChannel kGreen{8, 8};
+        static constexpr PixelChannel kBlue{0, 8};
+        static constexpr const PixelBGRA8888 *kPalette = nullptr;
+        static constexpr size_t kPaletteSize = 0;
+
+        static constexpr PixelRGB565 ToRGB565(const PixelBGR888 &p) { return MakePixelRGB565(p.r >> 3, p.g >> 2, p.b >> 3); }
+        static constexpr PixelBGR565 ToBGR565(const PixelBGR888 &p) { return MakePixelBGR565(p.b >> 3, p.g >> 2, p.r >> 3); }
+        static constexpr PixelRGB888 ToRGB888(const PixelBGR888 &p) { return MakePixelRGB888(p.r, p.g, p.b); }
+        static constexpr PixelBGR888 ToBGR888(const PixelBGR888 &p) { return p; }
+        static constexpr PixelGrayscale ToGrayscale(const PixelBGR888 &p) { return MakePixelGrayscale(RoundedLuminance(p.r, p.g, p.b)); }
+        static constexpr PixelBW ToBW(const PixelBGR888 &p) { return MakePixelBW(p.r > 127 || p.g > 127 || p.b > 127); }
+        static constexpr PixelBGRA8888 ToBGRA8888(const PixelBGR888 &p) { return MakePixelBGRA8888(p.b, p.g, p.r, 255); }
+    };
+
+    /**
+     * The grayscale palette maps w to (w, w, w), the conversions compute the palette colors instead of reading them.
+     *
+     */
+    template <>
+    struct PixelTraits<ColorFormat::kGrayscale>
+    {
+        using pixel_type = PixelGrayscale;
+        static constexpr size_t kBitsPerPixel = 8;
+        static constexpr PixelChannel kWhite{0, 8};
+        static constexpr const PixelBGRA8888 *kPalette = grayscale_palette;
+        static constexpr size_t kPaletteSize = 256;
+
+        static constexpr PixelRGB565 ToRGB565(const PixelGrayscale &p) { return MakePixelRGB565(p.w, p.w, p.w); }
+        static constexpr PixelBGR565 ToBGR565(const PixelGrayscale &p) { return MakePixelBGR565(p.w, p.w, p.w); }
+        static constexpr PixelRGB888 ToRGB888(const PixelGrayscale &p) { return MakePixelRGB888(p.w, p.w, p.w); }
+        static constexpr PixelBGR888 ToBGR888(const PixelGrayscale &p) { return MakePixelBGR888(p.w, p.w, p.w); }
+        static constexpr PixelGrayscale ToGrayscale(const PixelGrayscale &p) { return p; }
+        static constexpr PixelBW ToBW(const PixelGrayscale &p) { return MakePixelBW(p.w > 127); }
+        static constexpr PixelBGRA8888 ToBGRA8888(const PixelGrayscale &p) { return MakePixelBGRA8888(p.w, p.w, p.w, 255); }
+    };
+
+    /**
+     * The BW palette maps 0 to black and 1 to white, the conversions compute the palette colors instead of reading them.
+     *
+     */
+    template <>
+    struct PixelTraits<ColorFormat::kBW>
+    {
+        using pixel_type = PixelBW;
+        static constexpr size_t kBitsPerPixel = 1;
+        static constexpr PixelChannel kWhite{0, 1};
+        static constexpr const PixelBGRA8888 *kPalette = bw_palette;
+        static constexpr size_t kPaletteSize = 2;
+
+        static constexpr PixelRGB565 ToRGB565(const PixelBW &p) { return MakePixelRGB565(p.w * 255, p.w * 255, p.w * 255); }
+        static constexpr PixelBGR565 ToBGR565(const PixelBW &p) { return MakePixelBGR565(p.w * 255, p.w * 255, p.w * 255); }
+        static constexpr PixelRGB888 ToRGB888(const PixelBW &p) { return MakePixelRGB888(p.w * 255, p.w * 255, p.w * 255); }
+        static constexpr PixelBGR888 ToBGR888(const PixelBW &p) { return MakePixelBGR888(p.w * 255, p.w * 255, p.w * 255); }
+        static constexpr PixelGrayscale ToGrayscale(const PixelBW &p) { return MakePixelGrayscale(p.w * 255); }
+        static constexpr PixelBW ToBW(const PixelBW &p) { return p; }
+        static constexpr PixelBGRA8888 ToBGRA8888(const PixelBW &p) { return MakePixelBGRA8888(p.w * 255, p.w * 255, p.w * 255, 255); }
+    };
+
+    /**
+     * The pixels have premultiplied alpha (see blend.h), the conversions into the opaque formats drop the alpha
+     * (which gives the color over black).
+     *
+     */
+    template <>
+    struct PixelTraits<ColorFormat::kBGRA8888>
+    {
+        using pixel_type = PixelBGRA8888;
+        static constexpr size_t kBitsPerPixel = 32;
+        static constexpr PixelChannel kRed{16, 8};
+        static constexpr PixelChannel kGreen{8, 8};
+        static constexpr PixelChannel kBlue{0, 8};
+        static constexpr PixelChannel kAlpha{24, 8};
+        static constexpr const PixelBGRA8888 *kPalette = nullptr;
+        static constexpr size_t kPaletteSize = 0;
+
+        static constexpr PixelRGB565 ToRGB565(const PixelBGRA8888 &p) { return MakePixelRGB565(p.r >> 3, p.g >> 2, p.b >> 3); }
+        static constexpr PixelBGR565 ToBGR565(const PixelBGRA8888 &p) { return MakePixelBGR565(p.b >> 3, p.g >> 2, p.r >> 3); }
+        static constexpr PixelRGB888 ToRGB888(const PixelBGRA8888 &p) { return MakePixelRGB888(p.r, p.g, p.b); }
+        static constexpr PixelBGR888 ToBGR888(const PixelBGRA8888 &p) { return MakePixelBGR888(p.b, p.g, p.r); }
+        static constexpr PixelGrayscale ToGrayscale(const PixelBGRA8888 &p) { return MakePixelGrayscale(RoundedLuminance(p.r, p.g, p.b)); }
+        static constexpr PixelBW ToBW(const PixelBGRA8888 &p) { return MakePixelBW(p.r > 127 || p.g > 127 || p.b > 127); }
+        static constexpr PixelBGRA8888 ToBGRA8888(const PixelBGRA8888 &p) { return p; }
+    };
+
+    /**
+     * @brief Maps a pixel structure to its ColorFormat (PixelFormatOf<PixelT>::value).
+     *
+     */
+    template <typename PixelT>
+    struct PixelFormatOf;
+
+    template <>
+    struct PixelFormatOf<PixelRGB565>
+    {
+        static constexpr ColorFormat value = ColorFormat::kRGB565;
+    };
+
+    template <>
+    struct PixelFormatOf<PixelBGR565>
+    {
+        static constexpr ColorFormat value = ColorFormat::kBGR565;
+    };
+
+    template <>
+    struct PixelFormatOf<PixelRGB888>
+    {
+        static constexpr ColorFormat value = ColorFormat::kRGB888;
+    };
+
+    template <>
+    struct PixelFormatOf<PixelBGR888>
+    {
+        static constexpr ColorFormat value = ColorFormat::kBGR888;
+    };
+
+    template <>
+    struct PixelFormatOf<PixelGrayscale>
+    {
+        static constexpr ColorFormat value = ColorFormat::kGrayscale;
+    };
+
+    template <>
+    struct PixelFormatOf<PixelBW>
+    {
+        static constexpr ColorFormat value = ColorFormat::kBW;
+    };
+
+    template <>
+    struct PixelFormatOf<PixelBGRA8888>
+    {
+        static constexpr ColorFormat value = ColorFormat::kBGRA8888;
+    };
+
+    // Indexed pixels have no PixelTraits, their colors are in the Palette
+    template <>
+    struct PixelFormatOf<PixelIndexed8>
+    {
+        static constexpr ColorFormat value = ColorFormat::kIndexed8;
+    };
+
+    template <typename PixelT>
+    constexpr ColorFormat kPixelFormat = PixelFormatOf<PixelT>::value;
+
+    /**
+     * @brief Converts a pixel from one format into another (the same result as Color::SetColor()).
+     *
+     * @param src the source pixel.
+     * @return DstT the converted pixel.
+     */
+    template <typename DstT, typename SrcT>
+    constexpr DstT ConvertPixel(const SrcT &src)
+    {
+        using Traits = PixelTraits<kPixelFormat<SrcT>>;
+
+        if constexpr (kPixelFormat<DstT> == ColorFormat::kRGB565)
+            return Traits::ToRGB565(src);
+        else if constexpr (kPixelFormat<DstT> == ColorFormat::kBGR565)
+            return Traits::ToBGR565(src);
+        else if constexpr (kPixelFormat<DstT> == ColorFormat::kRGB888)
+            return Traits::ToRGB888(src);
+        else if constexpr (kPixelFormat<DstT> == ColorFormat::kBGR888)
+            return Traits::ToBGR888(src);
+        else if constexpr (kPixelFormat<DstT> == ColorFormat::kGrayscale)
+            return Traits::ToGrayscale(src);
+        else if constexpr (kPixelFormat<DstT> == ColorFormat::kBGRA8888)
+            return Traits::ToBGRA8888(src);
+        else
+            return Traits::ToBW(src);
+    }
+}
+
+#endif // PAINT_INC_PIXEL_TRAITS_H_
@@ -0,0 +1,176 @@
+#ifndef PAINT_INC_RASTER_H_
+#define PAINT_INC_RASTER_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "unit.h"
+#include "point.h"
+
+namespace paint
+{
+    /**
+     * @brief A run of pixels [x_begin, x_end) in row y.
+     *
+     */
+    struct RowSpan
+    {
+        Unit y;
+        Unit x_begin;
+        Unit x_end;
+    };
+
+    /**
+     * @brief Splits a line into runs of pixels, one run per row of the image (clipped to the image).
+     *
+     * The runs are computed row by row (without visiting the pixels), so drawing a line costs one run per row instead of one pixel at a time:
+     *  - lines 1px wide are Bresenham lines (both end points included), each row is a slice of the line,
+     *  - wider lines cover the pixels with centers inside the rectangle around the line
+     *    (width wide and half a pixel longer at both ends),
+     *  - the antialiased lines have the coverage of the pixels near the edges of the rectangle
+     *    (one pixel wide box filter of the distance from the edge).
+     *
+     * The pixel centers are the integer points.
+     *
+     */
+    class LineRasterizer
+    {
+    public:
+        /**
+         * @brief Constructs the rasterizer of the line.
+         *
+         * @param start start point of the line.
+         * @param end end point of the line.
+         * @param width width of the line (widths below 2 are Bresenham lines if not antialiased).
+         * @param size size of the image (the runs are clipped to it).
+         * @param antialias whether the pixels on the edges get their coverage (ForEachCoverageRow()) or are covered or not (GetSpans()).
+         */
+        LineRasterizer(Point start, Point end, Unit width, Point size, bool antialias = false);
+
+        /**
+         * @brief Limits the runs to the rows [row_begin, row_end) (i.e. one band of the image drawn by one thread).
+         *
+         */
+        void ClipRows(Unit row_begin, Unit row_end);
+
+        /**
+         * @brief Get the non empty runs of the rows covered by the line (at most one run per row).
+         *
+         * @param spans the runs (cleared first), a reused vector keeps its memory.
+         */
+        void GetSpans(std::vector<RowSpan> &spans) const;
+
+        /**
+         * @brief Calls fn(y, x_begin, coverage, count) for every row with pixels covered by the antialiased line.
+         *
+         * coverage[i] is the coverage of the pixel x_begin + i (0 - 255), the first and the last pixels have some coverage.
+         *
+         */
+        template <typename Function>
+        void ForEachCoverageRow(Function &&fn)
+        {
+            for (Unit y = row_begin_; y < row_end_; y++)
+            {
+                auto [x_begin, x_end] = CoverageSpan(y);
+                if (x_begin < x_end)
+                    fn(y, x_begin, static_cast<const uint8_t *>(coverage_.data()), x_end - x_begin);
+            }
+        }
+
+    private:
+        void GetBresenhamSpans(std::vector<RowSpan> &spans) const;
+
+        // Computes the coverage of the pixels of row y into coverage_, returns the pixels with some coverage
+        std::pair<Unit, Unit> CoverageSpan(Unit y);
+
+        // Intersection of the row with the rectangle of the line with the edges moved by grow (both in width and in length)
+        bool RowInterval(Unit y, double grow, double &x_left, double &x_right) const;
+
+        // Clips the pixels [x_begin, x_end) relative to the start point to the image
+        std::pair<Unit, Unit> ClipSpan(int64_t x_begin, int64_t x_end) const;
+
+        Point start_;
+        Point end_;
+        Point size_;
+        bool bresenham_;
+
+        // Bresenham lines (start_.x <= end_.x)
+        int64_t dx_ = 0;
+        int64_t dy_abs_ = 0;
+        int64_t step_y_ = 1;
+
+        // Rectangle around the line (relative to the start point)
+        double half_width_ = 0; // Distance of the long edges from the line
+        double length_ = 0;     // Length of the line
+        double cap_ = 0.5;      // Distance of the short edges from the end points
+        double ux_ = 1;         // Direction of the line
+        double uy_ = 0;
+        double nx_ = 0; // Normal of the line
+        double ny_ = 1;
+        double inverse_ux_ = 1; // 1 / ux_ (0 if the line is vertical)
+        double inverse_nx_ = 0; // 1 / nx_ (0 if the line is horizontal)
+
+        Unit row_begin_ = 0; // The first row of the rectangle (clipped)
+        Unit row_end_ = 0;   // One after the last row of the rectangle (clipped)
+
+        Unit clip_row_begin_ = 0; // Rows the runs are clipped to
+        Unit clip_row_end_;
+
+        std::vector<uint8_t> coverage_; // Coverage of the last antialiased row
+    };
+
+    /**
+     * @brief Splits a circle into runs of pixels of its border (ring) and of its inside, clipped to the image.
+     *
+     * The border covers the pixels with centers at distance d from the center with
+     * radius - border_width / 2 <= d < radius + border_width / 2, the inside covers the pixels closer to the center.
+     * Each row has at most 2 runs of the border and one run of the inside, the ends of the runs are found
+     * by integer square roots, so the runs are exact and drawing a filled circle costs one run per row.
+     *
+     */
+    class CircleRasterizer
+    {
+    public:
+        /**
+         * @brief Constructs the rasterizer of the circle.
+         *
+         * @param center center of the circle.
+         * @param radius radius of the middle of the border.
+         * @param border_width width of the border (0 = no border).
+         * @param size size of the image (the runs are clipped to it).
+         */
+        CircleRasterizer(Point center, Unit radius, Unit border_width, Point size);
+
+        /**
+         * @brief Limits the runs to the rows [row_begin, row_end) (see LineRasterizer::ClipRows()).
+         *
+         */
+        void ClipRows(Unit row_begin, Unit row_end);
+
+        /**
+         * @brief Get the non empty runs of the border and of the inside of the circle.
+         *
+         * @param border_spans the runs of the border (cleared first).
+         * @param fill_spans the runs of the inside (cleared first).
+         */
+        void GetSpans(std::vector<RowSpan> &border_spans, std::vector<RowSpan> &fill_spans) const;
+
+    private:
+        // The last pixel dx (relative to the center) of the row dy inside the circle of the doubled radius, -1 if none
+        static int64_t HalfSpan(uint64_t doubled_radius, int64_t dy);
+
+        // Adds the run of the pixels [x_begin, x_end) relative to the center clipped to the image
+        void AddSpan(std::vector<RowSpan> &spans, Unit y, int64_t x_begin, int64_t x_end) const;
+
+        Point center_;
+        Point size_;
+        uint64_t outer_; // Doubled radius of the outer edge of the border (2 * radius + border_width)
+        uint64_t inner_; // Doubled radius of the inner edge of the border (2 * radius - border_width, at least 0)
+
+        Unit row_begin_ = 0; // The first row of the circle (clipped)
+        Unit row_end_ = 0;   // One after the last row of the circle (clipped)
+    };
+}
+
+#endif // PAINT_INC_RASTER_H_
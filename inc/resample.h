@@ -0,0 +1,92 @@
+#ifndef PAINT_INC_RESAMPLE_H_
+#define PAINT_INC_RESAMPLE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "unit.h"
+#include "data_pixels.h"
+
+namespace paint
+{
+    /**
+     * @brief Filters used to resize the image.
+     *
+     */
+    enum class ResampleFilter
+    {
+        kInterpolate, /// Bilinear interpolation of the 4 pixels around each sample (not antialiased, indexed pixels pick the nearest pixel).
+        kBox,         /// Average of the covered pixels (the nearest pixel when upscaling).
+        kBilinear,    /// Triangle filter (radius 1 pixel).
+        kBicubic,     /// Cubic convolution with a = -0.5 (radius 2 pixels).
+        kLanczos3,    /// Windowed sinc (radius 3 pixels).
+    };
+
+    /**
+     * @brief Fixed-point weights of the source pixels of every destination pixel along one axis.
+     *
+     * The filter is centered on the destination pixel mapped into the source and stretched by the scale when downscaling
+     * (every source pixel contributes, so the result is antialiased). The taps outside of the image are moved to the edge pixels.
+     * The weights of a destination pixel add up to exactly 1 << kWeightBits, so a flat color stays the same.
+     *
+     */
+    struct ResampleWeights
+    {
+        static constexpr int kWeightBits = 14; /// Fractional bits of the weights.
+
+        /**
+         * @brief Computes the weights.
+         *
+         * @param filter the filter (not ResampleFilter::kInterpolate).
+         * @param src_size number of source pixels.
+         * @param dst_size number of destination pixels.
+         */
+        ResampleWeights(ResampleFilter filter, Unit src_size, Unit dst_size);
+
+        size_t taps;                 /// Number of the weights of every destination pixel, a multiple of 8 (the unused weights are 0).
+        std::vector<Unit> first;     /// The first source pixel of every destination pixel.
+        std::vector<Unit> count;     /// Number of the used weights of every destination pixel (first + count <= src_size).
+        std::vector<int16_t> values; /// taps weights of every destination pixel.
+    };
+
+    /**
+     * @brief Resizes data into new_data by a separable filter.
+     *
+     * The rows are first filtered horizontally into an image with the new width (the source rows in parallel),
+     * the columns of it are then filtered vertically (the new rows in parallel). The weights are computed once for each axis.
+     * All the arithmetic is in fixed point, 8-bit channels are filtered vertically by SIMD kernels selected by GetSimdLevel()
+     * (all the levels give the same result).
+     *
+     * The 8-bit channel formats (24-bit color, grayscale, premultiplied BGRA8888) are filtered as stored, in linear light
+     * the 24-bit color and grayscale channels are decoded into 16 bits first (see srgb.h). The 565 and indexed pixels
+     * are filtered as 24-bit color (indexed pixels get the nearest palette color, see PaletteMapper), BW pixels as grayscale.
+     *
+     * The box filter of an integer factor (the sizes are multiples of the new sizes) averages the aligned blocks of pixels
+     * directly, each block of rows is summed into one row of sums (the new rows in parallel).
+     *
+     * @param data the image.
+     * @param new_data the resized image (the same color type, any size and layout, nothing is done if it has no pixels).
+     * @param filter the filter (not ResampleFilter::kInterpolate).
+     * @param linear_light whether the 24-bit color and grayscale channels are filtered in linear light.
+     * @param thread_count number of threads (0 = DefaultThreadCount()).
+     */
+    void Resample(DataPixels &data, DataPixels &new_data, ResampleFilter filter, bool linear_light, unsigned thread_count = 0);
+
+    /**
+     * @brief Halves the image level_count times (a mip pyramid, i.e. thumbnails of several sizes).
+     *
+     * Every pixel of the level n is the average of its block of 2^n * 2^n pixels of data (the last odd row and column
+     * of the blocks are left out). All the levels are made in one pass over data: bands of 2^level_count rows
+     * are summed into the rows of every level on multiple threads. The formats are averaged as by Resample().
+     *
+     * @param data the image.
+     * @param level_count number of the halvings (only the levels at least 1 pixel wide and high are made).
+     * @param linear_light whether the 24-bit color and grayscale channels are averaged in linear light.
+     * @param thread_count number of threads (0 = DefaultThreadCount()).
+     * @return std::vector<std::shared_ptr<DataPixels>> the halved images (the same color type and layout), the biggest first.
+     */
+    std::vector<std::shared_ptr<DataPixels>> MakePyramid(DataPixels &data, size_t level_count, bool linear_light, unsigned thread_count = 0);
+}
+
+#endif // PAINT_INC_RESAMPLE_H_
@@ -0,0 +1,138 @@
+#ifndef PAINT_INC_ROW_BLENDER_H_
+#define PAINT_INC_ROW_BLENDER_H_
+
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "unit.h"
+#include "pixel.h"
+#include "color.h"
+#include "data_pixels.h"
+#include "data_pixels_view.h"
+#include "convert_span.h"
+#include "palette.h"
+#include "blend.h"
+
+namespace paint
+{
+    /**
+     * @brief Returns the premultiplied pixel of the color if drawing with it blends (the color is translucent).
+     * 
+     */
+    std::optional<PixelBGRA8888> TranslucentPixel(const Color &color);
+
+    /**
+     * @brief Converts the color to the pixel stored in data.
+     * 
+     * Indexed data gets the index of the nearest color of its palette.
+     * 
+     */
+    template <typename PixelT>
+    PixelT DataPixelFromColor(const DataPixels &data, const Color &color)
+    {
+        if constexpr (std::is_same_v<PixelT, PixelIndexed8>)
+            return PixelIndexed8{data.GetPalette()->FindNearest(PixelFromColor<PixelRGB888>(color))};
+        else
+            return PixelFromColor<PixelT>(color);
+    }
+
+    /**
+     * @brief Blends premultiplied BGRA8888 pixels over the rows of data (in any format and layout).
+     * 
+     * BGRA8888 pixels are blended in place, the other pixels are converted into BGRA8888 and back
+     * (indexed pixels get the nearest colors of their palette). Only the blended pixels are converted.
+     * Linear and tiled rows are blended by their continuous segments, planar and packed rows are copied out and back.
+     * The blended pixels of linear and tiled data have to be writable (see DataPixels::MakeWritable()).
+     * 
+     * The blender keeps its buffers, so every thread needs its own blender, and the threads have to blend
+     * different rows (the planar and packed rows are written back whole).
+     * 
+     */
+    class RowBlender
+    {
+    public:
+        explicit RowBlender(DataPixels &data);
+
+        // Blends color over the pixels [x_begin, x_end) of row y
+        void BlendColor(Unit y, Unit x_begin, Unit x_end, const PixelBGRA8888 &color)
+        {
+            BlendRow(y, x_begin, x_end, [&color](PixelBGRA8888 *pixels, Unit, Unit count) {
+                BlendSpanSolid(color, pixels, count);
+            });
+        }
+
+        // Blends src (starting with the pixel over x_begin) over the pixels [x_begin, x_end) of row y
+        void BlendPixels(Unit y, Unit x_begin, Unit x_end, const PixelBGRA8888 *src)
+        {
+            BlendRow(y, x_begin, x_end, [src, x_begin](PixelBGRA8888 *pixels, Unit x, Unit count) {
+                BlendSpan(src + (x - x_begin), pixels, count);
+            });
+        }
+
+    private:
+        template <typename Function>
+        void BlendRow(Unit y, Unit x_begin, Unit x_end, Function &&blend)
+        {
+            if (x_begin >= x_end)
+                return;
+
+            if (data_.GetLayout() == PixelLayout::kPlanar || data_.GetLayout() == PixelLayout::kPacked)
+            {
+                row_.resize(data_.GetRowSize());
+                data_.CopyRowTo(y, row_.data());
+                BlendSegment(row_.data() + x_begin * pixel_size_, x_begin, x_end - x_begin, blend);
+                data_.CopyRowFrom(y, row_.data());
+                return;
+            }
+
+            DispatchPixelType(format_, [&](auto tag) {
+                using PixelT = typename decltype(tag)::type;
+
+                DataPixelsView<PixelT>(data_).ForEachRowSegment(y, x_begin, x_end, [&](PixelT *segment, Unit x, Unit count) {
+                    BlendSegment(reinterpret_cast<uint8_t *>(segment), x, count, blend);
+                });
+            });
+        }
+
+        template <typename Function>
+        void BlendSegment(uint8_t *pixels, Unit x, Unit count, Function &blend)
+        {
+            if (format_ == ColorFormat::kBGRA8888)
+            {
+                blend(reinterpret_cast<PixelBGRA8888 *>(pixels), x, count);
+                return;
+            }
+
+            blended_.resize(count);
+            if (mapper_)
+                data_.GetPalette()->ConvertIndices(pixels, ColorFormat::kBGRA8888, blended_.data(), count);
+            else
+                ConvertSpan(format_, ColorFormat::kBGRA8888, pixels, blended_.data(), count);
+
+            blend(blended_.data(), x, count);
+
+            if (mapper_)
+            {
+                colors_.resize(count);
+                ConvertSpan(ColorFormat::kBGRA8888, ColorFormat::kRGB888, blended_.data(), colors_.data(), count);
+                mapper_->MapSpan(colors_.data(), pixels, count);
+            }
+            else
+            {
+                ConvertSpan(ColorFormat::kBGRA8888, format_, blended_.data(), pixels, count);
+            }
+        }
+
+        DataPixels &data_;
+        ColorFormat format_;
+        size_t pixel_size_;
+        std::optional<PaletteMapper> mapper_;  // Nearest palette colors of indexed data
+        std::vector<uint8_t> row_;             // Planar and packed row
+        std::vector<PixelBGRA8888> blended_;   // Converted pixels
+        std::vector<PixelRGB888> colors_;      // Blended pixels to map to the palette
+    };
+}
+
+#endif // PAINT_INC_ROW_BLENDER_H_
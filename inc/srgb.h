@@ -0,0 +1,74 @@
+#ifndef PAINT_INC_SRGB_H_
+#define PAINT_INC_SRGB_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "color.h"
+
+namespace paint
+{
+    /**
+     * @brief Decodes an sRGB encoded 8-bit channel into linear light.
+     *
+     * @param value sRGB channel (0 - 255).
+     * @return uint16_t linear light (0 - 65535).
+     */
+    uint16_t SrgbToLinear(uint8_t value);
+
+    /**
+     * @brief Encodes linear light into an sRGB 8-bit channel.
+     *
+     * The encoding table has 4096 entries (the top 12 bits of value), so it stays in the L1 cache.
+     * Every channel survives SrgbToLinear() and LinearToSrgb() unchanged.
+     *
+     * @param value linear light (0 - 65535).
+     * @return uint8_t sRGB channel (0 - 255).
+     */
+    uint8_t LinearToSrgb(uint16_t value);
+
+    /**
+     * @brief Decodes n sRGB channels into linear light (see SrgbToLinear()).
+     *
+     */
+    void SrgbToLinearSpan(const uint8_t *src, uint16_t *dst, size_t n);
+
+    /**
+     * @brief Encodes n linear light channels into sRGB (see LinearToSrgb()).
+     *
+     */
+    void LinearToSrgbSpan(const uint16_t *src, uint8_t *dst, size_t n);
+
+    /**
+     * @brief Converts n RGB888 or BGR888 pixels into grayscale in linear light.
+     *
+     * The channels are weighted in linear light with the Rec. 709 weights (the same as PixelTraits::ToGrayscale())
+     * and the luminance is encoded back into sRGB. The decoding and weighting of a channel is one lookup of a table
+     * of the weighted linear values, so a pixel is 3 lookups, 2 additions and the lookup of the encoding.
+     *
+     * @param src_format ColorFormat::kRGB888 or ColorFormat::kBGR888.
+     * @param src the first pixel.
+     * @param dst the first grayscale pixel.
+     * @param n number of pixels.
+     */
+    void LinearLuminanceSpan(ColorFormat src_format, const uint8_t *src, uint8_t *dst, size_t n);
+
+    /// Fractional bits of the weight of LerpLinearSpan().
+    constexpr int kLerpWeightBits = 15;
+
+    /**
+     * @brief Interpolates n channels of linear light between a and b.
+     *
+     * dst = a + (b - a) * weight / 2^kLerpWeightBits rounded to the nearest integer (in 32-bit integers,
+     * the kernels selected by GetSimdLevel() give the same result).
+     *
+     * @param a the channels at weight 0.
+     * @param b the channels at weight 1 << kLerpWeightBits.
+     * @param weight the weight of b (0 - 1 << kLerpWeightBits).
+     * @param dst the interpolated channels.
+     * @param n number of channels.
+     */
+    void LerpLinearSpan(const uint16_t *a, const uint16_t *b, int32_t weight, uint16_t *dst, size_t n);
+}
+
+#endif // PAINT_INC_SRGB_H_
@@ -9,5 +9,13 @@ namespace paint
      * 
      */
     using Unit = int32_t;
+
+    /**
+     * @brief A linear index of a pixel (y * width + x).
+     * 
+     * The product of 2 Units does not fit into Unit for images with more than 2^31 pixels, so the index is 64-bit.
+     * 
+     */
+    using PixelIndex = int64_t;
 }
 #endif // PAINT_INC_UNIT_H_
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PAINT_BLEND_X86
+#include <immintrin.h>
+#endif
+
+#include "blend.h"
+#include "convert_span.h"
+
+namespace paint
+{
+    namespace
+    {
+        void BlendSpanScalar(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+                dst[i] = BlendPixel(src[i], dst[i]);
+        }
+
+        void BlendSpanSolidScalar(const PixelBGRA8888 &color, PixelBGRA8888 *dst, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+                dst[i] = BlendPixel(color, dst[i]);
+        }
+
+#ifdef PAINT_BLEND_X86
+        /*
+         * The SIMD kernels give the same result as BlendPixel():
+         *  - the channels are widened to 16 bits, dst * (255 - src.a) is divided by 255 the same way as MulDiv255(),
+         *  - the sum with src is saturated (adds_epu8).
+         * Each kernel blends blocks of 4 (SSE4.1) or 8 (AVX2) pixels, the rest is left to the scalar kernel.
+         */
+
+        __attribute__((target("sse4.1"))) inline __m128i MulDiv255SSE41(__m128i x, __m128i y)
+        {
+            __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+
+        // 255 - alpha of every pixel in all 4 bytes of the pixel
+        __attribute__((target("sse4.1"))) inline __m128i InverseAlphaSSE41(__m128i src)
+        {
+            const __m128i alpha_mask = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+            return _mm_xor_si128(_mm_shuffle_epi8(src, alpha_mask), _mm_set1_epi8(-1));
+        }
+
+        __attribute__((target("sse4.1"))) inline __m128i BlendSSE41(__m128i src, __m128i inverse_alpha, __m128i dst)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo = MulDiv255SSE41(_mm_unpacklo_epi8(dst, zero), _mm_unpacklo_epi8(inverse_alpha, zero));
+            __m128i hi = MulDiv255SSE41(_mm_unpackhi_epi8(dst, zero), _mm_unpackhi_epi8(inverse_alpha, zero));
+            return _mm_adds_epu8(src, _mm_packus_epi16(lo, hi));
+        }
+
+        __attribute__((target("sse4.1"))) void BlendSpanSSE41(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), BlendSSE41(s, InverseAlphaSSE41(s), d));
+            }
+
+            BlendSpanScalar(src + i, dst + i, n - i);
+        }
+
+        __attribute__((target("sse4.1"))) void BlendSpanSolidSSE41(const PixelBGRA8888 &color, PixelBGRA8888 *dst, size_t n)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &color, sizeof(bits));
+            const __m128i s = _mm_set1_epi32(static_cast<int>(bits));
+            const __m128i inverse_alpha = InverseAlphaSSE41(s);
+
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), BlendSSE41(s, inverse_alpha, d));
+            }
+
+            BlendSpanSolidScalar(color, dst + i, n - i);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i MulDiv255AVX2(__m256i x, __m256i y)
+        {
+            __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, y), _mm256_set1_epi16(128));
+            return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i InverseAlphaAVX2(__m256i src)
+        {
+            // pshufb works within the 128-bit lanes, so the mask is the same for both of them
+            const __m256i alpha_mask = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+                                                        3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+            return _mm256_xor_si256(_mm256_shuffle_epi8(src, alpha_mask), _mm256_set1_epi8(-1));
+        }
+
+        // The unpacks and the pack work within the 128-bit lanes, so the pixels stay in place
+        __attribute__((target("avx2"))) inline __m256i BlendAVX2(__m256i src, __m256i inverse_alpha, __m256i dst)
+        {
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i lo = MulDiv255AVX2(_mm256_unpacklo_epi8(dst, zero), _mm256_unpacklo_epi8(inverse_alpha, zero));
+            __m256i hi = MulDiv255AVX2(_mm256_unpackhi_epi8(dst, zero), _mm256_unpackhi_epi8(inverse_alpha, zero));
+            return _mm256_adds_epu8(src, _mm256_packus_epi16(lo, hi));
+        }
+
+        __attribute__((target("avx2"))) void BlendSpanAVX2(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), BlendAVX2(s, InverseAlphaAVX2(s), d));
+            }
+
+            BlendSpanSSE41(src + i, dst + i, n - i);
+        }
+
+        __attribute__((target("avx2"))) void BlendSpanSolidAVX2(const PixelBGRA8888 &color, PixelBGRA8888 *dst, size_t n)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &color, sizeof(bits));
+            const __m256i s = _mm256_set1_epi32(static_cast<int>(bits));
+            const __m256i inverse_alpha = InverseAlphaAVX2(s);
+
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), BlendAVX2(s, inverse_alpha, d));
+            }
+
+            BlendSpanSolidSSE41(color, dst + i, n - i);
+        }
+#endif
+
+        using BlendKernel = void (*)(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n);
+        using BlendSolidKernel = void (*)(const PixelBGRA8888 &color, PixelBGRA8888 *dst, size_t n);
+
+        struct BlendKernels
+        {
+            BlendKernel blend = BlendSpanScalar;
+            BlendSolidKernel blend_solid = BlendSpanSolidScalar;
+        };
+
+        BlendKernels SelectBlendKernels(SimdLevel level)
+        {
+            BlendKernels kernels;
+
+#ifdef PAINT_BLEND_X86
+            if (level >= SimdLevel::kSSE41)
+            {
+                kernels.blend = BlendSpanSSE41;
+                kernels.blend_solid = BlendSpanSolidSSE41;
+            }
+
+            if (level >= SimdLevel::kAVX2)
+            {
+                kernels.blend = BlendSpanAVX2;
+                kernels.blend_solid = BlendSpanSolidAVX2;
+            }
+#else
+            (void)level;
+#endif
+
+            return kernels;
+        }
+
+        const BlendKernels blend_kernels[] = {SelectBlendKernels(SimdLevel::kScalar), SelectBlendKernels(SimdLevel::kSSE41),
+                                              SelectBlendKernels(SimdLevel::kAVX2), SelectBlendKernels(SimdLevel::kAVX512)};
+    }
+
+    void PremultiplySpan(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            dst[i] = PremultiplyPixel(src[i]);
+    }
+
+    void UnpremultiplySpan(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            dst[i] = UnpremultiplyPixel(src[i]);
+    }
+
+    void BlendSpan(const PixelBGRA8888 *src, PixelBGRA8888 *dst, size_t n)
+    {
+        blend_kernels[static_cast<int>(GetSimdLevel())].blend(src, dst, n);
+    }
+
+    void BlendSpanSolid(const PixelBGRA8888 &color, PixelBGRA8888 *dst, size_t n)
+    {
+        blend_kernels[static_cast<int>(GetSimdLevel())].blend_solid(color, dst, n);
+    }
+}
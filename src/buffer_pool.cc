@@ -0,0 +1,139 @@
+#include "buffer_pool.h"
+
+#include <new>
+
+namespace paint
+{
+    namespace
+    {
+        void FreeBuffer(uint8_t *data, size_t alignment)
+        {
+            ::operator delete[](data, std::align_val_t(alignment));
+        }
+    }
+
+    BufferPool::~BufferPool()
+    {
+        Clear();
+    }
+
+    const std::shared_ptr<BufferPool> &BufferPool::GetDefault()
+    {
+        // Buffers keep the pool alive, so it can outlive this pointer during static destruction
+        static const std::shared_ptr<BufferPool> pool = std::make_shared<BufferPool>();
+        return pool;
+    }
+
+    size_t BufferPool::GetSizeClass(size_t byte_count)
+    {
+        if (byte_count <= kMinSizeClass)
+            return kMinSizeClass;
+
+        // Largest power of 2 smaller than byte_count, the classes are 4 steps to the next power of 2
+        size_t power = kMinSizeClass;
+        while ((power << 1) < byte_count)
+            power <<= 1;
+
+        size_t step = power >> 2;
+        return (byte_count + step - 1) & ~(step - 1);
+    }
+
+    std::shared_ptr<uint8_t> BufferPool::Allocate(size_t byte_count, size_t alignment)
+    {
+        SizeClassKey key{GetSizeClass(byte_count), alignment};
+        uint8_t *data = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            auto it = free_buffers_.find(key);
+            if (it != free_buffers_.end() && !it->second.empty())
+            {
+                data = it->second.back();
+                it->second.pop_back();
+                statistics_.cached_byte_count -= key.first;
+                statistics_.hit_count++;
+            }
+            else
+            {
+                statistics_.miss_count++;
+            }
+        }
+
+        // Nothing in the pool -> allocate new buffer (outside of the lock)
+        if (!data)
+            data = static_cast<uint8_t *>(::operator new[](key.first, std::align_val_t(alignment)));
+
+        std::shared_ptr<BufferPool> pool = shared_from_this();
+        return std::shared_ptr<uint8_t>(data, [pool, key](uint8_t *released) { pool->Release(released, key); });
+    }
+
+    void BufferPool::Release(uint8_t *data, SizeClassKey key)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (statistics_.cached_byte_count + key.first <= capacity_)
+            {
+                free_buffers_[key].push_back(data);
+                statistics_.cached_byte_count += key.first;
+                statistics_.release_count++;
+                return;
+            }
+
+            statistics_.discard_count++;
+        }
+
+        FreeBuffer(data, key.second);
+    }
+
+    void BufferPool::SetCapacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        Trim(capacity);
+    }
+
+    size_t BufferPool::GetCapacity() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return capacity_;
+    }
+
+    BufferPool::Statistics BufferPool::GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return statistics_;
+    }
+
+    void BufferPool::ResetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // Cached bytes are the state of the pool, not a counter
+        size_t cached_byte_count = statistics_.cached_byte_count;
+        statistics_ = Statistics{};
+        statistics_.cached_byte_count = cached_byte_count;
+    }
+
+    void BufferPool::Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Trim(0);
+    }
+
+    void BufferPool::Trim(size_t capacity)
+    {
+        // Free the largest buffers first
+        for (auto it = free_buffers_.rbegin(); it != free_buffers_.rend() && statistics_.cached_byte_count > capacity; ++it)
+        {
+            auto &buffers = it->second;
+            while (!buffers.empty() && statistics_.cached_byte_count > capacity)
+            {
+                FreeBuffer(buffers.back(), it->first.second);
+                buffers.pop_back();
+                statistics_.cached_byte_count -= it->first.first;
+            }
+        }
+    }
+}
@@ -1,10 +1,11 @@
 #include "colors.h"
+#include "pixel_traits.h"
 
 namespace paint
 {
     ColorRGB565 ColorBGR565::ToRGB565() const
     {
-        return ColorRGB565(pixel_.r, pixel_.g, pixel_.b);
+        return ColorRGB565(PixelTraits<ColorFormat::kBGR565>::ToRGB565(pixel_));
     }
 
     ColorBGR565 ColorBGR565::ToBGR565() const
@@ -14,21 +15,26 @@ namespace paint
 
     ColorRGB888 ColorBGR565::ToRGB888() const
     {
-        return ColorRGB888(pixel_.r << 3, pixel_.g << 2, pixel_.b << 3);
+        return ColorRGB888(PixelTraits<ColorFormat::kBGR565>::ToRGB888(pixel_));
     }
 
     ColorBGR888 ColorBGR565::ToBGR888() const
     {
-        return ColorBGR888(pixel_.b << 3, pixel_.g << 2, pixel_.r << 3);
+        return ColorBGR888(PixelTraits<ColorFormat::kBGR565>::ToBGR888(pixel_));
     }
 
     ColorGrayscale ColorBGR565::ToGrayscale() const
     {
-        return ColorGrayscale(((pixel_.r << 3) + (pixel_.g << 2) + (pixel_.b << 3)) / 3);
+        return ColorGrayscale(PixelTraits<ColorFormat::kBGR565>::ToGrayscale(pixel_));
     }
 
     ColorBW ColorBGR565::ToBW() const
     {
-        return ColorBW(pixel_.r > 15 || pixel_.g > 31 || pixel_.b > 15);
+        return ColorBW(PixelTraits<ColorFormat::kBGR565>::ToBW(pixel_));
+    }
+
+    ColorBGRA8888 ColorBGR565::ToBGRA8888() const
+    {
+        return ColorBGRA8888(PixelTraits<ColorFormat::kBGR565>::ToBGRA8888(pixel_));
     }
 }
\ No newline at end of file
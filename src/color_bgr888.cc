@@ -1,22 +1,21 @@
-#include <cmath>
-
 #include "colors.h"
+#include "pixel_traits.h"
 
 namespace paint
 {
     ColorRGB565 ColorBGR888::ToRGB565() const
     {
-        return ColorRGB565(pixel_.r >> 3, pixel_.g >> 2, pixel_.b >> 3);
+        return ColorRGB565(PixelTraits<ColorFormat::kBGR888>::ToRGB565(pixel_));
     }
 
     ColorBGR565 ColorBGR888::ToBGR565() const
     {
-        return ColorBGR565(pixel_.b >> 3, pixel_.g >> 2, pixel_.r >> 3);
+        return ColorBGR565(PixelTraits<ColorFormat::kBGR888>::ToBGR565(pixel_));
     }
 
     ColorRGB888 ColorBGR888::ToRGB888() const
     {
-        return ColorRGB888(pixel_.r, pixel_.g, pixel_.b);
+        return ColorRGB888(PixelTraits<ColorFormat::kBGR888>::ToRGB888(pixel_));
     }
 
     ColorBGR888 ColorBGR888::ToBGR888() const
@@ -26,12 +25,16 @@ namespace paint
 
     ColorGrayscale ColorBGR888::ToGrayscale() const
     {
-        //https://stackoverflow.com/questions/14330/rgb-to-monochrome-conversion
-        return ColorGrayscale(std::round(0.2125f * pixel_.r + 0.7154f * pixel_.g + 0.0721f * pixel_.b));
+        return ColorGrayscale(PixelTraits<ColorFormat::kBGR888>::ToGrayscale(pixel_));
     }
 
     ColorBW ColorBGR888::ToBW() const
     {
-        return ColorBW(pixel_.r > 127 || pixel_.g > 127 || pixel_.b > 127);
+        return ColorBW(PixelTraits<ColorFormat::kBGR888>::ToBW(pixel_));
+    }
+
+    ColorBGRA8888 ColorBGR888::ToBGRA8888() const
+    {
+        return ColorBGRA8888(PixelTraits<ColorFormat::kBGR888>::ToBGRA8888(pixel_));
     }
 }
\ No newline at end of file
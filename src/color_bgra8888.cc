@@ -0,0 +1,40 @@
+#include "colors.h"
+#include "pixel_traits.h"
+
+namespace paint
+{
+    ColorRGB565 ColorBGRA8888::ToRGB565() const
+    {
+        return ColorRGB565(PixelTraits<ColorFormat::kBGRA8888>::ToRGB565(pixel_));
+    }
+
+    ColorBGR565 ColorBGRA8888::ToBGR565() const
+    {
+        return ColorBGR565(PixelTraits<ColorFormat::kBGRA8888>::ToBGR565(pixel_));
+    }
+
+    ColorRGB888 ColorBGRA8888::ToRGB888() const
+    {
+        return ColorRGB888(PixelTraits<ColorFormat::kBGRA8888>::ToRGB888(pixel_));
+    }
+
+    ColorBGR888 ColorBGRA8888::ToBGR888() const
+    {
+        return ColorBGR888(PixelTraits<ColorFormat::kBGRA8888>::ToBGR888(pixel_));
+    }
+
+    ColorGrayscale ColorBGRA8888::ToGrayscale() const
+    {
+        return ColorGrayscale(PixelTraits<ColorFormat::kBGRA8888>::ToGrayscale(pixel_));
+    }
+
+    ColorBW ColorBGRA8888::ToBW() const
+    {
+        return ColorBW(PixelTraits<ColorFormat::kBGRA8888>::ToBW(pixel_));
+    }
+
+    ColorBGRA8888 ColorBGRA8888::ToBGRA8888() const
+    {
+        return ColorBGRA8888(*this);
+    }
+}
\ No newline at end of file
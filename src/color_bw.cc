@@ -1,31 +1,32 @@
 #include "colors.h"
+#include "pixel_traits.h"
 
 namespace paint
 {
 
     ColorRGB565 ColorBW::ToRGB565() const
     {
-        return ColorRGB565(bw_palette[pixel_.w].r, bw_palette[pixel_.w].g, bw_palette[pixel_.w].b);
+        return ColorRGB565(PixelTraits<ColorFormat::kBW>::ToRGB565(pixel_));
     }
 
     ColorBGR565 ColorBW::ToBGR565() const
     {
-        return ColorBGR565(bw_palette[pixel_.w].b, bw_palette[pixel_.w].g, bw_palette[pixel_.w].r);
+        return ColorBGR565(PixelTraits<ColorFormat::kBW>::ToBGR565(pixel_));
     }
 
     ColorRGB888 ColorBW::ToRGB888() const
     {
-        return ColorRGB888(bw_palette[pixel_.w].r, bw_palette[pixel_.w].g, bw_palette[pixel_.w].b);
+        return ColorRGB888(PixelTraits<ColorFormat::kBW>::ToRGB888(pixel_));
     }
 
     ColorBGR888 ColorBW::ToBGR888() const
     {
-        return ColorBGR888(bw_palette[pixel_.w].b, bw_palette[pixel_.w].g, bw_palette[pixel_.w].r);
+        return ColorBGR888(PixelTraits<ColorFormat::kBW>::ToBGR888(pixel_));
     }
 
     ColorGrayscale ColorBW::ToGrayscale() const
     {
-        return ColorGrayscale(pixel_.w * 255);
+        return ColorGrayscale(PixelTraits<ColorFormat::kBW>::ToGrayscale(pixel_));
     }
 
     ColorBW ColorBW::ToBW() const
@@ -33,5 +34,10 @@ namespace paint
         return *this;
     }
 
+    ColorBGRA8888 ColorBW::ToBGRA8888() const
+    {
+        return ColorBGRA8888(PixelTraits<ColorFormat::kBW>::ToBGRA8888(pixel_));
+    }
+
     const PixelBGRA8888 bw_palette[2] = {{0, 0, 0, 0}, {255, 255, 255, 0}};
 }
\ No newline at end of file
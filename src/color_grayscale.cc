@@ -1,25 +1,26 @@
 #include "colors.h"
+#include "pixel_traits.h"
 
 namespace paint
 {
     ColorRGB565 ColorGrayscale::ToRGB565() const
     {
-        return ColorRGB565(grayscale_palette_[pixel_.w].r, grayscale_palette_[pixel_.w].g, grayscale_palette_[pixel_.w].b);
+        return ColorRGB565(PixelTraits<ColorFormat::kGrayscale>::ToRGB565(pixel_));
     }
 
     ColorBGR565 ColorGrayscale::ToBGR565() const
     {
-        return ColorBGR565(grayscale_palette_[pixel_.w].b, grayscale_palette_[pixel_.w].g, grayscale_palette_[pixel_.w].r);
+        return ColorBGR565(PixelTraits<ColorFormat::kGrayscale>::ToBGR565(pixel_));
     }
 
     ColorRGB888 ColorGrayscale::ToRGB888() const
     {
-        return ColorRGB888(grayscale_palette_[pixel_.w].r, grayscale_palette_[pixel_.w].g, grayscale_palette_[pixel_.w].b);
+        return ColorRGB888(PixelTraits<ColorFormat::kGrayscale>::ToRGB888(pixel_));
     }
 
     ColorBGR888 ColorGrayscale::ToBGR888() const
     {
-        return ColorBGR888(grayscale_palette_[pixel_.w].b, grayscale_palette_[pixel_.w].g, grayscale_palette_[pixel_.w].r);
+        return ColorBGR888(PixelTraits<ColorFormat::kGrayscale>::ToBGR888(pixel_));
     }
 
     ColorGrayscale ColorGrayscale::ToGrayscale() const
@@ -29,7 +30,12 @@ namespace paint
 
     ColorBW ColorGrayscale::ToBW() const
     {
-        return ColorBW(pixel_.w > 127);
+        return ColorBW(PixelTraits<ColorFormat::kGrayscale>::ToBW(pixel_));
+    }
+
+    ColorBGRA8888 ColorGrayscale::ToBGRA8888() const
+    {
+        return ColorBGRA8888(PixelTraits<ColorFormat::kGrayscale>::ToBGRA8888(pixel_));
     }
 
     const PixelBGRA8888 grayscale_palette[256] = {
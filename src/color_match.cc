@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PAINT_COLOR_MATCH_X86
+#include <immintrin.h>
+#endif
+
+#include "color_match.h"
+#include "convert_span.h"
+#include "packed_bits.h"
+#include "palette.h"
+
+namespace paint
+{
+    namespace
+    {
+        // Length of the repeated bytes of the pixel, a multiple of the pixel sizes (1, 3 and 4 bytes) and of the vectors (16 and 32 bytes)
+        constexpr size_t kPatternBytes = 96;
+
+        // flags[i] = 0xFF if src[i] differs from the pattern by at most tolerance, otherwise 0 (src starts at the start of the pattern)
+        void MatchBytesScalar(const uint8_t *src, const uint8_t *pattern, uint8_t tolerance, uint8_t *flags, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                const uint8_t p = pattern[i % kPatternBytes];
+                const uint8_t difference = src[i] > p ? src[i] - p : p - src[i];
+                flags[i] = difference <= tolerance ? 0xFF : 0;
+            }
+        }
+
+#ifdef PAINT_COLOR_MATCH_X86
+        /*
+         * The absolute difference of unsigned bytes is the saturated difference in either direction,
+         * the byte is within the tolerance if min(difference, tolerance) is the difference.
+         * The blocks of the whole pattern are compared by the vectors, the rest by the scalar kernel.
+         */
+
+        __attribute__((target("sse4.1"))) inline __m128i MatchSSE41(__m128i a, __m128i b, __m128i tolerance)
+        {
+            const __m128i difference = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+            return _mm_cmpeq_epi8(_mm_min_epu8(difference, tolerance), difference);
+        }
+
+        __attribute__((target("sse4.1"))) void MatchBytesSSE41(const uint8_t *src, const uint8_t *pattern, uint8_t tolerance, uint8_t *flags, size_t n)
+        {
+            const __m128i t = _mm_set1_epi8(static_cast<char>(tolerance));
+
+            size_t i = 0;
+            for (; i + kPatternBytes <= n; i += kPatternBytes)
+            {
+                for (size_t j = 0; j < kPatternBytes; j += 16)
+                {
+                    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + j));
+                    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern + j));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(flags + i + j), MatchSSE41(a, b, t));
+                }
+            }
+
+            MatchBytesScalar(src + i, pattern, tolerance, flags + i, n - i);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i MatchAVX2(__m256i a, __m256i b, __m256i tolerance)
+        {
+            const __m256i difference = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(difference, tolerance), difference);
+        }
+
+        __attribute__((target("avx2"))) void MatchBytesAVX2(const uint8_t *src, const uint8_t *pattern, uint8_t tolerance, uint8_t *flags, size_t n)
+        {
+            const __m256i t = _mm256_set1_epi8(static_cast<char>(tolerance));
+
+            size_t i = 0;
+            for (; i + kPatternBytes <= n; i += kPatternBytes)
+            {
+                for (size_t j = 0; j < kPatternBytes; j += 32)
+                {
+                    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + j));
+                    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pattern + j));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(flags + i + j), MatchAVX2(a, b, t));
+                }
+            }
+
+            MatchBytesScalar(src + i, pattern, tolerance, flags + i, n - i);
+        }
+#endif
+
+        using MatchBytesKernel = void (*)(const uint8_t *src, const uint8_t *pattern, uint8_t tolerance, uint8_t *flags, size_t n);
+
+        MatchBytesKernel SelectMatchKernel(SimdLevel level)
+        {
+#ifdef PAINT_COLOR_MATCH_X86
+            if (level >= SimdLevel::kAVX2)
+                return MatchBytesAVX2;
+            if (level >= SimdLevel::kSSE41)
+                return MatchBytesSSE41;
+#else
+            (void)level;
+#endif
+            return MatchBytesScalar;
+        }
+
+        const MatchBytesKernel match_kernels[] = {SelectMatchKernel(SimdLevel::kScalar), SelectMatchKernel(SimdLevel::kSSE41),
+                                                  SelectMatchKernel(SimdLevel::kAVX2), SelectMatchKernel(SimdLevel::kAVX512)};
+
+        void MatchBytes(const uint8_t *src, const uint8_t *pattern, uint8_t tolerance, uint8_t *flags, size_t n)
+        {
+            match_kernels[static_cast<int>(GetSimdLevel())](src, pattern, tolerance, flags, n);
+        }
+
+        // Sets the bits [x, x + count) of the pixels with all kPixelSize bytes matching
+        template <size_t kPixelSize>
+        void PackFlags(const uint8_t *flags, Unit x, Unit count, uint8_t *bits)
+        {
+            for (Unit i = 0; i < count; i++)
+            {
+                uint8_t all = flags[i * kPixelSize];
+                for (size_t byte = 1; byte < kPixelSize; byte++)
+                    all &= flags[i * kPixelSize + byte];
+
+                bits[(x + i) >> 3] |= (all & 0x80) >> ((x + i) & 7);
+            }
+        }
+
+        // Largest difference of the channels
+        uint8_t ChannelDifference(const PixelRGB888 &a, const PixelRGB888 &b)
+        {
+            auto difference = [](uint8_t c1, uint8_t c2) { return static_cast<uint8_t>(c1 > c2 ? c1 - c2 : c2 - c1); };
+            return std::max({difference(a.r, b.r), difference(a.g, b.g), difference(a.b, b.b)});
+        }
+    }
+
+    ColorMatcher::ColorMatcher(DataPixels &data, const void *pixel, uint8_t tolerance) : data_(data),
+                                                                                        format_(data.GetColorFormat()),
+                                                                                        layout_(data.GetLayout()),
+                                                                                        pixel_size_(data.GetColorType()->GetDataSize()),
+                                                                                        row_words_((static_cast<size_t>(data.GetSize().x) + kPackedWordBits - 1) / kPackedWordBits),
+                                                                                        tolerance_(tolerance)
+    {
+        std::memcpy(pixel_, pixel, pixel_size_);
+
+        if (format_ == ColorFormat::kRGB565 || format_ == ColorFormat::kBGR565 || format_ == ColorFormat::kBW || format_ == ColorFormat::kIndexed8)
+        {
+            // RGB888 colors of all the values of the pixel (the byte of BW and indexed pixels, both bytes of 565 pixels)
+            const size_t value_count = size_t{1} << (8 * pixel_size_);
+            std::vector<uint16_t> values(value_count);
+            std::iota(values.begin(), values.end(), 0);
+            std::vector<uint8_t> value_bytes(value_count * pixel_size_);
+            for (size_t value = 0; value < value_count; value++)
+                std::memcpy(value_bytes.data() + value * pixel_size_, &values[value], pixel_size_);
+
+            std::vector<PixelRGB888> colors(value_count);
+            PixelRGB888 color;
+            if (format_ == ColorFormat::kIndexed8)
+            {
+                data.GetPalette()->ConvertIndices(value_bytes.data(), ColorFormat::kRGB888, colors.data(), value_count);
+                data.GetPalette()->ConvertIndices(pixel_, ColorFormat::kRGB888, &color, 1);
+            }
+            else
+            {
+                ConvertSpan(format_, ColorFormat::kRGB888, value_bytes.data(), colors.data(), value_count);
+                ConvertSpan(format_, ColorFormat::kRGB888, pixel_, &color, 1);
+            }
+
+            table_.resize(value_count);
+            for (size_t value = 0; value < value_count; value++)
+                table_[value] = ChannelDifference(colors[value], color) <= tolerance_;
+            return;
+        }
+
+        // The bytes of the pixel over the whole pattern (planar data has a pattern of one byte for each plane)
+        if (layout_ == PixelLayout::kPlanar)
+        {
+            for (size_t plane = 0; plane < data.GetPlaneCount(); plane++)
+                patterns_[plane].assign(kPatternBytes, pixel_[plane]);
+            return;
+        }
+
+        patterns_[0].resize(kPatternBytes);
+        for (size_t i = 0; i < kPatternBytes; i++)
+            patterns_[0][i] = pixel_[i % pixel_size_];
+    }
+
+    void ColorMatcher::MatchRow(Unit y, uint8_t *bits)
+    {
+        const Unit width = data_.GetSize().x;
+        std::memset(bits, 0, GetRowSize());
+
+        // Packed pixels differ by 255 or not at all -> the bits of the row (inverted for the black pixel)
+        if (layout_ == PixelLayout::kPacked)
+        {
+            if (tolerance_ == 255)
+                FillPackedBits(bits, 0, width, true);
+            else
+            {
+                CopyPackedBits(static_cast<const uint8_t *>(data_.PackedRowPtr(y)), row_words_, 0, bits, width);
+                if (!reinterpret_cast<const PixelBW *>(pixel_)->w)
+                    InvertPackedBits(bits, width);
+            }
+            return;
+        }
+
+        // A plane at a time, a pixel matches when its bytes in all the planes match
+        if (layout_ == PixelLayout::kPlanar)
+        {
+            flags_.resize(width);
+            plane_flags_.resize(width);
+            MatchBytes(static_cast<const uint8_t *>(data_.PlaneRowPtr(0, y)), patterns_[0].data(), tolerance_, flags_.data(), width);
+            for (size_t plane = 1; plane < data_.GetPlaneCount(); plane++)
+            {
+                MatchBytes(static_cast<const uint8_t *>(data_.PlaneRowPtr(plane, y)), patterns_[plane].data(), tolerance_, plane_flags_.data(), width);
+                for (Unit x = 0; x < width; x++)
+                    flags_[x] &= plane_flags_[x];
+            }
+
+            PackFlags<1>(flags_.data(), 0, width, bits);
+            return;
+        }
+
+        // Continuous segments of the row (the whole row, or the row of each tile)
+        const Unit segment_size = layout_ == PixelLayout::kTiled ? DataPixels::kTileSize : width;
+        for (Unit x = 0; x < width;)
+        {
+            const Unit count = std::min<Unit>(segment_size - (x % segment_size), width - x);
+            MatchSegment(static_cast<const uint8_t *>(data_.at(x, y)), x, count, bits);
+            x += count;
+        }
+    }
+
+    void ColorMatcher::MatchSegment(const uint8_t *pixels, Unit x, Unit count, uint8_t *bits)
+    {
+        // Pixels looked up in the table by their value
+        if (!table_.empty())
+        {
+            for (Unit i = 0; i < count; i++)
+            {
+                uint16_t value = 0;
+                std::memcpy(&value, pixels + i * pixel_size_, pixel_size_);
+                if (table_[value])
+                    bits[(x + i) >> 3] |= 0x80 >> ((x + i) & 7);
+            }
+            return;
+        }
+
+        flags_.resize(count * pixel_size_);
+        MatchBytes(pixels, patterns_[0].data(), tolerance_, flags_.data(), flags_.size());
+
+        switch (pixel_size_)
+        {
+        case 1:
+            PackFlags<1>(flags_.data(), x, count, bits);
+            break;
+        case 3:
+            PackFlags<3>(flags_.data(), x, count, bits);
+            break;
+        default:
+            PackFlags<4>(flags_.data(), x, count, bits);
+            break;
+        }
+    }
+
+    void ColorMatcher::FindRuns(Unit row_begin, Unit row_end, std::vector<RowSpan> &spans)
+    {
+        const Unit width = data_.GetSize().x;
+        bits_.resize(GetRowSize());
+
+        for (Unit y = row_begin; y < row_end; y++)
+        {
+            MatchRow(y, bits_.data());
+            for (Unit x = FindPackedRunEnd(bits_.data(), 0, width, false); x < width; x = FindPackedRunEnd(bits_.data(), x, width, false))
+            {
+                const Unit x_end = FindPackedRunEnd(bits_.data(), x, width, true);
+                spans.push_back(RowSpan{y, x, x_end});
+                x = x_end;
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#include "colors.h"
+#include "pixel_traits.h"
+#include "pixel_ops.h"
+
+namespace paint
+{
+    ColorRGB565 ColorPalette::ToRGB565() const
+    {
+        return ColorRGB565(PixelTraits<ColorFormat::kRGB888>::ToRGB565(palette_->GetColor(pixel_.i)));
+    }
+
+    ColorBGR565 ColorPalette::ToBGR565() const
+    {
+        return ColorBGR565(PixelTraits<ColorFormat::kRGB888>::ToBGR565(palette_->GetColor(pixel_.i)));
+    }
+
+    ColorRGB888 ColorPalette::ToRGB888() const
+    {
+        return ColorRGB888(palette_->GetColor(pixel_.i));
+    }
+
+    ColorBGR888 ColorPalette::ToBGR888() const
+    {
+        return ColorBGR888(PixelTraits<ColorFormat::kRGB888>::ToBGR888(palette_->GetColor(pixel_.i)));
+    }
+
+    ColorGrayscale ColorPalette::ToGrayscale() const
+    {
+        return ColorGrayscale(PixelTraits<ColorFormat::kRGB888>::ToGrayscale(palette_->GetColor(pixel_.i)));
+    }
+
+    ColorBW ColorPalette::ToBW() const
+    {
+        return ColorBW(PixelTraits<ColorFormat::kRGB888>::ToBW(palette_->GetColor(pixel_.i)));
+    }
+
+    ColorBGRA8888 ColorPalette::ToBGRA8888() const
+    {
+        return ColorBGRA8888(PixelTraits<ColorFormat::kRGB888>::ToBGRA8888(palette_->GetColor(pixel_.i)));
+    }
+
+    void ColorPalette::SetColor(const Color &other)
+    {
+        pixel_.i = palette_->FindNearest(PixelFromColor<PixelRGB888>(other));
+    }
+
+    void ColorPalette::InvertColor()
+    {
+        PixelRGB888 color = palette_->GetColor(pixel_.i);
+        InvertPixel(color);
+        pixel_.i = palette_->FindNearest(color);
+    }
+
+    void ColorPalette::Interpolate(const std::shared_ptr<Color> &c1, const std::shared_ptr<Color> &c2, float percent_c1)
+    {
+        ColorRGB888 interpolated;
+        interpolated.Interpolate(c1, c2, percent_c1);
+        SetColor(interpolated);
+    }
+}
@@ -1,4 +1,5 @@
 #include "colors.h"
+#include "pixel_traits.h"
 
 namespace paint
 {
@@ -9,26 +10,31 @@ namespace paint
 
     ColorBGR565 ColorRGB565::ToBGR565() const
     {
-        return ColorBGR565(pixel_.b, pixel_.g, pixel_.r);
+        return ColorBGR565(PixelTraits<ColorFormat::kRGB565>::ToBGR565(pixel_));
     }
 
     ColorRGB888 ColorRGB565::ToRGB888() const
     {
-        return ColorRGB888(pixel_.r << 3, pixel_.g << 2, pixel_.b << 3);
+        return ColorRGB888(PixelTraits<ColorFormat::kRGB565>::ToRGB888(pixel_));
     }
 
     ColorBGR888 ColorRGB565::ToBGR888() const
     {
-        return ColorBGR888(pixel_.b << 3, pixel_.g << 2, pixel_.r << 3);
+        return ColorBGR888(PixelTraits<ColorFormat::kRGB565>::ToBGR888(pixel_));
     }
 
     ColorGrayscale ColorRGB565::ToGrayscale() const
     {
-        return ColorGrayscale(((pixel_.r << 3) + (pixel_.g << 2) + (pixel_.b << 3)) / 3);
+        return ColorGrayscale(PixelTraits<ColorFormat::kRGB565>::ToGrayscale(pixel_));
     }
 
     ColorBW ColorRGB565::ToBW() const
     {
-        return ColorBW(pixel_.r > 15 || pixel_.g > 31 || pixel_.b > 15);
+        return ColorBW(PixelTraits<ColorFormat::kRGB565>::ToBW(pixel_));
+    }
+
+    ColorBGRA8888 ColorRGB565::ToBGRA8888() const
+    {
+        return ColorBGRA8888(PixelTraits<ColorFormat::kRGB565>::ToBGRA8888(pixel_));
     }
 }
\ No newline at end of file
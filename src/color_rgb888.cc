@@ -1,17 +1,16 @@
-#include <cmath>
-
 #include "colors.h"
+#include "pixel_traits.h"
 
 namespace paint
 {
     ColorRGB565 ColorRGB888::ToRGB565() const
     {
-        return ColorRGB565(pixel_.r >> 3, pixel_.g >> 2, pixel_.b >> 3);
+        return ColorRGB565(PixelTraits<ColorFormat::kRGB888>::ToRGB565(pixel_));
     }
 
     ColorBGR565 ColorRGB888::ToBGR565() const
     {
-        return ColorBGR565(pixel_.b >> 3, pixel_.g >> 2, pixel_.r >> 3);
+        return ColorBGR565(PixelTraits<ColorFormat::kRGB888>::ToBGR565(pixel_));
     }
 
     ColorRGB888 ColorRGB888::ToRGB888() const
@@ -21,17 +20,21 @@ namespace paint
 
     ColorBGR888 ColorRGB888::ToBGR888() const
     {
-        return ColorBGR888(pixel_.b, pixel_.g, pixel_.r);
+        return ColorBGR888(PixelTraits<ColorFormat::kRGB888>::ToBGR888(pixel_));
     }
 
     ColorGrayscale ColorRGB888::ToGrayscale() const
     {
-        //https://stackoverflow.com/questions/14330/rgb-to-monochrome-conversion
-        return ColorGrayscale(std::round(0.2125f * pixel_.r + 0.7154f * pixel_.g + 0.0721f * pixel_.b));
+        return ColorGrayscale(PixelTraits<ColorFormat::kRGB888>::ToGrayscale(pixel_));
     }
 
     ColorBW ColorRGB888::ToBW() const
     {
-        return ColorBW(pixel_.r > 127 || pixel_.g > 127 || pixel_.b > 127);
+        return ColorBW(PixelTraits<ColorFormat::kRGB888>::ToBW(pixel_));
+    }
+
+    ColorBGRA8888 ColorRGB888::ToBGRA8888() const
+    {
+        return ColorBGRA8888(PixelTraits<ColorFormat::kRGB888>::ToBGRA8888(pixel_));
     }
 }
\ No newline at end of file
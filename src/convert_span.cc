@@ -0,0 +1,484 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PAINT_CONVERT_SPAN_X86
+#include <immintrin.h>
+#endif
+
+#include "convert_span.h"
+#include "pixel_traits.h"
+#include "data_pixels_view.h"
+
+namespace paint
+{
+    namespace
+    {
+        // Any pair of formats, pixel by pixel through the PixelTraits conversion
+        template <typename SrcT, typename DstT>
+        void ConvertSpanPixels(const SrcT *src, DstT *dst, size_t n)
+        {
+            // Indexed pixels are converted by their Palette
+            if constexpr (std::is_same_v<SrcT, PixelIndexed8> || std::is_same_v<DstT, PixelIndexed8>)
+                throw std::invalid_argument("Indexed pixels can only be converted with their palette.");
+            else
+            {
+                for (size_t i = 0; i < n; i++)
+                    dst[i] = ConvertPixel<DstT>(src[i]);
+            }
+        }
+
+        // 24-bit color to grayscale (the same weights as PixelTraits::ToGrayscale())
+        template <ColorFormat SrcFormat>
+        void ConvertSpanToGrayscale(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            constexpr size_t r = PixelTraits<SrcFormat>::kRed.offset_bits / 8;
+            constexpr size_t g = PixelTraits<SrcFormat>::kGreen.offset_bits / 8;
+            constexpr size_t b = PixelTraits<SrcFormat>::kBlue.offset_bits / 8;
+
+            for (size_t i = 0; i < n; i++)
+                dst[i] = RoundedLuminance(src[3 * i + r], src[3 * i + g], src[3 * i + b]);
+        }
+
+        // 24-bit color to BW, a channel > 127 has the highest bit set
+        void ConvertSpan888ToBW(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+                dst[i] = (src[3 * i] | src[3 * i + 1] | src[3 * i + 2]) >> 7;
+        }
+
+        void ConvertSpanGrayscaleToBW(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+                dst[i] = src[i] >> 7;
+        }
+
+        // 565 to grayscale, the formula is the same for RGB565 and BGR565 (red and blue have the same weight)
+        void ConvertSpan565ToGrayscale(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            ConvertSpanPixels(reinterpret_cast<const PixelRGB565 *>(src), reinterpret_cast<PixelGrayscale *>(dst), n);
+        }
+
+        void ConvertSpan565ToBW(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            ConvertSpanPixels(reinterpret_cast<const PixelRGB565 *>(src), reinterpret_cast<PixelBW *>(dst), n);
+        }
+
+        /*
+         * Lookup tables of the conversions from formats with few distinct pixels (built from PixelTraits, so the results are the same).
+         * Only the pairs where the table beats the inlined PixelTraits conversion have one (see ConvertSpan_Benchmark):
+         *  - Grayscale to 565: 256 entries (the palette colors are gray, so RGB565 and BGR565 are the same).
+         *  - BW to 565 and grayscale: 2 entries.
+         * 565 and grayscale to 24-bit color are vectorized by the compiler and are faster computed than looked up.
+         */
+        struct ConversionTables
+        {
+            PixelRGB565 grayscale_to_565[256];
+            PixelRGB565 bw_to_565[2];
+            PixelGrayscale bw_to_grayscale[2];
+
+            ConversionTables()
+            {
+                for (unsigned w = 0; w < 256; w++)
+                    grayscale_to_565[w] = PixelTraits<ColorFormat::kGrayscale>::ToRGB565(MakePixelGrayscale(w));
+
+                for (unsigned w = 0; w < 2; w++)
+                {
+                    bw_to_565[w] = PixelTraits<ColorFormat::kBW>::ToRGB565(MakePixelBW(w));
+                    bw_to_grayscale[w] = PixelTraits<ColorFormat::kBW>::ToGrayscale(MakePixelBW(w));
+                }
+            }
+        };
+
+        const ConversionTables kConversionTables;
+
+        // Converts n pixels by indexing table with index(src[i])
+        template <typename TableT, typename IndexFunction>
+        void ConvertSpanTable(const uint8_t *src, void *dst, size_t n, const TableT *table, IndexFunction index)
+        {
+            TableT *out = static_cast<TableT *>(dst);
+            for (size_t i = 0; i < n; i++)
+                out[i] = table[index(src[i])];
+        }
+
+        // Converts the span with a lookup table if there is one for the pair, returns false otherwise
+        bool ConvertSpanLookup(ColorFormat src_format, ColorFormat dst_format, const void *src, void *dst, size_t n)
+        {
+            const bool dst_565 = dst_format == ColorFormat::kRGB565 || dst_format == ColorFormat::kBGR565;
+            const uint8_t *src_bytes = static_cast<const uint8_t *>(src);
+            const ConversionTables &t = kConversionTables;
+
+            if (src_format == ColorFormat::kGrayscale && dst_565)
+            {
+                ConvertSpanTable(src_bytes, dst, n, t.grayscale_to_565, [](uint8_t w) { return w; });
+                return true;
+            }
+
+            // Only the lowest bit of BW pixel is used
+            if (src_format == ColorFormat::kBW && dst_565)
+            {
+                ConvertSpanTable(src_bytes, dst, n, t.bw_to_565, [](uint8_t w) { return w & 1; });
+                return true;
+            }
+
+            if (src_format == ColorFormat::kBW && dst_format == ColorFormat::kGrayscale)
+            {
+                ConvertSpanTable(src_bytes, dst, n, t.bw_to_grayscale, [](uint8_t w) { return w & 1; });
+                return true;
+            }
+
+            return false;
+        }
+
+#ifdef PAINT_CONVERT_SPAN_X86
+        /*
+         * The SIMD kernels give the same result as the scalar ones:
+         *  - Grayscale from 24-bit color is the fixed-point sum of RoundedLuminance(), the pairs (red, green) and (blue, 1) of 16-bit lanes
+         *    are multiplied by the pairs of weights (kLuminanceRed, kLuminanceGreen) and (kLuminanceBlue, rounding) and added into 32 bits.
+         *  - 565 to grayscale divides by 3 as (x * 21846) >> 16, which is exact for the sums up to 748.
+         *  - BW tests the highest bit of each channel (0x8410 are the highest bits of the 565 channels).
+         * Each kernel converts blocks of 16 pixels, the rest is left to the scalar kernel.
+         */
+
+        // pshufb masks gathering channel c of 16 pixels of 24-bit color from 3 loads of 16 bytes
+        struct DeinterleaveMasks
+        {
+            alignas(16) int8_t mask[3][3][16];
+
+            DeinterleaveMasks()
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    for (int load = 0; load < 3; load++)
+                    {
+                        for (int i = 0; i < 16; i++)
+                        {
+                            int byte = 3 * i + c - 16 * load;
+                            mask[c][load][i] = byte >= 0 && byte < 16 ? static_cast<int8_t>(byte) : -1;
+                        }
+                    }
+                }
+            }
+        };
+
+        const DeinterleaveMasks kDeinterleaveMasks;
+
+        __attribute__((target("sse4.1"))) inline __m128i DeinterleaveChannel(__m128i a, __m128i b, __m128i c, int channel)
+        {
+            const __m128i *mask = reinterpret_cast<const __m128i *>(kDeinterleaveMasks.mask[channel]);
+            return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, _mm_load_si128(mask)),
+                                             _mm_shuffle_epi8(b, _mm_load_si128(mask + 1))),
+                                _mm_shuffle_epi8(c, _mm_load_si128(mask + 2)));
+        }
+
+        // 8 luminances (16-bit lanes) of 8 pixels of 16-bit channels
+        __attribute__((target("sse4.1"))) inline __m128i LuminanceSSE41(__m128i red, __m128i green, __m128i blue)
+        {
+            const __m128i weights_rg = _mm_set1_epi32(kLuminanceRed | (kLuminanceGreen << 16));
+            const __m128i weights_b = _mm_set1_epi32(kLuminanceBlue | (1 << (kLuminanceBits - 1 + 16)));
+            const __m128i one = _mm_set1_epi16(1);
+
+            __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(red, green), weights_rg), _mm_madd_epi16(_mm_unpacklo_epi16(blue, one), weights_b));
+            __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(red, green), weights_rg), _mm_madd_epi16(_mm_unpackhi_epi16(blue, one), weights_b));
+            return _mm_packs_epi32(_mm_srli_epi32(lo, kLuminanceBits), _mm_srli_epi32(hi, kLuminanceBits));
+        }
+
+        template <ColorFormat SrcFormat>
+        __attribute__((target("sse4.1"))) void ConvertSpanToGrayscaleSSE41(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            const __m128i zero = _mm_setzero_si128();
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 16));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 32));
+                __m128i red = DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kRed.offset_bits / 8);
+                __m128i green = DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kGreen.offset_bits / 8);
+                __m128i blue = DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kBlue.offset_bits / 8);
+
+                __m128i gray_lo = LuminanceSSE41(_mm_unpacklo_epi8(red, zero), _mm_unpacklo_epi8(green, zero), _mm_unpacklo_epi8(blue, zero));
+                __m128i gray_hi = LuminanceSSE41(_mm_unpackhi_epi8(red, zero), _mm_unpackhi_epi8(green, zero), _mm_unpackhi_epi8(blue, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(gray_lo, gray_hi));
+            }
+
+            ConvertSpanToGrayscale<SrcFormat>(src + 3 * i, dst + i, n - i);
+        }
+
+        template <ColorFormat SrcFormat>
+        __attribute__((target("avx2"))) void ConvertSpanToGrayscaleAVX2(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            const __m256i weights_rg = _mm256_set1_epi32(kLuminanceRed | (kLuminanceGreen << 16));
+            const __m256i weights_b = _mm256_set1_epi32(kLuminanceBlue | (1 << (kLuminanceBits - 1 + 16)));
+            const __m256i one = _mm256_set1_epi16(1);
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 16));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 32));
+                __m256i red = _mm256_cvtepu8_epi16(DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kRed.offset_bits / 8));
+                __m256i green = _mm256_cvtepu8_epi16(DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kGreen.offset_bits / 8));
+                __m256i blue = _mm256_cvtepu8_epi16(DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kBlue.offset_bits / 8));
+
+                // The unpacks and the pack work within the 128-bit lanes, so the pixels stay in order
+                __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(red, green), weights_rg), _mm256_madd_epi16(_mm256_unpacklo_epi16(blue, one), weights_b));
+                __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(red, green), weights_rg), _mm256_madd_epi16(_mm256_unpackhi_epi16(blue, one), weights_b));
+                __m256i gray = _mm256_packs_epi32(_mm256_srli_epi32(lo, kLuminanceBits), _mm256_srli_epi32(hi, kLuminanceBits));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(_mm256_castsi256_si128(gray), _mm256_extracti128_si256(gray, 1)));
+            }
+
+            ConvertSpanToGrayscale<SrcFormat>(src + 3 * i, dst + i, n - i);
+        }
+
+        template <ColorFormat SrcFormat>
+        __attribute__((target("avx512f"))) void ConvertSpanToGrayscaleAVX512(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            // 32-bit lanes (the 16-bit multiply-add of 512-bit vectors needs AVX-512BW)
+            const __m512i wr = _mm512_set1_epi32(kLuminanceRed);
+            const __m512i wg = _mm512_set1_epi32(kLuminanceGreen);
+            const __m512i wb = _mm512_set1_epi32(kLuminanceBlue);
+            const __m512i half = _mm512_set1_epi32(1 << (kLuminanceBits - 1));
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 16));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 32));
+                __m512i r = _mm512_cvtepu8_epi32(DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kRed.offset_bits / 8));
+                __m512i g = _mm512_cvtepu8_epi32(DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kGreen.offset_bits / 8));
+                __m512i bl = _mm512_cvtepu8_epi32(DeinterleaveChannel(a, b, c, PixelTraits<SrcFormat>::kBlue.offset_bits / 8));
+
+                __m512i y = _mm512_add_epi32(_mm512_add_epi32(_mm512_mullo_epi32(r, wr), _mm512_mullo_epi32(g, wg)), _mm512_add_epi32(_mm512_mullo_epi32(bl, wb), half));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm512_cvtepi32_epi8(_mm512_srli_epi32(y, kLuminanceBits)));
+            }
+
+            ConvertSpanToGrayscale<SrcFormat>(src + 3 * i, dst + i, n - i);
+        }
+
+        __attribute__((target("sse4.1"))) void ConvertSpan888ToBWSSE41(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            const __m128i one = _mm_set1_epi8(1);
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 16));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * i + 32));
+                __m128i any = _mm_or_si128(_mm_or_si128(DeinterleaveChannel(a, b, c, 0), DeinterleaveChannel(a, b, c, 1)), DeinterleaveChannel(a, b, c, 2));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_and_si128(_mm_srli_epi16(any, 7), one));
+            }
+
+            ConvertSpan888ToBW(src + 3 * i, dst + i, n - i);
+        }
+
+        __attribute__((target("sse4.1"))) inline __m128i GrayscaleFrom565SSE41(__m128i v)
+        {
+            __m128i r = _mm_and_si128(v, _mm_set1_epi16(0x1F));
+            __m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), _mm_set1_epi16(0x3F));
+            __m128i b = _mm_srli_epi16(v, 11);
+            __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(r, 3), _mm_slli_epi16(g, 2)), _mm_slli_epi16(b, 3));
+            return _mm_mulhi_epu16(sum, _mm_set1_epi16(21846));
+        }
+
+        __attribute__((target("sse4.1"))) void ConvertSpan565ToGrayscaleSSE41(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i lo = GrayscaleFrom565SSE41(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)));
+                __m128i hi = GrayscaleFrom565SSE41(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+            }
+
+            ConvertSpan565ToGrayscale(src + 2 * i, dst + i, n - i);
+        }
+
+        __attribute__((target("avx2"))) void ConvertSpan565ToGrayscaleAVX2(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i));
+                __m256i r = _mm256_and_si256(v, _mm256_set1_epi16(0x1F));
+                __m256i g = _mm256_and_si256(_mm256_srli_epi16(v, 5), _mm256_set1_epi16(0x3F));
+                __m256i b = _mm256_srli_epi16(v, 11);
+                __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(r, 3), _mm256_slli_epi16(g, 2)), _mm256_slli_epi16(b, 3));
+                __m256i gray = _mm256_mulhi_epu16(sum, _mm256_set1_epi16(21846));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(_mm256_castsi256_si128(gray), _mm256_extracti128_si256(gray, 1)));
+            }
+
+            ConvertSpan565ToGrayscale(src + 2 * i, dst + i, n - i);
+        }
+
+        __attribute__((target("sse4.1"))) void ConvertSpan565ToBWSSE41(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            const __m128i high_bits = _mm_set1_epi16(static_cast<short>(0x8410));
+            const __m128i one = _mm_set1_epi16(1);
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i lo = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)), high_bits);
+                __m128i hi = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16)), high_bits);
+                lo = _mm_andnot_si128(_mm_cmpeq_epi16(lo, _mm_setzero_si128()), one);
+                hi = _mm_andnot_si128(_mm_cmpeq_epi16(hi, _mm_setzero_si128()), one);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+            }
+
+            ConvertSpan565ToBW(src + 2 * i, dst + i, n - i);
+        }
+#endif
+
+        using SpanKernel = void (*)(const uint8_t *src, uint8_t *dst, size_t n);
+
+        // Kernels for the pairs with SIMD versions
+        struct SpanKernels
+        {
+            SpanKernel rgb888_to_grayscale = ConvertSpanToGrayscale<ColorFormat::kRGB888>;
+            SpanKernel bgr888_to_grayscale = ConvertSpanToGrayscale<ColorFormat::kBGR888>;
+            SpanKernel color888_to_bw = ConvertSpan888ToBW;
+            SpanKernel color565_to_grayscale = ConvertSpan565ToGrayscale;
+            SpanKernel color565_to_bw = ConvertSpan565ToBW;
+        };
+
+        SpanKernels SelectKernels(SimdLevel level)
+        {
+            SpanKernels kernels;
+
+#ifdef PAINT_CONVERT_SPAN_X86
+            if (level >= SimdLevel::kSSE41)
+            {
+                kernels.rgb888_to_grayscale = ConvertSpanToGrayscaleSSE41<ColorFormat::kRGB888>;
+                kernels.bgr888_to_grayscale = ConvertSpanToGrayscaleSSE41<ColorFormat::kBGR888>;
+                kernels.color888_to_bw = ConvertSpan888ToBWSSE41;
+                kernels.color565_to_grayscale = ConvertSpan565ToGrayscaleSSE41;
+                kernels.color565_to_bw = ConvertSpan565ToBWSSE41;
+            }
+
+            if (level >= SimdLevel::kAVX2)
+            {
+                kernels.rgb888_to_grayscale = ConvertSpanToGrayscaleAVX2<ColorFormat::kRGB888>;
+                kernels.bgr888_to_grayscale = ConvertSpanToGrayscaleAVX2<ColorFormat::kBGR888>;
+                kernels.color565_to_grayscale = ConvertSpan565ToGrayscaleAVX2;
+            }
+
+            if (level >= SimdLevel::kAVX512)
+            {
+                kernels.rgb888_to_grayscale = ConvertSpanToGrayscaleAVX512<ColorFormat::kRGB888>;
+                kernels.bgr888_to_grayscale = ConvertSpanToGrayscaleAVX512<ColorFormat::kBGR888>;
+            }
+#else
+            (void)level;
+#endif
+
+            return kernels;
+        }
+
+        SimdLevel DetectSimdLevel()
+        {
+#ifdef PAINT_CONVERT_SPAN_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f"))
+                return SimdLevel::kAVX512;
+            if (__builtin_cpu_supports("avx2"))
+                return SimdLevel::kAVX2;
+            if (__builtin_cpu_supports("sse4.1"))
+                return SimdLevel::kSSE41;
+#endif
+            return SimdLevel::kScalar;
+        }
+
+        // The best level of the CPU and the kernels in use (selected when the program starts)
+        const SimdLevel kSupportedSimdLevel = DetectSimdLevel();
+        std::atomic<SimdLevel> simd_level{kSupportedSimdLevel};
+        SpanKernels simd_kernels[] = {SelectKernels(SimdLevel::kScalar), SelectKernels(SimdLevel::kSSE41),
+                                      SelectKernels(SimdLevel::kAVX2), SelectKernels(SimdLevel::kAVX512)};
+    }
+
+    SimdLevel GetSimdLevel()
+    {
+        return simd_level.load(std::memory_order_relaxed);
+    }
+
+    SimdLevel SetSimdLevel(SimdLevel level)
+    {
+        level = std::min(level, kSupportedSimdLevel);
+        simd_level.store(level, std::memory_order_relaxed);
+        return level;
+    }
+
+    size_t PixelSize(ColorFormat format)
+    {
+        return DispatchPixelType(format, [](auto tag) { return sizeof(typename decltype(tag)::type); });
+    }
+
+    void ConvertSpan(ColorFormat src_format, ColorFormat dst_format, const void *src, void *dst, size_t n)
+    {
+        const uint8_t *src_bytes = static_cast<const uint8_t *>(src);
+        uint8_t *dst_bytes = static_cast<uint8_t *>(dst);
+        const bool src_888 = src_format == ColorFormat::kRGB888 || src_format == ColorFormat::kBGR888;
+        const bool src_565 = src_format == ColorFormat::kRGB565 || src_format == ColorFormat::kBGR565;
+        const SpanKernels &kernels = simd_kernels[static_cast<int>(GetSimdLevel())];
+
+        if (src_format == dst_format)
+        {
+            std::memmove(dst, src, n * PixelSize(src_format));
+            return;
+        }
+
+        if (src_format == ColorFormat::kRGB888 && dst_format == ColorFormat::kGrayscale)
+        {
+            kernels.rgb888_to_grayscale(src_bytes, dst_bytes, n);
+            return;
+        }
+
+        if (src_format == ColorFormat::kBGR888 && dst_format == ColorFormat::kGrayscale)
+        {
+            kernels.bgr888_to_grayscale(src_bytes, dst_bytes, n);
+            return;
+        }
+
+        if (src_888 && dst_format == ColorFormat::kBW)
+        {
+            kernels.color888_to_bw(src_bytes, dst_bytes, n);
+            return;
+        }
+
+        if (src_565 && dst_format == ColorFormat::kGrayscale)
+        {
+            kernels.color565_to_grayscale(src_bytes, dst_bytes, n);
+            return;
+        }
+
+        if (src_565 && dst_format == ColorFormat::kBW)
+        {
+            kernels.color565_to_bw(src_bytes, dst_bytes, n);
+            return;
+        }
+
+        if (src_format == ColorFormat::kGrayscale && dst_format == ColorFormat::kBW)
+        {
+            ConvertSpanGrayscaleToBW(src_bytes, dst_bytes, n);
+            return;
+        }
+
+        if (ConvertSpanLookup(src_format, dst_format, src, dst, n))
+            return;
+
+        DispatchPixelType(src_format, [&](auto tag_src) {
+            DispatchPixelType(dst_format, [&](auto tag_dst) {
+                using SrcT = typename decltype(tag_src)::type;
+                using DstT = typename decltype(tag_dst)::type;
+                ConvertSpanPixels(static_cast<const SrcT *>(src), static_cast<DstT *>(dst), n);
+            });
+        });
+    }
+}
@@ -0,0 +1,512 @@
+#include <algorithm>
+#include "data_pixels.h"
+#include "data_pixels_view.h"
+#include "buffer_pool.h"
+#include "packed_bits.h"
+#include "convert_span.h"
+#include "color_palette.h"
+
+namespace paint
+{
+    DataPixels::DataPixels(Point image_size, std::unique_ptr<Color> &&color_type, size_t row_alignment) : DataPixels(image_size, std::move(color_type), PixelLayout::kLinear, row_alignment)
+    {
+    }
+
+    DataPixels::DataPixels(Point image_size, std::unique_ptr<Color> &&color_type, PixelLayout layout, size_t row_alignment) : pixel_struct_size_byte_(color_type->GetDataSize()),
+                                                                                                                              image_size_(image_size),
+                                                                                                                              pixel_count_(static_cast<size_t>(image_size.x) * image_size.y),
+                                                                                                                              row_alignment_byte_(row_alignment),
+                                                                                                                              layout_(layout),
+                                                                                                                              chunk_count_{0, 0},
+                                                                                                                              data_color_(std::move(color_type))
+    {
+        InitLayout();
+        AllocateData();
+    }
+
+    DataPixels::DataPixels(const DataPixels &other) : pixel_struct_size_byte_(other.data_color_->GetDataSize()),
+                                                      image_size_(other.image_size_),
+                                                      pixel_count_(other.pixel_count_),
+                                                      row_alignment_byte_(other.row_alignment_byte_),
+                                                      row_stride_byte_(other.row_stride_byte_),
+                                                      layout_(other.layout_),
+                                                      chunk_count_(other.chunk_count_),
+                                                      data_color_(std::unique_ptr<Color>(other.data_color_->clone())),
+                                                      chunks_(other.chunks_),
+                                                      chunk_data_(other.chunk_data_)
+    {
+        // All the chunks are shared, they are cloned on the first write (see DataPixels::MakeWritable())
+    }
+
+    DataPixels::DataPixels(Point image_size, std::unique_ptr<Color> &&color_type, std::shared_ptr<const uint8_t> read_only_data, size_t row_alignment) : pixel_struct_size_byte_(color_type->GetDataSize()),
+                                                                                                                                                          image_size_(image_size),
+                                                                                                                                                          pixel_count_(static_cast<size_t>(image_size.x) * image_size.y),
+                                                                                                                                                          row_alignment_byte_(row_alignment),
+                                                                                                                                                          layout_(PixelLayout::kLinear),
+                                                                                                                                                          chunk_count_{0, 0},
+                                                                                                                                                          data_color_(std::move(color_type))
+    {
+        InitLayout();
+
+        // Each row band points into the read-only data, it is never written, only copied in DataPixels::MakeWritable()
+        uint8_t *data = const_cast<uint8_t *>(read_only_data.get());
+        chunks_.reserve(chunk_count_.y);
+        chunk_data_.reserve(chunk_count_.y);
+        for (Unit band = 0; band < chunk_count_.y; band++)
+        {
+            chunks_.push_back(Chunk{read_only_data, false});
+            chunk_data_.push_back(data + (static_cast<size_t>(band) << kTileSizeShift) * row_stride_byte_);
+        }
+    }
+
+    void DataPixels::InitLayout()
+    {
+        // Alignment has to be power of 2
+        if (row_alignment_byte_ == 0 || (row_alignment_byte_ & (row_alignment_byte_ - 1)) != 0)
+            throw std::invalid_argument("Row alignment has to be a power of 2.");
+
+        Unit band_count = (image_size_.y + kTileSizeMask) >> kTileSizeShift;
+        if (layout_ == PixelLayout::kTiled)
+        {
+            // Round the row of a tile up to the alignment
+            row_stride_byte_ = (kTileSize * pixel_struct_size_byte_ + row_alignment_byte_ - 1) & ~(row_alignment_byte_ - 1);
+            chunk_count_ = Point{(image_size_.x + kTileSizeMask) >> kTileSizeShift, band_count};
+        }
+        else if (layout_ == PixelLayout::kPlanar)
+        {
+            if (!IsLayoutSupported(layout_, GetColorFormat()))
+                throw std::invalid_argument("Planar layout needs pixels made of 8-bit channels.");
+
+            // A plane for each byte of the pixel, the row of a plane is rounded up to the alignment
+            row_stride_byte_ = (image_size_.x + row_alignment_byte_ - 1) & ~(row_alignment_byte_ - 1);
+            chunk_count_ = Point{static_cast<Unit>(pixel_struct_size_byte_), band_count};
+        }
+        else if (layout_ == PixelLayout::kPacked)
+        {
+            if (!IsLayoutSupported(layout_, GetColorFormat()))
+                throw std::invalid_argument("Packed layout needs 1-bit pixels.");
+
+            // Packed rows are processed by 64-bit words -> align the rows (and the chunks) to whole words
+            row_alignment_byte_ = std::max(row_alignment_byte_, sizeof(uint64_t));
+            row_stride_byte_ = (GetPackedRowSize() + row_alignment_byte_ - 1) & ~(row_alignment_byte_ - 1);
+            chunk_count_ = Point{1, band_count};
+        }
+        else
+        {
+            // Round the row size up to the alignment
+            row_stride_byte_ = (GetRowSize() + row_alignment_byte_ - 1) & ~(row_alignment_byte_ - 1);
+            chunk_count_ = Point{1, band_count};
+        }
+    }
+
+    std::shared_ptr<uint8_t> DataPixels::AllocateChunk(size_t chunk) const
+    {
+        // Released chunks go back into the pool, so the next image of the same size does not allocate new memory
+        return BufferPool::GetDefault()->Allocate(GetChunkSize(chunk), row_alignment_byte_);
+    }
+
+    void DataPixels::AllocateData()
+    {
+        size_t chunk_count = static_cast<size_t>(chunk_count_.x) * chunk_count_.y;
+        chunks_.clear();
+        chunk_data_.clear();
+        chunks_.reserve(chunk_count);
+        chunk_data_.reserve(chunk_count);
+
+        // Bytes of a row in the chunk (a plane has a single byte per pixel)
+        size_t row_size = layout_ == PixelLayout::kPlanar ? image_size_.x : GetRowSize();
+        for (size_t chunk = 0; chunk < chunk_count; chunk++)
+        {
+            std::shared_ptr<uint8_t> data = AllocateChunk(chunk);
+            chunk_data_.push_back(data.get());
+            chunks_.push_back(Chunk{std::move(data), true});
+
+            // Only the padding is set, the pixels are left uninitialized as before
+            // (packed rows are cleared whole, the bits after the last pixel of a row have to be 0)
+            if (layout_ == PixelLayout::kPacked)
+            {
+                std::memset(chunk_data_.back(), 0, GetChunkSize(chunk));
+            }
+            else if (layout_ == PixelLayout::kTiled)
+            {
+                // Tiles in the last column and row reach outside of the image -> clear them whole
+                Unit tx = static_cast<Unit>(chunk % chunk_count_.x);
+                Unit ty = static_cast<Unit>(chunk / chunk_count_.x);
+                bool is_edge = ((tx + 1) << kTileSizeShift) > image_size_.x || ((ty + 1) << kTileSizeShift) > image_size_.y;
+                if (is_edge || row_stride_byte_ != kTileSize * pixel_struct_size_byte_)
+                    std::memset(chunk_data_.back(), 0, GetChunkSize(chunk));
+            }
+            else if (row_size != row_stride_byte_)
+            {
+                for (size_t offset = 0; offset < GetChunkSize(chunk); offset += row_stride_byte_)
+                    std::memset(chunk_data_.back() + offset + row_size, 0, row_stride_byte_ - row_size);
+            }
+        }
+    }
+
+    void DataPixels::CloneChunk(size_t chunk)
+    {
+        std::shared_ptr<uint8_t> data = AllocateChunk(chunk);
+        std::copy_n(chunk_data_[chunk], GetChunkSize(chunk), data.get());
+
+        // The old chunk is released here (or stays alive in the DataPixels sharing it)
+        chunk_data_[chunk] = data.get();
+        chunks_[chunk] = Chunk{std::move(data), true};
+    }
+
+    bool DataPixels::IsReadOnly() const
+    {
+        return std::any_of(chunks_.begin(), chunks_.end(), [](const Chunk &chunk) { return !chunk.is_owned; });
+    }
+
+    size_t DataPixels::GetSharedChunkCount() const
+    {
+        size_t count = 0;
+        for (size_t chunk = 0; chunk < chunks_.size(); chunk++)
+            count += !IsChunkWritable(chunk);
+
+        return count;
+    }
+
+    void DataPixels::MakeWritable()
+    {
+        for (size_t chunk = 0; chunk < chunks_.size(); chunk++)
+        {
+            if (!IsChunkWritable(chunk))
+                CloneChunk(chunk);
+        }
+    }
+
+    void DataPixels::MakeWritable(Point p1, Point p2)
+    {
+        // Clip the region to the image
+        Unit x_begin = std::max<Unit>(p1.x, 0);
+        Unit y_begin = std::max<Unit>(p1.y, 0);
+        Unit x_end = std::min<Unit>(p2.x, image_size_.x);
+        Unit y_end = std::min<Unit>(p2.y, image_size_.y);
+        if (x_begin >= x_end || y_begin >= y_end)
+            return;
+
+        // Chunks covering the region (the linear layout has a single column of chunks, the planar layout has a column for each plane)
+        Unit chunk_x_begin = 0, chunk_x_end = chunk_count_.x;
+        if (layout_ == PixelLayout::kTiled)
+        {
+            chunk_x_begin = x_begin >> kTileSizeShift;
+            chunk_x_end = ((x_end - 1) >> kTileSizeShift) + 1;
+        }
+        Unit chunk_y_begin = y_begin >> kTileSizeShift;
+        Unit chunk_y_end = ((y_end - 1) >> kTileSizeShift) + 1;
+
+        for (Unit cy = chunk_y_begin; cy < chunk_y_end; cy++)
+        {
+            for (Unit cx = chunk_x_begin; cx < chunk_x_end; cx++)
+            {
+                size_t chunk = static_cast<size_t>(cy) * chunk_count_.x + cx;
+                if (!IsChunkWritable(chunk))
+                    CloneChunk(chunk);
+            }
+        }
+    }
+
+    void DataPixels::CopyRowTo(Unit y, void *dst) const
+    {
+        uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+
+        // Interleave the planes
+        if (layout_ == PixelLayout::kPlanar)
+        {
+            for (size_t plane = 0; plane < pixel_struct_size_byte_; plane++)
+            {
+                const uint8_t *plane_row = PlanePtr(plane, 0, y);
+                for (Unit x = 0; x < image_size_.x; x++)
+                    out[x * pixel_struct_size_byte_ + plane] = plane_row[x];
+            }
+            return;
+        }
+
+        // Unpack the bits into BW pixels
+        if (layout_ == PixelLayout::kPacked)
+        {
+            const uint8_t *packed_row = PixelPtr(0, y);
+            for (Unit x = 0; x < image_size_.x; x++)
+                out[x] = GetPackedBit(packed_row, x);
+            return;
+        }
+
+        // Copy the row by the continuous segments
+        for (Unit x = 0; x < image_size_.x;)
+        {
+            Unit length = GetSegmentLength(x);
+            out = std::copy_n(PixelPtr(x, y), length * pixel_struct_size_byte_, out);
+            x += length;
+        }
+    }
+
+    void DataPixels::ConvertRowTo(Unit y, ColorFormat format, void *dst) const
+    {
+        if (format == GetColorFormat())
+        {
+            CopyRowTo(y, dst);
+            return;
+        }
+
+        // Linear rows are converted in place, other layouts are gathered first
+        std::unique_ptr<uint8_t[]> row;
+        const uint8_t *src = PixelPtr(0, y);
+        if (layout_ != PixelLayout::kLinear)
+        {
+            row = std::make_unique<uint8_t[]>(GetRowSize());
+            CopyRowTo(y, row.get());
+            src = row.get();
+        }
+
+        if (GetColorFormat() == ColorFormat::kIndexed8)
+            GetPalette()->ConvertIndices(src, format, dst, image_size_.x);
+        else
+            ConvertSpan(GetColorFormat(), format, src, dst, image_size_.x);
+    }
+
+    void DataPixels::CopyRowFrom(Unit y, const void *src)
+    {
+        const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+        MakeWritable(Point{0, y}, Point{image_size_.x, y + 1});
+
+        // Split the pixels into the planes
+        if (layout_ == PixelLayout::kPlanar)
+        {
+            for (size_t plane = 0; plane < pixel_struct_size_byte_; plane++)
+            {
+                uint8_t *plane_row = PlanePtr(plane, 0, y);
+                for (Unit x = 0; x < image_size_.x; x++)
+                    plane_row[x] = in[x * pixel_struct_size_byte_ + plane];
+            }
+            return;
+        }
+
+        // Pack 8 BW pixels into a byte (the unused bits of the last byte stay 0)
+        if (layout_ == PixelLayout::kPacked)
+        {
+            uint8_t *packed_row = PixelPtr(0, y);
+            std::fill_n(packed_row, GetPackedRowSize(), 0);
+            for (Unit x = 0; x < image_size_.x; x++)
+                packed_row[x >> 3] |= (in[x] & 1) << (7 - (x & 7));
+            return;
+        }
+
+        // Copy the row by the continuous segments
+        for (Unit x = 0; x < image_size_.x;)
+        {
+            Unit length = GetSegmentLength(x);
+            size_t length_byte = length * pixel_struct_size_byte_;
+            std::copy_n(in, length_byte, PixelPtr(x, y));
+            in += length_byte;
+            x += length;
+        }
+    }
+
+    void DataPixels::CopyPixelTo(Unit x, Unit y, void *dst) const
+    {
+        uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+
+        if (layout_ == PixelLayout::kPacked)
+        {
+            *out = GetPackedBit(PixelPtr(0, y), x);
+            return;
+        }
+
+        if (layout_ != PixelLayout::kPlanar)
+        {
+            std::copy_n(PixelPtr(x, y), pixel_struct_size_byte_, out);
+            return;
+        }
+
+        for (size_t plane = 0; plane < pixel_struct_size_byte_; plane++)
+            out[plane] = *PlanePtr(plane, x, y);
+    }
+
+    void DataPixels::CopyPixelFrom(Unit x, Unit y, const void *src)
+    {
+        const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+
+        if (layout_ == PixelLayout::kPacked)
+        {
+            SetPackedBit(PixelPtr(0, y), x, *in & 1);
+            return;
+        }
+
+        if (layout_ != PixelLayout::kPlanar)
+        {
+            std::copy_n(in, pixel_struct_size_byte_, PixelPtr(x, y));
+            return;
+        }
+
+        for (size_t plane = 0; plane < pixel_struct_size_byte_; plane++)
+            *PlanePtr(plane, x, y) = in[plane];
+    }
+
+    void DataPixels::ConvertLayout(PixelLayout layout)
+    {
+        if (layout == layout_)
+            return;
+
+        // Allocate space for pixel data
+        DataPixels new_data(image_size_, std::unique_ptr<Color>(data_color_->clone()), layout, row_alignment_byte_);
+
+        // Planes are interleaved or split (bits unpacked or packed) row by row
+        if (layout == PixelLayout::kPlanar || layout_ == PixelLayout::kPlanar || layout == PixelLayout::kPacked || layout_ == PixelLayout::kPacked)
+        {
+            std::unique_ptr<uint8_t[]> row = std::make_unique<uint8_t[]>(GetRowSize());
+            for (Unit y = 0; y < image_size_.y; y++)
+            {
+                CopyRowTo(y, row.get());
+                new_data.CopyRowFrom(y, row.get());
+            }
+
+            SwapData(new_data);
+            return;
+        }
+
+        // Both DataPixels have the same dimensions, so their tiles cover the same pixels
+        DispatchDataPixelsView(*this, [&](auto view_old) {
+            using PixelT = typename decltype(view_old)::pixel_type;
+            DataPixelsView<PixelT> view_new(new_data);
+
+            view_old.ForEachTile([&](const auto &tile_old) {
+                auto tile_new = view_new.TileAt(tile_old.GetOrigin());
+
+                for (Unit y = 0; y < tile_old.Height(); y++)
+                    std::copy_n(tile_old.Row(y), tile_old.Width(), tile_new.Row(y));
+            });
+        });
+
+        // Swap the old data of DataPixels with new data
+        SwapData(new_data);
+    }
+
+    std::shared_ptr<const Palette> DataPixels::GetPalette() const
+    {
+        if (GetColorFormat() != ColorFormat::kIndexed8)
+            return nullptr;
+
+        return static_cast<const ColorPalette &>(*data_color_).GetPalette();
+    }
+
+    void DataPixels::TransformToColorType(const std::unique_ptr<Color> &new_color)
+    {
+        const bool indexed = GetColorFormat() == ColorFormat::kIndexed8 || new_color->GetColorFormat() == ColorFormat::kIndexed8;
+        if (layout_ == PixelLayout::kPlanar || layout_ == PixelLayout::kPacked || indexed)
+        {
+            // Keep the planes (or packed bits) if the new color can be stored in them
+            PixelLayout new_layout = IsLayoutSupported(layout_, new_color->GetColorFormat()) ? layout_ : PixelLayout::kLinear;
+            DataPixels new_data(image_size_, std::unique_ptr<Color>(new_color->clone()), new_layout, row_alignment_byte_);
+
+            TransformRows(new_data);
+            SwapData(new_data);
+            return;
+        }
+
+        // Allocate space for pixel data
+        DataPixels new_data(image_size_, std::unique_ptr<Color>(new_color->clone()), layout_, row_alignment_byte_);
+
+        // Convert the continuous rows of pixels (rows of the tiles for the tiled layout) as spans
+        const ColorFormat old_format = GetColorFormat();
+        const ColorFormat new_format = new_data.GetColorFormat();
+        DispatchDataPixelsView(*this, [&](auto view_old) {
+            DispatchDataPixelsView(new_data, [&](auto view_new) {
+                // Both DataPixels have the same dimensions and layout, so their tiles cover the same pixels
+                view_old.ForEachTile([&](const auto &tile_old) {
+                    auto tile_new = view_new.TileAt(tile_old.GetOrigin());
+
+                    for (Unit y = 0; y < tile_old.Height(); y++)
+                        ConvertSpan(old_format, new_format, tile_old.Row(y), tile_new.Row(y), tile_old.Width());
+                });
+            });
+        });
+
+        // Swap the old data of DataPixels with new data
+        SwapData(new_data);
+    }
+
+    void DataPixels::TransformToColorType(const std::unique_ptr<Color> &new_color, DitherMethod dither)
+    {
+        const ColorFormat new_format = new_color->GetColorFormat();
+        if (!IsDitherFormat(new_format))
+        {
+            TransformToColorType(new_color);
+            return;
+        }
+
+        // Dithering needs the neighbouring rows -> convert the whole image into one continuous buffer first
+        const ColorFormat dither_format = DitherSourceFormat(new_format);
+        const size_t dither_stride = PixelSize(dither_format) * image_size_.x;
+        std::unique_ptr<uint8_t[]> dither_data = std::make_unique<uint8_t[]>(dither_stride * image_size_.y);
+
+        for (Unit y = 0; y < image_size_.y; y++)
+            ConvertRowTo(y, dither_format, dither_data.get() + y * dither_stride);
+
+        DitherPixels(dither, new_format, dither_data.get(), dither_stride, image_size_);
+
+        // The dithered values are the exact levels of the new color, so the conversion does not change them
+        PixelLayout new_layout = IsLayoutSupported(layout_, new_format) ? layout_ : PixelLayout::kLinear;
+        DataPixels new_data(image_size_, std::unique_ptr<Color>(new_color->clone()), new_layout, row_alignment_byte_);
+        std::unique_ptr<uint8_t[]> row_new = std::make_unique<uint8_t[]>(new_data.GetRowSize());
+
+        for (Unit y = 0; y < image_size_.y; y++)
+        {
+            ConvertSpan(dither_format, new_format, dither_data.get() + y * dither_stride, row_new.get(), image_size_.x);
+            new_data.CopyRowFrom(y, row_new.get());
+        }
+
+        SwapData(new_data);
+    }
+
+    void DataPixels::TransformRows(DataPixels &new_data) const
+    {
+        DispatchPixelType(GetColorFormat(), [&](auto tag_old) {
+            using PixelOld = typename decltype(tag_old)::type;
+
+            // Color to grayscale is a weighted sum of the planes (same weights as Color::ToGrayscale())
+            if constexpr (PixelChannels<PixelOld>::kCount == 3)
+            {
+                if (layout_ == PixelLayout::kPlanar && new_data.GetColorFormat() == ColorFormat::kGrayscale)
+                {
+                    for (Unit y = 0; y < image_size_.y; y++)
+                    {
+                        const uint8_t *r = PlanePtr(PixelChannels<PixelOld>::kRed, 0, y);
+                        const uint8_t *g = PlanePtr(PixelChannels<PixelOld>::kGreen, 0, y);
+                        const uint8_t *b = PlanePtr(PixelChannels<PixelOld>::kBlue, 0, y);
+                        uint8_t *gray = new_data.PlanePtr(0, 0, y);
+
+                        for (Unit x = 0; x < image_size_.x; x++)
+                            gray[x] = RoundedLuminance(r[x], g[x], b[x]);
+                    }
+                    return;
+                }
+            }
+
+            std::unique_ptr<uint8_t[]> row_new = std::make_unique<uint8_t[]>(new_data.GetRowSize());
+
+            // New palette -> the colors of the row are mapped to the nearest palette colors
+            if (new_data.GetColorFormat() == ColorFormat::kIndexed8)
+            {
+                PaletteMapper mapper(*new_data.GetPalette());
+                std::unique_ptr<PixelRGB888[]> row_rgb = std::make_unique<PixelRGB888[]>(image_size_.x);
+
+                for (Unit y = 0; y < image_size_.y; y++)
+                {
+                    ConvertRowTo(y, ColorFormat::kRGB888, row_rgb.get());
+                    mapper.MapSpan(row_rgb.get(), row_new.get(), image_size_.x);
+                    new_data.CopyRowFrom(y, row_new.get());
+                }
+                return;
+            }
+
+            // Any other color -> interleave the row, convert it and store it in new data
+            for (Unit y = 0; y < image_size_.y; y++)
+            {
+                ConvertRowTo(y, new_data.GetColorFormat(), row_new.get());
+                new_data.CopyRowFrom(y, row_new.get());
+            }
+        });
+    }
+}
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "dither.h"
+#include "parallel.h"
+#include "pixel_traits.h"
+
+namespace paint
+{
+    namespace
+    {
+        // Values one channel can hold after the conversion into the target format
+        struct ChannelLevels
+        {
+            uint8_t nearest[256]; // Value -> the nearest value the channel can hold
+            int step;             // Distance between two neighbouring values
+        };
+
+        // Levels of a channel stored with width_bits in the target format and converted back by shifting left (see PixelTraits::ToRGB888())
+        ChannelLevels MakeShiftLevels(size_t width_bits)
+        {
+            ChannelLevels levels;
+            levels.step = 1 << (8 - width_bits);
+
+            const int max_value = 256 - levels.step;
+            for (int v = 0; v < 256; v++)
+                levels.nearest[v] = static_cast<uint8_t>(std::min((v + levels.step / 2) / levels.step * levels.step, max_value));
+
+            return levels;
+        }
+
+        // Levels of the BW pixel converted to grayscale (the threshold of PixelTraits::ToBW())
+        ChannelLevels MakeBWLevels()
+        {
+            ChannelLevels levels;
+            levels.step = 255;
+
+            for (int v = 0; v < 256; v++)
+                levels.nearest[v] = v > 127 ? 255 : 0;
+
+            return levels;
+        }
+
+        // Levels of every byte of the source pixel (DitherSourceFormat()) for target format
+        std::vector<ChannelLevels> MakeLevels(ColorFormat target_format)
+        {
+            if (target_format == ColorFormat::kBW)
+                return {MakeBWLevels()};
+
+            // RGB565 and BGR565 have the same channel widths, the source RGB888 has one byte per channel
+            using Source = PixelTraits<ColorFormat::kRGB888>;
+            using Target = PixelTraits<ColorFormat::kRGB565>;
+
+            std::vector<ChannelLevels> levels(3);
+            levels[Source::kRed.offset_bits / 8] = MakeShiftLevels(Target::kRed.width_bits);
+            levels[Source::kGreen.offset_bits / 8] = MakeShiftLevels(Target::kGreen.width_bits);
+            levels[Source::kBlue.offset_bits / 8] = MakeShiftLevels(Target::kBlue.width_bits);
+            return levels;
+        }
+
+        // 8x8 Bayer threshold matrix (values 0 - 63)
+        constexpr uint8_t kBayerMatrix[8][8] = {
+            {0, 32, 8, 40, 2, 34, 10, 42},
+            {48, 16, 56, 24, 50, 18, 58, 26},
+            {12, 44, 4, 36, 14, 46, 6, 38},
+            {60, 28, 52, 20, 62, 30, 54, 22},
+            {3, 35, 11, 43, 1, 33, 9, 41},
+            {51, 19, 59, 27, 49, 17, 57, 25},
+            {15, 47, 7, 39, 13, 45, 5, 37},
+            {63, 31, 55, 23, 61, 29, 53, 21},
+        };
+
+        uint8_t Quantize(const ChannelLevels &levels, int value)
+        {
+            return levels.nearest[std::clamp(value, 0, 255)];
+        }
+
+        void DitherBayer(const std::vector<ChannelLevels> &levels, uint8_t *pixels, size_t stride, Point size, unsigned thread_count)
+        {
+            const size_t channels = levels.size();
+
+            ParallelFor(size.y, thread_count, [&](Unit y) {
+                uint8_t *row = pixels + y * stride;
+
+                for (Unit x = 0; x < size.x; x++)
+                {
+                    // Threshold moved into (-0.5, 0.5) of the level step
+                    const int threshold = 2 * kBayerMatrix[y & 7][x & 7] - 63;
+
+                    for (size_t c = 0; c < channels; c++)
+                    {
+                        uint8_t &v = row[x * channels + c];
+                        v = Quantize(levels[c], v + threshold * levels[c].step / 128);
+                    }
+                }
+            });
+        }
+
+        // Error diffusion kernel: the weights of the right neighbours in the row and of the neighbours in the next rows
+        struct DiffusionKernel
+        {
+            int shift;       // The weights are divided by 1 << shift
+            int right[2];    // x + 1, x + 2
+            int below[2][3]; // Rows y + 1 and y + 2, columns x - 1, x, x + 1
+        };
+
+        constexpr DiffusionKernel kFloydSteinberg{4, {7, 0}, {{3, 5, 1}, {0, 0, 0}}};
+        constexpr DiffusionKernel kAtkinson{3, {1, 1}, {{1, 1, 1}, {0, 1, 0}}};
+
+        void DitherErrorDiffusion(const DiffusionKernel &kernel, const std::vector<ChannelLevels> &levels,
+                                  uint8_t *pixels, size_t stride, Point size, unsigned thread_count)
+        {
+            const int channels = static_cast<int>(levels.size());
+            const int width = size.x;
+
+            // Errors diffused into the next rows, every row keeps its own errors in local variables.
+            // A row reads its buffer and writes the next two, so thread_count + 2 rows are enough:
+            // when a row is taken, all the rows thread_count rows above it are done.
+            const size_t buffer_rows = thread_count + 2;
+            const size_t buffer_row_size = static_cast<size_t>(width) * channels;
+            std::vector<int> errors(buffer_rows * buffer_row_size, 0);
+            auto error_row = [&](Unit y) { return errors.data() + (y % buffer_rows) * buffer_row_size; };
+
+            // Number of finished pixels of every row
+            std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[size.y]);
+            for (Unit y = 0; y < size.y; y++)
+                progress[y].store(0, std::memory_order_relaxed);
+
+            const int round = (1 << kernel.shift) / 2;
+
+            ParallelFor(size.y, thread_count, [&](Unit y) {
+                uint8_t *row = pixels + y * stride;
+                int *errors_this = error_row(y);
+                int *errors_next = error_row(y + 1);
+                int *errors_next2 = error_row(y + 2);
+
+                // Errors of the row diffused to the right
+                std::vector<int> carry(2 * channels, 0);
+
+                // Pixels of the row above known to be finished (the whole row for the first row)
+                int done_above = y > 0 ? 0 : width;
+
+                for (int x = 0; x < width; x++)
+                {
+                    // Wait for the row above to diffuse all its errors into this pixel
+                    const int needed = std::min(x + 2, width);
+                    while (done_above < needed)
+                    {
+                        done_above = progress[y - 1].load(std::memory_order_acquire);
+                        if (done_above < needed)
+                            std::this_thread::yield();
+                    }
+
+                    for (int c = 0; c < channels; c++)
+                    {
+                        const int i = x * channels + c;
+                        const int error_sum = errors_this[i] + carry[c];
+                        errors_this[i] = 0; // The buffer will be used by a later row
+
+                        const int value = std::clamp(row[i] + ((error_sum + round) >> kernel.shift), 0, 255);
+                        const uint8_t quantized = Quantize(levels[c], value);
+                        const int error = value - quantized;
+                        row[i] = quantized;
+
+                        carry[c] = carry[channels + c] + error * kernel.right[0];
+                        carry[channels + c] = error * kernel.right[1];
+
+                        // The errors diffused out of the image are lost, the zero weights are skipped,
+                        // so no two rows ever write the same error at the same time
+                        for (int dx = std::max(-1, -x); dx <= std::min(1, width - 1 - x); dx++)
+                        {
+                            if (kernel.below[0][dx + 1] != 0)
+                                errors_next[i + dx * channels] += error * kernel.below[0][dx + 1];
+                            if (kernel.below[1][dx + 1] != 0)
+                                errors_next2[i + dx * channels] += error * kernel.below[1][dx + 1];
+                        }
+                    }
+
+                    progress[y].store(x + 1, std::memory_order_release);
+                }
+            });
+        }
+    }
+
+    bool IsDitherFormat(ColorFormat format)
+    {
+        return format == ColorFormat::kBW || format == ColorFormat::kRGB565 || format == ColorFormat::kBGR565;
+    }
+
+    ColorFormat DitherSourceFormat(ColorFormat target_format)
+    {
+        return target_format == ColorFormat::kBW ? ColorFormat::kGrayscale : ColorFormat::kRGB888;
+    }
+
+    void DitherPixels(DitherMethod method, ColorFormat target_format, uint8_t *pixels, size_t stride, Point size, unsigned thread_count)
+    {
+        if (!IsDitherFormat(target_format))
+            throw "Dithering is only implemented for BW & RGB565 & BGR565";
+
+        if (size.x <= 0 || size.y <= 0)
+            return;
+
+        if (thread_count == 0)
+            thread_count = DefaultThreadCount();
+        thread_count = std::min<unsigned>(thread_count, size.y);
+
+        const std::vector<ChannelLevels> levels = MakeLevels(target_format);
+
+        switch (method)
+        {
+        case DitherMethod::kBayer:
+            DitherBayer(levels, pixels, stride, size, thread_count);
+            break;
+        case DitherMethod::kFloydSteinberg:
+            DitherErrorDiffusion(kFloydSteinberg, levels, pixels, stride, size, thread_count);
+            break;
+        case DitherMethod::kAtkinson:
+            DitherErrorDiffusion(kAtkinson, levels, pixels, stride, size, thread_count);
+            break;
+        }
+    }
+}
@@ -0,0 +1,199 @@
+#include "draw_batch.h"
+#include "color_bgra8888.h"
+#include "data_pixels_view.h"
+#include "packed_bits.h"
+#include "parallel.h"
+#include "blend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace paint
+{
+    PrimitiveColor::PrimitiveColor(const DataPixels &data, const Color &color, bool blend) : pixel{}
+    {
+        this->blend = blend || TranslucentPixel(color).has_value();
+        blend_pixel = color.ToBGRA8888().GetPixel();
+
+        // Opaque color is filled with the pixel of data (found once, i.e. the nearest palette color)
+        if (!this->blend)
+        {
+            DispatchPixelType(data.GetColorFormat(), [&](auto tag) {
+                using PixelT = typename decltype(tag)::type;
+                static_assert(sizeof(PixelT) <= sizeof(pixel), "PrimitiveColor::pixel is too small");
+
+                const PixelT data_pixel = DataPixelFromColor<PixelT>(data, color);
+                std::memcpy(pixel, &data_pixel, sizeof(PixelT));
+            });
+        }
+    }
+
+    LinePrimitive::LinePrimitive(const DataPixels &data, Point start, Point end, Unit width, bool antialias, const Color &color)
+        : start(start), end(end), width(width), antialias(antialias), color(data, color, antialias)
+    {
+        // The rectangle around the line is at most half the width (or half a pixel) longer, the antialiased edge grows it by half a pixel
+        const Unit margin = std::max<Unit>(width, 1) / 2 + 2;
+        box_begin = Point{std::min(start.x, end.x) - margin, std::min(start.y, end.y) - margin};
+        box_end = Point{std::max(start.x, end.x) + margin + 1, std::max(start.y, end.y) + margin + 1};
+    }
+
+    CirclePrimitive::CirclePrimitive(const DataPixels &data, Point center, Unit radius, Unit border_width, bool fill, const Color &fill_color, const Color &border_color)
+        : center(center), radius(radius), border_width(border_width), fill(fill), fill_color(data, fill_color), border_color(data, border_color)
+    {
+        // The outer edge of the border is radius + border_width / 2 from the center
+        const int64_t extent = std::max<int64_t>(radius, 0) + std::max<int64_t>(border_width, 0) / 2 + 1;
+        const Unit margin = static_cast<Unit>(std::min<int64_t>(extent, Unit{1} << 30));
+        box_begin = Point{center.x - margin, center.y - margin};
+        box_end = Point{center.x + margin + 1, center.y + margin + 1};
+    }
+
+    PrimitiveRenderer::PrimitiveRenderer(DataPixels &data, bool make_writable) : data_(data), make_writable_(make_writable)
+    {
+    }
+
+    void PrimitiveRenderer::Draw(const LinePrimitive &line, Unit row_begin, Unit row_end)
+    {
+        LineRasterizer raster(line.start, line.end, line.width, data_.GetSize(), line.antialias);
+        raster.ClipRows(row_begin, row_end);
+
+        // Antialiased line blends the color scaled by the coverage over each row
+        if (line.antialias)
+        {
+            if (!blender_)
+                blender_.emplace(data_);
+
+            raster.ForEachCoverageRow([&](Unit y, Unit x_begin, const uint8_t *coverage, Unit count) {
+                row_pixels_.resize(count);
+                for (Unit i = 0; i < count; i++)
+                    row_pixels_[i] = ScalePixel(line.color.blend_pixel, coverage[i]);
+
+                if (make_writable_)
+                    data_.MakeWritable(Point{x_begin, y}, Point{x_begin + count, y + 1});
+                blender_->BlendPixels(y, x_begin, x_begin + count, row_pixels_.data());
+            });
+            return;
+        }
+
+        raster.GetSpans(spans_);
+        FillSpans(spans_, line.color);
+    }
+
+    void PrimitiveRenderer::Draw(const CirclePrimitive &circle, Unit row_begin, Unit row_end)
+    {
+        CircleRasterizer raster(circle.center, circle.radius, circle.border_width, data_.GetSize());
+        raster.ClipRows(row_begin, row_end);
+        raster.GetSpans(spans_, fill_spans_);
+
+        if (circle.fill)
+            FillSpans(fill_spans_, circle.fill_color);
+        FillSpans(spans_, circle.border_color);
+    }
+
+    void PrimitiveRenderer::FillSpans(const std::vector<RowSpan> &spans, const PrimitiveColor &color)
+    {
+        // The pixels are changed in place -> copy only the shared chunks under the runs first
+        if (make_writable_)
+        {
+            for (const RowSpan &span : spans)
+                data_.MakeWritable(Point{span.x_begin, span.y}, Point{span.x_end, span.y + 1});
+        }
+
+        // Translucent color is blended over each run (every pixel once)
+        if (color.blend)
+        {
+            if (!blender_)
+                blender_.emplace(data_);
+
+            for (const RowSpan &span : spans)
+                blender_->BlendColor(span.y, span.x_begin, span.x_end, color.blend_pixel);
+            return;
+        }
+
+        DispatchPixelType(data_.GetColorFormat(), [&](auto tag) {
+            using PixelT = typename decltype(tag)::type;
+
+            PixelT fill_pixel;
+            std::memcpy(&fill_pixel, color.pixel, sizeof(PixelT));
+
+            // Packed BW pixels are filled by whole words
+            if constexpr (std::is_same_v<PixelT, PixelBW>)
+            {
+                if (data_.GetLayout() == PixelLayout::kPacked)
+                {
+                    for (const RowSpan &span : spans)
+                        FillPackedBits(static_cast<uint8_t *>(data_.PackedRowPtr(span.y)), span.x_begin, span.x_end, fill_pixel.w);
+                    return;
+                }
+            }
+
+            // Fill the runs with the whole pixels (or each plane with its byte of the pixel)
+            DispatchChannelViews(data_, [&](auto view, size_t plane) {
+                using ChannelT = typename decltype(view)::pixel_type;
+                const ChannelT fill_channel = GetChannelPixel<ChannelT>(fill_pixel, plane);
+
+                for (const RowSpan &span : spans)
+                    view.FillRow(span.y, span.x_begin, span.x_end, fill_channel);
+            });
+        });
+    }
+
+    void DrawBatch::Render(DataPixels &data, unsigned thread_count)
+    {
+        const Point size = data.GetSize();
+        const Unit band_count = (size.y + kBandHeight - 1) / kBandHeight;
+
+        // Bin the primitives into the bands crossed by their bounding boxes (in the order they were added)
+        // and find the columns covered in each band
+        std::vector<std::vector<size_t>> band_primitives(band_count);
+        std::vector<std::pair<Unit, Unit>> band_columns(band_count, {size.x, 0});
+        for (size_t i = 0; i < primitives_.size(); i++)
+        {
+            const auto [box_begin, box_end] = std::visit([](const auto &primitive) { return std::make_pair(primitive.box_begin, primitive.box_end); }, primitives_[i]);
+            const Unit y_begin = std::max<Unit>(box_begin.y, 0);
+            const Unit y_end = std::min<Unit>(box_end.y, size.y);
+            if (y_begin >= y_end || box_begin.x >= size.x || box_end.x <= 0)
+                continue;
+
+            for (Unit band = y_begin / kBandHeight; band <= (y_end - 1) / kBandHeight; band++)
+            {
+                band_primitives[band].push_back(i);
+                band_columns[band].first = std::min(band_columns[band].first, box_begin.x);
+                band_columns[band].second = std::max(band_columns[band].second, box_end.x);
+            }
+        }
+
+        // The chunks are copied serially (DataPixels::MakeWritable() changes the shared state of the data)
+        std::vector<Unit> bands;
+        for (Unit band = 0; band < band_count; band++)
+        {
+            if (band_primitives[band].empty())
+                continue;
+
+            data.MakeWritable(Point{band_columns[band].first, band * kBandHeight}, Point{band_columns[band].second, (band + 1) * kBandHeight});
+            bands.push_back(band);
+        }
+
+        // Each thread draws whole bands with its own renderer (the bands are different rows of different chunks)
+        if (thread_count == 0)
+            thread_count = DefaultThreadCount();
+        thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, bands.size()));
+
+        std::atomic<size_t> next{0};
+        RunOnThreads(thread_count, [&]() {
+            PrimitiveRenderer renderer(data, false);
+            for (size_t i = next++; i < bands.size(); i = next++)
+            {
+                const Unit row_begin = bands[i] * kBandHeight;
+                const Unit row_end = std::min<Unit>(row_begin + kBandHeight, size.y);
+                for (size_t primitive : band_primitives[bands[i]])
+                    std::visit([&](const auto &p) { renderer.Draw(p, row_begin, row_end); }, primitives_[primitive]);
+            }
+        });
+
+        Clear();
+    }
+}
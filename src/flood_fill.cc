@@ -0,0 +1,635 @@
+#include "flood_fill.h"
+#include "color_match.h"
+#include "data_pixels_view.h"
+#include "packed_bits.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace paint
+{
+    namespace
+    {
+        /**
+         * @brief 1 bit per pixel, set for the pixels of the found runs.
+         *
+         * The rows get their bits when the first run is found in them, so a small region of a huge image
+         * does not clear the bits of the whole image.
+         *
+         */
+        class VisitedMap
+        {
+        public:
+            explicit VisitedMap(Point size) : words_per_row_((static_cast<size_t>(size.x) + 63) / 64), row_offsets_(size.y, kNoRow)
+            {
+            }
+
+            // Marks the pixels [x_begin, x_end) of row y
+            void Set(Unit y, Unit x_begin, Unit x_end)
+            {
+                if (row_offsets_[y] == kNoRow)
+                {
+                    row_offsets_[y] = bits_.size();
+                    bits_.resize(bits_.size() + words_per_row_, 0);
+                }
+
+                uint64_t *row = bits_.data() + row_offsets_[y];
+                for (Unit x = x_begin; x < x_end;)
+                {
+                    const Unit bit = x & 63;
+                    const Unit count = std::min<Unit>(64 - bit, x_end - x);
+                    const uint64_t mask = count == 64 ? ~uint64_t{0} : ((uint64_t{1} << count) - 1) << bit;
+                    row[x >> 6] |= mask;
+                    x += count;
+                }
+            }
+
+            // Returns the first pixel in [x, x_end) of row y that is not marked (or x_end)
+            Unit NextUnvisited(Unit y, Unit x, Unit x_end) const
+            {
+                if (row_offsets_[y] == kNoRow)
+                    return x;
+
+                const uint64_t *row = bits_.data() + row_offsets_[y];
+                while (x < x_end)
+                {
+                    // Set bits are the unmarked pixels from x on
+                    const uint64_t unvisited = ~row[x >> 6] >> (x & 63);
+                    if (unvisited != 0)
+                        return std::min<Unit>(x + __builtin_ctzll(unvisited), x_end);
+
+                    x = (x | 63) + 1;
+                }
+
+                return x_end;
+            }
+
+        private:
+            static constexpr size_t kNoRow = ~size_t{0};
+
+            size_t words_per_row_;
+            std::vector<size_t> row_offsets_; // Offset of the bits of each row in bits_ (kNoRow = no run found yet)
+            std::vector<uint64_t> bits_;
+        };
+
+        /**
+         * @brief Compares pixels with a pattern of the picked pixel by blocks of kBlockPixels (memcmp() is vectorized),
+         * the rest (and the first difference) pixel by pixel.
+         *
+         * Only the pixels without padding bits are compared by bytes (i.e. not PixelBW).
+         *
+         */
+        template <typename PixelT>
+        class PixelMatcher
+        {
+        public:
+            static constexpr Unit kBlockPixels = 64;
+
+            explicit PixelMatcher(const PixelT &picked) : picked_(picked)
+            {
+                std::fill_n(block_, kBlockPixels, picked);
+            }
+
+            bool Match(const PixelT &pixel) const { return pixel == picked_; }
+
+            // Number of the matching pixels at the start of [pixels, pixels + count)
+            Unit MatchForward(const PixelT *pixels, Unit count) const
+            {
+                Unit i = 0;
+                if constexpr (kByBytes)
+                {
+                    while (i + kBlockPixels <= count && std::memcmp(pixels + i, block_, sizeof(block_)) == 0)
+                        i += kBlockPixels;
+                }
+
+                while (i < count && Match(pixels[i]))
+                    i++;
+                return i;
+            }
+
+            // Number of the matching pixels at the end of [pixels - count, pixels)
+            Unit MatchBackward(const PixelT *pixels, Unit count) const
+            {
+                Unit i = 0;
+                if constexpr (kByBytes)
+                {
+                    while (i + kBlockPixels <= count && std::memcmp(pixels - i - kBlockPixels, block_, sizeof(block_)) == 0)
+                        i += kBlockPixels;
+                }
+
+                while (i < count && Match(*(pixels - i - 1)))
+                    i++;
+                return i;
+            }
+
+        private:
+            static constexpr bool kByBytes = std::has_unique_object_representations_v<PixelT>;
+
+            PixelT picked_;
+            PixelT block_[kBlockPixels];
+        };
+
+        /**
+         * @brief Reads the rows of interleaved pixels (linear and tiled layout) and compares them with the picked pixel.
+         *
+         * The tiled rows are compared by the segments in each tile.
+         *
+         */
+        template <typename PixelT>
+        class PixelRowReader
+        {
+        public:
+            PixelRowReader(DataPixels &data, Point seed) : view_(data), is_tiled_(view_.IsTiled()), matcher_(view_(seed.x, seed.y))
+            {
+            }
+
+            void SetRow(Unit y)
+            {
+                y_ = y;
+                if (!is_tiled_)
+                    row_ = &view_(0, y);
+            }
+
+            bool Match(Unit x) const { return matcher_.Match(Pixel(x)); }
+
+            Unit RunStart(Unit x) const
+            {
+                if (!is_tiled_)
+                    return x - matcher_.MatchBackward(row_ + x, x);
+
+                while (x > 0)
+                {
+                    // Pixels [x - count, x) are in the same tile
+                    const Unit count = ((x - 1) & DataPixels::kTileSizeMask) + 1;
+                    const Unit matched = matcher_.MatchBackward(&Pixel(x - 1) + 1, count);
+                    x -= matched;
+                    if (matched < count)
+                        break;
+                }
+                return x;
+            }
+
+            Unit RunEnd(Unit x, Unit x_end) const
+            {
+                if (!is_tiled_)
+                    return x + matcher_.MatchForward(row_ + x, x_end - x);
+
+                while (x < x_end)
+                {
+                    // Pixels [x, x + count) are in the same tile
+                    const Unit count = std::min<Unit>(DataPixels::kTileSize - (x & DataPixels::kTileSizeMask), x_end - x);
+                    const Unit matched = matcher_.MatchForward(&Pixel(x), count);
+                    x += matched;
+                    if (matched < count)
+                        break;
+                }
+                return x;
+            }
+
+            // Returns the first matching pixel in [x, x_end) (or x_end)
+            Unit NextMatch(Unit x, Unit x_end) const
+            {
+                while (x < x_end && !Match(x))
+                    x++;
+                return x;
+            }
+
+        private:
+            const PixelT &Pixel(Unit x) const { return is_tiled_ ? view_(x, y_) : row_[x]; }
+
+            DataPixelsView<PixelT> view_;
+            bool is_tiled_;
+            PixelMatcher<PixelT> matcher_;
+            const PixelT *row_ = nullptr; // Row y_ of the linear layout
+            Unit y_ = 0;
+        };
+
+        /**
+         * @brief Reads the rows of the planes (planar layout) and compares their bytes with the bytes of the picked pixel.
+         *
+         * The run is found in the first plane, then shortened by each next plane.
+         *
+         */
+        class PlanarRowReader
+        {
+        public:
+            PlanarRowReader(DataPixels &data, Point seed) : data_(data), plane_count_(data.GetPlaneCount())
+            {
+                uint8_t picked[4] = {};
+                data.CopyPixelTo(seed.x, seed.y, picked);
+                for (size_t plane = 0; plane < plane_count_; plane++)
+                    matchers_.emplace_back(picked[plane]);
+            }
+
+            void SetRow(Unit y)
+            {
+                for (size_t plane = 0; plane < plane_count_; plane++)
+                    rows_[plane] = static_cast<const uint8_t *>(data_.PlaneRowPtr(plane, y));
+            }
+
+            bool Match(Unit x) const
+            {
+                for (size_t plane = 0; plane < plane_count_; plane++)
+                {
+                    if (!matchers_[plane].Match(rows_[plane][x]))
+                        return false;
+                }
+                return true;
+            }
+
+            Unit RunStart(Unit x) const
+            {
+                Unit count = x;
+                for (size_t plane = 0; plane < plane_count_ && count > 0; plane++)
+                    count = matchers_[plane].MatchBackward(rows_[plane] + x, count);
+                return x - count;
+            }
+
+            Unit RunEnd(Unit x, Unit x_end) const
+            {
+                Unit count = x_end - x;
+                for (size_t plane = 0; plane < plane_count_ && count > 0; plane++)
+                    count = matchers_[plane].MatchForward(rows_[plane] + x, count);
+                return x + count;
+            }
+
+            // Returns the first matching pixel in [x, x_end) (or x_end)
+            Unit NextMatch(Unit x, Unit x_end) const
+            {
+                while (x < x_end && !Match(x))
+                    x++;
+                return x;
+            }
+
+        private:
+            DataPixels &data_;
+            size_t plane_count_;
+            std::vector<PixelMatcher<uint8_t>> matchers_;
+            const uint8_t *rows_[4] = {};
+        };
+
+        /**
+         * @brief Reads the packed rows (see packed_bits.h), the runs are found by words.
+         *
+         */
+        class PackedRowReader
+        {
+        public:
+            PackedRowReader(DataPixels &data, Point seed) : data_(data)
+            {
+                picked_ = GetPackedBit(static_cast<const uint8_t *>(data.PackedRowPtr(seed.y)), seed.x);
+            }
+
+            void SetRow(Unit y) { row_ = static_cast<const uint8_t *>(data_.PackedRowPtr(y)); }
+
+            bool Match(Unit x) const { return GetPackedBit(row_, x) == picked_; }
+
+            Unit RunStart(Unit x) const { return FindPackedRunStart(row_, x, picked_); }
+
+            Unit RunEnd(Unit x, Unit x_end) const { return FindPackedRunEnd(row_, x, x_end, picked_); }
+
+            Unit NextMatch(Unit x, Unit x_end) const { return FindPackedRunEnd(row_, x, x_end, !picked_); }
+
+        private:
+            DataPixels &data_;
+            bool picked_;
+            const uint8_t *row_ = nullptr;
+        };
+
+        /**
+         * @brief Reads the rows of the pixels within a tolerance of the picked pixel (see ColorMatcher), the runs are found by words.
+         *
+         * The pixels of a row are matched into bits when the row is read first.
+         *
+         */
+        class MatchedRowReader
+        {
+        public:
+            MatchedRowReader(DataPixels &data, Point seed, uint8_t tolerance)
+                : matcher_(data, PickPixel(data, seed).data(), tolerance), row_offsets_(data.GetSize().y, kNoRow)
+            {
+            }
+
+            void SetRow(Unit y)
+            {
+                if (row_offsets_[y] == kNoRow)
+                {
+                    row_offsets_[y] = bits_.size();
+                    bits_.resize(bits_.size() + matcher_.GetRowSize());
+                    matcher_.MatchRow(y, bits_.data() + row_offsets_[y]);
+                }
+                row_ = bits_.data() + row_offsets_[y];
+            }
+
+            bool Match(Unit x) const { return GetPackedBit(row_, x); }
+
+            Unit RunStart(Unit x) const { return FindPackedRunStart(row_, x, true); }
+
+            Unit RunEnd(Unit x, Unit x_end) const { return FindPackedRunEnd(row_, x, x_end, true); }
+
+            Unit NextMatch(Unit x, Unit x_end) const { return FindPackedRunEnd(row_, x, x_end, false); }
+
+        private:
+            static constexpr size_t kNoRow = ~size_t{0};
+
+            static std::array<uint8_t, 4> PickPixel(DataPixels &data, Point seed)
+            {
+                std::array<uint8_t, 4> pixel{};
+                data.CopyPixelTo(seed.x, seed.y, pixel.data());
+                return pixel;
+            }
+
+            ColorMatcher matcher_;
+            std::vector<size_t> row_offsets_; // Offset of the bits of each row in bits_ (kNoRow = not matched yet)
+            std::vector<uint8_t> bits_;
+            const uint8_t *row_ = nullptr;
+        };
+
+        /**
+         * @brief Scanline search of the region (see FindRegion()).
+         *
+         * @return false if the search stopped after finding more than max_pixels pixels (spans are incomplete).
+         */
+        template <typename Reader>
+        bool SearchRegion(Reader &reader, Point size, Point seed, std::vector<RowSpan> &spans, PixelIndex max_pixels)
+        {
+            VisitedMap visited(size);
+            PixelIndex found_pixels = 0;
+
+            // Runs of the rows to search for the pixels of the region
+            std::vector<RowSpan> stack;
+
+            // Marks the run of the region and searches the rows above and below it
+            auto add_run = [&](Unit y, Unit x_begin, Unit x_end) {
+                visited.Set(y, x_begin, x_end);
+                spans.push_back(RowSpan{y, x_begin, x_end});
+                found_pixels += x_end - x_begin;
+
+                if (y > 0)
+                    stack.push_back(RowSpan{y - 1, x_begin, x_end});
+                if (y + 1 < size.y)
+                    stack.push_back(RowSpan{y + 1, x_begin, x_end});
+            };
+
+            reader.SetRow(seed.y);
+            add_run(seed.y, reader.RunStart(seed.x), reader.RunEnd(seed.x, size.x));
+
+            while (!stack.empty())
+            {
+                if (found_pixels > max_pixels)
+                    return false;
+
+                const RowSpan searched = stack.back();
+                stack.pop_back();
+
+                reader.SetRow(searched.y);
+                for (Unit x = searched.x_begin; x < searched.x_end; x++)
+                {
+                    // The found runs are skipped by words (a found run is the whole run of the color, so no pixel next to it can be found again)
+                    x = visited.NextUnvisited(searched.y, x, searched.x_end);
+                    if (x == searched.x_end || !reader.Match(x))
+                        continue;
+
+                    // The run can continue past the searched pixels on both sides
+                    const Unit x_begin = reader.RunStart(x);
+                    const Unit x_end = reader.RunEnd(x, size.x);
+                    add_run(searched.y, x_begin, x_end);
+                    x = x_end;
+                }
+            }
+
+            // The runs are filled row by row (the order of the search jumps between the rows)
+            std::sort(spans.begin(), spans.end(), [](const RowSpan &a, const RowSpan &b) { return a.y != b.y ? a.y < b.y : a.x_begin < b.x_begin; });
+            return true;
+        }
+
+        /**
+         * @brief Union-find of the runs (the index of a run is its index in the runs of all the strips).
+         *
+         * The root of a set is its smallest run, so the sets of different strips are joined without ranks.
+         *
+         */
+        class RunSets
+        {
+        public:
+            explicit RunSets(size_t count) : parents_(count)
+            {
+                for (size_t i = 0; i < count; i++)
+                    parents_[i] = i;
+            }
+
+            // Root of the set of the run (path halving)
+            size_t Find(size_t run)
+            {
+                while (parents_[run] != run)
+                {
+                    parents_[run] = parents_[parents_[run]];
+                    run = parents_[run];
+                }
+                return run;
+            }
+
+            // Root of the set of the run without changing the sets (can be called by more threads at once)
+            size_t FindConst(size_t run) const
+            {
+                while (parents_[run] != run)
+                    run = parents_[run];
+                return run;
+            }
+
+            void Join(size_t run1, size_t run2)
+            {
+                run1 = Find(run1);
+                run2 = Find(run2);
+                if (run1 < run2)
+                    parents_[run2] = run1;
+                else if (run2 < run1)
+                    parents_[run1] = run2;
+            }
+
+        private:
+            std::vector<size_t> parents_;
+        };
+
+        /**
+         * @brief Runs of the picked color in a strip of rows (see FindRegionParallel()).
+         *
+         */
+        struct Strip
+        {
+            Unit row_begin;
+            Unit row_end;
+            size_t first_run;               // Index of the first run of the strip in RunSets
+            std::vector<RowSpan> runs;      // Runs of all the rows of the strip (sorted)
+            std::vector<size_t> row_runs;   // Index of the first run of each row in runs (and the end of the runs)
+        };
+
+        // Joins the touching runs of 2 neighbouring rows (4-connected: the runs share at least one column)
+        void JoinRows(RunSets &sets, const RowSpan *row1, size_t row1_first, size_t row1_count, const RowSpan *row2, size_t row2_first, size_t row2_count)
+        {
+            for (size_t i = 0, j = 0; i < row1_count && j < row2_count;)
+            {
+                if (row1[i].x_begin < row2[j].x_end && row2[j].x_begin < row1[i].x_end)
+                    sets.Join(row1_first + i, row2_first + j);
+
+                // The run ending first cannot touch any next run of the other row
+                if (row1[i].x_end < row2[j].x_end)
+                    i++;
+                else
+                    j++;
+            }
+        }
+
+        /**
+         * @brief Finds the region by the sets of the runs of all the strips (see FindRegionParallel()).
+         *
+         */
+        template <typename MakeReader>
+        void LabelRegion(MakeReader &&make_reader, Point size, Point seed, std::vector<RowSpan> &spans, unsigned thread_count)
+        {
+            // Strips of whole bands of chunks (a few strips per thread, so the threads finish at about the same time)
+            const Unit bands = (size.y + DataPixels::kTileSizeMask) >> DataPixels::kTileSizeShift;
+            const Unit strip_bands = std::max<Unit>(1, bands / static_cast<Unit>(thread_count * 4));
+            const Unit strip_rows = strip_bands * DataPixels::kTileSize;
+
+            std::vector<Strip> strips;
+            for (Unit y = 0; y < size.y; y += strip_rows)
+                strips.push_back(Strip{y, std::min<Unit>(y + strip_rows, size.y), 0, {}, {}});
+            thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, strips.size()));
+
+            // Find the runs of the picked color in each strip
+            ParallelFor(strips.size(), thread_count, [&](size_t i) {
+                Strip &strip = strips[i];
+                auto reader = make_reader();
+                for (Unit y = strip.row_begin; y < strip.row_end; y++)
+                {
+                    strip.row_runs.push_back(strip.runs.size());
+                    reader.SetRow(y);
+                    for (Unit x = reader.NextMatch(0, size.x); x < size.x; x = reader.NextMatch(x, size.x))
+                    {
+                        const Unit x_end = reader.RunEnd(x, size.x);
+                        strip.runs.push_back(RowSpan{y, x, x_end});
+                        x = x_end;
+                    }
+                }
+                strip.row_runs.push_back(strip.runs.size());
+            });
+
+            size_t run_count = 0;
+            for (Strip &strip : strips)
+            {
+                strip.first_run = run_count;
+                run_count += strip.runs.size();
+            }
+
+            // Join the runs inside of each strip (each strip changes only the sets of its runs)
+            RunSets sets(run_count);
+            auto join_rows = [&sets](const Strip &strip1, Unit y1, const Strip &strip2, Unit y2) {
+                const size_t row1 = strip1.row_runs[y1 - strip1.row_begin], row1_end = strip1.row_runs[y1 - strip1.row_begin + 1];
+                const size_t row2 = strip2.row_runs[y2 - strip2.row_begin], row2_end = strip2.row_runs[y2 - strip2.row_begin + 1];
+                JoinRows(sets, strip1.runs.data() + row1, strip1.first_run + row1, row1_end - row1, strip2.runs.data() + row2, strip2.first_run + row2, row2_end - row2);
+            };
+            ParallelFor(strips.size(), thread_count, [&](size_t i) {
+                for (Unit y = strips[i].row_begin + 1; y < strips[i].row_end; y++)
+                    join_rows(strips[i], y - 1, strips[i], y);
+            });
+
+            // Join the sets across the borders of the strips
+            for (size_t i = 1; i < strips.size(); i++)
+                join_rows(strips[i - 1], strips[i - 1].row_end - 1, strips[i], strips[i].row_begin);
+
+            // The region is the set of the run with the seed
+            const Strip &seed_strip = strips[seed.y / strip_rows];
+            const size_t seed_row = seed_strip.row_runs[seed.y - seed_strip.row_begin];
+            size_t seed_run = seed_row;
+            while (seed_strip.runs[seed_run].x_end <= seed.x)
+                seed_run++;
+            const size_t region = sets.Find(seed_strip.first_run + seed_run);
+
+            // Collect the runs of the region in each strip (in the order of the strips, so they stay sorted)
+            std::vector<std::vector<RowSpan>> strip_spans(strips.size());
+            ParallelFor(strips.size(), thread_count, [&](size_t i) {
+                for (size_t run = 0; run < strips[i].runs.size(); run++)
+                {
+                    if (sets.FindConst(strips[i].first_run + run) == region)
+                        strip_spans[i].push_back(strips[i].runs[run]);
+                }
+            });
+
+            for (const auto &runs : strip_spans)
+                spans.insert(spans.end(), runs.begin(), runs.end());
+        }
+
+        /**
+         * @brief Calls fn with a function creating the reader of the rows of data (one reader for each thread).
+         *
+         */
+        template <typename Function>
+        void DispatchRowReader(DataPixels &data, Point seed, uint8_t tolerance, Function &&fn)
+        {
+            if (tolerance > 0)
+            {
+                fn([&data, seed, tolerance]() { return MatchedRowReader(data, seed, tolerance); });
+                return;
+            }
+
+            if (data.GetLayout() == PixelLayout::kPacked)
+            {
+                fn([&data, seed]() { return PackedRowReader(data, seed); });
+                return;
+            }
+
+            if (data.GetLayout() == PixelLayout::kPlanar)
+            {
+                fn([&data, seed]() { return PlanarRowReader(data, seed); });
+                return;
+            }
+
+            DispatchPixelType(data.GetColorFormat(), [&](auto tag) {
+                using PixelT = typename decltype(tag)::type;
+                fn([&data, seed]() { return PixelRowReader<PixelT>(data, seed); });
+            });
+        }
+    }
+
+    void FindRegion(DataPixels &data, Point seed, std::vector<RowSpan> &spans, uint8_t tolerance, PixelIndex parallel_pixel_count, unsigned thread_count)
+    {
+        spans.clear();
+        const Point size = data.GetSize();
+
+        if (thread_count == 0)
+            thread_count = DefaultThreadCount();
+
+        // A single thread searches the whole region, the parallel search pays off only when it reads less than the region on each thread
+        if (thread_count <= 1)
+            parallel_pixel_count = std::numeric_limits<PixelIndex>::max();
+        else
+            parallel_pixel_count = std::max<PixelIndex>(parallel_pixel_count, static_cast<PixelIndex>(size.x) * size.y / thread_count);
+
+        bool is_found = false;
+        DispatchRowReader(data, seed, tolerance, [&](auto make_reader) {
+            auto reader = make_reader();
+            is_found = SearchRegion(reader, size, seed, spans, parallel_pixel_count);
+        });
+
+        // Huge region is searched again in parallel
+        if (!is_found)
+            FindRegionParallel(data, seed, spans, tolerance, thread_count);
+    }
+
+    void FindRegionParallel(DataPixels &data, Point seed, std::vector<RowSpan> &spans, uint8_t tolerance, unsigned thread_count)
+    {
+        spans.clear();
+        if (thread_count == 0)
+            thread_count = DefaultThreadCount();
+
+        DispatchRowReader(data, seed, tolerance, [&](auto make_reader) {
+            LabelRegion(make_reader, data.GetSize(), seed, spans, thread_count);
+        });
+    }
+}
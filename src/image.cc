@@ -1,11 +1,15 @@
 #include "image.h"
 
 #include <iostream>
+#include <string>
 
 namespace paint
 {
     void Image::DumpImageHistory()
     {
+        // Draw the deferred primitives into the history
+        painter.Flush();
+
         // Clear image_dump dir
         std::filesystem::remove_all("./image_dump");
 
@@ -43,8 +47,39 @@ namespace paint
         image_data_ = save_data;
     }
 
+    void Image::SavePyramid(size_t level_count, const std::filesystem::path &path)
+    {
+        std::vector<std::shared_ptr<DataPixels>> levels = painter.MakePyramid(level_count);
+
+        // Directory or '*' as the name -> the name of the output file
+        std::filesystem::path base_path = path;
+        if (base_path.empty())
+            base_path = file_out_.file_path_;
+        else if (!base_path.has_filename() || base_path.stem().string() == "*")
+            base_path = base_path.parent_path() / file_out_.file_path_.filename();
+
+        auto save_data = image_data_;
+        auto save_file_out = file_out_;
+
+        // Save every level as the image
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            std::filesystem::path level_path = base_path.parent_path();
+            level_path /= base_path.stem().string() + "_" + std::to_string(level + 1) + base_path.extension().string();
+
+            image_data_ = levels[level];
+            SaveImage(level_path);
+        }
+
+        image_data_ = save_data;
+        file_out_ = save_file_out;
+    }
+
     void Image::Undo()
     {
+        // The deferred primitives are the last edit
+        painter.Flush();
+
         // If no image to return to -> nothing to do
         if (image_data_undo_history_.size() == 0)
             return;
@@ -83,6 +118,9 @@ namespace paint
 
     void Image::Redo()
     {
+        // The deferred primitives are the last edit
+        painter.Flush();
+
         // If no image in redo list -> nothing to do
         if (image_data_redo_history_.size() == 0)
             return;
@@ -1,20 +1,38 @@
 //#include "image_bmp.h"
 #include "image_iobmp.h"
 #include "colors.h"
+#include "mapped_file.h"
 
 #include <fstream>
 #include <iostream>
+#include <limits>
 
 namespace paint
 {
     namespace image_bmp
     {
-        void ImageBMP::CreateImage(Point res, [[maybe_unused]] const std::unique_ptr<Color> &color)
+        namespace
+        {
+            // Whether every color of the table is gray with the value of its index times step (the BW or the grayscale table)
+            bool IsGrayRamp(const Palette &table, unsigned step)
+            {
+                for (size_t i = 0; i < table.GetSize(); i++)
+                {
+                    const uint8_t w = static_cast<uint8_t>(i * step);
+                    if (!(table.GetColor(i) == PixelRGB888{w, w, w}))
+                        return false;
+                }
+
+                return true;
+            }
+        }
+
+        void ImageBMP::CreateImage(Point res, const std::unique_ptr<Color> &color)
         {
             header_bmp_info_.bi_width = res.x;
             header_bmp_info_.bi_height = res.y;
-            //TODO: Add support to other types than RGB888.
-            header_bmp_info_.bi_bitCount = BiBitCount::k24bpPX;
+            //TODO: Add support to other types than RGB888 & BGRA8888.
+            header_bmp_info_.bi_bitCount = color && color->GetColorFormat() == ColorFormat::kBGRA8888 ? BiBitCount::k32bpPX : BiBitCount::k24bpPX;
 
             CreateDataBuffer();
             GenerateMetadata();
@@ -48,23 +66,51 @@ namespace paint
                     throw "Invalid file format";
                 }
 
-                if (header_bmp_info_.bi_bitCount != BiBitCount::k24bpPX &&
+                // The dimensions are stored as unsigned in BMP header, but have to fit into Unit
+                if (header_bmp_info_.bi_width > static_cast<uint32_t>(std::numeric_limits<Unit>::max()) ||
+                    header_bmp_info_.bi_height > static_cast<uint32_t>(std::numeric_limits<Unit>::max()))
+                {
+                    std::cerr << "Image dimensions are too large: " << header_bmp_info_.bi_width << "x" << header_bmp_info_.bi_height << std::endl;
+                    throw "Image dimensions are too large";
+                }
+
+                if (header_bmp_info_.bi_bitCount != BiBitCount::k32bpPX &&
+                    header_bmp_info_.bi_bitCount != BiBitCount::k24bpPX &&
                     header_bmp_info_.bi_bitCount != BiBitCount::k16bpPX &&
                     header_bmp_info_.bi_bitCount != BiBitCount::k8bpPX &&
+                    header_bmp_info_.bi_bitCount != BiBitCount::k4bpPX &&
                     header_bmp_info_.bi_bitCount != BiBitCount::k1bpPX)
                 {
-                    std::cerr << "Only RGB888 & RGB565 & Grayscale & BW is implemented!" << std::endl;
-                    throw "Only RGB888 & RGB565 & Grayscale & BW is implemented";
+                    std::cerr << "Only BGRA8888 & RGB888 & RGB565 & Grayscale & BW & indexed color is implemented!" << std::endl;
+                    throw "Only BGRA8888 & RGB888 & RGB565 & Grayscale & BW & indexed color is implemented";
                 }
 
-                // Create data structure for editing the pixels
-                CreateDataBuffer();
+                // Read the colors of indexed pixels
+                ImageIOBMP::ReadColorTable(file, *this);
 
-                // Move to the start of the pixel data
-                file.seekg(header_bmp_.bf_offBits, std::ios_base::beg);
+                // Pixels with size multiple of byte can be used directly from the mapped file (mapped pixels are always linear)
+                bool map_pixels = load_mode_ == LoadMode::kMap && MappedFile::IsSupported() &&
+                                  pixel_layout_.value_or(PixelLayout::kLinear) == PixelLayout::kLinear &&
+                                  (header_bmp_info_.bi_bitCount == BiBitCount::k24bpPX ||
+                                   header_bmp_info_.bi_bitCount == BiBitCount::k16bpPX ||
+                                   header_bmp_info_.bi_bitCount == BiBitCount::k8bpPX);
 
-                // Read the pixel data
-                ImageIOBMP::ReadPixelData(file, *this);
+                if (map_pixels)
+                {
+                    // Use the pixel array of the file as the image data
+                    ImageIOBMP::MapPixelData(*this);
+                }
+                else
+                {
+                    // Create data structure for editing the pixels
+                    CreateDataBuffer();
+
+                    // Move to the start of the pixel data
+                    file.seekg(header_bmp_.bf_offBits, std::ios_base::beg);
+
+                    // Read the pixel data
+                    ImageIOBMP::ReadPixelData(file, *this);
+                }
 
                 // Attach data to the image painter
                 painter.AttachImageData(image_data_);
@@ -81,11 +127,24 @@ namespace paint
 
         void ImageBMP::SaveImage()
         {
+            // Draw the deferred primitives
+            painter.Flush();
+
             // Renew the headers
             GenerateMetadata();
 
             CheckOutputDir();
 
+            // Overwriting the mapped input file would cut the pixels from under the image (and its history)
+            // -> write into temporary file and replace the input file once done, the mapping keeps the old file
+            std::filesystem::path write_path = file_out_.file_path_;
+            bool replace_mapped_file = load_mode_ == LoadMode::kMap &&
+                                       std::filesystem::exists(file_out_.file_path_) &&
+                                       std::filesystem::exists(file_in_.file_path_) &&
+                                       std::filesystem::equivalent(file_out_.file_path_, file_in_.file_path_);
+            if (replace_mapped_file)
+                write_path += ".tmp";
+
             try
             {
                 std::ofstream file;
@@ -94,7 +153,7 @@ namespace paint
                 file.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
                 // Open output file
-                file.open(file_out_.file_path_, std::ios::binary | std::ios::out);
+                file.open(write_path, std::ios::binary | std::ios::out);
 
                 // Write BMP headers
                 ImageIOBMP::WriteHeaderBMP(file, *this);
@@ -104,6 +163,9 @@ namespace paint
                 ImageIOBMP::WritePixelData(file, *this);
 
                 file.close();
+
+                if (replace_mapped_file)
+                    std::filesystem::rename(write_path, file_out_.file_path_);
             }
             catch (const std::ios_base::failure &fail)
             {
@@ -147,7 +209,9 @@ namespace paint
             if (header_bmp_info_.bi_bitCount != BiBitCount::k1bpPX &&
                 header_bmp_info_.bi_bitCount != BiBitCount::k4bpPX &&
                 header_bmp_info_.bi_bitCount != BiBitCount::k8bpPX &&
-                header_bmp_info_.bi_bitCount != BiBitCount::k24bpPX)
+                header_bmp_info_.bi_bitCount != BiBitCount::k16bpPX &&
+                header_bmp_info_.bi_bitCount != BiBitCount::k24bpPX &&
+                header_bmp_info_.bi_bitCount != BiBitCount::k32bpPX)
             {
                 return false;
             }
@@ -172,73 +236,134 @@ namespace paint
             }
 
             // Get the dimensions from BMP header
-            Point image_size{static_cast<int>(header_bmp_info_.bi_width), static_cast<int>(header_bmp_info_.bi_height)};
+            Point image_size{static_cast<Unit>(header_bmp_info_.bi_width), static_cast<Unit>(header_bmp_info_.bi_height)};
 
             // Prepare color
+            std::unique_ptr<Color> color = CreateColorType();
+
+            // BW pixels are stored packed, other large images are stored in tiles
+            PixelLayout layout = PixelLayout::kLinear;
+            if (color->GetColorFormat() == ColorFormat::kBW)
+                layout = PixelLayout::kPacked;
+            else if (static_cast<size_t>(image_size.x) * image_size.y >= kTiledLayoutMinPixels)
+                layout = PixelLayout::kTiled;
+
+            // Requested layout (if it can store the pixels)
+            if (pixel_layout_ && DataPixels::IsLayoutSupported(*pixel_layout_, color->GetColorFormat()))
+                layout = *pixel_layout_;
+
+            // Create new data
+            image_data_ = std::make_shared<DataPixels>(image_size, std::move(color), layout, kRowAlignment);
+        }
+
+        std::unique_ptr<Color> ImageBMP::CreateColorType()
+        {
             std::unique_ptr<Color> color;
 
-            // TODO: Create more colors for BMP
             // Select color based on BMP header
             switch (header_bmp_info_.bi_bitCount)
             {
 
             // Black and white (or mapped color)
             case k1bpPX:
-                color = std::make_unique<ColorBW>(0);
+                if (!color_table_ || IsGrayRamp(*color_table_, 255))
+                    color = std::make_unique<ColorBW>(0);
+                else
+                    color = std::make_unique<ColorPalette>(color_table_);
                 break;
 
+            // Mapped color
             case k4bpPX:
-                std::cerr << "4bpPX color not implemented yet!" << std::endl;
-                throw "4bpPX color not implemented yet.";
+                if (!color_table_)
+                {
+                    std::cerr << "4bpPX image without color table!" << std::endl;
+                    throw "4bpPX image without color table.";
+                }
+                color = std::make_unique<ColorPalette>(color_table_);
                 break;
 
             // Grayscale (or mapped color)
             case k8bpPX:
-                color = std::make_unique<ColorGrayscale>(0);
+                if (!color_table_ || IsGrayRamp(*color_table_, 1))
+                    color = std::make_unique<ColorGrayscale>(0);
+                else
+                    color = std::make_unique<ColorPalette>(color_table_);
                 break;
 
             // RGB565
             case k16bpPX:
-                color = std::make_unique<ColorGrayscale>(0);
+                color = std::make_unique<ColorRGB565>(0, 0, 0);
                 break;
 
             // RGB888
             case k24bpPX:
                 color = std::make_unique<ColorBGR888>(0, 0, 0);
                 break;
+
+            // BGRA8888 (premultiplied in memory)
+            case k32bpPX:
+                color = std::make_unique<ColorBGRA8888>(0, 0, 0, 0);
+                break;
             }
 
-            // Create new data
-            image_data_ = std::make_shared<DataPixels>(image_size, std::move(color));
+            return color;
         }
 
         void ImageBMP::GenerateMetadata()
         {
             // Generate headers from image data
             header_bmp_info_.bi_size = 0x28;
+            header_bmp_info_.bi_planes = kPlanes;
             header_bmp_info_.bi_width = image_data_->GetSize().x;
             header_bmp_info_.bi_height = image_data_->GetSize().y;
             header_bmp_info_.bi_bitCount = image_data_->GetColorType()->GetDataSizeBits();
+
+            // Indexed pixels are saved with as few bits as their palette needs
+            color_table_ = image_data_->GetPalette();
+            if (color_table_)
+            {
+                if (color_table_->GetSize() <= 2)
+                    header_bmp_info_.bi_bitCount = BiBitCount::k1bpPX;
+                else if (color_table_->GetSize() <= 16)
+                    header_bmp_info_.bi_bitCount = BiBitCount::k4bpPX;
+            }
             header_bmp_info_.bi_compression = kBiRGB;
-            header_bmp_info_.bi_sizeImage = (header_bmp_info_.bi_width * header_bmp_info_.bi_bitCount + 31) / 32 * header_bmp_info_.bi_height * 4; // Uncompressed size
+
+            // Uncompressed size (computed in 64 bits, the row size times height overflows 32 bits for large images)
+            uint64_t size_image = (static_cast<uint64_t>(header_bmp_info_.bi_width) * header_bmp_info_.bi_bitCount + 31) / 32 * 4 * header_bmp_info_.bi_height;
+
             header_bmp_info_.bi_clrUsed = 0;
             header_bmp_info_.bi_clrImportant = 0;
 
             size_t color_map_size = 0;
 
             // Only pixel with size less or equal than 8bit use color map
-            switch (header_bmp_info_.bi_bitCount)
+            if (color_table_)
             {
-            case BiBitCount::k1bpPX:
-                color_map_size = sizeof(paint::bw_palette);
-                break;
-            case BiBitCount::k8bpPX:
-                color_map_size = sizeof(paint::grayscale_palette);
-                break;
+                header_bmp_info_.bi_clrUsed = color_table_->GetSize();
+                color_map_size = color_table_->GetSize() * sizeof(PixelBGRA8888);
+            }
+            else
+            {
+                switch (header_bmp_info_.bi_bitCount)
+                {
+                case BiBitCount::k1bpPX:
+                    color_map_size = sizeof(paint::bw_palette);
+                    break;
+                case BiBitCount::k8bpPX:
+                    color_map_size = sizeof(paint::grayscale_palette);
+                    break;
+                }
             }
 
             header_bmp_.bf_type = kBfType;
-            header_bmp_.bf_size = header_bmp_info_.bi_sizeImage + sizeof(HeaderBMP) + sizeof(HeaderBMPInfo) + color_map_size;
+            header_bmp_.bf_reserved1 = 0;
+            header_bmp_.bf_reserved2 = 0;
+            uint64_t file_size = size_image + sizeof(HeaderBMP) + sizeof(HeaderBMPInfo) + color_map_size;
+
+            // Sizes that do not fit into the 32-bit fields are written as 0 (valid for uncompressed pixels, readers use the dimensions)
+            header_bmp_info_.bi_sizeImage = size_image <= std::numeric_limits<uint32_t>::max() ? static_cast<uint32_t>(size_image) : 0;
+            header_bmp_.bf_size = file_size <= std::numeric_limits<uint32_t>::max() ? static_cast<uint32_t>(file_size) : 0;
             header_bmp_.bf_offBits = 0x36 + color_map_size;
         }
     }
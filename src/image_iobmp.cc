@@ -1,7 +1,16 @@
 #include "image_iobmp.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "color_grayscale.h"
 #include "color_bw.h"
+#include "color_palette.h"
+#include "color_bgra8888.h"
+#include "blend.h"
+#include "mapped_file.h"
+#include "packed_bits.h"
+#include "convert_span.h"
 
 namespace paint
 {
@@ -19,83 +28,195 @@ namespace paint
             file.read(reinterpret_cast<char *>(&image.header_bmp_info_), sizeof(HeaderBMPInfo));
         }
 
+        void ImageIOBMP::ReadColorTable(std::ifstream &file, ImageBMP &image)
+        {
+            image.color_table_.reset();
+
+            const size_t bit_count = image.header_bmp_info_.bi_bitCount;
+            if (bit_count > BiBitCount::k8bpPX)
+                return;
+
+            // The table is right after the info header (of any version)
+            const size_t table_offset = sizeof(HeaderBMP) + image.header_bmp_info_.bi_size;
+            if (image.header_bmp_.bf_offBits <= table_offset)
+                return;
+
+            size_t entries = size_t{1} << bit_count;
+            if (image.header_bmp_info_.bi_clrUsed != 0)
+                entries = std::min<size_t>(entries, image.header_bmp_info_.bi_clrUsed);
+            entries = std::min<size_t>(entries, (image.header_bmp_.bf_offBits - table_offset) / sizeof(PixelBGRA8888));
+            if (entries == 0)
+                return;
+
+            std::vector<PixelBGRA8888> table(entries);
+            file.seekg(table_offset, std::ios_base::beg);
+            file.read(reinterpret_cast<char *>(table.data()), entries * sizeof(PixelBGRA8888));
+
+            std::vector<PixelRGB888> colors(entries);
+            for (size_t i = 0; i < entries; i++)
+                colors[i] = PixelRGB888{table[i].r, table[i].g, table[i].b};
+
+            image.color_table_ = std::make_shared<const Palette>(std::move(colors));
+        }
+
         void ImageIOBMP::ReadPixelData(std::ifstream &file, ImageBMP &image)
         {
-            // Calculate the size of pixel data to be loaded
-            size_t data_size = image.header_bmp_info_.bi_sizeImage;
-            if (data_size == 0)
-            {
-                // Size in DWORD (4 bytes)
-                data_size = (image.header_bmp_info_.bi_width * image.header_bmp_info_.bi_bitCount + 31) / 32 * image.header_bmp_info_.bi_height;
-                // Uncompressed size in single bytes
-                data_size = data_size * 4;
-            }
+            DataPixels &data = *image.image_data_;
+            const size_t height = image.header_bmp_info_.bi_height;
+            const size_t width = image.header_bmp_info_.bi_width;
+            const size_t bit_count = image.header_bmp_info_.bi_bitCount;
 
-            // Create pixel data buffer and read pixel data
-            image.unprocessed_data = std::make_unique<uint8_t[]>(data_size);
-            file.read(reinterpret_cast<char *>(image.unprocessed_data.get()), data_size);
+            // Number of bytes in BMP pixel row with padding (rows are aligned to 4 bytes)
+            const size_t bmp_row_stride = (width * bit_count + 31) / 32 * 4;
 
-            // How many bits after 4byte alignment
-            int four_byte_align = (image.header_bmp_info_.bi_bitCount * image.header_bmp_info_.bi_width) % 32;
-            // How many remainning bits to 4byte alignment
-            if (four_byte_align != 0)
+            // 32-bit pixels have straight alpha in the file -> premultiply each row
+            if (bit_count == BiBitCount::k32bpPX)
             {
-                four_byte_align = 32 - four_byte_align;
+                if (data.GetColorFormat() != ColorFormat::kBGRA8888)
+                    throw error_data_mismatch();
 
-                // How many remainning bytes to 4byte alignment, discarding the first incomplete byte, which will be copied when copying by line
-                four_byte_align = four_byte_align / 8;
-            }
+                std::vector<PixelBGRA8888> row(width);
+                const std::streampos pixels_start = file.tellg();
+
+                // BI_RGB files often leave the 4th byte 0 (reserved) -> the pixels are opaque unless any alpha is set
+                bool has_alpha = false;
+                for (size_t y = 0; y < height && !has_alpha; y++)
+                {
+                    file.read(reinterpret_cast<char *>(row.data()), bmp_row_stride);
+                    has_alpha = std::any_of(row.begin(), row.end(), [](const PixelBGRA8888 &p) { return p.a != 0; });
+                }
+
+                file.seekg(pixels_start);
+                for (size_t y = 0; y < height; y++)
+                {
+                    file.read(reinterpret_cast<char *>(row.data()), bmp_row_stride);
 
-            // Number of bytes in pixel row without padding
-            const int data_width_bytes = std::ceil(static_cast<float>(image.header_bmp_info_.bi_width * image.header_bmp_info_.bi_bitCount) / 8);
+                    if (has_alpha)
+                        PremultiplySpan(row.data(), row.data(), width);
+                    else
+                        std::for_each(row.begin(), row.end(), [](PixelBGRA8888 &p) { p.a = 255; });
 
+                    data.CopyRowFrom(y, row.data());
+                }
+            }
             // If pixel is multiple of byte
-            if (image.header_bmp_info_.bi_bitCount == BiBitCount::k24bpPX ||
-                image.header_bmp_info_.bi_bitCount == BiBitCount::k16bpPX ||
-                image.header_bmp_info_.bi_bitCount == BiBitCount::k8bpPX)
+            else if (bit_count == BiBitCount::k24bpPX ||
+                     bit_count == BiBitCount::k16bpPX ||
+                     bit_count == BiBitCount::k8bpPX)
             {
-                // For each row
-                for (size_t y = 0; y < image.header_bmp_info_.bi_height; y++)
+                // Pixels in another format than in the file -> convert each row
+                const ColorFormat file_format = image.CreateColorType()->GetColorFormat();
+                if (data.GetColorFormat() != file_format)
+                {
+                    std::unique_ptr<uint8_t[]> row_buffer = std::make_unique<uint8_t[]>(bmp_row_stride);
+                    std::unique_ptr<uint8_t[]> row = std::make_unique<uint8_t[]>(data.GetRowSize());
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        file.read(reinterpret_cast<char *>(row_buffer.get()), bmp_row_stride);
+                        ConvertSpan(file_format, data.GetColorFormat(), row_buffer.get(), row.get(), width);
+                        data.CopyRowFrom(y, row.get());
+                    }
+                    return;
+                }
+
+                if (data.GetRowSize() != width * bit_count / 8)
+                    throw error_data_mismatch();
+
+                // Linear DataPixels created by CreateDataBuffer() have the same row layout as BMP
+                if (data.GetLayout() == PixelLayout::kLinear)
+                {
+                    if (data.GetRowStride() != bmp_row_stride)
+                        throw error_data_mismatch();
+
+                    // Read the pixel array directly into DataPixels, a whole band of continuous rows at once
+                    for (size_t y = 0; y < height;)
+                    {
+                        size_t rows = data.GetContinuousRows(y);
+                        data.MakeWritable(Point{0, static_cast<Unit>(y)}, Point{data.GetSize().x, static_cast<Unit>(y + rows)});
+                        file.read(reinterpret_cast<char *>(data.RowPtr(y)), bmp_row_stride * rows);
+                        y += rows;
+                    }
+                    return;
+                }
+
+                // Tiled DataPixels -> read row by row and spread each row into the tiles
+                std::unique_ptr<uint8_t[]> row_buffer = std::make_unique<uint8_t[]>(bmp_row_stride);
+                for (size_t y = 0; y < height; y++)
+                {
+                    file.read(reinterpret_cast<char *>(row_buffer.get()), bmp_row_stride);
+                    data.CopyRowFrom(y, row_buffer.get());
+                }
+            }
+            // Packed DataPixels have the same bit order as BMP 1bpp rows -> read each row directly
+            else if (data.GetLayout() == PixelLayout::kPacked)
+            {
+                if (bit_count != BiBitCount::k1bpPX || data.GetRowStride() < bmp_row_stride)
+                    throw error_data_mismatch();
+
+                for (size_t y = 0; y < height; y++)
                 {
-                    // Copy whole row
-                    std::copy_n(reinterpret_cast<uint8_t *>(image.unprocessed_data.get()) + y * data_width_bytes, data_width_bytes, reinterpret_cast<uint8_t *>(image.image_data_->at(0, y)));
+                    data.MakeWritable(Point{0, static_cast<Unit>(y)}, Point{data.GetSize().x, static_cast<Unit>(y + 1)});
+                    uint8_t *row = static_cast<uint8_t *>(data.PackedRowPtr(y));
+                    file.read(reinterpret_cast<char *>(row), bmp_row_stride);
+
+                    // The padding bits of the BMP row are not pixels (kernels expect them to be 0)
+                    FillPackedBits(row, static_cast<Unit>(width), static_cast<Unit>(data.GetRowStride() * 8), false);
                 }
             }
             // Each pixel size is not multiple of byte
             else
             {
+                const uint8_t pixel_mask = (1U << bit_count) - 1; // Mask for the pixel
+                const size_t pixels_per_byte = 8 / bit_count;     // Number of pixels in single byte
+                int shift;                                        // Position of the pixel inside of byte
 
-                const uint8_t pixel_mask = std::pow(2, image.header_bmp_info_.bi_bitCount) - 1; // Mask for the pixel
-                uint8_t mask;                                                                   // Mask shifted to the right position
-                int pos;                                                                        // Position of the byte
-                int pos_in_byte;                                                                // Position of the pixel inside of byte
-                uint8_t pixel;                                                                  // Value of the pixel after applying mask
+                // Buffer for a single row of packed pixels and a single row of unpacked pixels
+                std::unique_ptr<uint8_t[]> row_buffer = std::make_unique<uint8_t[]>(bmp_row_stride);
+                std::unique_ptr<uint8_t[]> row = std::make_unique<uint8_t[]>(width);
 
                 // For each row
-                for (size_t y = 0; y < image.header_bmp_info_.bi_height; y++)
+                for (size_t y = 0; y < height; y++)
                 {
+                    file.read(reinterpret_cast<char *>(row_buffer.get()), bmp_row_stride);
+
                     // For each pixel in row
-                    for (size_t x = 0; x < image.header_bmp_info_.bi_width; x++)
+                    for (size_t x = 0; x < width; x++)
                     {
-                        // Calculate byte position
-                        pos = x / (8 / image.header_bmp_info_.bi_bitCount);
-                        // Calculate starting position of pixel inside byte
-                        pos_in_byte = x % (8 / image.header_bmp_info_.bi_bitCount);
-                        // Shift the mask
-                        mask = pixel_mask << ((8 - image.header_bmp_info_.bi_bitCount) - pos_in_byte * image.header_bmp_info_.bi_bitCount);
-                        // Get the value
-                        pixel = image.unprocessed_data.get()[y * (data_width_bytes + four_byte_align) + pos] & mask;
-                        // Normalize the pixel
-                        pixel = pixel >> ((8 - image.header_bmp_info_.bi_bitCount) - pos_in_byte * image.header_bmp_info_.bi_bitCount);
+                        // The first pixel is in the most significant bits
+                        shift = (8 - bit_count) - (x % pixels_per_byte) * bit_count;
 
                         // Set the value in data at (x, y)
-                        *reinterpret_cast<uint8_t *>(image.image_data_->at(x, y)) = pixel;
+                        row[x] = (row_buffer[x / pixels_per_byte] >> shift) & pixel_mask;
                     }
+
+                    data.CopyRowFrom(y, row.get());
                 }
             }
+        }
+
+        void ImageIOBMP::MapPixelData(ImageBMP &image)
+        {
+            const size_t height = image.header_bmp_info_.bi_height;
+            const size_t width = image.header_bmp_info_.bi_width;
+            const size_t bit_count = image.header_bmp_info_.bi_bitCount;
+
+            // Number of bytes in BMP pixel row with padding (rows are aligned to 4 bytes)
+            const size_t bmp_row_stride = (width * bit_count + 31) / 32 * 4;
 
-            // Free copied data
-            delete[] image.unprocessed_data.release();
+            auto mapped_file = std::make_shared<MappedFile>(image.file_in_.file_path_);
+
+            // The whole pixel array has to be in the file
+            if (mapped_file->GetSize() < image.header_bmp_.bf_offBits + bmp_row_stride * height)
+                throw std::ios_base::failure("BMP pixel data is outside of the file: " + image.file_in_.file_path_.string());
+
+            // The pixel data keeps the mapping alive
+            std::shared_ptr<const uint8_t> pixel_data(mapped_file, mapped_file->GetData() + image.header_bmp_.bf_offBits);
+
+            Point image_size{static_cast<Unit>(width), static_cast<Unit>(height)};
+            image.image_data_ = std::make_shared<DataPixels>(image_size, image.CreateColorType(), std::move(pixel_data), kRowAlignment);
+
+            if (image.image_data_->GetRowStride() != bmp_row_stride)
+                throw error_data_mismatch();
         }
 
         void ImageIOBMP::WriteHeaderBMP(std::ofstream &file, ImageBMP &image)
@@ -112,6 +233,17 @@ namespace paint
 
         void ImageIOBMP::WriteColorTable(std::ofstream &file, ImageBMP &image)
         {
+            // Palette of indexed image
+            if (image.color_table_)
+            {
+                for (const PixelRGB888 &color : image.color_table_->GetColors())
+                {
+                    const PixelBGRA8888 entry{color.b, color.g, color.r, 0};
+                    file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+                }
+                return;
+            }
+
             switch (image.header_bmp_info_.bi_bitCount)
             {
             case BiBitCount::k1bpPX:
@@ -129,85 +261,97 @@ namespace paint
             // Write the color table
             WriteColorTable(file, image);
 
-            // How many bits after 4byte alignment
-            int four_byte_align = (image.header_bmp_info_.bi_bitCount * image.header_bmp_info_.bi_width) % 32;
-            // How many remainning bits to 4byte alignment
-            if (four_byte_align != 0)
-            {
-                four_byte_align = 32 - four_byte_align;
-
-                // How many remainning bytes to 4byte alignment, discarding the first incomplete byte, which will be copied when copying by line
-                four_byte_align = four_byte_align / 8;
-            }
-
-            // Number of bytes in pixel row without padding
-            const int data_width_bytes = std::ceil(static_cast<float>(image.header_bmp_info_.bi_width * image.header_bmp_info_.bi_bitCount) / 8);
+            DataPixels &data = *image.image_data_;
+            const size_t height = image.header_bmp_info_.bi_height;
+            const size_t width = image.header_bmp_info_.bi_width;
+            const size_t bit_count = image.header_bmp_info_.bi_bitCount;
 
-            // Just bunch of 0's used for padding the row
-            const int padding = 0;
+            // Number of bytes in BMP pixel row with padding (rows are aligned to 4 bytes)
+            const size_t bmp_row_stride = (width * bit_count + 31) / 32 * 4;
 
+            // 32-bit pixels are stored with straight alpha -> unpremultiply each row
+            if (bit_count == BiBitCount::k32bpPX)
+            {
+                std::vector<PixelBGRA8888> row(width);
+                for (size_t y = 0; y < height; y++)
+                {
+                    data.ConvertRowTo(y, ColorFormat::kBGRA8888, row.data());
+                    UnpremultiplySpan(row.data(), row.data(), width);
+                    file.write(reinterpret_cast<const char *>(row.data()), bmp_row_stride);
+                }
+            }
             // If pixel is multiple of byte
-            if (image.header_bmp_info_.bi_bitCount == BiBitCount::k24bpPX ||
-                image.header_bmp_info_.bi_bitCount == BiBitCount::k16bpPX ||
-                image.header_bmp_info_.bi_bitCount == BiBitCount::k8bpPX)
+            else if (bit_count == BiBitCount::k24bpPX ||
+                     bit_count == BiBitCount::k16bpPX ||
+                     bit_count == BiBitCount::k8bpPX)
             {
-                for (size_t y = 0; y < image.header_bmp_info_.bi_height; y++)
+                // Pixels in another format than in the file (i.e. RGB888 is stored as BGR888) -> convert each row
+                const ColorFormat file_format = image.CreateColorType()->GetColorFormat();
+                if (data.GetColorFormat() != file_format)
                 {
-                    file.write(reinterpret_cast<char *>((*image.image_data_)[y * image.header_bmp_info_.bi_width]), data_width_bytes);
+                    std::unique_ptr<uint8_t[]> row_buffer = std::make_unique<uint8_t[]>(bmp_row_stride);
+                    std::fill_n(row_buffer.get(), bmp_row_stride, 0);
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        data.ConvertRowTo(y, file_format, row_buffer.get());
+                        file.write(reinterpret_cast<const char *>(row_buffer.get()), bmp_row_stride);
+                    }
+                    return;
+                }
 
-                    if (four_byte_align)
+                // Same row layout as BMP (padding is always 0) -> write a whole band of continuous rows at once
+                if (data.GetLayout() == PixelLayout::kLinear && data.GetRowStride() == bmp_row_stride)
+                {
+                    for (size_t y = 0; y < height;)
                     {
-                        file.write(reinterpret_cast<const char *>(&padding), four_byte_align);
+                        size_t rows = data.GetContinuousRows(y);
+                        file.write(reinterpret_cast<const char *>(data.RowPtr(y)), bmp_row_stride * rows);
+                        y += rows;
                     }
+                    return;
+                }
+
+                // Different layout -> gather each row with BMP padding
+                std::unique_ptr<uint8_t[]> row_buffer = std::make_unique<uint8_t[]>(bmp_row_stride);
+                std::fill_n(row_buffer.get(), bmp_row_stride, 0);
+                for (size_t y = 0; y < height; y++)
+                {
+                    data.CopyRowTo(y, row_buffer.get());
+                    file.write(reinterpret_cast<const char *>(row_buffer.get()), bmp_row_stride);
                 }
             }
             else
             {
-                size_t colors_per_byte = 8 / image.header_bmp_info_.bi_bitCount;
+                // Packed rows are BMP rows (the bits after the last pixel are always 0)
+                if (data.GetLayout() == PixelLayout::kPacked && data.GetRowStride() >= bmp_row_stride)
+                {
+                    for (size_t y = 0; y < height; y++)
+                        file.write(reinterpret_cast<const char *>(data.PackedRowPtr(y)), bmp_row_stride);
+                    return;
+                }
+
+                const ColorFormat file_format = image.CreateColorType()->GetColorFormat();
+                const uint8_t pixel_mask = (1U << bit_count) - 1; // Mask for the pixel
+                const size_t pixels_per_byte = 8 / bit_count;     // Number of pixels in single byte
+
+                // Buffer for a single row of packed pixels (padding included) and a single row of unpacked pixels
+                std::unique_ptr<uint8_t[]> row_buffer = std::make_unique<uint8_t[]>(bmp_row_stride);
+                std::unique_ptr<uint8_t[]> row = std::make_unique<uint8_t[]>(width);
 
-                char data_byte = 0;
                 // For each line
-                for (size_t y = 0; y < image.header_bmp_info_.bi_height; y++)
+                for (size_t y = 0; y < height; y++)
                 {
-                    // For each byte in line
-                    for (int x = 0; x < data_width_bytes; x++)
-                    {
-                        // Clear compressed data_byte
-                        data_byte = 0;
-
-                        for (size_t i = 0; i < colors_per_byte; i++)
-                        {
-                            // Set bits in data_byte
-                            int idx = y * image.header_bmp_info_.bi_width + x * 8 + i;
-                            int shift = (colors_per_byte - i - 1) * image.header_bmp_info_.bi_bitCount;
-                            unsigned char val;
-                            if (image.header_bmp_info_.bi_bitCount == BiBitCount::k1bpPX)
-                            {
-                                val = (*reinterpret_cast<const PixelBW *>((*image.image_data_)[idx])).w;
-                            }
-                            else
-                            {
-                                throw "todo BiBitCount::k4bpPX"; // not done
-                            }
-
-                            data_byte |= val << shift;
-
-                            // data_byte |= (*reinterpret_cast<const char *>((*image.image_data_)[y * image.header_bmp_info_.bi_width + x * 8 + i])) << (i * image.header_bmp_info_.bi_bitCount);
-                        }
-
-                        // Write the single compressed byte;
-                        file.write(&data_byte, 1);
-                    }
+                    std::fill_n(row_buffer.get(), bmp_row_stride, 0);
+                    data.ConvertRowTo(y, file_format, row.get());
 
-                    // Add padding at the end of line
-                    if (four_byte_align)
-                    {
-                        file.write(reinterpret_cast<const char *>(&padding), four_byte_align);
-                    }
-                }
+                    // Pack the pixels into bytes, the first pixel is in the most significant bits
+                    for (size_t x = 0; x < width; x++)
+                        row_buffer[x / pixels_per_byte] |= (row[x] & pixel_mask) << ((8 - bit_count) - (x % pixels_per_byte) * bit_count);
 
-                // throw "TODO BMP BiBitCount::k1bpPX && BiBitCount::k4bpPX support";
+                    // Write the packed line with padding
+                    file.write(reinterpret_cast<const char *>(row_buffer.get()), bmp_row_stride);
+                }
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,62 @@
+#include "mapped_file.h"
+
+#include <ios>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PAINT_HAS_MMAP 1
+#else
+#define PAINT_HAS_MMAP 0
+#endif
+
+namespace paint
+{
+#if PAINT_HAS_MMAP
+    MappedFile::MappedFile(const std::filesystem::path &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::ios_base::failure("Could not open file for mapping: " + path.string());
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+        {
+            close(fd);
+            throw std::ios_base::failure("Could not map empty file: " + path.string());
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+
+        void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        // The mapping stays valid after closing the file
+        close(fd);
+
+        if (data == MAP_FAILED)
+            throw std::ios_base::failure("Could not map file: " + path.string());
+
+        // The pixels are going to be read from start to end
+        madvise(data, size_, MADV_SEQUENTIAL);
+
+        data_ = static_cast<const uint8_t *>(data);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        munmap(const_cast<uint8_t *>(data_), size_);
+    }
+
+    bool MappedFile::IsSupported() { return true; }
+#else
+    MappedFile::MappedFile(const std::filesystem::path &path)
+    {
+        throw std::ios_base::failure("Memory mapped files are not supported: " + path.string());
+    }
+
+    MappedFile::~MappedFile() {}
+
+    bool MappedFile::IsSupported() { return false; }
+#endif
+}
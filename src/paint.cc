@@ -53,32 +53,54 @@ namespace paint
 
         LOAD ./folder/filename.bmp or LOAD ./folder/*.bmp
         SAVE ./folder/filename.bmp or SAVE ./folder/*.bmp
+        PYRAMID levels [./folder/filename.bmp or ./folder/*.bmp]
         
-        COLOR r g b
+        COLOR r g b [a]
         
         LINE %|PX x1 y1 x2 y2 {
                                width: number,
-                               color: {r: number, g: number, b: number}
+                               color: {r: number, g: number, b: number[, a: number]},
+                               antialias: bool
                                }
         
         CIRCLE %|PX x1 y1 radius {
                                   fill: bool,
-                                  fill-color: {r: number, g: number, b: number},
-                                  border-color: {r: number, g: number, b: number},
+                                  fill-color: {r: number, g: number, b: number[, a: number]},
+                                  border-color: {r: number, g: number, b: number[, a: number]},
                                   border-width: number
                                   }
         
         BUCKET %|PX x1 y1 {
-                           color: {r: number, g: number, b: number
+                           color: {r: number, g: number, b: number[, a: number]},
+                           tolerance: number (0 - 255)
                            }
+
+        REPLACECOLOR r g b {
+                            color: {r: number, g: number, b: number[, a: number]},
+                            tolerance: number (0 - 255)
+                            }
         
-        RESIZE %|PX width height
+        RESIZE %|PX width height {
+                                  filter: box|bilinear|bicubic|lanczos3
+                                  }
         
         ROTATE CLOCK|COUNTERCLOCK
 
+        OVERLAY %|PX x y ./folder/overlay.bmp
+
         INVERTCOLORS
         GRAYSCALE
 
+        DITHER BW|RGB565 {
+                          method: bayer|floyd-steinberg|atkinson
+                          }
+
+        LINEARLIGHT ON|OFF
+        DEFER ON|OFF
+        PARALLELFILL pixels
+
+        QUANTIZE colors (1 - 256)
+
         CROP %|PX x1 y1 x2 y2
 
         UNDO
@@ -169,6 +191,8 @@ To view help write -h or --help, to quit write q
         }
 
         image_ = CreateImageByExtension(load_command->FilePath());
+        image_->SetLoadMode(load_command->GetLoadMode());
+        image_->SetPixelLayout(load_command->GetPixelLayout());
         image_->LoadImage();
 
         std::for_each(++commands_.begin(), commands_.end(), [this](auto &command) {
@@ -261,6 +285,35 @@ To view help write -h or --help, to quit write q
             return;
         }
 
+        // Load, edit and release one image at a time, so the pixel buffers of the previous image are reused (see BufferPool)
+        LoadMode load_mode = load_command->GetLoadMode();
+        std::optional<PixelLayout> pixel_layout = load_command->GetPixelLayout();
+        auto process_image = [this, load_mode, pixel_layout](const std::filesystem::path &path) {
+            std::unique_ptr<Image> img;
+
+            // Try reading the file
+            try
+            {
+                img = CreateImageByExtension(path);
+                img->SetLoadMode(load_mode);
+                img->SetPixelLayout(pixel_layout);
+                img->LoadImage();
+            }
+            // Unknown file -> do nothing
+            catch (const unknown_file_error &e)
+            {
+                return;
+            }
+
+            // Run each command.
+            std::for_each(++commands_.begin(), commands_.end(), [&img](auto &command) {
+                command->Invoke(*img);
+            });
+        };
+
+        // The images are listed before any is edited, so the saved images are not loaded again from the same directory
+        std::vector<std::filesystem::path> image_paths;
+
         // Check file type
         auto file_path = load_command->FilePath();
         auto file_ext = file_path.extension();
@@ -274,55 +327,19 @@ To view help write -h or --help, to quit write q
 
             for (auto &dir_entry : std::filesystem::directory_iterator(file_path))
             {
-                // Try reading all files
-                try
-                {
-                    if (dir_entry.path().extension() == file_ext && dir_entry.is_regular_file())
-                    {
-                        auto img = CreateImageByExtension(dir_entry.path());
-                        img->LoadImage();
-                        images_.emplace_back(std::move(img));
-                    }
-                }
-                // Unknown file -> do nothing
-                catch (const unknown_file_error &e)
-                {
-                    // Do nothing
-                }
+                if (dir_entry.path().extension() == file_ext && dir_entry.is_regular_file())
+                    image_paths.push_back(dir_entry.path());
             }
         }
         // LOAD command does not have any filename -> load all supported files in directory, not only specified format
         else
         {
             for (auto &dir_entry : std::filesystem::directory_iterator(file_path))
-            {
-                // Try reading all files
-                try
-                {
-                    auto img = CreateImageByExtension(dir_entry.path());
-                    img->LoadImage();
-                    images_.emplace_back(std::move(img));
-                }
-                // Unknown file -> do nothing
-                catch (const unknown_file_error &e)
-                {
-                    // Do nothing
-                }
-            }
+                image_paths.push_back(dir_entry.path());
         }
 
-        if (commands_.empty())
-        {
-            std::cerr << "PaintFile::Run - No commands to apply." << std::endl;
-            return;
-        }
-
-        // Run each command.
-        std::for_each(images_.begin(), images_.end(), [this](auto &img) {
-            std::for_each(++commands_.begin(), commands_.end(), [&img](auto &command) {
-                command->Invoke(*img);
-            });
-        });
+        for (const auto &path : image_paths)
+            process_image(path);
     }
 
     //---------------PaintFile--------------
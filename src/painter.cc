@@ -1,22 +1,242 @@
 #include "painter.h"
 #include "color_grayscale.h"
 #include "color_bw.h"
+#include "color_rgb565.h"
+#include "color_palette.h"
+#include "color_bgra8888.h"
+#include "blend.h"
+#include "row_blender.h"
+#include "draw_batch.h"
+#include "flood_fill.h"
+#include "color_match.h"
+#include "resample.h"
+#include "parallel.h"
+#include "raster.h"
+#include "data_pixels_view.h"
+#include "packed_bits.h"
+#include "convert_span.h"
+#include "srgb.h"
+#include "palette.h"
 #include "unit.h"
 #include "vec.h"
 
-#include <set>
-#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
 #include <iostream>
+#include <type_traits>
 
 namespace paint
 {
+    namespace
+    {
+        /**
+         * @brief Rotates packed data into new_data (with swapped dimensions) by 8x8 blocks of bits.
+         * 
+         * 8 rows of old data are read a byte at a time, the transposed block is written as a byte into 8 new rows.
+         * 
+         * @param clock_bottom_up clockwise rotation of 'bottom up' images (counter clockwise rotation of the stored rows).
+         */
+        void RotatePacked(DataPixels &data, DataPixels &new_data, bool clock_bottom_up)
+        {
+            Point size = data.GetSize();
+
+            for (Unit block_y = 0; block_y < (size.y + 7) / 8; block_y++)
+            {
+                // Old rows of the block in the order of the pixels in the new rows (rows outside of the image are 0)
+                const uint8_t *rows[8];
+                for (Unit i = 0; i < 8; i++)
+                {
+                    Unit y = block_y * 8 + i;
+                    rows[i] = y < size.y ? static_cast<const uint8_t *>(data.PackedRowPtr(clock_bottom_up ? size.y - 1 - y : y)) : nullptr;
+                }
+
+                for (Unit block_x = 0; block_x < (size.x + 7) / 8; block_x++)
+                {
+                    uint64_t block = 0;
+                    for (Unit i = 0; i < 8; i++)
+                        block = (block << 8) | (rows[i] ? rows[i][block_x] : 0);
+
+                    // Each column of the block is a byte of a new row
+                    uint64_t columns = TransposePackedBlock(block);
+                    for (Unit j = 0; j < 8 && block_x * 8 + j < size.x; j++)
+                    {
+                        Unit x = block_x * 8 + j;
+                        Unit new_y = clock_bottom_up ? x : size.x - 1 - x;
+                        static_cast<uint8_t *>(new_data.PackedRowPtr(new_y))[block_y] = static_cast<uint8_t>(columns >> (56 - 8 * j));
+                    }
+                }
+            }
+        }
+
+        // Interpolates the decoded row horizontally into the columns of the new row (the same rounding as LerpLinearSpan())
+        template <size_t kChannels>
+        void LerpLinearRow(const uint16_t *row, const std::vector<size_t> &left, const std::vector<size_t> &right,
+                           const std::vector<int32_t> &weight_right, uint16_t *new_row)
+        {
+            for (size_t x = 0; x < left.size(); x++)
+            {
+                for (size_t c = 0; c < kChannels; c++)
+                {
+                    const int32_t a = row[left[x] + c];
+                    const int32_t b = row[right[x] + c];
+                    new_row[x * kChannels + c] = static_cast<uint16_t>(a + (((b - a) * weight_right[x] + (1 << (kLerpWeightBits - 1))) >> kLerpWeightBits));
+                }
+            }
+        }
+
+        /**
+         * @brief Resizes the data into new_data with bilinear interpolation of the linear light.
+         * 
+         * The samples are taken at the same positions as Painter::Resize() takes them.
+         * The new rows go down the image, so only the 2 source rows of the current new row are kept: each source row is decoded
+         * into 16-bit linear channels (24-bit color or grayscale) and interpolated horizontally once, the new row is interpolated
+         * between the 2 rows by LerpLinearSpan() and encoded. The weights are in fixed point.
+         * 
+         */
+        void ResizeLinearLight(DataPixels &data, DataPixels &new_data)
+        {
+            const ColorFormat format = data.GetColorFormat();
+            const ColorFormat work_format = format == ColorFormat::kGrayscale ? ColorFormat::kGrayscale : ColorFormat::kRGB888;
+            const size_t channels = PixelSize(work_format);
+            const Point size = data.GetSize();
+            const Point new_size = new_data.GetSize();
+
+            vec2f multiplier{static_cast<float>(size.x) / static_cast<float>(new_size.x),
+                             static_cast<float>(size.y) / static_cast<float>(new_size.y)};
+
+            // Every row samples the same columns
+            std::vector<size_t> left(new_size.x);
+            std::vector<size_t> right(new_size.x);
+            std::vector<int32_t> weight_right(new_size.x);
+            for (Unit x = 0; x < new_size.x; x++)
+            {
+                float u = x * multiplier.u;
+                Unit p_left = std::floor(u);
+                left[x] = p_left * channels;
+                right[x] = std::min(static_cast<Unit>(std::ceil(u)), size.x - 1) * channels;
+                weight_right[x] = static_cast<int32_t>(std::lround((u - p_left) * (1 << kLerpWeightBits)));
+            }
+
+            const size_t new_row_samples = new_size.x * channels;
+            std::vector<uint8_t> work_row(std::max(size.x, new_size.x) * channels);
+            std::vector<uint16_t> linear_row(size.x * channels);
+            std::vector<uint16_t> new_linear(new_row_samples);
+            std::vector<uint8_t> new_row(new_data.GetRowSize());
+
+            // The horizontally interpolated source rows (the top and bottom rows of the current new row)
+            std::vector<uint16_t> rows[2] = {std::vector<uint16_t>(new_row_samples), std::vector<uint16_t>(new_row_samples)};
+            Unit row_y[2] = {-1, -1};
+            auto source_row = [&](Unit y, Unit keep_y) -> const uint16_t * {
+                for (size_t i = 0; i < 2; i++)
+                    if (row_y[i] == y)
+                        return rows[i].data();
+
+                const size_t slot = row_y[0] == keep_y ? 1 : 0;
+                data.ConvertRowTo(y, work_format, work_row.data());
+                SrgbToLinearSpan(work_row.data(), linear_row.data(), linear_row.size());
+                if (channels == 1)
+                    LerpLinearRow<1>(linear_row.data(), left, right, weight_right, rows[slot].data());
+                else
+                    LerpLinearRow<3>(linear_row.data(), left, right, weight_right, rows[slot].data());
+
+                row_y[slot] = y;
+                return rows[slot].data();
+            };
+
+            for (Unit y = 0; y < new_size.y; y++)
+            {
+                float v = y * multiplier.v;
+                Unit p_top = std::floor(v);
+                Unit p_bottom = std::min(static_cast<Unit>(std::ceil(v)), size.y - 1);
+                const int32_t weight_bottom = static_cast<int32_t>(std::lround((v - p_top) * (1 << kLerpWeightBits)));
+                const uint16_t *top = source_row(p_top, p_bottom);
+                const uint16_t *bottom = source_row(p_bottom, p_top);
+
+                LerpLinearSpan(top, bottom, weight_bottom, new_linear.data(), new_row_samples);
+
+                LinearToSrgbSpan(new_linear.data(), work_row.data(), new_row_samples);
+                ConvertSpan(work_format, format, work_row.data(), new_row.data(), new_size.x);
+                new_data.CopyRowFrom(y, new_row.data());
+            }
+        }
+
+        /**
+         * @brief Converts the color data to grayscale data with the luminance of the linear light.
+         * 
+         * 24-bit color rows of the linear layout are read in place, other rows are converted into RGB888 first (one row at a time).
+         * 
+         */
+        void ConvertToGrayscaleLinearLight(DataPixels &data)
+        {
+            const Point size = data.GetSize();
+            const ColorFormat format = data.GetColorFormat();
+            const PixelLayout layout = DataPixels::IsLayoutSupported(data.GetLayout(), ColorFormat::kGrayscale) ? data.GetLayout() : PixelLayout::kLinear;
+            DataPixels new_data(size, std::unique_ptr<Color>(new ColorGrayscale(0)), layout, data.GetRowAlignment());
+
+            const bool is_888 = format == ColorFormat::kRGB888 || format == ColorFormat::kBGR888;
+            const bool read_in_place = is_888 && data.GetLayout() == PixelLayout::kLinear;
+            const bool write_in_place = new_data.GetLayout() == PixelLayout::kLinear;
+            const ColorFormat src_format = is_888 ? format : ColorFormat::kRGB888;
+
+            std::vector<uint8_t> color_row(read_in_place ? 0 : size.x * PixelSize(src_format));
+            std::vector<uint8_t> gray_row(write_in_place ? 0 : new_data.GetRowSize());
+
+            for (Unit y = 0; y < size.y; y++)
+            {
+                const uint8_t *src = color_row.data();
+                if (read_in_place)
+                    src = static_cast<const uint8_t *>(data.RowPtr(y));
+                else
+                    data.ConvertRowTo(y, src_format, color_row.data());
+
+                uint8_t *dst = write_in_place ? static_cast<uint8_t *>(new_data.RowPtr(y)) : gray_row.data();
+                LinearLuminanceSpan(src_format, src, dst, size.x);
+                if (!write_in_place)
+                    new_data.CopyRowFrom(y, gray_row.data());
+            }
+
+            data.SwapData(new_data);
+        }
+    }
+
     void Painter::SetNextColor(const std::shared_ptr<Color> &color)
     {
-        next_command_color_->SetColor(*color);
+        // A copy of the color keeps its alpha
+        next_command_color_ = std::shared_ptr<Color>(color->clone());
+    }
+
+    void Painter::SetDeferredDrawing(bool deferred_drawing)
+    {
+        if (!deferred_drawing)
+            Flush();
+
+        deferred_drawing_ = deferred_drawing;
+    }
+
+    void Painter::Flush()
+    {
+        if (deferred_.IsEmpty())
+            return;
+
+        if (image_data_.expired())
+        {
+            deferred_.Clear();
+            return;
+        }
+
+        deferred_.Render(*image_data_.lock());
+
+        // Call back that image was edited (one history step for the whole batch)
+        image_edit_callback_();
     }
 
     void Painter::ClearImage(const std::optional<std::shared_ptr<Color>> &clear_color)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         std::shared_ptr<Color> color = clear_color.value_or(std::make_shared<ColorRGB888>(255, 255, 255));
 
         if (image_data_.expired())
@@ -28,22 +248,51 @@ namespace paint
         // Lock the image data
         std::shared_ptr<DataPixels> dp = image_data_.lock();
 
-        // Init color
-        auto fill_color = dp->GetColorType();
-        fill_color->SetColor(*clear_color.value_or(next_command_color_));
-        auto fill_color_data = reinterpret_cast<uint8_t *>(fill_color->GetData());
-        auto fill_color_data_size = fill_color->GetDataSize();
+        // The pixels are changed in place -> copy shared data first
+        dp->MakeWritable();
 
-        for (auto data_it : *dp)
+        // Translucent color is blended over every row
+        if (auto translucent = TranslucentPixel(*clear_color.value_or(next_command_color_)))
         {
-            std::copy_n(fill_color_data, fill_color_data_size, reinterpret_cast<uint8_t *>(data_it));
+            RowBlender blender(*dp);
+            for (Unit y = 0; y < dp->image_size_.y; y++)
+                blender.BlendColor(y, 0, dp->image_size_.x, *translucent);
+            return;
         }
+
+        DispatchPixelType(dp->GetColorFormat(), [&](auto tag) {
+            using PixelT = typename decltype(tag)::type;
+
+            // Init color
+            const PixelT fill_pixel = DataPixelFromColor<PixelT>(*dp, *clear_color.value_or(next_command_color_));
+
+            // Packed BW pixels are filled by whole words
+            if constexpr (std::is_same_v<PixelT, PixelBW>)
+            {
+                if (dp->GetLayout() == PixelLayout::kPacked)
+                {
+                    for (Unit y = 0; y < dp->image_size_.y; y++)
+                        FillPackedBits(static_cast<uint8_t *>(dp->PackedRowPtr(y)), 0, dp->image_size_.x, fill_pixel.w);
+                    return;
+                }
+            }
+
+            // Fill the whole pixels (or each plane with its byte of the pixel)
+            DispatchChannelViews(*dp, [&](auto view, size_t plane) {
+                using ChannelT = typename decltype(view)::pixel_type;
+                const ChannelT fill_channel = GetChannelPixel<ChannelT>(fill_pixel, plane);
+
+                for (Unit y = 0; y < view.Height(); y++)
+                    view.FillRow(y, 0, view.Width(), fill_channel);
+            });
+        });
     }
 
     void Painter::DrawLine(const BasePoint &start,
                            const BasePoint &end,
                            const std::optional<std::shared_ptr<Color>> &line_color_,
-                           const std::optional<Unit> &line_width_)
+                           const std::optional<Unit> &line_width_,
+                           bool antialias)
     {
         if (image_data_.expired())
         {
@@ -54,10 +303,9 @@ namespace paint
         // Lock the image data
         std::shared_ptr<DataPixels> dp = image_data_.lock();
 
-        // Get line points and width
+        // Get line points
         Point l_start = start.GetPointPX(dp->image_size_);
         Point l_end = end.GetPointPX(dp->image_size_);
-        float l_width_half = line_width_.value_or(1) / 2.0f;
 
         // If image data is horizontaly mirrored -> flip line horizontaly
         if (draw_bottom_up_)
@@ -66,67 +314,16 @@ namespace paint
             l_end = Point{l_end.x, dp->image_size_.y - l_end.y};
         }
 
-        // Init Color
-        auto l_color = dp->GetColorType();
-        l_color->SetColor(*line_color_.value_or(next_command_color_));
-
-        //TODO: reverse the vector if it is in direction of [-1,-1]. It would break the algorithm if THE loop
-        //      or do some checks/swaps in the loop
-        // Calculate parameters of line equations
-        line t{static_cast<float>(l_start.y - l_end.y),
-               static_cast<float>(l_end.x - l_start.x),
-               static_cast<float>(l_start.x * l_end.y - l_start.y * l_end.x)};
-
-        // Create 2 parallel lines with distance of 1/2 l_width
-        // Point (x, y + l_width_half)
-        line t1(t);
-        t1.c -= t1.b * l_width_half;
+        LinePrimitive line(*dp, l_start, l_end, line_width_.value_or(1), antialias, *line_color_.value_or(next_command_color_));
 
-        // Point (x, y - l_width_half)
-        line t2(t);
-        t2.c += t2.b * l_width_half;
-
-        vec2 size{dp->image_size_.x, dp->image_size_.y};
-        vec2 y_bounds; // u is upper bound v is lower bound
-
-        // Set start and end x coordinates
-        int x = l_start.x;
-        int x_end = l_end.x;
-
-        // Set x to be on the left
-        if (x > x_end)
+        // Deferred line is drawn by Painter::Flush()
+        if (deferred_drawing_)
         {
-            std::swap(x, x_end);
+            deferred_.Add(line);
+            return;
         }
 
-        // Check bounds of left (starting) x
-        if (x < 0)
-            x = 0;
-
-        // Check bounds of right (ending) x
-        if (x_end > size.u)
-            x_end = size.u;
-
-        // For each x fill calculated y points
-        for (; x < x_end; x += 1)
-        {
-            y_bounds.u = std::round(line_get_y(t1, x));
-            y_bounds.v = std::round(line_get_y(t2, x));
-
-            // Check bounds of max (top) y
-            if (y_bounds.u > size.v)
-                y_bounds.u = size.v;
-
-            // Check bounds of min (bottom) y
-            if (y_bounds.v < 0)
-                y_bounds.v = 0;
-
-            for (Unit y = y_bounds.v; y <= y_bounds.u && y < size.v; y++)
-            {
-                // line n{-t.a, t.b, 0.0f}; // Check distance (line_intersection & norm)
-                std::copy_n(reinterpret_cast<uint8_t *>(l_color->GetData()), l_color->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[y * size.u + x]));
-            }
-        }
+        PrimitiveRenderer(*dp, true).Draw(line);
 
         // Call back that image was edited
         image_edit_callback_();
@@ -144,168 +341,185 @@ namespace paint
 
         // Lock the image data
         std::shared_ptr<DataPixels> dp = image_data_.lock();
-        Point image_size = dp->image_size_;
 
-        // Get parameters
-        Point cen = center.GetPointPX(image_size);
-        Unit border_w = border_width.value_or(1);
+        // Get circle center
+        Point cen = center.GetPointPX(dp->image_size_);
 
-        // If image data is horizontaly mirrored -> flip licircle center horizontaly
+        // If image data is horizontaly mirrored -> flip circle center horizontaly
         if (draw_bottom_up_)
         {
             cen = Point{cen.x, dp->image_size_.y - cen.y};
         }
 
-        // Init colors
-        auto fill_c = dp->GetColorType();
-        fill_c->SetColor(*fill_color.value_or(next_command_color_));
+        CirclePrimitive circle(*dp, cen, radius, border_width.value_or(1), fill,
+                               *fill_color.value_or(next_command_color_), *border_color.value_or(next_command_color_));
 
-        auto border_c = dp->GetColorType();
-        border_c->SetColor(*border_color.value_or(next_command_color_));
+        // Deferred circle is drawn by Painter::Flush()
+        if (deferred_drawing_)
+        {
+            deferred_.Add(circle);
+            return;
+        }
 
-        // Create circles
-        Circle c_outer{cen, radius + static_cast<int>(std::round(static_cast<float>(border_w) / 2.0f))};
-        Circle c_inner{cen, radius - static_cast<int>(std::round(static_cast<float>(border_w) / 2.0f))};
+        PrimitiveRenderer(*dp, true).Draw(circle);
 
-        Unit x1 = c_outer.center.x - c_outer.radius;
-        Unit x2 = c_inner.center.x - c_inner.radius;
+        // Call back that image was edited
+        image_edit_callback_();
+    }
 
-        Unit y1;
-        Unit y2;
+    void Painter::DrawBucket(const BasePoint &point, const std::optional<std::shared_ptr<Color>> &fill_color_in, uint8_t tolerance)
+    {
+        // The deferred primitives are drawn under the edit
+        Flush();
 
-        // Set y1 to y coordinate of circle
-        y1 = c_outer.center.y;
+        if (image_data_.expired())
+            throw "image_data_.expired";
 
-        // Color circular segments to the left and right
-        for (Unit x = x1; x < x2; x++)
-        {
-            // Get max y
-            y2 = circle_get_top_y(c_outer, x);
+        // Lock the image data
+        std::shared_ptr<DataPixels> dp = image_data_.lock();
 
-            // TODO: y < y2 or y <= y2
-            for (Unit y = y1; y < y2; y++)
-            {
-                // Use symetry to color the 4 pixels
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[y * image_size.x + x]));
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[y * image_size.x + (c_outer.center.x << 2) - x]));
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[((c_outer.center.y << 2) - y) * image_size.x + x]));
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[((c_outer.center.y << 2) - y) * image_size.x + (c_outer.center.x << 2) - x]));
-            }
+        Point p = point.GetPointPX(dp->image_size_);
+
+        // If image data is horizontaly mirrored -> flip starting point horizontaly
+        if (draw_bottom_up_)
+        {
+            p = Point{p.x, dp->image_size_.y - p.y};
         }
 
-        // Color the rest of the circle
-        for (Unit x = x1; x < x2; x++)
+        // Point outside of image, nothing to do
+        if (p.x < 0 || p.x >= dp->image_size_.x || p.y < 0 || p.y >= dp->image_size_.y)
+            return;
+
+        // Translucent color is blended over each of the filled pixels
+        const PrimitiveColor fill_color(*dp, *fill_color_in.value_or(next_command_color_));
+
+        // Filling with the same color changes nothing (the pixels within a tolerance are not the same color)
+        if (!fill_color.blend && tolerance == 0)
         {
-            // Get max y
-            y2 = circle_get_top_y(c_outer, x);
-            y1 = circle_get_top_y(c_inner, x);
+            const bool is_same = DispatchPixelType(dp->GetColorFormat(), [&](auto tag) {
+                using PixelT = typename decltype(tag)::type;
 
-            // Fill all pixels from center to c_inner
-            if (fill)
-            {
-                // TODO: y < y2 or y <= y2
-                for (Unit y = 0; y < y1; y++)
-                {
-                    // Use symetry to color the 4 pixels
-                    std::copy_n(reinterpret_cast<uint8_t *>(fill_c->GetData()), fill_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[y * image_size.x + x]));
-                    std::copy_n(reinterpret_cast<uint8_t *>(fill_c->GetData()), fill_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[y * image_size.x + (c_outer.center.x << 2) - x]));
-                    std::copy_n(reinterpret_cast<uint8_t *>(fill_c->GetData()), fill_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[((c_outer.center.y << 2) - y) * image_size.x + x]));
-                    std::copy_n(reinterpret_cast<uint8_t *>(fill_c->GetData()), fill_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[((c_outer.center.y << 2) - y) * image_size.x + (c_outer.center.x << 2) - x]));
-                }
-            }
+                PixelT picked_pixel, fill_pixel;
+                dp->CopyPixelTo(p.x, p.y, &picked_pixel);
+                std::memcpy(&fill_pixel, fill_color.pixel, sizeof(PixelT));
+                return picked_pixel == fill_pixel;
+            });
 
-            // Fill the rest of pixels between c_inner & c_outer
-            // TODO: y < y2 or y <= y2
-            for (Unit y = y1; y < y2; y++)
-            {
-                // Use symetry to color the 4 pixels
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[y * image_size.x + x]));
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[y * image_size.x + (c_outer.center.x << 2) - x]));
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[((c_outer.center.y << 2) - y) * image_size.x + x]));
-                std::copy_n(reinterpret_cast<uint8_t *>(border_c->GetData()), border_c->GetDataSize(), reinterpret_cast<uint8_t *>((*dp)[((c_outer.center.y << 2) - y) * image_size.x + (c_outer.center.x << 2) - x]));
-            }
+            if (is_same)
+                return;
         }
+
+        // Find the runs of the region, then fill them (copy only the shared chunks under the runs)
+        std::vector<RowSpan> spans;
+        FindRegion(*dp, p, spans, tolerance, parallel_fill_pixels_);
+        PrimitiveRenderer(*dp, true).FillSpans(spans, fill_color);
+
         // Call back that image was edited
         image_edit_callback_();
     }
 
-    void Painter::DrawBucket(const BasePoint &point, const std::optional<std::shared_ptr<Color>> &fill_color_in)
+    void Painter::ReplaceColor(const Color &color, const std::optional<std::shared_ptr<Color>> &fill_color_in, uint8_t tolerance)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         if (image_data_.expired())
             throw "image_data_.expired";
 
         // Lock the image data
         std::shared_ptr<DataPixels> dp = image_data_.lock();
+        const Point size = dp->image_size_;
 
-        Point p = point.GetPointPX(dp->image_size_);
-        Point image_size = dp->image_size_;
-        int pixel_count = image_size.x * image_size.y;
+        // The replaced color as the pixel of the image
+        uint8_t pixel[4] = {};
+        DispatchPixelType(dp->GetColorFormat(), [&](auto tag) {
+            using PixelT = typename decltype(tag)::type;
 
-        // Point outside of image, nothing to do
-        if (p.x < 0 || p.x >= image_size.x || p.y < 0 || p.y >= image_size.y)
-            return;
+            const PixelT data_pixel = DataPixelFromColor<PixelT>(*dp, color);
+            std::memcpy(pixel, &data_pixel, sizeof(PixelT));
+        });
+        const PrimitiveColor fill_color(*dp, *fill_color_in.value_or(next_command_color_));
+
+        // Find the matching runs of each band of rows (each thread has its own matcher)
+        const Unit band_count = (size.y + DataPixels::kTileSize - 1) / DataPixels::kTileSize;
+        const unsigned thread_count = static_cast<unsigned>(std::min<size_t>(DefaultThreadCount(), band_count));
+        std::vector<std::vector<RowSpan>> band_spans(band_count);
+        std::atomic<Unit> next{0};
+        RunOnThreads(thread_count, [&]() {
+            ColorMatcher matcher(*dp, pixel, tolerance);
+            for (Unit band = next++; band < band_count; band = next++)
+                matcher.FindRuns(band * DataPixels::kTileSize, std::min<Unit>((band + 1) * DataPixels::kTileSize, size.y), band_spans[band]);
+        });
 
-        // If image data is horizontaly mirrored -> flip starting point horizontaly
-        if (draw_bottom_up_)
+        // The chunks are copied serially (DataPixels::MakeWritable() changes the shared state of the data)
+        std::vector<Unit> bands;
+        for (Unit band = 0; band < band_count; band++)
         {
-            p = Point{p.x, dp->image_size_.y - p.y};
+            if (band_spans[band].empty())
+                continue;
+
+            Unit x_begin = size.x, x_end = 0;
+            for (const RowSpan &span : band_spans[band])
+            {
+                x_begin = std::min(x_begin, span.x_begin);
+                x_end = std::max(x_end, span.x_end);
+            }
+
+            dp->MakeWritable(Point{x_begin, band * DataPixels::kTileSize}, Point{x_end, (band + 1) * DataPixels::kTileSize});
+            bands.push_back(band);
         }
 
-        // Init 2 sets used for breadth search
-        std::set<int> pixels_to_search;
-        std::set<int> pixels_to_change;
-        int first_idx = p.y * dp->image_size_.x + p.x;
-        pixels_to_change.insert(first_idx);
+        // No pixel matches, nothing to do
+        if (bands.empty())
+            return;
 
-        // Init the color
-        std::unique_ptr<Color> picked_color(dp->GetColorType());
-        picked_color->SetFromData((*dp)[first_idx]);
-        size_t color_size_bytes(picked_color->GetDataSize());
+        // Each thread fills whole bands (different rows of different chunks)
+        ParallelFor(bands.size(), static_cast<unsigned>(std::min<size_t>(thread_count, bands.size())), [&](size_t i) {
+            PrimitiveRenderer(*dp, false).FillSpans(band_spans[bands[i]], fill_color);
+        });
 
-        auto fill_color = dp->GetColorType();
-        fill_color->SetColor(*fill_color_in.value_or(next_command_color_));
-        auto fill_data_ptr = reinterpret_cast<uint8_t *>(fill_color->GetData());
+        // Call back that image was edited
+        image_edit_callback_();
+    }
 
-        // Search pixels to replace
-        while (!pixels_to_search.empty() || !pixels_to_change.empty())
-        {
-            // Iterate through all found pixels with the same color in previous iteration
-            std::for_each(pixels_to_change.begin(), pixels_to_change.end(), [&](auto &i) {
-                // Change the color of the pixel to fill_color
-                std::copy_n(fill_data_ptr, color_size_bytes, reinterpret_cast<uint8_t *>((*dp)[i]));
-            });
+    void Painter::DrawOverlay(const DataPixels &overlay, const BasePoint &position)
+    {
+        // The deferred primitives are drawn under the edit
+        Flush();
 
-            // Clear pixels_to_search
-            pixels_to_search.clear();
+        if (image_data_.expired())
+            throw "image_data_.expired";
 
-            // Iterate once again search around the pixel for pixels with desired color
-            int idx;
-            for (auto p : pixels_to_change)
-            {
-                // Check right pixel
-                idx = p + 1;
-                if (idx < pixel_count && p % image_size.x != image_size.x - 1 && !std::memcmp((*dp)[idx], picked_color->GetData(), color_size_bytes))
-                    pixels_to_search.insert(idx);
-
-                // Check left pixel
-                idx -= 2;
-                if (idx >= 0 && p % image_size.x != 0 && !std::memcmp((*dp)[idx], picked_color->GetData(), color_size_bytes))
-                    pixels_to_search.insert(idx);
-
-                // Check top pixel
-                idx = p - image_size.x;
-                if (idx >= 0 && !std::memcmp((*dp)[idx], picked_color->GetData(), color_size_bytes))
-                    pixels_to_search.insert(idx);
-
-                // Check top pixel
-                idx = p + image_size.x;
-                if (idx < pixel_count && !std::memcmp((*dp)[idx], picked_color->GetData(), color_size_bytes))
-                    pixels_to_search.insert(idx);
-            }
+        // Lock the image data
+        std::shared_ptr<DataPixels> dp = image_data_.lock();
+
+        Point image_size = dp->image_size_;
+        Point overlay_size = overlay.image_size_;
+        Point pos = position.GetPointPX(image_size);
+
+        // If image data is horizontaly mirrored -> the first row of the overlay is its bottom row
+        if (draw_bottom_up_)
+            pos.y = image_size.y - pos.y - overlay_size.y;
 
-            // After changing all the pixels and searching new pixels to replace, swap pixels_to_search & pixels_to_change
-            pixels_to_change.swap(pixels_to_search);
-            pixels_to_search.clear();
+        // Clip the overlay to the image
+        Unit x_begin = std::max<Unit>(pos.x, 0);
+        Unit x_end = std::min<Unit>(pos.x + overlay_size.x, image_size.x);
+        Unit y_begin = std::max<Unit>(pos.y, 0);
+        Unit y_end = std::min<Unit>(pos.y + overlay_size.y, image_size.y);
+
+        // Overlay outside of image, nothing to do
+        if (x_begin >= x_end || y_begin >= y_end)
+            return;
+
+        // The pixels are changed in place -> copy only the shared chunks under the overlay first
+        dp->MakeWritable(Point{x_begin, y_begin}, Point{x_end, y_end});
+
+        std::vector<PixelBGRA8888> overlay_row(overlay_size.x);
+        RowBlender blender(*dp);
+        for (Unit y = y_begin; y < y_end; y++)
+        {
+            overlay.ConvertRowTo(y - pos.y, ColorFormat::kBGRA8888, overlay_row.data());
+            blender.BlendPixels(y, x_begin, x_end, overlay_row.data() + (x_begin - pos.x));
         }
 
         // Call back that image was edited
@@ -314,6 +528,9 @@ namespace paint
 
     void Painter::Crop(const BasePoint &corner1, const BasePoint &corner2)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         if (image_data_.expired())
             throw "image_data_.expired";
 
@@ -353,28 +570,35 @@ namespace paint
             p2.y = image_size.y;
 
         // Set new data
-        std::shared_ptr<DataPixels> new_data_pixels = std::make_shared<DataPixels>(Point{p2.x - p1.x, p2.y - p1.y}, dp->GetColorType());
-        Point new_size = new_data_pixels->image_size_;
-        size_t color_size_bytes = dp->GetColorType()->GetDataSize();
-
-        // Set iterators
-        auto it = new_data_pixels->begin();
-        auto it_end = new_data_pixels->end();
-
-        // For each pixel in new data -> set data from old data
-        int x = p1.x;
-        int y = p1.y;
-        for (; it != it_end; it++, x++)
-        {
-            // Reached the end of line -> go to the 'beginning' (p1.x)
-            if (x == p1.x + new_size.x)
-            {
-                x = p1.x;
-                y++;
-            }
+        std::shared_ptr<DataPixels> new_data_pixels = std::make_shared<DataPixels>(Point{p2.x - p1.x, p2.y - p1.y}, dp->GetColorType(), dp->GetLayout(), dp->GetRowAlignment());
 
-            size_t idx = y * image_size.x + x;
-            std::copy_n(reinterpret_cast<uint8_t *>((*dp)[idx]), color_size_bytes, reinterpret_cast<uint8_t *>(*it));
+        // Packed BW rows are copied by words shifted to the first cropped pixel
+        if (dp->GetLayout() == PixelLayout::kPacked)
+        {
+            size_t row_words = dp->GetRowStride() / sizeof(uint64_t);
+            for (Unit y = 0; y < p2.y - p1.y; y++)
+                CopyPackedBits(static_cast<const uint8_t *>(dp->PackedRowPtr(p1.y + y)), row_words, p1.x,
+                               static_cast<uint8_t *>(new_data_pixels->PackedRowPtr(y)), p2.x - p1.x);
+        }
+        else
+        {
+            // Every channel is copied the same way -> planar data is processed plane by plane
+            DispatchChannelViews(*dp, *new_data_pixels, [&](auto view, auto new_view) {
+                using PixelT = typename decltype(view)::pixel_type;
+
+                // For each tile in new data -> copy the rows of the tile from the parts of the rows in old data
+                new_view.ForEachTile([&](const auto &tile) {
+                    Point origin = tile.GetOrigin();
+
+                    for (Unit y = 0; y < tile.Height(); y++)
+                    {
+                        PixelT *new_row = tile.Row(y);
+                        view.ForEachRowSegment(p1.y + origin.y + y, p1.x + origin.x, p1.x + origin.x + tile.Width(), [&](const PixelT *segment, Unit x, Unit count) {
+                            std::copy_n(segment, count, new_row + (x - p1.x - origin.x));
+                        });
+                    }
+                });
+            });
         }
 
         // Swap the new and old data
@@ -384,8 +608,11 @@ namespace paint
         image_edit_callback_();
     }
 
-    void Painter::Resize(const BasePoint &new_size)
+    void Painter::Resize(const BasePoint &new_size, ResampleFilter filter)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         if (image_data_.expired())
             throw "image_data_.expired";
 
@@ -395,17 +622,46 @@ namespace paint
 
         Point new_image_size = new_size.GetPointPX(image_size);
 
-        // Desired image has the same size -> no resize needed
-        if (new_image_size == image_size)
+        // Desired image has the same size or no pixels (a too small percentage) -> no resize
+        if (new_image_size == image_size || new_image_size.x <= 0 || new_image_size.y <= 0)
             return;
 
+        // Separable filters resample the rows in any layout
+        if (filter != ResampleFilter::kInterpolate)
+        {
+            DataPixels new_data(new_image_size, dp->GetColorType(), dp->GetLayout(), dp->GetRowAlignment());
+            Resample(*dp, new_data, filter, linear_light_);
+            dp->SwapData(new_data);
+
+            // Call back that image was edited
+            image_edit_callback_();
+            return;
+        }
+
+        // Packed BW pixels are interpolated unpacked and packed again afterwards
+        const bool is_packed = dp->GetLayout() == PixelLayout::kPacked;
+        if (is_packed)
+            dp->ConvertLayout(PixelLayout::kLinear);
+
         vec2f multiplier{static_cast<float>(image_size.x) / static_cast<float>(new_image_size.x),
                          static_cast<float>(image_size.y) / static_cast<float>(new_image_size.y)};
 
         vec2f point_in_old;
 
         // Create new data
-        std::shared_ptr<DataPixels> new_data_pixels = std::make_shared<DataPixels>(Point{new_image_size.x, new_image_size.y}, dp->GetColorType());
+        std::shared_ptr<DataPixels> new_data_pixels = std::make_shared<DataPixels>(Point{new_image_size.x, new_image_size.y}, dp->GetColorType(), dp->GetLayout(), dp->GetRowAlignment());
+
+        // Colors are mixed in linear light (BW has no colors to mix, indexed pixels are not mixed, premultiplied alpha is mixed as stored)
+        if (linear_light_ && dp->GetColorFormat() != ColorFormat::kBW && dp->GetColorFormat() != ColorFormat::kIndexed8 &&
+            dp->GetColorFormat() != ColorFormat::kBGRA8888)
+        {
+            ResizeLinearLight(*dp, *new_data_pixels);
+            dp->SwapData(*new_data_pixels);
+
+            // Call back that image was edited
+            image_edit_callback_();
+            return;
+        }
 
         // Letf, right, top and bottom points used for bilinear interpolation
         Unit p_left;
@@ -413,74 +669,81 @@ namespace paint
         Unit p_top;
         Unit p_bottom;
 
-        // Init colors for 4 points
-        std::shared_ptr<Color> c1(dp->GetColorType().release());
-        std::shared_ptr<Color> c2(dp->GetColorType().release());
-        std::shared_ptr<Color> c_interp_bottom(dp->GetColorType().release());
-        std::shared_ptr<Color> c_interp_top(dp->GetColorType().release());
+        // Every channel is copied the same way -> planar data is processed plane by plane
+        DispatchChannelViews(*dp, *new_data_pixels, [&](auto view, auto new_view) {
+            using PixelT = typename decltype(view)::pixel_type;
 
-        // For each pixel in new data
-        for (int y = 0; y != new_image_size.y; y++)
-        {
-            for (int x = 0; x != new_image_size.x; x++)
-            {
-                // Get pixel position in old image
-                point_in_old = vec2f{x * multiplier.u, y * multiplier.v};
+            // Interpolated colors of the bottom and top points
+            PixelT c_interp_bottom;
+            PixelT c_interp_top;
 
-                // Find surrounding pixels
-                p_left = std::floor(point_in_old.u);
-                p_right = std::ceil(point_in_old.u);
-                p_top = std::floor(point_in_old.v); // Top point is at (x, 0)!!!
-                p_bottom = std::ceil(point_in_old.v);
-
-                if (p_left != p_right)
-                {
-                    // Start with bottom points. Set them to their color
-                    c1->SetFromData((*dp)[p_bottom * image_size.x + p_left]);
-                    c2->SetFromData((*dp)[p_bottom * image_size.x + p_right]);
+            // For each pixel in new data (tile by tile, so that the read part of old data stays in the cache)
+            new_view.ForEachTile([&](const auto &tile) {
+                Point origin = tile.GetOrigin();
 
-                    // Interpolate bottom points
-                    c_interp_bottom->Interpolate(c1, c2, 1 - (point_in_old.u - p_left));
-                }
-                else
+                for (Unit y = origin.y; y != origin.y + tile.Height(); y++)
                 {
-                    c1->SetFromData((*dp)[p_bottom * image_size.x + p_left]);
-                    c_interp_bottom->SetColor(*c1);
+                    PixelT *new_row = tile.Row(y - origin.y);
+
+                    for (Unit x = origin.x; x != origin.x + tile.Width(); x++)
+                    {
+                        // Get pixel position in old image
+                        point_in_old = vec2f{x * multiplier.u, y * multiplier.v};
+
+                        // Find surrounding pixels (when upscaling the right and bottom pixel can be just outside the image)
+                        p_left = std::floor(point_in_old.u);
+                        p_right = std::min(static_cast<Unit>(std::ceil(point_in_old.u)), image_size.x - 1);
+                        p_top = std::floor(point_in_old.v); // Top point is at (x, 0)!!!
+                        p_bottom = std::min(static_cast<Unit>(std::ceil(point_in_old.v)), image_size.y - 1);
+
+                        // Start with bottom points
+                        if (p_left != p_right)
+                            c_interp_bottom = InterpolatePixel(view(p_left, p_bottom), view(p_right, p_bottom), 1 - (point_in_old.u - p_left));
+                        else
+                            c_interp_bottom = view(p_left, p_bottom);
+
+                        // Then the top points
+                        if (p_top != p_bottom)
+                            c_interp_top = InterpolatePixel(view(p_left, p_top), view(p_right, p_top), 1 - (point_in_old.u - p_left));
+                        else
+                            c_interp_top = view(p_left, p_top);
+
+                        // Now interpolate the c_interp_bottom & c_interp_top in y direction
+                        new_row[x - origin.x] = InterpolatePixel(c_interp_top, c_interp_bottom, 1 - (point_in_old.v - p_top));
+                    }
                 }
-
-                if (p_top != p_bottom)
-                {
-                    // Then set top points to their color
-                    c1->SetFromData((*dp)[p_top * image_size.x + p_left]);
-                    c2->SetFromData((*dp)[p_top * image_size.x + p_right]);
-
-                    // Interpolate top points
-                    c_interp_top->Interpolate(c1, c2, 1 - (point_in_old.u - p_left));
-                }
-                else
-                {
-                    c1->SetFromData((*dp)[p_top * image_size.x + p_left]);
-                    c_interp_top->SetColor(*c1);
-                }
-
-                // Now interpolate the c_interp_bottom & c_interp_top in y direction
-                c1->Interpolate(c_interp_top, c_interp_bottom, 1 - (point_in_old.v - p_top));
-                //c1->SetColor(ColorRGB888(0, 0, 0));
-
-                // Copy the color data
-                std::copy_n(reinterpret_cast<uint8_t *>(c1->GetData()), c1->GetDataSize(), reinterpret_cast<uint8_t *>((*new_data_pixels)[y * new_image_size.x + x]));
-            }
-        }
+            });
+        });
 
         // Swap the new and old data
         dp->SwapData(*new_data_pixels);
 
+        if (is_packed)
+            dp->ConvertLayout(PixelLayout::kPacked);
+
         // Call back that image was edited
         image_edit_callback_();
     }
 
+    std::vector<std::shared_ptr<DataPixels>> Painter::MakePyramid(size_t level_count)
+    {
+        // The deferred primitives are drawn into the levels
+        Flush();
+
+        if (image_data_.expired())
+            throw "image_data_.expired";
+
+        // Lock the image data
+        std::shared_ptr<DataPixels> dp = image_data_.lock();
+
+        return paint::MakePyramid(*dp, level_count, linear_light_);
+    }
+
     void Painter::Rotate(Rotation rotation)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         if (image_data_.expired())
             throw "image_data_.expired";
 
@@ -488,119 +751,196 @@ namespace paint
         std::shared_ptr<DataPixels> dp = image_data_.lock();
 
         Point image_size = dp->image_size_;
-        size_t color_size_bytes = dp->GetColorType()->GetDataSize();
 
         // Create new data
-        std::shared_ptr<DataPixels> new_data_pixels = std::make_shared<DataPixels>(Point{image_size.y, image_size.x}, dp->GetColorType());
+        std::shared_ptr<DataPixels> new_data_pixels = std::make_shared<DataPixels>(Point{image_size.y, image_size.x}, dp->GetColorType(), dp->GetLayout(), dp->GetRowAlignment());
 
-        // Create iterators to new data
-        auto it = new_data_pixels->begin();
-        auto it_end = new_data_pixels->end();
+        // Direction of the rotation of the stored rows (the image can be stored bottom up)
+        const bool clock_bottom_up = (rotation == Rotation::kClock) ^ draw_bottom_up_;
 
-        int pixel_count = image_size.x * image_size.y;
-
-        // Clockwise rotation for 'bottom up' images, Counter Clockwise rotation for 'top down' images
-        if ((rotation == Rotation::kClock) ^ draw_bottom_up_)
+        // Packed BW pixels are rotated by 8x8 blocks of bits
+        if (dp->GetLayout() == PixelLayout::kPacked)
         {
-            // Go up from bottom left, then to the right (inside old image)
-            int idx = image_size.x * (image_size.y - 1);
-            for (; it != it_end; it++, idx -= image_size.x)
-            {
-                // Go back to the bottom, then one to the right
-                if (idx < 0)
-                    idx = idx + pixel_count + 1;
+            RotatePacked(*dp, *new_data_pixels, clock_bottom_up);
+        }
+        else
+        {
+            // Every channel is copied the same way -> planar data is processed plane by plane
+            DispatchChannelViews(*dp, *new_data_pixels, [&](auto view, auto new_view) {
+                using PixelT = typename decltype(view)::pixel_type;
+
+                // Reading columns of old data is slow for large images -> rotate tile by tile,
+                // a tile of new data is made of the columns of a single block of old data
+                new_view.ForEachTile([&](const auto &tile) {
+                    Point origin = tile.GetOrigin();
+
+                    for (Unit y = origin.y; y < origin.y + tile.Height(); y++)
+                    {
+                        PixelT *new_row = tile.Row(y - origin.y);
+
+                        // Clockwise rotation for 'bottom up' images, Counter Clockwise rotation for 'top down' images
+                        if (clock_bottom_up)
+                        {
+                            // New row y is the old column y read from the bottom up
+                            for (Unit x = origin.x; x < origin.x + tile.Width(); x++)
+                                new_row[x - origin.x] = view(y, image_size.y - 1 - x);
+                        }
+                        // Counter Clockwise rotation for 'bottom up' images, Clockwise rotation for 'top down' images
+                        else
+                        {
+                            // New row y is the old column (width - 1 - y) read from the top down
+                            for (Unit x = origin.x; x < origin.x + tile.Width(); x++)
+                                new_row[x - origin.x] = view(image_size.x - 1 - y, x);
+                        }
+                    }
+                });
+            });
+        }
 
-                // Reached the top right pixel of old image -> end
-                if (idx == image_size.x - 1)
-                {
-                    std::copy_n(reinterpret_cast<uint8_t *>((*dp)[idx]), color_size_bytes, reinterpret_cast<uint8_t *>(*it));
-                    break;
-                }
+        // Swap the new and old data
+        dp->SwapData(*new_data_pixels);
 
-                // Copy pixel
-                std::copy_n(reinterpret_cast<uint8_t *>((*dp)[idx]), color_size_bytes, reinterpret_cast<uint8_t *>(*it));
-            }
+        // Call back that image was edited
+        image_edit_callback_();
+    }
+
+    void Painter::InvertColors()
+    {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
+        if (image_data_.expired())
+            throw "image_data_.expired";
+
+        // Lock the image data
+        std::shared_ptr<DataPixels> dp = image_data_.lock();
+
+        // The pixels are changed in place -> copy shared data first
+        dp->MakeWritable();
+
+        // Indexed pixels keep their indices, only the palette colors are inverted
+        if (dp->GetColorFormat() == ColorFormat::kIndexed8)
+        {
+            dp->data_color_ = std::make_unique<ColorPalette>(std::make_shared<const Palette>(dp->GetPalette()->Inverted()));
+        }
+        // Packed BW pixels are inverted by whole words
+        else if (dp->GetLayout() == PixelLayout::kPacked)
+        {
+            for (Unit y = 0; y < dp->image_size_.y; y++)
+                InvertPackedBits(static_cast<uint8_t *>(dp->PackedRowPtr(y)), dp->image_size_.x);
         }
-        // Counter Clockwise rotation for 'bottom up' images, Clockwise rotation for 'top down' images
         else
         {
-            // Go down from top right, then one to the left
-            int idx = image_size.x - 1;
-            for (; it != it_end; it++, idx += image_size.x)
-            {
-                // Go back to the top, then one to the left
-                if (idx > pixel_count)
-                    idx = idx - pixel_count - 1;
+            // Invert the pixels in place (plane by plane for planar data)
+            DispatchChannelViews(*dp, [&](auto view, size_t) {
+                using PixelT = typename decltype(view)::pixel_type;
 
-                // Reached bottom left pixel of old image -> end
-                if (idx == pixel_count - image_size.x)
+                if constexpr (!std::is_same_v<PixelT, PixelIndexed8>)
                 {
-                    std::copy_n(reinterpret_cast<uint8_t *>((*dp)[idx]), color_size_bytes, reinterpret_cast<uint8_t *>(*it));
-                    break;
+                    view.ForEachTile([](const auto &tile) {
+                        for (Unit y = 0; y < tile.Height(); y++)
+                        {
+                            auto row = tile.Row(y);
+                            for (Unit x = 0; x < tile.Width(); x++)
+                                InvertPixel(row[x]);
+                        }
+                    });
                 }
-
-                // Copy pixel
-                std::copy_n(reinterpret_cast<uint8_t *>((*dp)[idx]), color_size_bytes, reinterpret_cast<uint8_t *>(*it));
-            }
+            });
         }
 
-        // Swap the new and old data
-        dp->SwapData(*new_data_pixels);
+        // Call back that image was edited
+        image_edit_callback_();
+    }
+
+    void Painter::ConvertToGrayscale()
+    {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
+        if (image_data_.expired())
+            throw "image_data_.expired";
+
+        // Lock the image data
+        std::shared_ptr<DataPixels> dp = image_data_.lock();
+
+        // Grayscale and BW have no colors to weight
+        const ColorFormat format = dp->GetColorFormat();
+        if (linear_light_ && format != ColorFormat::kGrayscale && format != ColorFormat::kBW)
+            ConvertToGrayscaleLinearLight(*dp);
+        else
+            dp->TransformToColorType(std::unique_ptr<Color>(new ColorGrayscale(0)));
 
         // Call back that image was edited
         image_edit_callback_();
     }
 
-    void Painter::InvertColors()
+    void Painter::ConvertToBW(const std::optional<DitherMethod> &dither)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         if (image_data_.expired())
             throw "image_data_.expired";
 
         // Lock the image data
         std::shared_ptr<DataPixels> dp = image_data_.lock();
 
-        std::unique_ptr<Color> color(dp->GetColorType());
-        size_t color_size_bytes = color->GetDataSize();
-        void *color_data = color->GetData();
-
-        // TODO: Could implement subclass color reader/writer
-        //      that would just iterate through the array and change the color,
-        //      instead of copying there and back again just to invert color.
-        std::for_each(dp->begin(), dp->end(), [&](auto p) {
-            color->SetFromData(p);
-            color->InvertColor();
-            std::copy_n(reinterpret_cast<uint8_t *>(color_data), color_size_bytes, reinterpret_cast<uint8_t *>(p));
-        });
+        if (dither.has_value())
+            dp->TransformToColorType(std::unique_ptr<Color>(new ColorBW(0)), dither.value());
+        else
+            dp->TransformToColorType(std::unique_ptr<Color>(new ColorBW(0)));
 
         // Call back that image was edited
         image_edit_callback_();
     }
 
-    void Painter::ConvertToGrayscale()
+    void Painter::ConvertToRGB565(const std::optional<DitherMethod> &dither)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         if (image_data_.expired())
             throw "image_data_.expired";
 
         // Lock the image data
         std::shared_ptr<DataPixels> dp = image_data_.lock();
 
-        dp->TransformToColorType(std::unique_ptr<Color>(new ColorGrayscale(0)));
+        if (dither.has_value())
+            dp->TransformToColorType(std::unique_ptr<Color>(new ColorRGB565(0, 0, 0)), dither.value());
+        else
+            dp->TransformToColorType(std::unique_ptr<Color>(new ColorRGB565(0, 0, 0)));
 
         // Call back that image was edited
         image_edit_callback_();
     }
 
-    void Painter::ConvertToBW()
+    void Painter::Quantize(size_t max_colors)
     {
+        // The deferred primitives are drawn under the edit
+        Flush();
+
         if (image_data_.expired())
             throw "image_data_.expired";
 
         // Lock the image data
         std::shared_ptr<DataPixels> dp = image_data_.lock();
+        const Point size = dp->GetSize();
+
+        // Count the colors
+        OctreeQuantizer quantizer;
+        std::vector<PixelRGB888> row(size.x);
+        for (Unit y = 0; y < size.y; y++)
+        {
+            dp->ConvertRowTo(y, ColorFormat::kRGB888, row.data());
+            quantizer.AddColors(row.data(), row.size());
+        }
 
-        dp->TransformToColorType(std::unique_ptr<Color>(new ColorBW(0)));
+        // Map the pixels to the nearest colors of the new palette
+        std::shared_ptr<const Palette> palette = std::make_shared<const Palette>(quantizer.CreatePalette(max_colors));
+        dp->TransformToColorType(std::unique_ptr<Color>(new ColorPalette(palette)));
 
         // Call back that image was edited
         image_edit_callback_();
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+
+#include "palette.h"
+#include "convert_span.h"
+#include "data_pixels_view.h"
+
+namespace paint
+{
+    namespace
+    {
+        // Number of formats with converted palette tables (all the formats before kIndexed8)
+        constexpr size_t kLookupFormats = static_cast<size_t>(ColorFormat::kIndexed8);
+
+        // Empty slot of the PaletteMapper cache (no color has the top byte set)
+        constexpr uint32_t kEmptyKey = 0xFFFFFFFFU;
+
+        int Channel(const PixelRGB888 &color, int axis)
+        {
+            return axis == 0 ? color.r : (axis == 1 ? color.g : color.b);
+        }
+
+        int SquaredDistance(const PixelRGB888 &c1, const PixelRGB888 &c2)
+        {
+            const int r = c1.r - c2.r;
+            const int g = c1.g - c2.g;
+            const int b = c1.b - c2.b;
+            return r * r + g * g + b * b;
+        }
+
+        // A node of the octree built by OctreeQuantizer (the sums are of the whole subtree)
+        struct OctreeNode
+        {
+            uint64_t count = 0;
+            uint64_t red = 0;
+            uint64_t green = 0;
+            uint64_t blue = 0;
+            int children[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+            int parent = -1;
+            int depth = 0;
+            int child_count = 0;
+            int leaf_children = 0;
+            bool leaf = false;
+        };
+    }
+
+    Palette::Palette(std::vector<PixelRGB888> colors) : colors_(std::move(colors))
+    {
+        if (colors_.empty() || colors_.size() > kMaxColors)
+            throw std::invalid_argument("Palette has to have 1 - 256 colors.");
+
+        // k-d tree of the colors
+        std::vector<uint8_t> indices(colors_.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        kd_nodes_.reserve(colors_.size());
+        kd_root_ = BuildKdTree(indices, 0, indices.size());
+
+        // Every entry converted into every format (the indices past the end are black)
+        std::vector<PixelRGB888> entries(kMaxColors, PixelRGB888{0, 0, 0});
+        std::copy(colors_.begin(), colors_.end(), entries.begin());
+
+        lookup_.resize(kLookupFormats);
+        for (size_t f = 0; f < kLookupFormats; f++)
+        {
+            const ColorFormat format = static_cast<ColorFormat>(f);
+            lookup_[f].resize(kMaxColors * PixelSize(format));
+            ConvertSpan(ColorFormat::kRGB888, format, entries.data(), lookup_[f].data(), kMaxColors);
+        }
+    }
+
+    int16_t Palette::BuildKdTree(std::vector<uint8_t> &indices, size_t begin, size_t end)
+    {
+        if (begin >= end)
+            return -1;
+
+        // Split by the channel with the largest range
+        int axis = 0;
+        int largest_range = -1;
+        for (int a = 0; a < 3; a++)
+        {
+            auto [min, max] = std::minmax_element(indices.begin() + begin, indices.begin() + end, [&](uint8_t i1, uint8_t i2) {
+                return Channel(colors_[i1], a) < Channel(colors_[i2], a);
+            });
+
+            int range = Channel(colors_[*max], a) - Channel(colors_[*min], a);
+            if (range > largest_range)
+            {
+                largest_range = range;
+                axis = a;
+            }
+        }
+
+        // The median splits the colors into the smaller (left) and the larger or equal (right) ones
+        const size_t mid = begin + (end - begin) / 2;
+        std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end, [&](uint8_t i1, uint8_t i2) {
+            return Channel(colors_[i1], axis) < Channel(colors_[i2], axis);
+        });
+
+        const int16_t node = static_cast<int16_t>(kd_nodes_.size());
+        kd_nodes_.push_back(KdNode{colors_[indices[mid]], indices[mid], static_cast<uint8_t>(axis), -1, -1});
+
+        const int16_t left = BuildKdTree(indices, begin, mid);
+        const int16_t right = BuildKdTree(indices, mid + 1, end);
+        kd_nodes_[node].left = left;
+        kd_nodes_[node].right = right;
+
+        return node;
+    }
+
+    void Palette::SearchKdTree(int16_t node, const PixelRGB888 &color, int &best_distance, uint8_t &best_index) const
+    {
+        if (node < 0)
+            return;
+
+        const KdNode &n = kd_nodes_[node];
+        const int distance = SquaredDistance(color, n.color);
+        if (distance < best_distance || (distance == best_distance && n.index < best_index))
+        {
+            best_distance = distance;
+            best_index = n.index;
+        }
+
+        // The side of the color first, the other side only if it can hold an equally close color
+        const int diff = Channel(color, n.axis) - Channel(n.color, n.axis);
+        SearchKdTree(diff < 0 ? n.left : n.right, color, best_distance, best_index);
+        if (diff * diff <= best_distance)
+            SearchKdTree(diff < 0 ? n.right : n.left, color, best_distance, best_index);
+    }
+
+    uint8_t Palette::FindNearest(const PixelRGB888 &color) const
+    {
+        int best_distance = std::numeric_limits<int>::max();
+        uint8_t best_index = 0;
+        SearchKdTree(kd_root_, color, best_distance, best_index);
+        return best_index;
+    }
+
+    void Palette::ConvertIndices(const uint8_t *indices, ColorFormat format, void *dst, size_t n) const
+    {
+        if (format == ColorFormat::kIndexed8)
+        {
+            std::memmove(dst, indices, n);
+            return;
+        }
+
+        DispatchPixelType(format, [&](auto tag) {
+            using PixelT = typename decltype(tag)::type;
+            const PixelT *table = reinterpret_cast<const PixelT *>(lookup_[static_cast<size_t>(format)].data());
+            PixelT *pixels = static_cast<PixelT *>(dst);
+
+            for (size_t i = 0; i < n; i++)
+                pixels[i] = table[indices[i]];
+        });
+    }
+
+    Palette Palette::Inverted() const
+    {
+        std::vector<PixelRGB888> colors(colors_);
+        for (auto &color : colors)
+        {
+            color.r = ~color.r;
+            color.g = ~color.g;
+            color.b = ~color.b;
+        }
+
+        return Palette(std::move(colors));
+    }
+
+    PaletteMapper::PaletteMapper(const Palette &palette) : palette_(palette),
+                                                           cache_keys_(size_t{1} << kCacheBits, kEmptyKey),
+                                                           cache_indices_(size_t{1} << kCacheBits, 0) {}
+
+    uint8_t PaletteMapper::Map(const PixelRGB888 &color)
+    {
+        const uint32_t key = (static_cast<uint32_t>(color.r) << 16) | (static_cast<uint32_t>(color.g) << 8) | color.b;
+        const size_t slot = static_cast<uint32_t>(key * 2654435761U) >> (32 - kCacheBits);
+
+        if (cache_keys_[slot] != key)
+        {
+            cache_keys_[slot] = key;
+            cache_indices_[slot] = palette_.FindNearest(color);
+        }
+
+        return cache_indices_[slot];
+    }
+
+    void PaletteMapper::MapSpan(const PixelRGB888 *src, uint8_t *dst, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            // Runs of the same color reuse the last index
+            if (i > 0 && src[i] == src[i - 1])
+                dst[i] = dst[i - 1];
+            else
+                dst[i] = Map(src[i]);
+        }
+    }
+
+    OctreeQuantizer::OctreeQuantizer() : count_(kBinCount, 0),
+                                         red_(kBinCount, 0),
+                                         green_(kBinCount, 0),
+                                         blue_(kBinCount, 0) {}
+
+    void OctreeQuantizer::AddColors(const PixelRGB888 *pixels, size_t n)
+    {
+        constexpr size_t shift = 8 - kLevelBits;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const PixelRGB888 &p = pixels[i];
+            const size_t bin = ((p.r >> shift) << (2 * kLevelBits)) | ((p.g >> shift) << kLevelBits) | (p.b >> shift);
+            count_[bin]++;
+            red_[bin] += p.r;
+            green_[bin] += p.g;
+            blue_[bin] += p.b;
+        }
+    }
+
+    Palette OctreeQuantizer::CreatePalette(size_t max_colors) const
+    {
+        if (max_colors == 0 || max_colors > Palette::kMaxColors)
+            throw std::invalid_argument("Number of palette colors has to be 1 - 256.");
+
+        constexpr size_t level_mask = (1 << kLevelBits) - 1;
+
+        // Insert every used bin as a leaf (the bits of the channels from the most significant one select the children)
+        std::vector<OctreeNode> nodes(1);
+        size_t leaf_count = 0;
+
+        for (size_t bin = 0; bin < kBinCount; bin++)
+        {
+            if (count_[bin] == 0)
+                continue;
+
+            const size_t r = (bin >> (2 * kLevelBits)) & level_mask;
+            const size_t g = (bin >> kLevelBits) & level_mask;
+            const size_t b = bin & level_mask;
+
+            int node = 0;
+            for (int depth = 0; depth <= static_cast<int>(kLevelBits); depth++)
+            {
+                nodes[node].count += count_[bin];
+                nodes[node].red += red_[bin];
+                nodes[node].green += green_[bin];
+                nodes[node].blue += blue_[bin];
+
+                if (depth == static_cast<int>(kLevelBits))
+                    break;
+
+                const int bit = static_cast<int>(kLevelBits) - 1 - depth;
+                const int child = static_cast<int>((((r >> bit) & 1) << 2) | (((g >> bit) & 1) << 1) | ((b >> bit) & 1));
+
+                if (nodes[node].children[child] < 0)
+                {
+                    OctreeNode new_node;
+                    new_node.parent = node;
+                    new_node.depth = depth + 1;
+                    new_node.leaf = new_node.depth == static_cast<int>(kLevelBits);
+
+                    nodes[node].children[child] = static_cast<int>(nodes.size());
+                    nodes[node].child_count++;
+                    if (new_node.leaf)
+                    {
+                        nodes[node].leaf_children++;
+                        leaf_count++;
+                    }
+
+                    nodes.push_back(new_node);
+                }
+
+                node = nodes[node].children[child];
+            }
+        }
+
+        // Image without pixels
+        if (leaf_count == 0)
+            return Palette({PixelRGB888{0, 0, 0}});
+
+        // Nodes with only leaves as children are merged into leaves, the deepest and the least used first
+        auto merge_later = [&nodes](int n1, int n2) {
+            if (nodes[n1].depth != nodes[n2].depth)
+                return nodes[n1].depth < nodes[n2].depth;
+            if (nodes[n1].count != nodes[n2].count)
+                return nodes[n1].count > nodes[n2].count;
+            return n1 > n2;
+        };
+        std::priority_queue<int, std::vector<int>, decltype(merge_later)> mergeable(merge_later);
+
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            if (!nodes[n].leaf && nodes[n].leaf_children == nodes[n].child_count)
+                mergeable.push(static_cast<int>(n));
+        }
+
+        while (leaf_count > max_colors)
+        {
+            const int n = mergeable.top();
+            mergeable.pop();
+
+            nodes[n].leaf = true;
+            leaf_count -= nodes[n].child_count - 1;
+
+            const int parent = nodes[n].parent;
+            if (parent >= 0 && ++nodes[parent].leaf_children == nodes[parent].child_count)
+                mergeable.push(parent);
+        }
+
+        // Every leaf is the average of its pixels
+        std::vector<PixelRGB888> colors;
+        std::vector<int> stack{0};
+        while (!stack.empty())
+        {
+            const OctreeNode &node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (node.leaf)
+            {
+                colors.push_back(PixelRGB888{static_cast<uint8_t>((node.red + node.count / 2) / node.count),
+                                             static_cast<uint8_t>((node.green + node.count / 2) / node.count),
+                                             static_cast<uint8_t>((node.blue + node.count / 2) / node.count)});
+                continue;
+            }
+
+            for (int child = 7; child >= 0; child--)
+            {
+                if (node.children[child] >= 0)
+                    stack.push_back(node.children[child]);
+            }
+        }
+
+        return Palette(std::move(colors));
+    }
+}
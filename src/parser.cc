@@ -2,6 +2,7 @@
 #include <memory>
 #include <regex>
 #include <iostream>
+#include <algorithm>
 #include <filesystem>
 #include <vector>
 #include <utility>
@@ -13,6 +14,7 @@
 #include "parser.h"
 #include "color.h"
 #include "color_rgb888.h"
+#include "color_bgra8888.h"
 
 namespace paint
 {
@@ -46,21 +48,29 @@ namespace paint
     }
 
     std::regex Parser::re_save_ = std::regex("^SAVE\\s([a-zA-Z0-9\\s\\\\/\\*._-]+)\\r?\\n?$");
-    std::regex Parser::re_load_ = std::regex("^LOAD\\s([a-zA-Z0-9\\s\\\\/\\*._-]+)\\r?\\n?$");
-    std::regex Parser::re_color_ = std::regex("^COLOR\\s(\\d{1,3})\\s(\\d{1,3})\\s(\\d{1,3})\\r?\\n?$");
+    std::regex Parser::re_pyramid_ = std::regex("^PYRAMID\\s(\\d{1,2})(?:\\s([a-zA-Z0-9\\s\\\\/\\*._-]+))?\\r?\\n?$");
+    std::regex Parser::re_load_ = std::regex("^LOAD\\s([a-zA-Z0-9\\s\\\\/\\*._-]+)(:?\\s\\{(.+)\\})?\\r?\\n?$");
+    std::regex Parser::re_color_ = std::regex("^COLOR\\s(\\d{1,3})\\s(\\d{1,3})\\s(\\d{1,3})(?:\\s(\\d{1,3}))?\\r?\\n?$");
     std::regex Parser::re_line_ = std::regex("^LINE\\s(%|PX)\\s(\\d+)\\s(\\d+)\\s(\\d+)\\s(\\d+)(:?\\s\\{(.+)\\})?\\r?\\n?$");
     std::regex Parser::re_circle_ = std::regex("^CIRCLE\\s(%|PX)\\s(\\d+)\\s(\\d+)\\s(\\d+)(:?\\s\\{(.+)\\})?\\r?\\n?$");
     std::regex Parser::re_bucket_ = std::regex("^BUCKET\\s(%|PX)\\s(\\d+)\\s(\\d+)(:?\\s\\{(.+)\\})?\\r?\\n?$");
-    std::regex Parser::re_resize_ = std::regex("^RESIZE\\s(%|PX)\\s(\\d+)\\s(\\d+)\\r?\\n?$");
+    std::regex Parser::re_replace_color_ = std::regex("^REPLACECOLOR\\s(\\d{1,3})\\s(\\d{1,3})\\s(\\d{1,3})(:?\\s\\{(.+)\\})?\\r?\\n?$");
+    std::regex Parser::re_resize_ = std::regex("^RESIZE\\s(%|PX)\\s(\\d+)\\s(\\d+)(:?\\s\\{(.+)\\})?\\r?\\n?$");
     std::regex Parser::re_rotate_ = std::regex("^ROTATE\\s(CLOCK|COUNTERCLOCK)\\r?\\n?$");
     std::regex Parser::re_invert_colors_ = std::regex("^INVERTCOLORS\\r?\\n?$");
     std::regex Parser::re_grayscale_ = std::regex("^GRAYSCALE\\r?\\n?$");
+    std::regex Parser::re_dither_ = std::regex("^DITHER\\s(BW|RGB565)(:?\\s\\{(.+)\\})?\\r?\\n?$");
+    std::regex Parser::re_linear_light_ = std::regex("^LINEARLIGHT\\s(ON|OFF)\\r?\\n?$");
+    std::regex Parser::re_defer_ = std::regex("^DEFER\\s(ON|OFF)\\r?\\n?$");
+    std::regex Parser::re_parallel_fill_ = std::regex("^PARALLELFILL\\s(\\d{1,18})\\r?\\n?$");
+    std::regex Parser::re_quantize_ = std::regex("^QUANTIZE\\s(\\d{1,3})\\r?\\n?$");
+    std::regex Parser::re_overlay_ = std::regex("^OVERLAY\\s(%|PX)\\s(\\d+)\\s(\\d+)\\s([a-zA-Z0-9\\s\\\\/\\*._-]+)\\r?\\n?$");
     std::regex Parser::re_crop_ = std::regex("^CROP\\s(%|PX)\\s(\\d+)\\s(\\d+)\\s(\\d+)\\s(\\d+)\\r?\\n?$");
     std::regex Parser::re_undo_ = std::regex("^UNDO\\r?\\n?$");
     std::regex Parser::re_redo_ = std::regex("^REDO\\r?\\n?$");
     std::regex Parser::re_param_delim_ = std::regex(",\\s(?=[^\\{\\}]*\\{[^\\{\\}]*\\}|[^\\{\\}]+$\\r?\\n?)");
     std::regex Parser::re_param_ = std::regex("^([a-z-]+):\\s(?:([a-z0-9-]+)|\\{(.+)\\})\\r?\\n?$");
-    std::regex Parser::re_param_color_ = std::regex("^r:\\s(\\d{1,3}),\\sg:\\s(\\d{1,3}),\\sb:\\s(\\d{1,3})\\r?\\n?$");
+    std::regex Parser::re_param_color_ = std::regex("^r:\\s(\\d{1,3}),\\sg:\\s(\\d{1,3}),\\sb:\\s(\\d{1,3})(?:,\\sa:\\s(\\d{1,3}))?\\r?\\n?$");
 
     std::shared_ptr<Command> Parser::ParseLine(const std::string &line)
     {
@@ -71,7 +81,46 @@ namespace paint
         // Do not check the file
         if (std::regex_match(line, match, Parser::re_load_))
         {
-            command = std::make_shared<LoadCommand>(std::filesystem::path(match[1].str()));
+            std::shared_ptr<LoadCommand> load_command = std::make_shared<LoadCommand>(std::filesystem::path(match[1].str()));
+
+            // Has optional parameters
+            if (match[3].matched == true)
+            {
+                std::vector<std::pair<std::string, std::string>> opt_args = Parser::ParseOptionalArgs(match[3].str());
+                bool has_mode_arg = false;
+                bool has_layout_arg = false;
+
+                // Read the optional parameters
+                for (auto &[arg, val] : opt_args)
+                {
+                    // Read mode parameter
+                    if (arg == "mode" && !has_mode_arg && (val == "read" || val == "mmap"))
+                    {
+                        has_mode_arg = true;
+                        load_command->AddLoadMode(val == "mmap" ? LoadMode::kMap : LoadMode::kRead);
+                    }
+                    // Read layout parameter
+                    else if (arg == "layout" && !has_layout_arg && (val == "linear" || val == "tiled" || val == "planar" || val == "packed"))
+                    {
+                        has_layout_arg = true;
+                        if (val == "linear")
+                            load_command->AddPixelLayout(PixelLayout::kLinear);
+                        else if (val == "tiled")
+                            load_command->AddPixelLayout(PixelLayout::kTiled);
+                        else if (val == "planar")
+                            load_command->AddPixelLayout(PixelLayout::kPlanar);
+                        else
+                            load_command->AddPixelLayout(PixelLayout::kPacked);
+                    }
+                    else
+                    {
+                        // Unknown optional parameter or duplicate parameter
+                        throw parse_error(arg + ": " + val);
+                    }
+                }
+            }
+
+            command = std::move(load_command);
         }
 
         // SAVE command
@@ -81,19 +130,37 @@ namespace paint
             command = std::make_shared<SaveCommand>(std::filesystem::path(match[1].str()));
         }
 
+        // PYRAMID command
+        else if (std::regex_match(line, match, Parser::re_pyramid_))
+        {
+            size_t level_count = std::stoul(match[1].str());
+
+            if (level_count == 0)
+            {
+                throw parse_error(line);
+            }
+
+            command = std::make_shared<PyramidCommand>(level_count, std::filesystem::path(match[2].str()));
+        }
+
         // COLOR command
         else if (std::regex_match(line, match, Parser::re_color_))
         {
             int r = std::stoi(match[1].str());
             int g = std::stoi(match[2].str());
             int b = std::stoi(match[3].str());
+            int a = match[4].matched ? std::stoi(match[4].str()) : 255;
 
-            if (r > 255 || g > 255 || b > 255)
+            if (r > 255 || g > 255 || b > 255 || a > 255)
             {
                 throw parse_error(line);
             }
 
-            command = std::make_shared<ColorCommand>(std::shared_ptr<Color>(new ColorRGB888(r, g, b)));
+            // Translucent color is blended over the image
+            if (a < 255)
+                command = std::make_shared<ColorCommand>(std::shared_ptr<Color>(new ColorBGRA8888(b, g, r, a)));
+            else
+                command = std::make_shared<ColorCommand>(std::shared_ptr<Color>(new ColorRGB888(r, g, b)));
         }
 
         // LINE command
@@ -121,6 +188,7 @@ namespace paint
 
                 bool has_color = false;
                 bool has_line_width = false;
+                bool has_antialias = false;
 
                 // Read the optional parameters
                 for (auto &[arg, val] : opt_args)
@@ -130,7 +198,7 @@ namespace paint
                     {
                         has_color = true;
 
-                        line_command->AddLineColor(std::make_shared<ColorRGB888>(std::move(ParseColorVal(val))));
+                        line_command->AddLineColor(ParseColorVal(val));
                     }
                     // Read width
                     else if (arg == "width" && has_line_width == false)
@@ -146,6 +214,24 @@ namespace paint
                         has_line_width = true;
                         line_command->AddLineWidth(width);
                     }
+                    // Read antialias
+                    else if (arg == "antialias" && has_antialias == false)
+                    {
+                        has_antialias = true;
+
+                        if (val == "true")
+                        {
+                            line_command->SetLineAntialias(true);
+                        }
+                        else if (val == "false")
+                        {
+                            line_command->SetLineAntialias(false);
+                        }
+                        else
+                        {
+                            throw parse_error(arg + ": " + val);
+                        }
+                    }
                     else
                     {
                         // Unknown optional parameter or duplicate parameter
@@ -210,13 +296,13 @@ namespace paint
                     else if (arg == "fill-color" && !has_fill_color_arg)
                     {
                         has_fill_color_arg = true;
-                        circle_command->AddCircleFillColor(std::make_shared<ColorRGB888>(Parser::ParseColorVal(val)));
+                        circle_command->AddCircleFillColor(Parser::ParseColorVal(val));
                     }
                     // Read border-color parameter
                     else if (arg == "border-color" && !has_border_color_arg)
                     {
                         has_border_color_arg = true;
-                        circle_command->AddCircleBorderColor(std::make_shared<ColorRGB888>(Parser::ParseColorVal(val)));
+                        circle_command->AddCircleBorderColor(Parser::ParseColorVal(val));
                     }
                     // Read border-width parameter
                     else if (arg == "border-width" && !has_border_width_arg)
@@ -264,16 +350,23 @@ namespace paint
             {
                 std::vector<std::pair<std::string, std::string>> opt_args = Parser::ParseOptionalArgs(match[5].str());
 
+                bool has_color_arg = false;
+                bool has_tolerance_arg = false;
+
                 // Read the optional parameters
                 for (auto &[arg, val] : opt_args)
                 {
-                    bool has_color_arg = false;
-
                     // Read color parameter
                     if (arg == "color" && !has_color_arg)
                     {
                         has_color_arg = true;
-                        bucket_command->AddFillColor(std::make_shared<ColorRGB888>(Parser::ParseColorVal(val)));
+                        bucket_command->AddFillColor(Parser::ParseColorVal(val));
+                    }
+                    // Read tolerance parameter
+                    else if (arg == "tolerance" && !has_tolerance_arg)
+                    {
+                        has_tolerance_arg = true;
+                        bucket_command->AddTolerance(Parser::ParseToleranceVal(val));
                     }
                     else
                     {
@@ -286,6 +379,54 @@ namespace paint
             command = std::move(bucket_command);
         }
 
+        // REPLACECOLOR command
+        else if (std::regex_match(line, match, Parser::re_replace_color_))
+        {
+            int red = std::stoi(match[1].str());
+            int green = std::stoi(match[2].str());
+            int blue = std::stoi(match[3].str());
+
+            if (red > 255 || green > 255 || blue > 255)
+            {
+                throw parse_error(line);
+            }
+
+            auto replace_command = std::make_shared<ReplaceColorCommand>(std::make_shared<ColorRGB888>(red, green, blue));
+
+            // Has optional parameters
+            if (match[5].matched == true)
+            {
+                std::vector<std::pair<std::string, std::string>> opt_args = Parser::ParseOptionalArgs(match[5].str());
+
+                bool has_color_arg = false;
+                bool has_tolerance_arg = false;
+
+                // Read the optional parameters
+                for (auto &[arg, val] : opt_args)
+                {
+                    // Read color parameter
+                    if (arg == "color" && !has_color_arg)
+                    {
+                        has_color_arg = true;
+                        replace_command->AddFillColor(Parser::ParseColorVal(val));
+                    }
+                    // Read tolerance parameter
+                    else if (arg == "tolerance" && !has_tolerance_arg)
+                    {
+                        has_tolerance_arg = true;
+                        replace_command->AddTolerance(Parser::ParseToleranceVal(val));
+                    }
+                    else
+                    {
+                        // Unknown optional parameter or duplicate parameter
+                        throw parse_error(arg + ": " + val);
+                    }
+                }
+            }
+
+            command = std::move(replace_command);
+        }
+
         // RESIZE command
         else if (std::regex_match(line, match, Parser::re_resize_))
         {
@@ -302,6 +443,36 @@ namespace paint
                                                                                            std::stoi(match[3].str())));
             }
 
+            // Has optional parameters
+            if (match[5].matched == true)
+            {
+                std::vector<std::pair<std::string, std::string>> opt_args = Parser::ParseOptionalArgs(match[5].str());
+                bool has_filter_arg = false;
+
+                // Read the optional parameters
+                for (auto &[arg, val] : opt_args)
+                {
+                    // Read filter parameter
+                    if (arg == "filter" && !has_filter_arg && (val == "box" || val == "bilinear" || val == "bicubic" || val == "lanczos3"))
+                    {
+                        has_filter_arg = true;
+                        if (val == "box")
+                            resize_command->AddFilter(ResampleFilter::kBox);
+                        else if (val == "bilinear")
+                            resize_command->AddFilter(ResampleFilter::kBilinear);
+                        else if (val == "bicubic")
+                            resize_command->AddFilter(ResampleFilter::kBicubic);
+                        else
+                            resize_command->AddFilter(ResampleFilter::kLanczos3);
+                    }
+                    else
+                    {
+                        // Unknown optional parameter or duplicate parameter
+                        throw parse_error(arg + ": " + val);
+                    }
+                }
+            }
+
             command = std::move(resize_command);
         }
 
@@ -334,6 +505,73 @@ namespace paint
             command = std::make_shared<GrayscaleCommand>();
         }
 
+        // DITHER command
+        else if (std::regex_match(line, match, Parser::re_dither_))
+        {
+            std::shared_ptr<DitherCommand> dither_command = std::make_shared<DitherCommand>(match[1].str() == "BW" ? ColorFormat::kBW : ColorFormat::kRGB565);
+
+            // Has optional parameters
+            if (match[3].matched == true)
+            {
+                std::vector<std::pair<std::string, std::string>> opt_args = Parser::ParseOptionalArgs(match[3].str());
+                bool has_method_arg = false;
+
+                // Read the optional parameters
+                for (auto &[arg, val] : opt_args)
+                {
+                    // Read method parameter
+                    if (arg == "method" && !has_method_arg && (val == "bayer" || val == "floyd-steinberg" || val == "atkinson"))
+                    {
+                        has_method_arg = true;
+                        if (val == "bayer")
+                            dither_command->AddDitherMethod(DitherMethod::kBayer);
+                        else if (val == "floyd-steinberg")
+                            dither_command->AddDitherMethod(DitherMethod::kFloydSteinberg);
+                        else
+                            dither_command->AddDitherMethod(DitherMethod::kAtkinson);
+                    }
+                    else
+                    {
+                        // Unknown optional parameter or duplicate parameter
+                        throw parse_error(arg + ": " + val);
+                    }
+                }
+            }
+
+            command = std::move(dither_command);
+        }
+
+        // LINEARLIGHT command
+        else if (std::regex_match(line, match, Parser::re_linear_light_))
+        {
+            command = std::make_shared<LinearLightCommand>(match[1].str() == "ON");
+        }
+
+        // DEFER command
+        else if (std::regex_match(line, match, Parser::re_defer_))
+        {
+            command = std::make_shared<DeferCommand>(match[1].str() == "ON");
+        }
+
+        // PARALLELFILL command
+        else if (std::regex_match(line, match, Parser::re_parallel_fill_))
+        {
+            command = std::make_shared<ParallelFillCommand>(std::stoll(match[1].str()));
+        }
+
+        // QUANTIZE command
+        else if (std::regex_match(line, match, Parser::re_quantize_))
+        {
+            int colors = std::stoi(match[1].str());
+
+            if (colors < 1 || colors > 256)
+            {
+                throw parse_error(line);
+            }
+
+            command = std::make_shared<QuantizeCommand>(colors);
+        }
+
         // CROP command
         else if (std::regex_match(line, match, Parser::re_crop_))
         {
@@ -351,6 +589,24 @@ namespace paint
             }
         }
 
+        // OVERLAY command
+        // Do not check the file
+        else if (std::regex_match(line, match, Parser::re_overlay_))
+        {
+            // Using relative units
+            if (match[1].str() == "%")
+            {
+                command = std::make_shared<OverlayCommand>(std::make_shared<PointPer>(std::stoi(match[2].str()), std::stoi(match[3].str())),
+                                                           std::filesystem::path(match[4].str()));
+            }
+            // Using PX units
+            else
+            {
+                command = std::make_shared<OverlayCommand>(std::make_shared<PointPX>(std::stoi(match[2].str()), std::stoi(match[3].str())),
+                                                           std::filesystem::path(match[4].str()));
+            }
+        }
+
         // UNDO command
         else if (std::regex_match(line, match, Parser::re_undo_))
         {
@@ -411,7 +667,7 @@ namespace paint
         return parsed_args;
     }
 
-    ColorRGB888 Parser::ParseColorVal(const std::string &color_arg)
+    std::shared_ptr<Color> Parser::ParseColorVal(const std::string &color_arg)
     {
         std::smatch color_match;
         std::regex_match(color_arg, color_match, Parser::re_param_color_);
@@ -426,14 +682,35 @@ namespace paint
         int r = std::stoi(color_match[1].str());
         int g = std::stoi(color_match[2].str());
         int b = std::stoi(color_match[3].str());
+        int a = color_match[4].matched ? std::stoi(color_match[4].str()) : 255;
 
         // Any component of color cannot be bigger than 255
-        if (r > 255 || g > 255 || b > 255)
+        if (r > 255 || g > 255 || b > 255 || a > 255)
         {
             throw parse_error(color_arg);
         }
 
-        // Return parsed color
-        return ColorRGB888(r, g, b);
+        // Return parsed color (translucent color is blended over the image)
+        if (a < 255)
+            return std::make_shared<ColorBGRA8888>(b, g, r, a);
+
+        return std::make_shared<ColorRGB888>(r, g, b);
+    }
+
+    uint8_t Parser::ParseToleranceVal(const std::string &tolerance_arg)
+    {
+        // Only a number of 0 - 255
+        if (tolerance_arg.empty() || tolerance_arg.size() > 3 || !std::all_of(tolerance_arg.begin(), tolerance_arg.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        {
+            throw parse_error(tolerance_arg);
+        }
+
+        int tolerance = std::stoi(tolerance_arg);
+        if (tolerance > 255)
+        {
+            throw parse_error(tolerance_arg);
+        }
+
+        return static_cast<uint8_t>(tolerance);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,329 @@
+#include "raster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace paint
+{
+    LineRasterizer::LineRasterizer(Point start, Point end, Unit width, Point size, bool antialias)
+        : start_(start), end_(end), size_(size), bresenham_(!antialias && width < 2), clip_row_end_(size.y)
+    {
+        // Lines go from left to right (or up if vertical), so both directions of the same line give the same pixels
+        if (end_.x < start_.x || (end_.x == start_.x && end_.y < start_.y))
+            std::swap(start_, end_);
+
+        if (bresenham_)
+        {
+            dx_ = static_cast<int64_t>(end_.x) - start_.x;
+            dy_abs_ = std::abs(static_cast<int64_t>(end_.y) - start_.y);
+            step_y_ = end_.y < start_.y ? -1 : 1;
+        }
+        else
+        {
+            const double dx = static_cast<double>(end_.x) - start_.x;
+            const double dy = static_cast<double>(end_.y) - start_.y;
+
+            length_ = std::hypot(dx, dy);
+            if (length_ > 0)
+            {
+                ux_ = dx / length_;
+                uy_ = dy / length_;
+                nx_ = -uy_;
+                ny_ = ux_;
+            }
+
+            // Rows are crossed by the edges that are not horizontal
+            inverse_ux_ = std::abs(ux_) < 1e-12 ? 0.0 : 1.0 / ux_;
+            inverse_nx_ = std::abs(nx_) < 1e-12 ? 0.0 : 1.0 / nx_;
+
+            half_width_ = std::max<Unit>(width, 1) / 2.0;
+
+            // A line without length is a square
+            cap_ = length_ > 0 ? 0.5 : std::max(0.5, half_width_);
+
+            // Bounding rows of the corners of the rectangle (grown by the coverage of the edge pixels)
+            const double grow = antialias ? 0.5 : 0.0;
+            double y_min = std::numeric_limits<double>::max();
+            double y_max = std::numeric_limits<double>::lowest();
+            for (double along : {-cap_ - grow, length_ + cap_ + grow})
+            {
+                for (double across : {-half_width_ - grow, half_width_ + grow})
+                {
+                    const double y = start_.y + along * uy_ + across * ny_;
+                    y_min = std::min(y_min, y);
+                    y_max = std::max(y_max, y);
+                }
+            }
+
+            // Clip the rows to the image
+            row_begin_ = static_cast<Unit>(std::clamp<double>(std::ceil(y_min), 0, size_.y));
+            row_end_ = static_cast<Unit>(std::clamp<double>(std::floor(y_max) + 1, 0, size_.y));
+        }
+    }
+
+    void LineRasterizer::ClipRows(Unit row_begin, Unit row_end)
+    {
+        clip_row_begin_ = std::max(clip_row_begin_, row_begin);
+        clip_row_end_ = std::min(clip_row_end_, row_end);
+
+        row_begin_ = std::max(row_begin_, clip_row_begin_);
+        row_end_ = std::min(row_end_, clip_row_end_);
+    }
+
+    void LineRasterizer::GetSpans(std::vector<RowSpan> &spans) const
+    {
+        spans.clear();
+
+        if (bresenham_)
+        {
+            GetBresenhamSpans(spans);
+            return;
+        }
+
+        for (Unit y = row_begin_; y < row_end_; y++)
+        {
+            double x_left, x_right;
+            if (!RowInterval(y, 0.0, x_left, x_right))
+                continue;
+
+            // Pixel centers in [x_left, x_right)
+            auto [x_begin, x_end] = ClipSpan(static_cast<int64_t>(std::ceil(x_left)), static_cast<int64_t>(std::ceil(x_right)));
+            if (x_begin < x_end)
+                spans.push_back(RowSpan{y, x_begin, x_end});
+        }
+    }
+
+    void LineRasterizer::GetBresenhamSpans(std::vector<RowSpan> &spans) const
+    {
+        // Steps k of the line inside the image (the row of step k is start_.y + k * step_y_)
+        int64_t k_begin, k_end;
+        if (step_y_ > 0)
+        {
+            k_begin = std::max<int64_t>(0, static_cast<int64_t>(clip_row_begin_) - start_.y);
+            k_end = std::min<int64_t>(dy_abs_, static_cast<int64_t>(clip_row_end_) - 1 - start_.y);
+        }
+        else
+        {
+            k_begin = std::max<int64_t>(0, static_cast<int64_t>(start_.y) - (clip_row_end_ - 1));
+            k_end = std::min<int64_t>(dy_abs_, static_cast<int64_t>(start_.y) - clip_row_begin_);
+        }
+
+        auto add_span = [&](int64_t k, int64_t x_begin, int64_t x_end) {
+            auto [clipped_begin, clipped_end] = ClipSpan(x_begin, x_end);
+            if (clipped_begin < clipped_end)
+                spans.push_back(RowSpan{static_cast<Unit>(start_.y + k * step_y_), clipped_begin, clipped_end});
+        };
+
+        if (k_begin > k_end)
+            return;
+
+        // Horizontal line is a single row
+        if (dy_abs_ == 0)
+        {
+            add_span(0, 0, dx_ + 1);
+            return;
+        }
+
+        // The divisions of the steps are carried from row to row (the numerators grow by 2 * dx each row)
+        const int64_t denominator = 2 * dy_abs_;
+
+        // Mostly vertical lines have one pixel per row: x = round(k * dx / dy) = floor((2 * dx * k + dy) / (2 * dy))
+        if (dx_ < dy_abs_)
+        {
+            const int64_t numerator = 2 * dx_ * k_begin + dy_abs_;
+            int64_t x = numerator / denominator;
+            int64_t remainder = numerator % denominator;
+
+            for (int64_t k = k_begin; k <= k_end; k++)
+            {
+                add_span(k, x, x + 1);
+
+                // 2 * dx < 2 * dy -> at most one pixel to the right
+                remainder += 2 * dx_;
+                if (remainder >= denominator)
+                {
+                    remainder -= denominator;
+                    x++;
+                }
+            }
+            return;
+        }
+
+        // Mostly horizontal lines have the slice of x with round(x * dy / dx) == k in each row,
+        // it ends at ceil((2 * k + 1) * dx / (2 * dy)) and begins where the slice of the previous row ended
+        const int64_t step = 2 * dx_ / denominator;
+        const int64_t step_remainder = 2 * dx_ % denominator;
+
+        const int64_t numerator = (2 * k_begin + 1) * dx_ + denominator - 1;
+        int64_t x_begin = k_begin == 0 ? 0 : ((2 * k_begin - 1) * dx_ + denominator - 1) / denominator;
+        int64_t x_end = numerator / denominator;
+        int64_t remainder = numerator % denominator;
+
+        for (int64_t k = k_begin; k <= k_end; k++)
+        {
+            add_span(k, x_begin, k == dy_abs_ ? dx_ + 1 : x_end);
+
+            x_begin = x_end;
+            x_end += step;
+            remainder += step_remainder;
+            if (remainder >= denominator)
+            {
+                remainder -= denominator;
+                x_end++;
+            }
+        }
+    }
+
+    std::pair<Unit, Unit> LineRasterizer::CoverageSpan(Unit y)
+    {
+        // Pixels with any coverage are at most half a pixel outside of the rectangle
+        double x_left, x_right;
+        if (!RowInterval(y, 0.5, x_left, x_right))
+            return {0, 0};
+
+        auto [x_begin, x_end] = ClipSpan(static_cast<int64_t>(std::ceil(x_left)), static_cast<int64_t>(std::ceil(x_right)));
+        if (x_begin >= x_end)
+            return {0, 0};
+
+        const double y_rel = static_cast<double>(y) - start_.y;
+        coverage_.resize(x_end - x_begin);
+        for (Unit x = x_begin; x < x_end; x++)
+        {
+            const double x_rel = static_cast<double>(x) - start_.x;
+            const double across = x_rel * nx_ + y_rel * ny_;
+            const double along = x_rel * ux_ + y_rel * uy_;
+
+            // Coverage of the pixel by the width and by the length of the line
+            const double coverage_across = std::clamp(half_width_ + 0.5 - std::abs(across), 0.0, 1.0);
+            const double coverage_along = std::clamp(std::min(along + cap_, length_ + cap_ - along) + 0.5, 0.0, 1.0);
+            coverage_[x - x_begin] = static_cast<uint8_t>(std::lround(coverage_across * coverage_along * 255.0));
+        }
+
+        // Skip the pixels without coverage at both ends
+        auto first = std::find_if(coverage_.begin(), coverage_.end(), [](uint8_t c) { return c != 0; });
+        if (first == coverage_.end())
+            return {0, 0};
+
+        auto last = std::find_if(coverage_.rbegin(), coverage_.rend(), [](uint8_t c) { return c != 0; });
+        x_end -= static_cast<Unit>(last - coverage_.rbegin());
+        x_begin += static_cast<Unit>(first - coverage_.begin());
+        coverage_.erase(coverage_.begin(), first);
+
+        return {x_begin, x_end};
+    }
+
+    bool LineRasterizer::RowInterval(Unit y, double grow, double &x_left, double &x_right) const
+    {
+        const double y_rel = static_cast<double>(y) - start_.y;
+
+        x_left = std::numeric_limits<double>::lowest();
+        x_right = std::numeric_limits<double>::max();
+
+        // Limits x by low <= x * a + c < high (with inverse_a = 1 / a)
+        auto limit = [&](double inverse_a, double c, double low, double high) {
+            if (inverse_a == 0)
+                return low <= c && c < high;
+
+            double x1 = (low - c) * inverse_a;
+            double x2 = (high - c) * inverse_a;
+            if (x1 > x2)
+                std::swap(x1, x2);
+
+            x_left = std::max(x_left, x1);
+            x_right = std::min(x_right, x2);
+            return x_left < x_right;
+        };
+
+        return limit(inverse_nx_, y_rel * ny_, -half_width_ - grow, half_width_ + grow) &&
+               limit(inverse_ux_, y_rel * uy_, -cap_ - grow, length_ + cap_ + grow);
+    }
+
+    std::pair<Unit, Unit> LineRasterizer::ClipSpan(int64_t x_begin, int64_t x_end) const
+    {
+        x_begin = std::max<int64_t>(x_begin + start_.x, 0);
+        x_end = std::min<int64_t>(x_end + start_.x, size_.x);
+        if (x_begin >= x_end)
+            return {0, 0};
+
+        return {static_cast<Unit>(x_begin), static_cast<Unit>(x_end)};
+    }
+
+    CircleRasterizer::CircleRasterizer(Point center, Unit radius, Unit border_width, Point size) : center_(center), size_(size)
+    {
+        // The squares of the doubled radii fit into 64 bits
+        constexpr Unit kMaxRadius = Unit{1} << 30;
+        const uint64_t r = static_cast<uint64_t>(std::clamp<Unit>(radius, 0, kMaxRadius));
+        const uint64_t w = static_cast<uint64_t>(std::clamp<Unit>(border_width, 0, kMaxRadius));
+
+        outer_ = 2 * r + w;
+        inner_ = 2 * r > w ? 2 * r - w : 0;
+
+        // The circle is symmetric -> it is as high as wide
+        const int64_t half = HalfSpan(outer_, 0);
+        if (half < 0)
+            return;
+
+        row_begin_ = static_cast<Unit>(std::clamp<int64_t>(static_cast<int64_t>(center_.y) - half, 0, size_.y));
+        row_end_ = static_cast<Unit>(std::clamp<int64_t>(static_cast<int64_t>(center_.y) + half + 1, 0, size_.y));
+    }
+
+    void CircleRasterizer::ClipRows(Unit row_begin, Unit row_end)
+    {
+        row_begin_ = std::max(row_begin_, row_begin);
+        row_end_ = std::min(row_end_, row_end);
+    }
+
+    void CircleRasterizer::GetSpans(std::vector<RowSpan> &border_spans, std::vector<RowSpan> &fill_spans) const
+    {
+        border_spans.clear();
+        fill_spans.clear();
+
+        for (Unit y = row_begin_; y < row_end_; y++)
+        {
+            const int64_t dy = static_cast<int64_t>(y) - center_.y;
+            const int64_t outer = HalfSpan(outer_, dy);
+            const int64_t inner = HalfSpan(inner_, dy);
+            if (outer < 0)
+                continue;
+
+            // Without the inside the border is a single run
+            if (inner < 0)
+            {
+                AddSpan(border_spans, y, -outer, outer + 1);
+                continue;
+            }
+
+            AddSpan(border_spans, y, -outer, -inner);
+            AddSpan(fill_spans, y, -inner, inner + 1);
+            AddSpan(border_spans, y, inner + 1, outer + 1);
+        }
+    }
+
+    int64_t CircleRasterizer::HalfSpan(uint64_t doubled_radius, int64_t dy)
+    {
+        // The pixel centers with (2 * dx)^2 + (2 * dy)^2 < doubled_radius^2 -> dx^2 <= (doubled_radius^2 - 4 * dy^2 - 1) / 4
+        const uint64_t radius_squared = doubled_radius * doubled_radius;
+        const uint64_t dy_squared = 4 * static_cast<uint64_t>(dy * dy);
+        if (radius_squared <= dy_squared)
+            return -1;
+
+        // Integer square root (the floating point root is off by at most one)
+        const uint64_t n = (radius_squared - dy_squared - 1) / 4;
+        uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+        while (root * root > n)
+            root--;
+        while ((root + 1) * (root + 1) <= n)
+            root++;
+
+        return static_cast<int64_t>(root);
+    }
+
+    void CircleRasterizer::AddSpan(std::vector<RowSpan> &spans, Unit y, int64_t x_begin, int64_t x_end) const
+    {
+        x_begin = std::max<int64_t>(x_begin + center_.x, 0);
+        x_end = std::min<int64_t>(x_end + center_.x, size_.x);
+        if (x_begin < x_end)
+            spans.push_back(RowSpan{y, static_cast<Unit>(x_begin), static_cast<Unit>(x_end)});
+    }
+}
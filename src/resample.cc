@@ -0,0 +1,775 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PAINT_RESAMPLE_X86
+#include <immintrin.h>
+#endif
+
+#include "resample.h"
+#include "convert_span.h"
+#include "palette.h"
+#include "parallel.h"
+#include "srgb.h"
+
+namespace paint
+{
+    namespace
+    {
+        constexpr int32_t kWeightOne = int32_t{1} << ResampleWeights::kWeightBits;
+        constexpr int32_t kWeightRound = kWeightOne >> 1;
+        constexpr double kPi = 3.14159265358979323846;
+
+        // Radius of the filter in source pixels (when not downscaling)
+        double FilterRadius(ResampleFilter filter)
+        {
+            switch (filter)
+            {
+            case ResampleFilter::kBox:
+                return 0.5;
+            case ResampleFilter::kBicubic:
+                return 2.0;
+            case ResampleFilter::kLanczos3:
+                return 3.0;
+            default:
+                return 1.0;
+            }
+        }
+
+        double Sinc(double x)
+        {
+            if (x == 0.0)
+                return 1.0;
+
+            x *= kPi;
+            return std::sin(x) / x;
+        }
+
+        // Weight of the pixel at the distance t from the center of the filter
+        double FilterWeight(ResampleFilter filter, double t)
+        {
+            // The box covers [-0.5, 0.5), so a pixel exactly between 2 destination pixels is counted once
+            if (filter == ResampleFilter::kBox)
+                return t >= -0.5 && t < 0.5 ? 1.0 : 0.0;
+
+            t = std::abs(t);
+            switch (filter)
+            {
+            case ResampleFilter::kBicubic:
+            {
+                constexpr double a = -0.5;
+                if (t < 1.0)
+                    return ((a + 2.0) * t - (a + 3.0)) * t * t + 1.0;
+                if (t < 2.0)
+                    return ((a * t - 5.0 * a) * t + 8.0 * a) * t - 4.0 * a;
+                return 0.0;
+            }
+            case ResampleFilter::kLanczos3:
+                return t < 3.0 ? Sinc(t) * Sinc(t / 3.0) : 0.0;
+            default:
+                return t < 1.0 ? 1.0 - t : 0.0;
+            }
+        }
+
+        // The weighted sum rounded back to a sample (the negative lobes can overshoot both ends)
+        template <typename SampleT, typename Accumulator>
+        SampleT ClampSample(Accumulator sum)
+        {
+            sum >>= ResampleWeights::kWeightBits;
+            return static_cast<SampleT>(std::clamp<Accumulator>(sum, 0, std::numeric_limits<SampleT>::max()));
+        }
+
+        // 8-bit samples are summed in 32 bits, 16-bit samples in 64 bits
+        template <typename SampleT>
+        using Accumulator = std::conditional_t<sizeof(SampleT) == 1, int32_t, int64_t>;
+
+        /**
+         * @brief Filters the pixels of a row horizontally (one destination pixel after another).
+         *
+         */
+        template <typename SampleT, size_t kChannels>
+        void FilterRow(const SampleT *src, SampleT *dst, const ResampleWeights &weights)
+        {
+            for (size_t x = 0; x < weights.first.size(); x++)
+            {
+                const SampleT *pixel = src + weights.first[x] * kChannels;
+                const int16_t *w = weights.values.data() + x * weights.taps;
+
+                Accumulator<SampleT> sum[kChannels];
+                std::fill_n(sum, kChannels, kWeightRound);
+                for (Unit k = 0; k < weights.count[x]; k++)
+                    for (size_t c = 0; c < kChannels; c++)
+                        sum[c] += static_cast<Accumulator<SampleT>>(w[k]) * pixel[k * kChannels + c];
+
+                for (size_t c = 0; c < kChannels; c++)
+                    dst[x * kChannels + c] = ClampSample<SampleT>(sum[c]);
+            }
+        }
+
+        template <typename SampleT>
+        void FilterRowScalar(const SampleT *src, SampleT *dst, const ResampleWeights &weights, size_t channels)
+        {
+            switch (channels)
+            {
+            case 1:
+                FilterRow<SampleT, 1>(src, dst, weights);
+                break;
+            case 3:
+                FilterRow<SampleT, 3>(src, dst, weights);
+                break;
+            default:
+                FilterRow<SampleT, 4>(src, dst, weights);
+                break;
+            }
+        }
+
+#ifdef PAINT_RESAMPLE_X86
+        /*
+         * The horizontal pass multiplies and adds 2 taps of all the channels (24-bit color and BGRA8888) by one madd instruction,
+         * grayscale pixels 8 taps at once. The weights are padded by zeros to whole vectors and the rows are padded
+         * by a vector of samples (see ResampleWeights::taps), so the kernel reads the whole vectors after the last used tap.
+         */
+        __attribute__((target("sse4.1"))) void FilterRowSSE41(const uint8_t *src, uint8_t *dst, const ResampleWeights &weights, size_t channels)
+        {
+            if (channels == 1)
+            {
+                for (size_t x = 0; x < weights.first.size(); x++)
+                {
+                    const uint8_t *pixel = src + weights.first[x];
+                    const int16_t *w = weights.values.data() + x * weights.taps;
+
+                    __m128i sum = _mm_setzero_si128();
+                    for (Unit k = 0; k < weights.count[x]; k += 8)
+                    {
+                        const __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel + k)));
+                        sum = _mm_add_epi32(sum, _mm_madd_epi16(a, _mm_loadu_si128(reinterpret_cast<const __m128i *>(w + k))));
+                    }
+
+                    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+                    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+                    dst[x] = ClampSample<uint8_t>(_mm_cvtsi128_si32(sum) + kWeightRound);
+                }
+                return;
+            }
+
+            for (size_t x = 0; x < weights.first.size(); x++)
+            {
+                const uint8_t *pixel = src + weights.first[x] * channels;
+                const int16_t *w = weights.values.data() + x * weights.taps;
+
+                // The channels of 2 pixels interleaved (the 4th channel of 24-bit color is the next pixel, its sum is not used)
+                __m128i sum = _mm_set1_epi32(kWeightRound);
+                for (Unit k = 0; k < weights.count[x]; k += 2)
+                {
+                    int32_t a_bytes;
+                    int32_t b_bytes;
+                    std::memcpy(&a_bytes, pixel + k * channels, sizeof(a_bytes));
+                    std::memcpy(&b_bytes, pixel + (k + 1) * channels, sizeof(b_bytes));
+                    const __m128i a = _mm_cvtepu8_epi16(_mm_cvtsi32_si128(a_bytes));
+                    const __m128i b = _mm_cvtepu8_epi16(_mm_cvtsi32_si128(b_bytes));
+                    const int32_t pair = static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint16_t>(w[k])) | (static_cast<uint32_t>(static_cast<uint16_t>(w[k + 1])) << 16));
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), _mm_set1_epi32(pair)));
+                }
+
+                const __m128i words = _mm_packs_epi32(_mm_srai_epi32(sum, ResampleWeights::kWeightBits), _mm_setzero_si128());
+                const int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+                std::memcpy(dst + x * channels, &bytes, channels);
+            }
+        }
+#endif
+
+        using FilterRowKernel = void (*)(const uint8_t *src, uint8_t *dst, const ResampleWeights &weights, size_t channels);
+
+        FilterRowKernel SelectFilterRowKernel(SimdLevel level)
+        {
+#ifdef PAINT_RESAMPLE_X86
+            if (level >= SimdLevel::kSSE41)
+                return FilterRowSSE41;
+#else
+            (void)level;
+#endif
+            return FilterRowScalar<uint8_t>;
+        }
+
+        const FilterRowKernel filter_row_kernels[] = {SelectFilterRowKernel(SimdLevel::kScalar), SelectFilterRowKernel(SimdLevel::kSSE41),
+                                                      SelectFilterRowKernel(SimdLevel::kAVX2), SelectFilterRowKernel(SimdLevel::kAVX512)};
+
+        void FilterRow(const uint8_t *src, uint8_t *dst, const ResampleWeights &weights, size_t channels)
+        {
+            filter_row_kernels[static_cast<int>(GetSimdLevel())](src, dst, weights, channels);
+        }
+
+        void FilterRow(const uint16_t *src, uint16_t *dst, const ResampleWeights &weights, size_t channels)
+        {
+            FilterRowScalar(src, dst, weights, channels);
+        }
+
+        /*
+         * The vertical pass sums the same samples of the rows, so whole vectors of samples are filtered at once.
+         * The weights come in pairs (the low 16 bits weight the even row, the high 16 bits the odd row),
+         * so 2 rows are multiplied and added by one madd instruction. An odd row has a pair with the weight 0.
+         */
+
+        // dst[i] = sum of the weighted rows[k][i] for the samples [begin, end)
+        template <typename SampleT>
+        void FilterColumnsRange(const SampleT *const *rows, const int32_t *weight_pairs, size_t pair_count, SampleT *dst, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                Accumulator<SampleT> sum = kWeightRound;
+                for (size_t k = 0; k < pair_count; k++)
+                {
+                    sum += static_cast<Accumulator<SampleT>>(static_cast<int16_t>(weight_pairs[k] & 0xFFFF)) * rows[2 * k][i];
+                    sum += static_cast<Accumulator<SampleT>>(static_cast<int16_t>(weight_pairs[k] >> 16)) * rows[2 * k + 1][i];
+                }
+
+                dst[i] = ClampSample<SampleT>(sum);
+            }
+        }
+
+        template <typename SampleT>
+        void FilterColumnsScalar(const SampleT *const *rows, const int32_t *weight_pairs, size_t pair_count, SampleT *dst, size_t n)
+        {
+            FilterColumnsRange(rows, weight_pairs, pair_count, dst, 0, n);
+        }
+
+#ifdef PAINT_RESAMPLE_X86
+        __attribute__((target("sse4.1"))) void FilterColumnsSSE41(const uint8_t *const *rows, const int32_t *weight_pairs, size_t pair_count, uint8_t *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i sum_low = _mm_set1_epi32(kWeightRound);
+                __m128i sum_high = _mm_set1_epi32(kWeightRound);
+                for (size_t k = 0; k < pair_count; k++)
+                {
+                    const __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[2 * k] + i)));
+                    const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[2 * k + 1] + i)));
+                    const __m128i w = _mm_set1_epi32(weight_pairs[k]);
+                    sum_low = _mm_add_epi32(sum_low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+                    sum_high = _mm_add_epi32(sum_high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+                }
+
+                const __m128i words = _mm_packs_epi32(_mm_srai_epi32(sum_low, ResampleWeights::kWeightBits), _mm_srai_epi32(sum_high, ResampleWeights::kWeightBits));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(words, words));
+            }
+
+            FilterColumnsRange(rows, weight_pairs, pair_count, dst, i, n);
+        }
+
+        __attribute__((target("avx2"))) void FilterColumnsAVX2(const uint8_t *const *rows, const int32_t *weight_pairs, size_t pair_count, uint8_t *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                // The unpacks and packs work in the 128-bit lanes, so the samples end up in their order
+                __m256i sum_low = _mm256_set1_epi32(kWeightRound);
+                __m256i sum_high = _mm256_set1_epi32(kWeightRound);
+                for (size_t k = 0; k < pair_count; k++)
+                {
+                    const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[2 * k] + i)));
+                    const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[2 * k + 1] + i)));
+                    const __m256i w = _mm256_set1_epi32(weight_pairs[k]);
+                    sum_low = _mm256_add_epi32(sum_low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+                    sum_high = _mm256_add_epi32(sum_high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+                }
+
+                const __m256i words = _mm256_packs_epi32(_mm256_srai_epi32(sum_low, ResampleWeights::kWeightBits), _mm256_srai_epi32(sum_high, ResampleWeights::kWeightBits));
+                const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(bytes));
+            }
+
+            FilterColumnsRange(rows, weight_pairs, pair_count, dst, i, n);
+        }
+#endif
+
+        using FilterColumnsKernel = void (*)(const uint8_t *const *rows, const int32_t *weight_pairs, size_t pair_count, uint8_t *dst, size_t n);
+
+        FilterColumnsKernel SelectFilterColumnsKernel(SimdLevel level)
+        {
+#ifdef PAINT_RESAMPLE_X86
+            if (level >= SimdLevel::kAVX2)
+                return FilterColumnsAVX2;
+            if (level >= SimdLevel::kSSE41)
+                return FilterColumnsSSE41;
+#else
+            (void)level;
+#endif
+            return FilterColumnsScalar<uint8_t>;
+        }
+
+        const FilterColumnsKernel filter_columns_kernels[] = {SelectFilterColumnsKernel(SimdLevel::kScalar), SelectFilterColumnsKernel(SimdLevel::kSSE41),
+                                                              SelectFilterColumnsKernel(SimdLevel::kAVX2), SelectFilterColumnsKernel(SimdLevel::kAVX512)};
+
+        void FilterColumns(const uint8_t *const *rows, const int32_t *weight_pairs, size_t pair_count, uint8_t *dst, size_t n)
+        {
+            filter_columns_kernels[static_cast<int>(GetSimdLevel())](rows, weight_pairs, pair_count, dst, n);
+        }
+
+        void FilterColumns(const uint16_t *const *rows, const int32_t *weight_pairs, size_t pair_count, uint16_t *dst, size_t n)
+        {
+            FilterColumnsScalar(rows, weight_pairs, pair_count, dst, n);
+        }
+
+        // Premultiplied color channels cannot be over the alpha (the negative lobes can push them over)
+        void ClampPremultiplied(uint8_t *pixels, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                uint8_t *pixel = pixels + i * 4;
+                for (size_t c = 0; c < 3; c++)
+                    pixel[c] = std::min(pixel[c], pixel[3]);
+            }
+        }
+
+        // 565 and indexed pixels are filtered as 24-bit color, BW pixels as grayscale
+        ColorFormat GetWorkFormat(ColorFormat format)
+        {
+            if (format == ColorFormat::kRGB565 || format == ColorFormat::kBGR565 || format == ColorFormat::kIndexed8)
+                return ColorFormat::kRGB888;
+            if (format == ColorFormat::kBW)
+                return ColorFormat::kGrayscale;
+            return format;
+        }
+
+        // BW has no colors to mix, indexed pixels get the palette colors, premultiplied alpha is mixed as stored
+        bool IsMixedInLinearLight(ColorFormat format, bool linear_light)
+        {
+            return linear_light && format != ColorFormat::kBW && format != ColorFormat::kIndexed8 && format != ColorFormat::kBGRA8888;
+        }
+
+        /**
+         * @brief Reads the rows of data as the samples of the work format (decoded into linear light for 16-bit samples).
+         *
+         */
+        template <typename SampleT>
+        class SampleReader
+        {
+        public:
+            SampleReader(const DataPixels &data, ColorFormat work_format, Unit width) : data_(data),
+                                                                                      work_format_(work_format),
+                                                                                      row_samples_(static_cast<size_t>(width) * PixelSize(work_format)),
+                                                                                      work_row_(sizeof(SampleT) == 1 ? 0 : row_samples_) {}
+
+            void Read(Unit y, SampleT *samples)
+            {
+                if constexpr (sizeof(SampleT) == 1)
+                    data_.ConvertRowTo(y, work_format_, samples);
+                else
+                {
+                    data_.ConvertRowTo(y, work_format_, work_row_.data());
+                    SrgbToLinearSpan(work_row_.data(), samples, row_samples_);
+                }
+            }
+
+        private:
+            const DataPixels &data_;
+            ColorFormat work_format_;
+            size_t row_samples_;
+            std::vector<uint8_t> work_row_;
+        };
+
+        /**
+         * @brief Writes the samples of the work format into the rows of new_data (encoded from linear light for 16-bit samples).
+         *
+         * Premultiplied colors are clamped to their alpha and indexed pixels get the nearest palette color (see PaletteMapper).
+         *
+         */
+        template <typename SampleT>
+        class SampleWriter
+        {
+        public:
+            SampleWriter(DataPixels &new_data, ColorFormat work_format, Unit width) : new_data_(new_data),
+                                                                                     format_(new_data.GetColorFormat()),
+                                                                                     work_format_(work_format),
+                                                                                     width_(width),
+                                                                                     work_row_(sizeof(SampleT) == 1 ? 0 : static_cast<size_t>(width) * PixelSize(work_format)),
+                                                                                     new_row_(format_ == work_format ? 0 : static_cast<size_t>(width) * PixelSize(format_))
+            {
+                if (format_ == ColorFormat::kIndexed8)
+                    mapper_.emplace(*new_data.GetPalette());
+            }
+
+            // The samples can be changed
+            void Write(Unit y, SampleT *samples)
+            {
+                const uint8_t *work_pixels;
+                if constexpr (sizeof(SampleT) == 1)
+                {
+                    if (work_format_ == ColorFormat::kBGRA8888)
+                        ClampPremultiplied(samples, width_);
+                    work_pixels = samples;
+                }
+                else
+                {
+                    LinearToSrgbSpan(samples, work_row_.data(), work_row_.size());
+                    work_pixels = work_row_.data();
+                }
+
+                if (format_ == work_format_)
+                {
+                    new_data_.CopyRowFrom(y, work_pixels);
+                    return;
+                }
+
+                if (mapper_)
+                    mapper_->MapSpan(reinterpret_cast<const PixelRGB888 *>(work_pixels), new_row_.data(), width_);
+                else
+                    ConvertSpan(work_format_, format_, work_pixels, new_row_.data(), width_);
+                new_data_.CopyRowFrom(y, new_row_.data());
+            }
+
+        private:
+            DataPixels &new_data_;
+            ColorFormat format_;
+            ColorFormat work_format_;
+            Unit width_;
+            std::vector<uint8_t> work_row_;
+            std::vector<uint8_t> new_row_;
+            std::optional<PaletteMapper> mapper_;
+        };
+
+        /**
+         * @brief Resamples the rows of data converted into work_format (8-bit channels or 16-bit linear light channels).
+         *
+         */
+        template <typename SampleT>
+        void ResampleSamples(DataPixels &data, DataPixels &new_data, ColorFormat work_format, const ResampleWeights &weights_x, const ResampleWeights &weights_y, unsigned thread_count)
+        {
+            const bool is_premultiplied = work_format == ColorFormat::kBGRA8888;
+            const size_t channels = PixelSize(work_format);
+            const Point size = data.GetSize();
+            const Point new_size = new_data.GetSize();
+            const size_t src_row_samples = static_cast<size_t>(size.x) * channels;
+            const size_t new_row_samples = static_cast<size_t>(new_size.x) * channels;
+
+            // The rows filtered horizontally (the old height, the new width)
+            std::vector<SampleT> filtered(new_row_samples * size.y);
+
+            std::atomic<Unit> next_row{0};
+            RunOnThreads(thread_count, [&]() {
+                SampleReader<SampleT> reader(data, work_format, size.x);
+
+                // The row padded by the taps read after the last pixel
+                std::vector<SampleT> samples(src_row_samples + (weights_x.taps + 2) * channels);
+
+                for (Unit y = next_row++; y < size.y; y = next_row++)
+                {
+                    reader.Read(y, samples.data());
+
+                    SampleT *filtered_row = filtered.data() + y * new_row_samples;
+                    FilterRow(samples.data(), filtered_row, weights_x, channels);
+                    if constexpr (sizeof(SampleT) == 1)
+                        if (is_premultiplied)
+                            ClampPremultiplied(filtered_row, new_size.x);
+                }
+            });
+
+            std::atomic<Unit> next_new_row{0};
+            RunOnThreads(thread_count, [&]() {
+                SampleWriter<SampleT> writer(new_data, work_format, new_size.x);
+                std::vector<const SampleT *> rows(weights_y.taps + 1);
+                std::vector<int32_t> weight_pairs((weights_y.taps + 1) / 2);
+                std::vector<SampleT> samples(new_row_samples);
+
+                for (Unit y = next_new_row++; y < new_size.y; y = next_new_row++)
+                {
+                    // The used rows in pairs (the padding row has the weight 0)
+                    const Unit first = weights_y.first[y];
+                    const Unit count = weights_y.count[y];
+                    const int16_t *w = weights_y.values.data() + y * weights_y.taps;
+                    const size_t pair_count = (count + 1) / 2;
+                    for (size_t k = 0; k < pair_count * 2; k++)
+                        rows[k] = filtered.data() + (first + std::min<Unit>(k, count - 1)) * new_row_samples;
+                    for (size_t k = 0; k < pair_count; k++)
+                    {
+                        const uint16_t even = static_cast<uint16_t>(w[2 * k]);
+                        const uint16_t odd = 2 * k + 1 < static_cast<size_t>(count) ? static_cast<uint16_t>(w[2 * k + 1]) : 0;
+                        weight_pairs[k] = static_cast<int32_t>(static_cast<uint32_t>(even) | (static_cast<uint32_t>(odd) << 16));
+                    }
+
+                    FilterColumns(rows.data(), weight_pairs.data(), pair_count, samples.data(), new_row_samples);
+                    writer.Write(y, samples.data());
+                }
+            });
+        }
+
+        /**
+         * @brief Averages the blocks of factor.x * factor.y pixels of data into the pixels of new_data.
+         *
+         * Every new row adds its block of rows into one row of column sums (a plain loop over the samples), the sums of factor.x
+         * columns are then added and divided once, so the result is the exact rounded average. SumT has to hold the sum of a block.
+         *
+         */
+        template <typename SampleT, typename SumT>
+        void AverageBlocks(DataPixels &data, DataPixels &new_data, ColorFormat work_format, Point factor, unsigned thread_count)
+        {
+            const size_t channels = PixelSize(work_format);
+            const Point size = data.GetSize();
+            const Point new_size = new_data.GetSize();
+            const SumT block_size = static_cast<SumT>(factor.x) * static_cast<SumT>(factor.y);
+
+            std::atomic<Unit> next_new_row{0};
+            RunOnThreads(thread_count, [&]() {
+                SampleReader<SampleT> reader(data, work_format, size.x);
+                SampleWriter<SampleT> writer(new_data, work_format, new_size.x);
+                std::vector<SampleT> samples(static_cast<size_t>(size.x) * channels);
+                std::vector<SampleT> new_samples(static_cast<size_t>(new_size.x) * channels);
+                std::vector<SumT> column_sums(samples.size());
+
+                for (Unit y = next_new_row++; y < new_size.y; y = next_new_row++)
+                {
+                    std::fill(column_sums.begin(), column_sums.end(), 0);
+                    for (Unit block_y = y * factor.y; block_y < (y + 1) * factor.y; block_y++)
+                    {
+                        reader.Read(block_y, samples.data());
+                        for (size_t i = 0; i < samples.size(); i++)
+                            column_sums[i] += samples[i];
+                    }
+
+                    const SumT *column_sum = column_sums.data();
+                    for (Unit x = 0; x < new_size.x; x++)
+                    {
+                        for (size_t c = 0; c < channels; c++)
+                        {
+                            SumT sum = block_size / 2;
+                            for (Unit i = 0; i < factor.x; i++)
+                                sum += column_sum[i * channels + c];
+                            new_samples[x * channels + c] = static_cast<SampleT>(sum / block_size);
+                        }
+                        column_sum += factor.x * channels;
+                    }
+                    writer.Write(y, new_samples.data());
+                }
+            });
+        }
+
+        /**
+         * @brief Halves data level_count times (see MakePyramid()), the levels have to be created already.
+         *
+         * The source rows are read in bands of 2^level_count rows. The rows of a band are summed by pairs of pixels and pairs
+         * of rows into the rows of the first level, each completed row of sums is summed the same way into the next level.
+         * A band makes whole rows of all the levels, so the bands are summed in parallel and every source row is read once.
+         *
+         */
+        template <typename SampleT>
+        void SumPyramid(DataPixels &data, std::vector<std::shared_ptr<DataPixels>> &levels, ColorFormat work_format, unsigned thread_count)
+        {
+            const size_t channels = PixelSize(work_format);
+            const Point size = data.GetSize();
+            const size_t level_count = levels.size();
+            const Unit band_height = Unit{1} << level_count;
+            const Unit band_count = (size.y + band_height - 1) / band_height;
+
+            std::atomic<Unit> next_band{0};
+            RunOnThreads(thread_count, [&]() {
+                SampleReader<SampleT> reader(data, work_format, size.x);
+                std::vector<SampleT> samples(static_cast<size_t>(size.x) * channels);
+                std::vector<uint64_t> source_sums(samples.size());
+
+                // The first row of a pair of rows of each level (summed by pairs of pixels), the summed pair and its pixels
+                std::vector<std::vector<uint64_t>> pending(level_count);
+                std::vector<std::vector<uint64_t>> row_sums(level_count);
+                std::vector<std::vector<SampleT>> level_samples(level_count);
+                std::vector<std::optional<SampleWriter<SampleT>>> writers(level_count);
+                for (size_t level = 0; level < level_count; level++)
+                {
+                    const Unit width = levels[level]->GetSize().x;
+                    pending[level].resize(static_cast<size_t>(width) * channels);
+                    row_sums[level].resize(pending[level].size());
+                    level_samples[level].resize(pending[level].size());
+                    writers[level].emplace(*levels[level], work_format, width);
+                }
+
+                // Adds the row y of the sums of the previous level (width of the previous level) into the level
+                std::function<void(size_t, const uint64_t *, Unit)> add_row = [&](size_t level, const uint64_t *sums, Unit y) {
+                    const Point level_size = levels[level]->GetSize();
+                    if (y / 2 >= level_size.y)
+                        return;
+
+                    // The even row is kept until the odd row comes
+                    std::vector<uint64_t> &pair_sums = y % 2 ? row_sums[level] : pending[level];
+                    for (Unit x = 0; x < level_size.x; x++)
+                        for (size_t c = 0; c < channels; c++)
+                            pair_sums[x * channels + c] = sums[2 * x * channels + c] + sums[(2 * x + 1) * channels + c];
+                    if (y % 2 == 0)
+                        return;
+
+                    for (size_t i = 0; i < pair_sums.size(); i++)
+                        pair_sums[i] += pending[level][i];
+
+                    // Level n sums 4^(n + 1) pixels
+                    const unsigned shift = 2 * static_cast<unsigned>(level + 1);
+                    const uint64_t half = uint64_t{1} << (shift - 1);
+                    for (size_t i = 0; i < pair_sums.size(); i++)
+                        level_samples[level][i] = static_cast<SampleT>((pair_sums[i] + half) >> shift);
+                    writers[level]->Write(y / 2, level_samples[level].data());
+
+                    if (level + 1 < level_count)
+                        add_row(level + 1, pair_sums.data(), y / 2);
+                };
+
+                for (Unit band = next_band++; band < band_count; band = next_band++)
+                {
+                    for (Unit y = band * band_height; y < std::min((band + 1) * band_height, levels[0]->GetSize().y * 2); y++)
+                    {
+                        reader.Read(y, samples.data());
+                        std::copy(samples.begin(), samples.end(), source_sums.begin());
+                        add_row(0, source_sums.data(), y);
+                    }
+                }
+            });
+        }
+    }
+
+    ResampleWeights::ResampleWeights(ResampleFilter filter, Unit src_size, Unit dst_size) : first(dst_size), count(dst_size)
+    {
+        const double scale = static_cast<double>(src_size) / static_cast<double>(dst_size);
+        const double filter_scale = std::max(scale, 1.0);
+        const double support = FilterRadius(filter) * filter_scale;
+
+        // The source pixels [begin, end) around the center of every destination pixel, clamped into the image
+        const size_t max_taps = std::min<size_t>(static_cast<size_t>(std::ceil(2.0 * support)) + 2, src_size);
+        std::vector<double> contributions(max_taps);
+        std::vector<int16_t> all_values(max_taps * dst_size, 0);
+        taps = 1;
+
+        for (Unit x = 0; x < dst_size; x++)
+        {
+            const double center = (x + 0.5) * scale;
+            const Unit begin = static_cast<Unit>(std::floor(center - support));
+            const Unit end = static_cast<Unit>(std::ceil(center + support));
+            const Unit low = std::clamp<Unit>(begin, 0, src_size - 1);
+            const Unit high = std::clamp<Unit>(end - 1, 0, src_size - 1);
+
+            std::fill(contributions.begin(), contributions.end(), 0.0);
+            double total = 0.0;
+            for (Unit i = begin; i < end; i++)
+            {
+                const double weight = FilterWeight(filter, (i + 0.5 - center) / filter_scale);
+                contributions[std::clamp<Unit>(i, 0, src_size - 1) - low] += weight;
+                total += weight;
+            }
+
+            // Nothing under the filter (cannot happen for the filters above) -> the nearest pixel
+            if (total == 0.0)
+            {
+                std::fill(contributions.begin(), contributions.end(), 0.0);
+                contributions[std::clamp<Unit>(static_cast<Unit>(center), low, high) - low] = 1.0;
+                total = 1.0;
+            }
+
+            // Round the weights, the rounding error goes to the biggest weight
+            int16_t *values_x = all_values.data() + x * max_taps;
+            int32_t sum = 0;
+            size_t biggest = 0;
+            for (Unit i = 0; i <= high - low; i++)
+            {
+                values_x[i] = static_cast<int16_t>(std::lround(contributions[i] / total * kWeightOne));
+                sum += values_x[i];
+                if (values_x[i] > values_x[biggest])
+                    biggest = i;
+            }
+            values_x[biggest] = static_cast<int16_t>(values_x[biggest] + kWeightOne - sum);
+
+            // Skip the pixels with the weight 0 at both ends
+            Unit skip = 0;
+            Unit used = high - low + 1;
+            while (used > 1 && values_x[skip] == 0)
+            {
+                skip++;
+                used--;
+            }
+            while (used > 1 && values_x[skip + used - 1] == 0)
+                used--;
+
+            std::copy_n(values_x + skip, used, values_x);
+            std::fill(values_x + used, values_x + max_taps, 0);
+            first[x] = low + skip;
+            count[x] = used;
+            taps = std::max<size_t>(taps, used);
+        }
+
+        // Whole vectors of the weights (see FilterRowSSE41())
+        taps = (taps + 7) & ~size_t{7};
+        values.assign(taps * dst_size, 0);
+        for (Unit x = 0; x < dst_size; x++)
+            std::copy_n(all_values.data() + x * max_taps, count[x], values.data() + x * taps);
+    }
+
+    void Resample(DataPixels &data, DataPixels &new_data, ResampleFilter filter, bool linear_light, unsigned thread_count)
+    {
+        const ColorFormat work_format = GetWorkFormat(data.GetColorFormat());
+        const bool is_linear_light = IsMixedInLinearLight(data.GetColorFormat(), linear_light);
+        const Point size = data.GetSize();
+        const Point new_size = new_data.GetSize();
+
+        // No pixels to resample
+        if (new_size.x <= 0 || new_size.y <= 0 || size.x <= 0 || size.y <= 0)
+            return;
+
+        if (thread_count == 0)
+            thread_count = DefaultThreadCount();
+
+        // The box filter of an integer factor covers whole blocks of pixels -> their averages
+        if (filter == ResampleFilter::kBox && new_size.x > 0 && new_size.y > 0 && size.x % new_size.x == 0 && size.y % new_size.y == 0)
+        {
+            const Point factor{size.x / new_size.x, size.y / new_size.y};
+            const uint64_t max_block_sum = static_cast<uint64_t>(factor.x) * static_cast<uint64_t>(factor.y) * (is_linear_light ? 0xFFFF : 0xFF) * 2;
+            const bool is_32_bit_sum = max_block_sum <= std::numeric_limits<uint32_t>::max();
+            if (is_linear_light && is_32_bit_sum)
+                AverageBlocks<uint16_t, uint32_t>(data, new_data, work_format, factor, thread_count);
+            else if (is_linear_light)
+                AverageBlocks<uint16_t, uint64_t>(data, new_data, work_format, factor, thread_count);
+            else if (is_32_bit_sum)
+                AverageBlocks<uint8_t, uint32_t>(data, new_data, work_format, factor, thread_count);
+            else
+                AverageBlocks<uint8_t, uint64_t>(data, new_data, work_format, factor, thread_count);
+            return;
+        }
+
+        const ResampleWeights weights_x(filter, size.x, new_size.x);
+        const ResampleWeights weights_y(filter, size.y, new_size.y);
+
+        if (is_linear_light)
+            ResampleSamples<uint16_t>(data, new_data, work_format, weights_x, weights_y, thread_count);
+        else
+            ResampleSamples<uint8_t>(data, new_data, work_format, weights_x, weights_y, thread_count);
+    }
+
+    std::vector<std::shared_ptr<DataPixels>> MakePyramid(DataPixels &data, size_t level_count, bool linear_light, unsigned thread_count)
+    {
+        const Point size = data.GetSize();
+
+        if (thread_count == 0)
+            thread_count = DefaultThreadCount();
+
+        // Every level has at least 1 pixel
+        std::vector<std::shared_ptr<DataPixels>> levels;
+        for (size_t level = 1; level <= level_count && (size.x >> level) > 0 && (size.y >> level) > 0; level++)
+        {
+            const Point level_size{size.x >> level, size.y >> level};
+            const PixelLayout layout = data.GetLayout();
+            levels.push_back(std::make_shared<DataPixels>(level_size, data.GetColorType(), layout, data.GetRowAlignment()));
+        }
+
+        if (levels.empty())
+            return levels;
+
+        const ColorFormat work_format = GetWorkFormat(data.GetColorFormat());
+        if (IsMixedInLinearLight(data.GetColorFormat(), linear_light))
+            SumPyramid<uint16_t>(data, levels, work_format, thread_count);
+        else
+            SumPyramid<uint8_t>(data, levels, work_format, thread_count);
+
+        return levels;
+    }
+}
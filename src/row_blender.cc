@@ -0,0 +1,23 @@
+#include "row_blender.h"
+#include "color_bgra8888.h"
+
+namespace paint
+{
+    std::optional<PixelBGRA8888> TranslucentPixel(const Color &color)
+    {
+        if (color.GetColorFormat() != ColorFormat::kBGRA8888)
+            return std::nullopt;
+
+        const PixelBGRA8888 pixel = color.ToBGRA8888().GetPixel();
+        if (pixel.a == 255)
+            return std::nullopt;
+
+        return pixel;
+    }
+
+    RowBlender::RowBlender(DataPixels &data) : data_(data), format_(data.GetColorFormat()), pixel_size_(PixelSize(format_))
+    {
+        if (format_ == ColorFormat::kIndexed8)
+            mapper_.emplace(*data.GetPalette());
+    }
+}
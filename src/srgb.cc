@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PAINT_SRGB_X86
+#include <immintrin.h>
+#endif
+
+#include "srgb.h"
+#include "convert_span.h"
+#include "pixel_traits.h"
+
+namespace paint
+{
+    namespace
+    {
+        constexpr int kLinearToSrgbBits = 12; // Linear light is looked up by its top 12 bits
+
+        /*
+         * sRGB transfer function tables.
+         *  - Decoding: 256 entries of 16-bit linear light.
+         *  - Encoding: 4096 entries, every entry is the encoded center of its range of linear light.
+         */
+        struct SrgbTables
+        {
+            uint16_t to_linear[256];
+            uint8_t to_srgb[1 << kLinearToSrgbBits];
+
+            SrgbTables()
+            {
+                for (int v = 0; v < 256; v++)
+                {
+                    double c = v / 255.0;
+                    double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+                    to_linear[v] = static_cast<uint16_t>(std::lround(linear * 65535.0));
+                }
+
+                constexpr int shift = 16 - kLinearToSrgbBits;
+                for (int i = 0; i < (1 << kLinearToSrgbBits); i++)
+                {
+                    double linear = std::min(((i << shift) + (1 << shift) / 2.0) / 65535.0, 1.0);
+                    double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                    to_srgb[i] = static_cast<uint8_t>(std::clamp(std::lround(c * 255.0), 0l, 255l));
+                }
+            }
+        };
+
+        const SrgbTables kSrgbTables;
+
+        // Rec. 709 weights in 1 / 65536 (they sum up to 65536, so white stays white)
+        constexpr uint32_t kLinearRedWeight = 13933;
+        constexpr uint32_t kLinearGreenWeight = 46871;
+        constexpr uint32_t kLinearBlueWeight = 4732;
+        static_assert(kLinearRedWeight + kLinearGreenWeight + kLinearBlueWeight == 65536);
+
+        // Luminance -> index of SrgbTables::to_srgb: the luminance is rounded to 16 bits and looked up by its top bits
+        constexpr int kLuminanceIndexShift = 16 + 16 - kLinearToSrgbBits;
+        constexpr uint32_t kLuminanceRounding = 1u << 15;
+
+        /*
+         * The decoded channels multiplied by their weights, so the luminance in 1 / 65536 is the sum of 3 lookups
+         * (at most 65536 * 65535, it fits into 32 bits).
+         */
+        struct LuminanceTables
+        {
+            uint32_t red[256];
+            uint32_t green[256];
+            uint32_t blue[256];
+
+            LuminanceTables()
+            {
+                for (int v = 0; v < 256; v++)
+                {
+                    red[v] = kLinearRedWeight * kSrgbTables.to_linear[v];
+                    green[v] = kLinearGreenWeight * kSrgbTables.to_linear[v];
+                    blue[v] = kLinearBlueWeight * kSrgbTables.to_linear[v];
+                }
+            }
+        };
+
+        const LuminanceTables kLuminanceTables;
+
+        template <ColorFormat SrcFormat>
+        void LinearLuminanceSpanScalar(const uint8_t *src, uint8_t *dst, size_t n)
+        {
+            constexpr size_t r = PixelTraits<SrcFormat>::kRed.offset_bits / 8;
+            constexpr size_t g = PixelTraits<SrcFormat>::kGreen.offset_bits / 8;
+            constexpr size_t b = PixelTraits<SrcFormat>::kBlue.offset_bits / 8;
+
+            for (size_t i = 0; i < n; i++)
+            {
+                const uint32_t luminance = kLuminanceTables.red[src[3 * i + r]] + kLuminanceTables.green[src[3 * i + g]] + kLuminanceTables.blue[src[3 * i + b]];
+                dst[i] = kSrgbTables.to_srgb[(luminance + kLuminanceRounding) >> kLuminanceIndexShift];
+            }
+        }
+
+        void LerpLinearSpanScalar(const uint16_t *a, const uint16_t *b, int32_t weight, uint16_t *dst, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+                dst[i] = static_cast<uint16_t>(a[i] + (((b[i] - a[i]) * weight + (1 << (kLerpWeightBits - 1))) >> kLerpWeightBits));
+        }
+
+#ifdef PAINT_SRGB_X86
+        // The same 32-bit arithmetic as the scalar kernel, 4 (8) channels at a time
+        __attribute__((target("sse4.1"))) void LerpLinearSpanSSE41(const uint16_t *a, const uint16_t *b, int32_t weight, uint16_t *dst, size_t n)
+        {
+            const __m128i w = _mm_set1_epi32(weight);
+            const __m128i rounding = _mm_set1_epi32(1 << (kLerpWeightBits - 1));
+
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                __m128i result[2];
+                for (int h = 0; h < 2; h++)
+                {
+                    __m128i a32 = _mm_cvtepu16_epi32(h ? _mm_srli_si128(va, 8) : va);
+                    __m128i b32 = _mm_cvtepu16_epi32(h ? _mm_srli_si128(vb, 8) : vb);
+                    __m128i difference = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(b32, a32), w), rounding), kLerpWeightBits);
+                    result[h] = _mm_add_epi32(a32, difference);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi32(result[0], result[1]));
+            }
+
+            LerpLinearSpanScalar(a + i, b + i, weight, dst + i, n - i);
+        }
+
+        __attribute__((target("avx2"))) void LerpLinearSpanAVX2(const uint16_t *a, const uint16_t *b, int32_t weight, uint16_t *dst, size_t n)
+        {
+            const __m256i w = _mm256_set1_epi32(weight);
+            const __m256i rounding = _mm256_set1_epi32(1 << (kLerpWeightBits - 1));
+
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256i a32 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+                __m256i b32 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+                __m256i difference = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(b32, a32), w), rounding), kLerpWeightBits);
+                __m256i result = _mm256_add_epi32(a32, difference);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi32(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1)));
+            }
+
+            LerpLinearSpanScalar(a + i, b + i, weight, dst + i, n - i);
+        }
+#endif
+
+        using LerpLinearKernel = void (*)(const uint16_t *a, const uint16_t *b, int32_t weight, uint16_t *dst, size_t n);
+
+        LerpLinearKernel SelectLerpKernel(SimdLevel level)
+        {
+#ifdef PAINT_SRGB_X86
+            if (level >= SimdLevel::kAVX2)
+                return LerpLinearSpanAVX2;
+            if (level >= SimdLevel::kSSE41)
+                return LerpLinearSpanSSE41;
+#else
+            (void)level;
+#endif
+            return LerpLinearSpanScalar;
+        }
+
+        const LerpLinearKernel lerp_kernels[] = {SelectLerpKernel(SimdLevel::kScalar), SelectLerpKernel(SimdLevel::kSSE41),
+                                                 SelectLerpKernel(SimdLevel::kAVX2), SelectLerpKernel(SimdLevel::kAVX512)};
+    }
+
+    uint16_t SrgbToLinear(uint8_t value)
+    {
+        return kSrgbTables.to_linear[value];
+    }
+
+    uint8_t LinearToSrgb(uint16_t value)
+    {
+        return kSrgbTables.to_srgb[value >> (16 - kLinearToSrgbBits)];
+    }
+
+    void SrgbToLinearSpan(const uint8_t *src, uint16_t *dst, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            dst[i] = kSrgbTables.to_linear[src[i]];
+    }
+
+    void LinearToSrgbSpan(const uint16_t *src, uint8_t *dst, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            dst[i] = kSrgbTables.to_srgb[src[i] >> (16 - kLinearToSrgbBits)];
+    }
+
+    void LinearLuminanceSpan(ColorFormat src_format, const uint8_t *src, uint8_t *dst, size_t n)
+    {
+        if (src_format == ColorFormat::kBGR888)
+            LinearLuminanceSpanScalar<ColorFormat::kBGR888>(src, dst, n);
+        else
+            LinearLuminanceSpanScalar<ColorFormat::kRGB888>(src, dst, n);
+    }
+
+    void LerpLinearSpan(const uint16_t *a, const uint16_t *b, int32_t weight, uint16_t *dst, size_t n)
+    {
+        lerp_kernels[static_cast<int>(GetSimdLevel())](a, b, weight, dst, n);
+    }
+}
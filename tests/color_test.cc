@@ -1,5 +1,18 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
 #include <gtest/gtest.h>
 #include "colors.h"
+#include "pixel_traits.h"
+#include "convert_span.h"
+#include "dither.h"
+#include "srgb.h"
+#include "palette.h"
+#include "blend.h"
 
 TEST(colorRGB565, colorConversion)
 {
@@ -35,6 +48,491 @@ TEST(colorRGB888, colorConversion)
     GTEST_ASSERT_EQ(paint::ColorRGB888(100, 50, 10), c2) << "ColorRGB888 moce assignment ctor";
 }
 
+TEST(pixelTraits, colorConversion)
+{
+    // Conversions are usable at compile time
+    constexpr paint::PixelRGB888 rgb888 = paint::MakePixelRGB888(42, 84, 127);
+    static_assert(paint::ConvertPixel<paint::PixelRGB565>(rgb888) == paint::MakePixelRGB565(42 >> 3, 84 >> 2, 127 >> 3));
+    static_assert(paint::ConvertPixel<paint::PixelBGR888>(rgb888) == paint::MakePixelBGR888(127, 84, 42));
+    static_assert(paint::ConvertPixel<paint::PixelGrayscale>(rgb888).w == 78);
+    static_assert(paint::ConvertPixel<paint::PixelBW>(rgb888).w == 0);
+    static_assert(paint::PixelTraits<paint::ColorFormat::kBGR565>::kRed.offset_bits == 11);
+
+    // Grayscale and BW conversions compute the palette colors
+    for (unsigned w = 0; w < paint::PixelTraits<paint::ColorFormat::kGrayscale>::kPaletteSize; w++)
+    {
+        paint::PixelBGR888 bgr = paint::ConvertPixel<paint::PixelBGR888>(paint::MakePixelGrayscale(w));
+        const paint::PixelBGRA8888 &entry = paint::PixelTraits<paint::ColorFormat::kGrayscale>::kPalette[w];
+        EXPECT_EQ(paint::MakePixelBGR888(entry.b, entry.g, entry.r), bgr);
+    }
+    for (unsigned w = 0; w < paint::PixelTraits<paint::ColorFormat::kBW>::kPaletteSize; w++)
+    {
+        paint::PixelRGB888 rgb = paint::ConvertPixel<paint::PixelRGB888>(paint::MakePixelBW(w));
+        const paint::PixelBGRA8888 &entry = paint::PixelTraits<paint::ColorFormat::kBW>::kPalette[w];
+        EXPECT_EQ(paint::MakePixelRGB888(entry.r, entry.g, entry.b), rgb);
+    }
+
+    // Color classes convert with the traits
+    EXPECT_EQ(paint::ColorGrayscale(78), paint::ColorGrayscale(paint::ColorRGB888(42, 84, 127)));
+    EXPECT_EQ(paint::ColorBW(1), paint::ColorBW(paint::ColorBGR565(0, 32, 0)));
+}
+
+TEST(convertSpan, colorConversion)
+{
+    std::vector<std::unique_ptr<paint::Color>> colors;
+    colors.emplace_back(std::make_unique<paint::ColorRGB565>(0, 0, 0));
+    colors.emplace_back(std::make_unique<paint::ColorBGR565>(0, 0, 0));
+    colors.emplace_back(std::make_unique<paint::ColorRGB888>(0, 0, 0));
+    colors.emplace_back(std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    colors.emplace_back(std::make_unique<paint::ColorGrayscale>(0));
+    colors.emplace_back(std::make_unique<paint::ColorBW>(0));
+
+    // Random pixels (BW pixels are 0 or 1)
+    const size_t n = 1000;
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> distr(0, 255);
+
+    for (auto &color_from : colors)
+    {
+        size_t src_size = paint::PixelSize(color_from->GetColorFormat());
+        std::vector<uint8_t> src(n * src_size);
+        for (auto &byte : src)
+            byte = color_from->GetColorFormat() == paint::ColorFormat::kBW ? distr(gen) & 1 : distr(gen);
+
+        for (auto &color_to : colors)
+        {
+            size_t dst_size = paint::PixelSize(color_to->GetColorFormat());
+            std::vector<uint8_t> dst(n * dst_size);
+            paint::ConvertSpan(color_from->GetColorFormat(), color_to->GetColorFormat(), src.data(), dst.data(), n);
+
+            // Each pixel must be the same as the one converted by Color::SetColor()
+            std::unique_ptr<paint::Color> converted(color_to->clone());
+            std::unique_ptr<paint::Color> expected(color_to->clone());
+            for (size_t i = 0; i < n; i++)
+            {
+                color_from->SetFromData(&src[i * src_size]);
+                expected->SetColor(*color_from);
+                converted->SetFromData(&dst[i * dst_size]);
+                ASSERT_EQ(paint::ColorRGB888(*expected), paint::ColorRGB888(*converted));
+            }
+        }
+    }
+}
+
+TEST(convertSpan, simdLevels)
+{
+    // All the 24-bit colors and all the 565 colors
+    std::vector<uint8_t> color888(3 << 24);
+    for (size_t i = 0; i < color888.size(); i++)
+        color888[i] = (i / 3) >> (8 * (i % 3));
+    std::vector<uint16_t> color565(1 << 16);
+    for (size_t i = 0; i < color565.size(); i++)
+        color565[i] = i;
+
+    const paint::SimdLevel supported = paint::SetSimdLevel(paint::SimdLevel::kAVX512);
+    for (paint::ColorFormat dst_format : {paint::ColorFormat::kGrayscale, paint::ColorFormat::kBW})
+    {
+        for (paint::ColorFormat src_format : {paint::ColorFormat::kRGB888, paint::ColorFormat::kBGR888, paint::ColorFormat::kRGB565, paint::ColorFormat::kBGR565})
+        {
+            const bool is_888 = src_format == paint::ColorFormat::kRGB888 || src_format == paint::ColorFormat::kBGR888;
+            const void *src = is_888 ? static_cast<const void *>(color888.data()) : static_cast<const void *>(color565.data());
+            const size_t n = is_888 ? color888.size() / 3 : color565.size();
+
+            // Odd count, so the scalar tail is used too
+            paint::SetSimdLevel(paint::SimdLevel::kScalar);
+            std::vector<uint8_t> expected(n);
+            paint::ConvertSpan(src_format, dst_format, src, expected.data(), n - 5);
+
+            // The fixed-point luminance is the float luminance rounded to the nearest integer (up to the error of the 15-bit weights)
+            if (src_format == paint::ColorFormat::kRGB888 && dst_format == paint::ColorFormat::kGrayscale)
+            {
+                for (size_t i = 0; i < n - 5; i++)
+                {
+                    const double luminance = 0.2125 * color888[3 * i] + 0.7154 * color888[3 * i + 1] + 0.0721 * color888[3 * i + 2];
+                    ASSERT_NEAR(luminance, expected[i], 0.5 + 1.0 / 256) << "color " << i;
+                }
+            }
+
+            for (int level = 1; level <= static_cast<int>(supported); level++)
+            {
+                paint::SetSimdLevel(static_cast<paint::SimdLevel>(level));
+                std::vector<uint8_t> converted(n);
+                paint::ConvertSpan(src_format, dst_format, src, converted.data(), n - 5);
+                ASSERT_EQ(expected, converted) << "SIMD level " << level;
+            }
+        }
+    }
+    paint::SetSimdLevel(supported);
+}
+
+TEST(dither, threadsMatchSerial)
+{
+    const paint::Point size{97, 61};
+    std::mt19937 gen(14);
+    std::uniform_int_distribution<int> noise(-20, 20);
+
+    for (paint::ColorFormat target : {paint::ColorFormat::kBW, paint::ColorFormat::kRGB565})
+    {
+        // Noisy gradient, so every method has errors to diffuse
+        const size_t stride = paint::PixelSize(paint::DitherSourceFormat(target)) * size.x;
+        std::vector<uint8_t> source(stride * size.y);
+        for (paint::Unit y = 0; y < size.y; y++)
+            for (size_t i = 0; i < stride; i++)
+                source[y * stride + i] = std::clamp(static_cast<int>(i * 255 / stride) + noise(gen), 0, 255);
+
+        for (paint::DitherMethod method : {paint::DitherMethod::kBayer, paint::DitherMethod::kFloydSteinberg, paint::DitherMethod::kAtkinson})
+        {
+            std::vector<uint8_t> expected = source;
+            paint::DitherPixels(method, target, expected.data(), stride, size, 1);
+
+            for (unsigned threads : {2u, 5u, 64u})
+            {
+                std::vector<uint8_t> dithered = source;
+                paint::DitherPixels(method, target, dithered.data(), stride, size, threads);
+                ASSERT_EQ(expected, dithered) << "method " << static_cast<int>(method) << ", threads " << threads;
+            }
+        }
+    }
+}
+
+TEST(dither, keepsMeanLevel)
+{
+    // Horizontal grayscale ramp, every column has one gray level
+    const paint::Point size{256, 64};
+    std::vector<uint8_t> ramp(size.x * size.y);
+    for (paint::Unit y = 0; y < size.y; y++)
+        for (paint::Unit x = 0; x < size.x; x++)
+            ramp[y * size.x + x] = x;
+
+    for (paint::DitherMethod method : {paint::DitherMethod::kBayer, paint::DitherMethod::kFloydSteinberg, paint::DitherMethod::kAtkinson})
+    {
+        std::vector<uint8_t> dithered = ramp;
+        paint::DitherPixels(method, paint::ColorFormat::kBW, dithered.data(), size.x, size);
+
+        // Only black and white, the mean of every 16 columns stays close to the ramp (Atkinson loses a part of the error)
+        const int tolerance = method == paint::DitherMethod::kAtkinson ? 32 : 8;
+        for (paint::Unit x0 = 0; x0 < size.x; x0 += 16)
+        {
+            int sum_ramp = 0;
+            int sum_dithered = 0;
+            for (paint::Unit y = 0; y < size.y; y++)
+            {
+                for (paint::Unit x = x0; x < x0 + 16; x++)
+                {
+                    ASSERT_TRUE(dithered[y * size.x + x] == 0 || dithered[y * size.x + x] == 255);
+                    sum_ramp += ramp[y * size.x + x];
+                    sum_dithered += dithered[y * size.x + x];
+                }
+            }
+            EXPECT_NEAR(sum_ramp / (16 * size.y), sum_dithered / (16 * size.y), tolerance) << "method " << static_cast<int>(method) << ", column " << x0;
+        }
+
+        // 565 levels survive the conversion to RGB565 and back
+        std::vector<uint8_t> color(size.x * size.y * 3);
+        paint::ConvertSpan(paint::ColorFormat::kGrayscale, paint::ColorFormat::kRGB888, ramp.data(), color.data(), ramp.size());
+        paint::DitherPixels(method, paint::ColorFormat::kRGB565, color.data(), size.x * 3, size);
+
+        std::vector<paint::PixelRGB565> color565(ramp.size());
+        std::vector<uint8_t> roundtrip(color.size());
+        paint::ConvertSpan(paint::ColorFormat::kRGB888, paint::ColorFormat::kRGB565, color.data(), color565.data(), ramp.size());
+        paint::ConvertSpan(paint::ColorFormat::kRGB565, paint::ColorFormat::kRGB888, color565.data(), roundtrip.data(), ramp.size());
+        ASSERT_EQ(color, roundtrip) << "method " << static_cast<int>(method);
+    }
+}
+
+TEST(srgb, linearLight)
+{
+    // Every channel survives the decoding and encoding, the decoding keeps the order
+    for (int v = 0; v < 256; v++)
+    {
+        ASSERT_EQ(v, paint::LinearToSrgb(paint::SrgbToLinear(v))) << "channel " << v;
+        if (v > 0)
+        {
+            ASSERT_LT(paint::SrgbToLinear(v - 1), paint::SrgbToLinear(v)) << "channel " << v;
+        }
+    }
+    EXPECT_EQ(0, paint::SrgbToLinear(0));
+    EXPECT_EQ(65535, paint::SrgbToLinear(255));
+
+    // Half of the light is much brighter than half of the encoded value
+    EXPECT_NEAR(188, paint::LinearToSrgb(32768), 1);
+
+    // Gray stays the same gray, pure colors are brighter than in sRGB
+    std::vector<uint8_t> rgb;
+    for (int v = 0; v < 256; v++)
+        rgb.insert(rgb.end(), {static_cast<uint8_t>(v), static_cast<uint8_t>(v), static_cast<uint8_t>(v)});
+    rgb.insert(rgb.end(), {255, 0, 0, 0, 255, 0, 0, 0, 255});
+
+    std::vector<uint8_t> gray(rgb.size() / 3);
+    paint::LinearLuminanceSpan(paint::ColorFormat::kRGB888, rgb.data(), gray.data(), gray.size());
+    for (int v = 0; v < 256; v++)
+        ASSERT_EQ(v, gray[v]) << "gray " << v;
+
+    EXPECT_NEAR(127, gray[256], 1); // Red
+    EXPECT_NEAR(220, gray[257], 1); // Green
+    EXPECT_NEAR(76, gray[258], 1);  // Blue
+
+    // BGR888 pixels have the same luminance as the RGB888 pixels with swapped red and blue
+    std::mt19937 gen(15);
+    std::vector<uint8_t> random_rgb(3 * 1001), random_bgr(random_rgb.size());
+    for (size_t i = 0; i < random_rgb.size(); i++)
+        random_rgb[i] = static_cast<uint8_t>(gen());
+    for (size_t i = 0; i < random_rgb.size(); i += 3)
+    {
+        random_bgr[i] = random_rgb[i + 2];
+        random_bgr[i + 1] = random_rgb[i + 1];
+        random_bgr[i + 2] = random_rgb[i];
+    }
+    std::vector<uint8_t> gray_rgb(1001), gray_bgr(1001);
+    paint::LinearLuminanceSpan(paint::ColorFormat::kRGB888, random_rgb.data(), gray_rgb.data(), gray_rgb.size());
+    paint::LinearLuminanceSpan(paint::ColorFormat::kBGR888, random_bgr.data(), gray_bgr.data(), gray_bgr.size());
+    EXPECT_EQ(gray_rgb, gray_bgr);
+
+    // The luminance of the decoded channels
+    for (size_t i = 0; i < gray_rgb.size(); i++)
+    {
+        const double luminance = 0.2126 * paint::SrgbToLinear(random_rgb[3 * i]) + 0.7152 * paint::SrgbToLinear(random_rgb[3 * i + 1]) +
+                                 0.0722 * paint::SrgbToLinear(random_rgb[3 * i + 2]);
+        ASSERT_NEAR(paint::LinearToSrgb(static_cast<uint16_t>(luminance + 0.5)), gray_rgb[i], 1) << "pixel " << i;
+    }
+
+    // The interpolation is rounded the same by all the kernels (odd count, so the scalar tail is used too)
+    const size_t n = 1003;
+    std::vector<uint16_t> a(n), b(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        a[i] = i < 4 ? 0 : static_cast<uint16_t>(gen());
+        b[i] = i < 4 ? 65535 : static_cast<uint16_t>(gen());
+    }
+    const paint::SimdLevel supported = paint::SetSimdLevel(paint::SimdLevel::kAVX512);
+    for (int32_t weight : {0, 1, 12345, 16384, 32767, 1 << paint::kLerpWeightBits})
+    {
+        std::vector<uint16_t> expected(n);
+        for (size_t i = 0; i < n; i++)
+            expected[i] = static_cast<uint16_t>(std::lround(a[i] + (b[i] - a[i]) * (weight / 32768.0)));
+
+        for (int level = 0; level <= static_cast<int>(supported); level++)
+        {
+            paint::SetSimdLevel(static_cast<paint::SimdLevel>(level));
+            std::vector<uint16_t> lerped(n);
+            paint::LerpLinearSpan(a.data(), b.data(), weight, lerped.data(), n);
+            for (size_t i = 0; i < n; i++)
+                ASSERT_NEAR(expected[i], lerped[i], 1) << "weight " << weight << " level " << level << " channel " << i;
+
+            if (level > 0)
+            {
+                paint::SetSimdLevel(paint::SimdLevel::kScalar);
+                std::vector<uint16_t> scalar(n);
+                paint::LerpLinearSpan(a.data(), b.data(), weight, scalar.data(), n);
+                ASSERT_EQ(scalar, lerped) << "weight " << weight << " level " << level;
+            }
+        }
+    }
+    paint::SetSimdLevel(supported);
+}
+
+TEST(palette, findNearest)
+{
+    std::mt19937 gen(11);
+    auto random_color = [&gen]() { return paint::PixelRGB888{static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen())}; };
+
+    for (size_t size : {1, 2, 16, 200, 256})
+    {
+        std::vector<paint::PixelRGB888> colors;
+        for (size_t i = 0; i < size; i++)
+            colors.push_back(random_color());
+        colors.push_back(colors.front()); // Duplicate color -> the lower index wins
+        colors.resize(std::min<size_t>(colors.size(), paint::Palette::kMaxColors));
+        paint::Palette palette(colors);
+
+        // The k-d tree finds the same color as the linear search
+        for (int i = 0; i < 2000; i++)
+        {
+            paint::PixelRGB888 color = i < static_cast<int>(colors.size()) ? colors[i] : random_color();
+
+            size_t best = 0;
+            int best_distance = std::numeric_limits<int>::max();
+            for (size_t c = 0; c < colors.size(); c++)
+            {
+                int dr = color.r - colors[c].r, dg = color.g - colors[c].g, db = color.b - colors[c].b;
+                if (dr * dr + dg * dg + db * db < best_distance)
+                {
+                    best_distance = dr * dr + dg * dg + db * db;
+                    best = c;
+                }
+            }
+            ASSERT_EQ(best, palette.FindNearest(color)) << "palette of " << colors.size() << " colors";
+        }
+    }
+
+    EXPECT_THROW(paint::Palette(std::vector<paint::PixelRGB888>{}), std::invalid_argument);
+    EXPECT_THROW(paint::Palette(std::vector<paint::PixelRGB888>(257)), std::invalid_argument);
+}
+
+TEST(palette, colorConversion)
+{
+    auto palette = std::make_shared<const paint::Palette>(std::vector<paint::PixelRGB888>{{0, 0, 0}, {250, 20, 10}, {30, 140, 220}, {255, 255, 255}});
+
+    // Indices are converted by the palette table the same way as by ColorPalette
+    const uint8_t indices[] = {0, 1, 2, 3, 200};
+    for (int f = 0; f < static_cast<int>(paint::ColorFormat::kIndexed8); f++)
+    {
+        const paint::ColorFormat format = static_cast<paint::ColorFormat>(f);
+        std::vector<uint8_t> converted(5 * paint::PixelSize(format));
+        palette->ConvertIndices(indices, format, converted.data(), 5);
+
+        for (size_t i = 0; i < 5; i++)
+        {
+            paint::ColorPalette color(palette, indices[i]);
+            std::vector<uint8_t> expected(paint::PixelSize(format));
+            paint::ColorRGB888 rgb = color.ToRGB888();
+            paint::ConvertSpan(paint::ColorFormat::kRGB888, format, rgb.GetData(), expected.data(), 1);
+            ASSERT_EQ(0, std::memcmp(expected.data(), converted.data() + i * expected.size(), expected.size())) << "format " << f << ", index " << i;
+        }
+    }
+    EXPECT_EQ(paint::ColorRGB888(0, 0, 0), paint::ColorPalette(palette, 200).ToRGB888());
+
+    // Setting a color picks the nearest palette color
+    paint::ColorPalette color(palette);
+    color.SetColor(paint::ColorRGB888(240, 40, 40));
+    EXPECT_EQ(1, color.GetIndex());
+    EXPECT_EQ(paint::ColorRGB888(250, 20, 10), color.ToRGB888());
+    color.InvertColor();
+    EXPECT_EQ(2, color.GetIndex());
+
+    // Other colors set from the palette color
+    paint::ColorRGB565 rgb565(0, 0, 0);
+    rgb565.SetColor(color);
+    EXPECT_EQ(paint::ColorRGB565(30 >> 3, 140 >> 2, 220 >> 3), rgb565);
+}
+
+TEST(palette, octreeQuantizer)
+{
+    // Few colors are kept exactly
+    const std::vector<paint::PixelRGB888> few = {{0, 0, 0}, {255, 255, 255}, {255, 0, 0}, {0, 128, 0}, {16, 32, 200}};
+    paint::OctreeQuantizer exact;
+    for (int i = 0; i < 100; i++)
+        exact.AddColors(few.data(), few.size());
+
+    paint::Palette palette = exact.CreatePalette(16);
+    ASSERT_EQ(few.size(), palette.GetSize());
+    for (const auto &color : few)
+        EXPECT_EQ(color, palette.GetColor(palette.FindNearest(color)));
+
+    // Merged colors are the averages of their pixels
+    EXPECT_EQ(1U, exact.CreatePalette(1).GetSize());
+
+    // Random colors are reduced to at most max_colors, every pixel stays close to its palette color
+    std::mt19937 gen(12);
+    std::vector<paint::PixelRGB888> pixels(50000);
+    for (auto &p : pixels)
+        p = paint::PixelRGB888{static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen())};
+
+    paint::OctreeQuantizer quantizer;
+    quantizer.AddColors(pixels.data(), pixels.size());
+    for (size_t max_colors : {2, 16, 64, 256})
+    {
+        paint::Palette reduced = quantizer.CreatePalette(max_colors);
+        EXPECT_LE(reduced.GetSize(), max_colors);
+        EXPECT_GE(reduced.GetSize(), max_colors / 2);
+
+        paint::PaletteMapper mapper(reduced);
+        std::vector<uint8_t> indices(pixels.size());
+        mapper.MapSpan(pixels.data(), indices.data(), pixels.size());
+
+        double error = 0;
+        for (size_t i = 0; i < pixels.size(); i++)
+        {
+            ASSERT_EQ(reduced.FindNearest(pixels[i]), indices[i]);
+            paint::PixelRGB888 c = reduced.GetColor(indices[i]);
+            error += std::abs(c.r - pixels[i].r) + std::abs(c.g - pixels[i].g) + std::abs(c.b - pixels[i].b);
+        }
+
+        // The average error per channel is close to a quarter of the spacing of max_colors evenly spread colors
+        EXPECT_LT(error / pixels.size() / 3, 256.0 / std::cbrt(static_cast<double>(max_colors)) / 3) << max_colors << " colors";
+    }
+
+    EXPECT_THROW(quantizer.CreatePalette(0), std::invalid_argument);
+    EXPECT_THROW(quantizer.CreatePalette(257), std::invalid_argument);
+}
+
+TEST(colorBGRA8888, colorConversion)
+{
+    // The channels are premultiplied by the alpha
+    paint::ColorBGRA8888 translucent(200, 100, 50, 128);
+    EXPECT_EQ((paint::PixelBGRA8888{100, 50, 25, 128}), translucent.GetPixel());
+    EXPECT_FALSE(translucent.IsOpaque());
+
+    // Other colors are the color over black, the opaque colors convert exactly
+    EXPECT_EQ(paint::ColorRGB888(25, 50, 100), translucent.ToRGB888());
+    EXPECT_EQ(paint::ColorRGB888(10, 20, 30), paint::ColorBGRA8888(paint::ColorRGB888(10, 20, 30)).ToRGB888());
+    EXPECT_TRUE(paint::ColorBGRA8888(paint::ColorGrayscale(7)).IsOpaque());
+
+    // Inverting keeps the alpha
+    translucent.InvertColor();
+    EXPECT_EQ((paint::PixelBGRA8888{28, 78, 103, 128}), translucent.GetPixel());
+
+    // Premultiplying the unpremultiplied pixel gives the pixel back
+    for (unsigned a = 0; a < 256; a++)
+    {
+        for (unsigned c = 0; c <= a; c++)
+        {
+            const paint::PixelBGRA8888 p{static_cast<uint8_t>(c), static_cast<uint8_t>(a - c), static_cast<uint8_t>(c / 2), static_cast<uint8_t>(a)};
+            ASSERT_EQ(a == 0 ? (paint::PixelBGRA8888{0, 0, 0, 0}) : p, paint::PremultiplyPixel(paint::UnpremultiplyPixel(p))) << c << " " << a;
+        }
+    }
+}
+
+TEST(blend, simdLevels)
+{
+    // Every alpha with random colors (premultiplied, so no channel is above its alpha)
+    std::mt19937 gen(17);
+    const size_t n = 256 * 16 + 7;
+    std::vector<paint::PixelBGRA8888> src(n), dst(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint8_t a = static_cast<uint8_t>(i);
+        src[i] = paint::PremultiplyPixel(paint::PixelBGRA8888{static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()), a});
+        dst[i] = paint::PremultiplyPixel(paint::PixelBGRA8888{static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()),
+                                                              static_cast<uint8_t>(gen())});
+    }
+
+    // The scalar blend is dst * (255 - alpha) / 255 rounded to the nearest integer
+    for (size_t i = 0; i < n; i++)
+    {
+        const paint::PixelBGRA8888 blended = paint::BlendPixel(src[i], dst[i]);
+        ASSERT_EQ(src[i].g + std::lround(dst[i].g * (255 - src[i].a) / 255.0), blended.g) << i;
+        ASSERT_EQ(src[i].a + std::lround(dst[i].a * (255 - src[i].a) / 255.0), blended.a) << i;
+    }
+
+    // Opaque source replaces, transparent source keeps the destination
+    paint::PixelBGRA8888 pixel{1, 2, 3, 4};
+    paint::BlendSpanSolid(paint::PixelBGRA8888{10, 20, 30, 255}, &pixel, 1);
+    EXPECT_EQ((paint::PixelBGRA8888{10, 20, 30, 255}), pixel);
+    paint::BlendSpanSolid(paint::PixelBGRA8888{0, 0, 0, 0}, &pixel, 1);
+    EXPECT_EQ((paint::PixelBGRA8888{10, 20, 30, 255}), pixel);
+
+    // All the kernels give the same result (odd count, so the scalar tail is used too)
+    const paint::SimdLevel supported = paint::SetSimdLevel(paint::SimdLevel::kAVX512);
+    paint::SetSimdLevel(paint::SimdLevel::kScalar);
+    std::vector<paint::PixelBGRA8888> expected = dst;
+    std::vector<paint::PixelBGRA8888> expected_solid = dst;
+    paint::BlendSpan(src.data(), expected.data(), n);
+    paint::BlendSpanSolid(src[100], expected_solid.data(), n);
+
+    for (int level = 1; level <= static_cast<int>(supported); level++)
+    {
+        paint::SetSimdLevel(static_cast<paint::SimdLevel>(level));
+        std::vector<paint::PixelBGRA8888> blended = dst;
+        std::vector<paint::PixelBGRA8888> blended_solid = dst;
+        paint::BlendSpan(src.data(), blended.data(), n);
+        paint::BlendSpanSolid(src[100], blended_solid.data(), n);
+        ASSERT_EQ(expected, blended) << "SIMD level " << level;
+        ASSERT_EQ(expected_solid, blended_solid) << "SIMD level " << level;
+    }
+    paint::SetSimdLevel(supported);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
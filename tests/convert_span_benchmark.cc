@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "blend.h"
+#include "colors.h"
+#include "convert_span.h"
+#include "data_pixels_view.h"
+
+// Does not use GTest, measures ConvertSpan() against converting the pixels one by one through PixelTraits
+// and BlendSpan() (a full-frame overlay) at every SIMD level.
+
+namespace
+{
+    const char *FormatName(paint::ColorFormat format)
+    {
+        switch (format)
+        {
+        case paint::ColorFormat::kRGB565:
+            return "RGB565";
+        case paint::ColorFormat::kBGR565:
+            return "BGR565";
+        case paint::ColorFormat::kRGB888:
+            return "RGB888";
+        case paint::ColorFormat::kBGR888:
+            return "BGR888";
+        case paint::ColorFormat::kGrayscale:
+            return "Grayscale";
+        case paint::ColorFormat::kBW:
+            return "BW";
+        case paint::ColorFormat::kBGRA8888:
+            return "BGRA8888";
+        case paint::ColorFormat::kIndexed8:
+            return "Indexed8";
+        }
+        return "?";
+    }
+
+    // Returns the best time of a few runs of fn in milliseconds
+    template <typename Function>
+    double Measure(Function &&fn)
+    {
+        double best = 0;
+        for (int run = 0; run < 5; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (run == 0 || ms < best)
+                best = ms;
+        }
+        return best;
+    }
+}
+
+int main()
+{
+    const size_t n = 4 << 20;
+    const paint::ColorFormat formats[] = {paint::ColorFormat::kRGB565, paint::ColorFormat::kBGR565, paint::ColorFormat::kRGB888,
+                                          paint::ColorFormat::kBGR888, paint::ColorFormat::kGrayscale, paint::ColorFormat::kBW,
+                                          paint::ColorFormat::kBGRA8888};
+
+    std::vector<uint8_t> src(4 * n), dst(4 * n);
+    std::mt19937 gen(1);
+    for (auto &byte : src)
+        byte = gen() & 0xFF;
+
+    std::cout << "Converting " << n << " pixels (best of 5 runs), SIMD level " << static_cast<int>(paint::GetSimdLevel()) << std::endl;
+    std::cout << std::left << std::setw(24) << "pair" << std::right << std::setw(16) << "per pixel ms" << std::setw(16) << "ConvertSpan ms" << std::setw(10) << "gain" << std::endl;
+
+    for (paint::ColorFormat src_format : formats)
+    {
+        for (paint::ColorFormat dst_format : formats)
+        {
+            if (src_format == dst_format)
+                continue;
+
+            double per_pixel = Measure([&]() {
+                paint::DispatchPixelType(src_format, [&](auto tag_src) {
+                    paint::DispatchPixelType(dst_format, [&](auto tag_dst) {
+                        using SrcT = typename decltype(tag_src)::type;
+                        using DstT = typename decltype(tag_dst)::type;
+                        const SrcT *s = reinterpret_cast<const SrcT *>(src.data());
+                        DstT *d = reinterpret_cast<DstT *>(dst.data());
+
+                        // Indexed pixels have no PixelTraits (and are not measured)
+                        if constexpr (!std::is_same_v<SrcT, paint::PixelIndexed8> && !std::is_same_v<DstT, paint::PixelIndexed8>)
+                        {
+                            for (size_t i = 0; i < n; i++)
+                                d[i] = paint::ConvertPixel<DstT>(s[i]);
+                        }
+                    });
+                });
+            });
+
+            double span = Measure([&]() { paint::ConvertSpan(src_format, dst_format, src.data(), dst.data(), n); });
+
+            std::cout << std::left << std::setw(24) << (std::string(FormatName(src_format)) + " -> " + FormatName(dst_format))
+                      << std::right << std::fixed << std::setprecision(2) << std::setw(16) << per_pixel << std::setw(16) << span
+                      << std::setw(9) << per_pixel / span << "x" << std::endl;
+        }
+    }
+
+    // Overlay with random premultiplied pixels over an opaque image
+    std::vector<paint::PixelBGRA8888> overlay(n), image(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        overlay[i] = paint::PremultiplyPixel(paint::PixelBGRA8888{static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()),
+                                                                  static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen())});
+        image[i] = paint::PixelBGRA8888{static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()), static_cast<uint8_t>(gen()), 255};
+    }
+
+    std::cout << std::endl
+              << std::left << std::setw(24) << "BlendSpan SIMD level" << std::right << std::setw(16) << "ms" << std::setw(16) << "Mpx/s" << std::endl;
+
+    const paint::SimdLevel best_level = paint::GetSimdLevel();
+    for (paint::SimdLevel level : {paint::SimdLevel::kScalar, paint::SimdLevel::kSSE41, paint::SimdLevel::kAVX2})
+    {
+        if (paint::SetSimdLevel(level) != level)
+            continue;
+
+        double blend = Measure([&]() { paint::BlendSpan(overlay.data(), image.data(), n); });
+        std::cout << std::left << std::setw(24) << static_cast<int>(level) << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(16) << blend << std::setw(16) << n / blend / 1000 << std::endl;
+    }
+    paint::SetSimdLevel(best_level);
+
+    return 0;
+}
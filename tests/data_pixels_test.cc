@@ -0,0 +1,2082 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <functional>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "colors.h"
+#include "data_pixels.h"
+#include "data_pixels_view.h"
+#include "painter.h"
+#include "image_bmp.h"
+#include "buffer_pool.h"
+#include "blend.h"
+#include "raster.h"
+#include "draw_batch.h"
+#include "flood_fill.h"
+#include "color_match.h"
+#include "resample.h"
+#include "srgb.h"
+#include "convert_span.h"
+#include "packed_bits.h"
+
+namespace
+{
+    // Fills the DataPixels with random bytes
+    void FillRandom(paint::DataPixels &data, unsigned seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<int> distr(0, 255);
+
+        size_t pixel_size = data.GetColorType()->GetDataSize();
+        for (auto p : data)
+        {
+            for (size_t i = 0; i < pixel_size; i++)
+                reinterpret_cast<uint8_t *>(p)[i] = distr(gen);
+        }
+    }
+
+    std::vector<std::unique_ptr<paint::Color>> AllColorTypes()
+    {
+        std::vector<std::unique_ptr<paint::Color>> colors;
+        colors.emplace_back(std::make_unique<paint::ColorRGB565>(0, 0, 0));
+        colors.emplace_back(std::make_unique<paint::ColorBGR565>(0, 0, 0));
+        colors.emplace_back(std::make_unique<paint::ColorRGB888>(0, 0, 0));
+        colors.emplace_back(std::make_unique<paint::ColorBGR888>(0, 0, 0));
+        colors.emplace_back(std::make_unique<paint::ColorGrayscale>(0));
+        colors.emplace_back(std::make_unique<paint::ColorBW>(0));
+        return colors;
+    }
+}
+
+TEST(data_pixels, row_stride)
+{
+    // 5 * 3 = 15 bytes per row -> rounded to 16 for 4 byte alignment
+    paint::DataPixels data(paint::Point{5, 3}, std::make_unique<paint::ColorRGB888>(0, 0, 0), 4);
+    EXPECT_EQ(15U, data.GetRowSize());
+    EXPECT_EQ(16U, data.GetRowStride());
+    EXPECT_EQ(16U * 3, data.GetDataSize());
+    EXPECT_EQ(data.RowPtr(1), data.at(0, 1));
+    EXPECT_EQ(data[7], data.at(2, 1));
+
+    // Default alignment is a cache line
+    paint::DataPixels data_default(paint::Point{5, 3}, std::make_unique<paint::ColorRGB888>(0, 0, 0));
+    EXPECT_EQ(static_cast<size_t>(paint::DataPixels::kCacheLineRowAlignment), data_default.GetRowStride());
+    for (paint::Unit y = 0; y < 3; y++)
+        EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(data_default.RowPtr(y)) % paint::DataPixels::kCacheLineRowAlignment);
+
+    EXPECT_THROW(paint::DataPixels(paint::Point{5, 3}, std::make_unique<paint::ColorRGB888>(0, 0, 0), 3), std::invalid_argument);
+}
+
+TEST(data_pixels, iterator_skips_padding)
+{
+    paint::DataPixels data(paint::Point{5, 3}, std::make_unique<paint::ColorGrayscale>(0), 4);
+
+    size_t count = 0;
+    for (auto p : data)
+        *reinterpret_cast<uint8_t *>(p) = ++count;
+
+    EXPECT_EQ(15U, count);
+    for (paint::Unit y = 0; y < 3; y++)
+    {
+        uint8_t *row = reinterpret_cast<uint8_t *>(data.RowPtr(y));
+        for (paint::Unit x = 0; x < 5; x++)
+            EXPECT_EQ(y * 5 + x + 1, row[x]);
+
+        // Padding stays 0
+        for (size_t i = 5; i < data.GetRowStride(); i++)
+            EXPECT_EQ(0, row[i]);
+    }
+
+    // Copy keeps the layout
+    paint::DataPixels copy(data);
+    EXPECT_EQ(data.GetRowStride(), copy.GetRowStride());
+    EXPECT_EQ(0, std::memcmp(data.RowPtr(0), copy.RowPtr(0), data.GetDataSize()));
+}
+
+TEST(data_pixels_view, dispatch_pixel_type)
+{
+    for (auto &color : AllColorTypes())
+    {
+        paint::DataPixels data(paint::Point{7, 5}, std::unique_ptr<paint::Color>(color->clone()));
+
+        size_t pixel_size = paint::DispatchDataPixelsView(data, [](auto view) {
+            return sizeof(typename decltype(view)::pixel_type);
+        });
+
+        EXPECT_EQ(color->GetDataSize(), pixel_size);
+    }
+}
+
+TEST(data_pixels_view, typed_access)
+{
+    paint::DataPixels data(paint::Point{7, 5}, std::make_unique<paint::ColorRGB888>(0, 0, 0));
+    paint::DataPixelsView<paint::PixelRGB888> view(data);
+
+    view(3, 2) = paint::PixelRGB888{1, 2, 3};
+    EXPECT_EQ((paint::PixelRGB888{1, 2, 3}), *reinterpret_cast<paint::PixelRGB888 *>(data.at(3, 2)));
+    EXPECT_THROW(view.at(7, 0), std::out_of_range);
+
+    // View with wrong pixel type
+    EXPECT_THROW(paint::DataPixelsView<paint::PixelGrayscale>{data}, paint::error_data_mismatch);
+}
+
+TEST(data_pixels_view, transform_matches_color)
+{
+    for (auto &color_from : AllColorTypes())
+    {
+        for (auto &color_to : AllColorTypes())
+        {
+            paint::DataPixels data(paint::Point{13, 3}, std::unique_ptr<paint::Color>(color_from->clone()));
+            FillRandom(data, 42);
+            paint::DataPixels original(data);
+
+            data.TransformToColorType(color_to);
+            ASSERT_EQ(color_to->GetColorFormat(), data.GetColorFormat());
+
+            // Each pixel must be the same as the one converted by Color::SetColor()
+            auto old_color = original.GetColorType();
+            auto new_color = data.GetColorType();
+            auto transformed_color = data.GetColorType();
+            for (paint::Unit y = 0; y < 3; y++)
+            {
+                for (paint::Unit x = 0; x < 13; x++)
+                {
+                    old_color->SetFromData(original.at(x, y));
+                    new_color->SetColor(*old_color);
+                    transformed_color->SetFromData(data.at(x, y));
+
+                    // Compare through RGB888, bits unused by the pixel structure are not defined
+                    EXPECT_EQ(paint::ColorRGB888(*new_color), paint::ColorRGB888(*transformed_color));
+                }
+            }
+        }
+    }
+}
+
+TEST(data_pixels_view, painter_invert)
+{
+    for (auto &color : AllColorTypes())
+    {
+        auto data = std::make_shared<paint::DataPixels>(paint::Point{9, 4}, std::unique_ptr<paint::Color>(color->clone()));
+        FillRandom(*data, 7);
+        paint::DataPixels original(*data);
+
+        paint::Painter painter([]() {});
+        painter.AttachImageData(data);
+        painter.InvertColors();
+
+        // Each pixel must be the same as the one inverted by Color::InvertColor()
+        auto c = original.GetColorType();
+        auto c_inverted = data->GetColorType();
+        for (paint::Unit y = 0; y < 4; y++)
+        {
+            for (paint::Unit x = 0; x < 9; x++)
+            {
+                c->SetFromData(original.at(x, y));
+                c->InvertColor();
+                c_inverted->SetFromData(data->at(x, y));
+                EXPECT_EQ(paint::ColorRGB888(*c), paint::ColorRGB888(*c_inverted));
+            }
+        }
+    }
+}
+
+TEST(data_pixels, tiled_layout)
+{
+    // Size that is not a multiple of tile size
+    paint::DataPixels data(paint::Point{150, 70}, std::make_unique<paint::ColorRGB888>(0, 0, 0));
+    FillRandom(data, 3);
+    paint::DataPixels linear(data);
+
+    data.ConvertLayout(paint::PixelLayout::kTiled);
+    ASSERT_EQ(paint::PixelLayout::kTiled, data.GetLayout());
+    EXPECT_EQ(3U * 2 * paint::DataPixels::kTileSize * data.GetRowStride(), data.GetDataSize());
+
+    // Same pixels through at() and the row copies
+    std::vector<uint8_t> row_linear(linear.GetRowSize());
+    std::vector<uint8_t> row_tiled(data.GetRowSize());
+    for (paint::Unit y = 0; y < 70; y++)
+    {
+        linear.CopyRowTo(y, row_linear.data());
+        data.CopyRowTo(y, row_tiled.data());
+        EXPECT_EQ(row_linear, row_tiled);
+        EXPECT_EQ(0, std::memcmp(linear.at(149, y), data.at(149, y), 3));
+    }
+
+    // The iterator walks the pixels in the same order
+    size_t count = 0;
+    auto it_linear = linear.begin();
+    for (auto p : data)
+    {
+        EXPECT_EQ(0, std::memcmp(*it_linear, p, 3));
+        ++it_linear;
+        count++;
+    }
+    EXPECT_EQ(150U * 70, count);
+
+    data.ConvertLayout(paint::PixelLayout::kLinear);
+    for (paint::Unit y = 0; y < 70; y++)
+        EXPECT_EQ(0, std::memcmp(linear.RowPtr(y), data.RowPtr(y), linear.GetRowStride()));
+}
+
+TEST(data_pixels, tiled_painter_matches_linear)
+{
+    using Operation = std::function<void(paint::Painter &)>;
+    std::vector<Operation> operations{
+        [](paint::Painter &p) { p.Rotate(paint::Rotation::kClock); },
+        [](paint::Painter &p) { p.Rotate(paint::Rotation::kCounterClock); },
+        [](paint::Painter &p) { p.Crop(paint::PointPX(13, 7), paint::PointPX(140, 69)); },
+        [](paint::Painter &p) { p.Resize(paint::PointPX(97, 131)); },
+        [](paint::Painter &p) { p.Resize(paint::PointPX(61, 200), paint::ResampleFilter::kLanczos3); },
+        [](paint::Painter &p) { p.InvertColors(); },
+        [](paint::Painter &p) { p.ConvertToGrayscale(); },
+        [](paint::Painter &p) { p.DrawLine(paint::PointPX(0, 3), paint::PointPX(149, 60), std::nullopt, 5); },
+        [](paint::Painter &p) { p.DrawLine(paint::PointPX(140, 2), paint::PointPX(3, 66), std::make_shared<paint::ColorRGB888>(200, 100, 50), 3, true); },
+        [](paint::Painter &p) { p.DrawCircle(paint::PointPX(100, 30), 45, true, std::make_shared<paint::ColorRGB888>(7, 8, 9), std::make_shared<paint::ColorRGB888>(200, 100, 50), 4); },
+        [](paint::Painter &p) { p.DrawBucket(paint::PointPX(75, 35), std::make_shared<paint::ColorRGB888>(7, 8, 9), 100); },
+        [](paint::Painter &p) { p.ReplaceColor(paint::ColorRGB888(128, 128, 128), std::make_shared<paint::ColorRGB888>(7, 8, 9), 60); },
+        [](paint::Painter &p) { p.ClearImage(std::make_shared<paint::ColorRGB888>(1, 2, 3)); },
+    };
+
+    for (auto &operation : operations)
+    {
+        auto linear = std::make_shared<paint::DataPixels>(paint::Point{150, 70}, std::make_unique<paint::ColorRGB888>(0, 0, 0));
+        FillRandom(*linear, 11);
+        auto tiled = std::make_shared<paint::DataPixels>(*linear);
+        tiled->ConvertLayout(paint::PixelLayout::kTiled);
+
+        paint::Painter painter([]() {}, true);
+        painter.AttachImageData(linear);
+        operation(painter);
+        painter.AttachImageData(tiled);
+        operation(painter);
+
+        ASSERT_EQ(paint::PixelLayout::kTiled, tiled->GetLayout());
+        ASSERT_EQ(linear->GetSize(), tiled->GetSize());
+        tiled->ConvertLayout(paint::PixelLayout::kLinear);
+        for (paint::Unit y = 0; y < linear->GetSize().y; y++)
+            ASSERT_EQ(0, std::memcmp(linear->RowPtr(y), tiled->RowPtr(y), linear->GetRowSize()));
+    }
+}
+
+TEST(data_pixels, planar_layout)
+{
+    paint::DataPixels data(paint::Point{150, 70}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    FillRandom(data, 5);
+    paint::DataPixels linear(data);
+
+    data.ConvertLayout(paint::PixelLayout::kPlanar);
+    ASSERT_EQ(paint::PixelLayout::kPlanar, data.GetLayout());
+    ASSERT_EQ(3U, data.GetPlaneCount());
+
+    // Each plane holds one byte of the pixels
+    for (paint::Unit y = 0; y < 70; y++)
+    {
+        const uint8_t *row = reinterpret_cast<const uint8_t *>(linear.RowPtr(y));
+        for (size_t plane = 0; plane < 3; plane++)
+        {
+            const uint8_t *plane_row = reinterpret_cast<const uint8_t *>(data.PlaneRowPtr(plane, y));
+            for (paint::Unit x = 0; x < 150; x++)
+                ASSERT_EQ(row[x * 3 + plane], plane_row[x]);
+        }
+    }
+
+    // Pixel copies interleave the planes
+    paint::PixelBGR888 pixel;
+    data.CopyPixelTo(149, 69, &pixel);
+    EXPECT_EQ(0, std::memcmp(linear.at(149, 69), &pixel, 3));
+    pixel = paint::PixelBGR888{1, 2, 3};
+    data.CopyPixelFrom(3, 4, &pixel);
+    EXPECT_EQ(2, reinterpret_cast<uint8_t *>(data.PlaneRowPtr(1, 4))[3]);
+
+    // Views of the interleaved pixels cannot be created, views of a plane can
+    EXPECT_THROW(paint::DataPixelsView<paint::PixelBGR888>{data}, paint::error_data_mismatch);
+    paint::DataPixelsView<paint::PixelGrayscale> plane_view(data, 2);
+    EXPECT_EQ(3, plane_view(3, 4).w);
+
+    // Formats without 8-bit channels cannot be planar
+    EXPECT_THROW(paint::DataPixels(paint::Point{5, 3}, std::make_unique<paint::ColorRGB565>(0, 0, 0), paint::PixelLayout::kPlanar), std::invalid_argument);
+
+    data.CopyPixelFrom(3, 4, linear.at(3, 4));
+    data.ConvertLayout(paint::PixelLayout::kLinear);
+    for (paint::Unit y = 0; y < 70; y++)
+        EXPECT_EQ(0, std::memcmp(linear.RowPtr(y), data.RowPtr(y), linear.GetRowSize()));
+}
+
+TEST(data_pixels, planar_painter_matches_linear)
+{
+    using Operation = std::function<void(paint::Painter &)>;
+    std::vector<Operation> operations{
+        [](paint::Painter &p) { p.Rotate(paint::Rotation::kClock); },
+        [](paint::Painter &p) { p.Crop(paint::PointPX(13, 7), paint::PointPX(140, 69)); },
+        [](paint::Painter &p) { p.Resize(paint::PointPX(97, 131)); },
+        [](paint::Painter &p) { p.Resize(paint::PointPX(61, 200), paint::ResampleFilter::kBicubic); },
+        [](paint::Painter &p) { p.InvertColors(); },
+        [](paint::Painter &p) { p.ConvertToGrayscale(); },
+        [](paint::Painter &p) { p.ConvertToBW(); },
+        [](paint::Painter &p) { p.DrawLine(paint::PointPX(0, 3), paint::PointPX(149, 60), std::nullopt, 5); },
+        [](paint::Painter &p) { p.DrawLine(paint::PointPX(140, 2), paint::PointPX(3, 66), std::make_shared<paint::ColorRGB888>(200, 100, 50), 3, true); },
+        [](paint::Painter &p) { p.DrawCircle(paint::PointPX(100, 30), 45, true, std::make_shared<paint::ColorRGB888>(7, 8, 9), std::make_shared<paint::ColorRGB888>(200, 100, 50), 4); },
+        [](paint::Painter &p) { p.DrawBucket(paint::PointPX(75, 35), std::make_shared<paint::ColorRGB888>(7, 8, 9)); },
+        [](paint::Painter &p) { p.DrawBucket(paint::PointPX(75, 35), std::make_shared<paint::ColorRGB888>(7, 8, 9), 30); },
+        [](paint::Painter &p) { p.ReplaceColor(paint::ColorRGB888(200, 200, 200), std::make_shared<paint::ColorRGB888>(7, 8, 9), 10); },
+        [](paint::Painter &p) { p.ClearImage(std::make_shared<paint::ColorRGB888>(1, 2, 3)); },
+    };
+
+    for (auto &operation : operations)
+    {
+        // Few distinct colors, so the bucket fills a region
+        auto linear = std::make_shared<paint::DataPixels>(paint::Point{150, 70}, std::make_unique<paint::ColorRGB888>(0, 0, 0));
+        for (auto p : *linear)
+            std::memset(p, 0, 3);
+        for (paint::Unit y = 20; y < 50; y++)
+            std::memset(linear->at(40, y), 200, 3 * 60);
+        auto planar = std::make_shared<paint::DataPixels>(*linear);
+        planar->ConvertLayout(paint::PixelLayout::kPlanar);
+
+        paint::Painter painter([]() {}, true);
+        painter.AttachImageData(linear);
+        operation(painter);
+        painter.AttachImageData(planar);
+        operation(painter);
+
+        ASSERT_EQ(linear->GetColorFormat(), planar->GetColorFormat());
+        ASSERT_EQ(linear->GetSize(), planar->GetSize());
+        planar->ConvertLayout(paint::PixelLayout::kLinear);
+
+        // Compare through RGB888, bits unused by the pixel structure (BW) are not defined
+        auto c_linear = linear->GetColorType();
+        auto c_planar = planar->GetColorType();
+        for (paint::Unit y = 0; y < linear->GetSize().y; y++)
+        {
+            for (paint::Unit x = 0; x < linear->GetSize().x; x++)
+            {
+                c_linear->SetFromData(linear->at(x, y));
+                c_planar->SetFromData(planar->at(x, y));
+                ASSERT_EQ(paint::ColorRGB888(*c_linear), paint::ColorRGB888(*c_planar));
+            }
+        }
+    }
+}
+
+TEST(data_pixels, dither_matches_linear)
+{
+    using Operation = std::function<void(paint::Painter &)>;
+    std::vector<Operation> operations{
+        [](paint::Painter &p) { p.ConvertToBW(paint::DitherMethod::kBayer); },
+        [](paint::Painter &p) { p.ConvertToBW(paint::DitherMethod::kFloydSteinberg); },
+        [](paint::Painter &p) { p.ConvertToRGB565(paint::DitherMethod::kAtkinson); },
+        [](paint::Painter &p) { p.ConvertToRGB565(); },
+    };
+
+    for (paint::PixelLayout layout : {paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar})
+    {
+        for (auto &operation : operations)
+        {
+            auto linear = std::make_shared<paint::DataPixels>(paint::Point{150, 70}, std::make_unique<paint::ColorRGB888>(0, 0, 0));
+            FillRandom(*linear, 14);
+            auto other = std::make_shared<paint::DataPixels>(*linear);
+            other->ConvertLayout(layout);
+
+            paint::Painter painter([]() {}, true);
+            painter.AttachImageData(linear);
+            operation(painter);
+            painter.AttachImageData(other);
+            operation(painter);
+
+            ASSERT_EQ(linear->GetColorFormat(), other->GetColorFormat());
+            ASSERT_TRUE(linear->GetColorFormat() == paint::ColorFormat::kBW || linear->GetColorFormat() == paint::ColorFormat::kRGB565);
+            other->ConvertLayout(paint::PixelLayout::kLinear);
+
+            // Compare through RGB888, bits unused by the pixel structure (BW) are not defined
+            auto c_linear = linear->GetColorType();
+            auto c_other = other->GetColorType();
+            for (paint::Unit y = 0; y < linear->GetSize().y; y++)
+            {
+                for (paint::Unit x = 0; x < linear->GetSize().x; x++)
+                {
+                    c_linear->SetFromData(linear->at(x, y));
+                    c_other->SetFromData(other->at(x, y));
+                    ASSERT_EQ(paint::ColorRGB888(*c_linear), paint::ColorRGB888(*c_other));
+                }
+            }
+        }
+    }
+}
+
+TEST(data_pixels, linear_light)
+{
+    for (paint::PixelLayout layout : {paint::PixelLayout::kLinear, paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar})
+    {
+        // Black and white halves
+        auto data = std::make_shared<paint::DataPixels>(paint::Point{2, 2}, std::make_unique<paint::ColorRGB888>(0, 0, 0), layout);
+        for (paint::Unit y = 0; y < 2; y++)
+        {
+            const uint8_t row[6] = {0, 0, 0, 255, 255, 255};
+            data->CopyRowFrom(y, row);
+        }
+
+        paint::Painter painter([]() {}, true);
+        painter.SetLinearLight(true);
+        painter.AttachImageData(data);
+
+        // The pixel between black and white has half of the light
+        painter.Resize(paint::PointPX(4, 2));
+        ASSERT_EQ(4, data->GetSize().x);
+        uint8_t row[12];
+        data->CopyRowTo(0, row);
+        EXPECT_EQ(0, row[0]);
+        EXPECT_NEAR(188, row[3], 1);
+        EXPECT_EQ(255, row[6]);
+
+        // Red has about half of the light of white
+        painter.ClearImage(std::make_shared<paint::ColorRGB888>(255, 0, 0));
+        painter.ConvertToGrayscale();
+        ASSERT_EQ(paint::ColorFormat::kGrayscale, data->GetColorFormat());
+        data->CopyRowTo(1, row);
+        EXPECT_NEAR(127, row[0], 1);
+
+    }
+
+    // Random BGR888 pixels: the resize is the interpolation of the decoded channels, the grayscale is the same in every layout
+    paint::DataPixels source(paint::Point{150, 70}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    FillRandom(source, 21);
+    std::vector<uint8_t> gray_linear;
+    for (paint::PixelLayout layout : {paint::PixelLayout::kLinear, paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar})
+    {
+        for (paint::Point new_size : {paint::Point{61, 97}, paint::Point{211, 33}})
+        {
+            auto data = std::make_shared<paint::DataPixels>(source);
+            data->ConvertLayout(layout);
+            paint::Painter painter([]() {}, true);
+            painter.SetLinearLight(true);
+            painter.AttachImageData(data);
+            painter.Resize(paint::PointPX(new_size.x, new_size.y));
+            ASSERT_EQ(new_size, data->GetSize());
+
+            // The sample positions of Painter::Resize()
+            const float multiplier_x = 150.0f / new_size.x, multiplier_y = 70.0f / new_size.y;
+            auto linear = [&](paint::Unit x, paint::Unit y, size_t c) { return static_cast<double>(paint::SrgbToLinear(static_cast<const uint8_t *>(source.at(x, y))[c])); };
+            std::vector<uint8_t> row(data->GetRowSize());
+            for (paint::Unit y = 0; y < new_size.y; y++)
+            {
+                data->CopyRowTo(y, row.data());
+                const float v = y * multiplier_y;
+                const paint::Unit top = static_cast<paint::Unit>(std::floor(v)), bottom = std::min<paint::Unit>(static_cast<paint::Unit>(std::ceil(v)), 69);
+                for (paint::Unit x = 0; x < new_size.x; x++)
+                {
+                    const float u = x * multiplier_x;
+                    const paint::Unit left = static_cast<paint::Unit>(std::floor(u)), right = std::min<paint::Unit>(static_cast<paint::Unit>(std::ceil(u)), 149);
+                    for (size_t c = 0; c < 3; c++)
+                    {
+                        const double c_top = linear(left, top, c) + (linear(right, top, c) - linear(left, top, c)) * (u - left);
+                        const double c_bottom = linear(left, bottom, c) + (linear(right, bottom, c) - linear(left, bottom, c)) * (u - left);
+                        const uint8_t expected = paint::LinearToSrgb(static_cast<uint16_t>(std::lround(c_top + (c_bottom - c_top) * (v - top))));
+                        ASSERT_NEAR(expected, row[x * 3 + c], 1) << "layout " << static_cast<int>(layout) << " at " << x << ", " << y;
+                    }
+                }
+            }
+        }
+
+        auto data = std::make_shared<paint::DataPixels>(source);
+        data->ConvertLayout(layout);
+        paint::Painter painter([]() {}, true);
+        painter.SetLinearLight(true);
+        painter.AttachImageData(data);
+        painter.ConvertToGrayscale();
+        ASSERT_EQ(paint::ColorFormat::kGrayscale, data->GetColorFormat());
+
+        std::vector<uint8_t> gray(150 * 70);
+        for (paint::Unit y = 0; y < 70; y++)
+            data->CopyRowTo(y, gray.data() + y * 150);
+        if (gray_linear.empty())
+            gray_linear = gray;
+        EXPECT_EQ(gray_linear, gray) << "layout " << static_cast<int>(layout);
+    }
+}
+
+TEST(data_pixels, indexed_palette)
+{
+    for (paint::PixelLayout layout : {paint::PixelLayout::kLinear, paint::PixelLayout::kTiled})
+    {
+        // 3 colors
+        auto data = std::make_shared<paint::DataPixels>(paint::Point{150, 70}, std::make_unique<paint::ColorRGB888>(0, 0, 0), layout);
+        paint::Painter painter([]() {}, true);
+        painter.AttachImageData(data);
+        painter.ClearImage(std::make_shared<paint::ColorRGB888>(10, 20, 30));
+        painter.DrawLine(paint::PointPX(0, 0), paint::PointPX(149, 69), std::make_shared<paint::ColorRGB888>(200, 100, 50), 5);
+        painter.DrawLine(paint::PointPX(0, 69), paint::PointPX(149, 0), std::make_shared<paint::ColorRGB888>(255, 255, 255), 3);
+        paint::DataPixels original(*data);
+
+        // Few colors are kept exactly
+        painter.Quantize(16);
+        ASSERT_EQ(paint::ColorFormat::kIndexed8, data->GetColorFormat());
+        ASSERT_EQ(layout, data->GetLayout());
+        ASSERT_EQ(3U, data->GetPalette()->GetSize());
+
+        std::vector<uint8_t> row(150 * 3), row_original(150 * 3);
+        for (paint::Unit y = 0; y < 70; y++)
+        {
+            data->ConvertRowTo(y, paint::ColorFormat::kRGB888, row.data());
+            original.CopyRowTo(y, row_original.data());
+            ASSERT_EQ(row_original, row) << "row " << y;
+        }
+
+        // Inverting changes only the palette
+        paint::DataPixels indexed(*data);
+        painter.InvertColors();
+        original.TransformToColorType(std::make_unique<paint::ColorBGR888>(0, 0, 0));
+        std::vector<uint8_t> indices(150), indices_before(150);
+        for (paint::Unit y = 0; y < 70; y++)
+        {
+            data->CopyRowTo(y, indices.data());
+            indexed.CopyRowTo(y, indices_before.data());
+            ASSERT_EQ(indices_before, indices) << "row " << y;
+
+            data->ConvertRowTo(y, paint::ColorFormat::kBGR888, row.data());
+            original.CopyRowTo(y, row_original.data());
+            for (auto &channel : row_original)
+                channel = ~channel;
+            ASSERT_EQ(row_original, row) << "row " << y;
+        }
+        EXPECT_EQ(paint::ColorFormat::kIndexed8, indexed.GetColorFormat());
+        EXPECT_NE(*indexed.GetPalette(), *data->GetPalette());
+
+        // Drawing picks the nearest palette color
+        painter.DrawLine(paint::PointPX(0, 10), paint::PointPX(149, 10), std::make_shared<paint::ColorRGB888>(250, 250, 250), 1);
+        data->ConvertRowTo(10, paint::ColorFormat::kRGB888, row.data());
+        EXPECT_EQ(245, row[0]);
+        EXPECT_EQ(235, row[1]);
+        EXPECT_EQ(225, row[2]);
+
+        // Resizing picks the nearest pixels
+        painter.Resize(paint::PointPX(61, 33));
+        ASSERT_EQ((paint::Point{61, 33}), data->GetSize());
+        for (paint::Unit y = 0; y < 33; y++)
+        {
+            data->CopyRowTo(y, indices.data());
+            for (paint::Unit x = 0; x < 61; x++)
+                ASSERT_LT(indices[x], 3);
+        }
+
+        // Back to colors through the palette
+        painter.ConvertToGrayscale();
+        EXPECT_EQ(paint::ColorFormat::kGrayscale, data->GetColorFormat());
+        EXPECT_EQ(nullptr, data->GetPalette());
+    }
+}
+
+TEST(data_pixels, packed_layout)
+{
+    paint::DataPixels data(paint::Point{150, 70}, std::make_unique<paint::ColorBW>(0));
+    FillRandom(data, 6);
+    paint::DataPixels linear(data);
+
+    data.ConvertLayout(paint::PixelLayout::kPacked);
+    ASSERT_EQ(paint::PixelLayout::kPacked, data.GetLayout());
+    ASSERT_EQ(0U, data.GetRowStride() % 8);
+
+    // 8 pixels in a byte, the first pixel in the most significant bit, the bits after the last pixel are 0
+    for (paint::Unit y = 0; y < 70; y++)
+    {
+        const uint8_t *row = reinterpret_cast<const uint8_t *>(data.PackedRowPtr(y));
+        for (paint::Unit x = 0; x < 150; x++)
+            ASSERT_EQ(reinterpret_cast<paint::PixelBW *>(linear.at(x, y))->w, (row[x / 8] >> (7 - x % 8)) & 1);
+        for (size_t i = 150; i < data.GetRowStride() * 8; i++)
+            ASSERT_EQ(0, (row[i / 8] >> (7 - i % 8)) & 1);
+    }
+
+    // Pixel copies read and write single bits
+    paint::PixelBW pixel;
+    pixel.w = 1;
+    data.CopyPixelFrom(149, 69, &pixel);
+    pixel.w = 0;
+    data.CopyPixelTo(149, 69, &pixel);
+    EXPECT_EQ(1, pixel.w);
+    EXPECT_EQ(1, (reinterpret_cast<const uint8_t *>(data.PackedRowPtr(69))[18] >> 2) & 1);
+
+    // Packed pixels are not addressable and only BW can be packed
+    EXPECT_THROW(paint::DataPixelsView<paint::PixelBW>{data}, paint::error_data_mismatch);
+    EXPECT_THROW(paint::DataPixels(paint::Point{5, 3}, std::make_unique<paint::ColorRGB565>(0, 0, 0), paint::PixelLayout::kPacked), std::invalid_argument);
+
+    data.CopyPixelFrom(149, 69, linear.at(149, 69));
+    data.ConvertLayout(paint::PixelLayout::kLinear);
+    for (paint::Unit y = 0; y < 70; y++)
+        for (paint::Unit x = 0; x < 150; x++)
+            ASSERT_EQ(reinterpret_cast<paint::PixelBW *>(linear.at(x, y))->w, reinterpret_cast<paint::PixelBW *>(data.at(x, y))->w);
+}
+
+TEST(data_pixels, packed_painter_matches_linear)
+{
+    using Operation = std::function<void(paint::Painter &)>;
+    std::vector<Operation> operations{
+        [](paint::Painter &p) { p.Rotate(paint::Rotation::kClock); },
+        [](paint::Painter &p) { p.Rotate(paint::Rotation::kCounterClock); },
+        [](paint::Painter &p) { p.Crop(paint::PointPX(13, 7), paint::PointPX(140, 69)); },
+        [](paint::Painter &p) { p.Crop(paint::PointPX(65, 1), paint::PointPX(149, 68)); },
+        [](paint::Painter &p) { p.Resize(paint::PointPX(97, 131)); },
+        [](paint::Painter &p) { p.Resize(paint::PointPX(61, 23), paint::ResampleFilter::kBox); },
+        [](paint::Painter &p) { p.InvertColors(); },
+        [](paint::Painter &p) { p.ConvertToGrayscale(); },
+        [](paint::Painter &p) { p.DrawLine(paint::PointPX(0, 3), paint::PointPX(149, 60), std::nullopt, 5); },
+        [](paint::Painter &p) { p.DrawLine(paint::PointPX(10, 0), paint::PointPX(20, 69), std::make_shared<paint::ColorRGB888>(255, 255, 255), 1); },
+        [](paint::Painter &p) { p.DrawLine(paint::PointPX(140, 2), paint::PointPX(3, 66), std::make_shared<paint::ColorRGB888>(255, 255, 255), 3, true); },
+        [](paint::Painter &p) { p.DrawCircle(paint::PointPX(100, 30), 45, true, std::make_shared<paint::ColorRGB888>(0, 0, 0), std::make_shared<paint::ColorRGB888>(255, 255, 255), 4); },
+        [](paint::Painter &p) { p.DrawBucket(paint::PointPX(75, 35), std::make_shared<paint::ColorRGB888>(255, 255, 255)); },
+        [](paint::Painter &p) { p.DrawBucket(paint::PointPX(3, 3), std::make_shared<paint::ColorRGB888>(255, 255, 255)); },
+        [](paint::Painter &p) { p.DrawBucket(paint::PointPX(3, 3), std::make_shared<paint::ColorRGB888>(255, 255, 255), 100); },
+        [](paint::Painter &p) { p.ReplaceColor(paint::ColorRGB888(0, 0, 0), std::make_shared<paint::ColorRGB888>(255, 255, 255)); },
+        [](paint::Painter &p) { p.ReplaceColor(paint::ColorRGB888(0, 0, 0), std::make_shared<paint::ColorRGB888>(255, 255, 255), 255); },
+        [](paint::Painter &p) { p.ClearImage(std::make_shared<paint::ColorRGB888>(255, 255, 255)); },
+    };
+
+    for (auto &operation : operations)
+    {
+        // Black background with a white rectangle containing a few black holes
+        auto linear = std::make_shared<paint::DataPixels>(paint::Point{150, 70}, std::make_unique<paint::ColorBW>(0));
+        std::mt19937 gen(7);
+        std::bernoulli_distribution hole(0.05);
+        for (paint::Unit y = 0; y < 70; y++)
+            for (paint::Unit x = 0; x < 150; x++)
+                reinterpret_cast<paint::PixelBW *>(linear->at(x, y))->w = x >= 30 && x < 120 && y >= 10 && y < 60 && !hole(gen);
+        auto packed = std::make_shared<paint::DataPixels>(*linear);
+        packed->ConvertLayout(paint::PixelLayout::kPacked);
+
+        paint::Painter painter([]() {}, true);
+        painter.AttachImageData(linear);
+        operation(painter);
+        painter.AttachImageData(packed);
+        operation(painter);
+
+        ASSERT_EQ(linear->GetColorFormat(), packed->GetColorFormat());
+        ASSERT_EQ(linear->GetSize(), packed->GetSize());
+        packed->ConvertLayout(paint::PixelLayout::kLinear);
+
+        // Compare through RGB888, bits unused by the pixel structure (BW) are not defined
+        auto c_linear = linear->GetColorType();
+        auto c_packed = packed->GetColorType();
+        for (paint::Unit y = 0; y < linear->GetSize().y; y++)
+        {
+            for (paint::Unit x = 0; x < linear->GetSize().x; x++)
+            {
+                c_linear->SetFromData(linear->at(x, y));
+                c_packed->SetFromData(packed->at(x, y));
+                ASSERT_EQ(paint::ColorRGB888(*c_linear), paint::ColorRGB888(*c_packed)) << "at " << x << ", " << y;
+            }
+        }
+    }
+}
+
+TEST(data_pixels, read_only_data)
+{
+    // 3 rows of 5 grayscale pixels with 4 byte alignment
+    auto shared = std::shared_ptr<uint8_t>(new uint8_t[8 * 3]{1, 2, 3, 4, 5, 9, 9, 9,
+                                                              6, 7, 8, 9, 10, 9, 9, 9,
+                                                              11, 12, 13, 14, 15, 9, 9, 9},
+                                           std::default_delete<uint8_t[]>());
+
+    paint::DataPixels data(paint::Point{5, 3}, std::make_unique<paint::ColorGrayscale>(0), std::shared_ptr<const uint8_t>(shared), 4);
+    ASSERT_TRUE(data.IsReadOnly());
+    EXPECT_EQ(shared.get(), data.RowPtr(0));
+    EXPECT_EQ(13, *reinterpret_cast<uint8_t *>(data.at(2, 2)));
+
+    // Copy (i.e. undo history) shares the data
+    paint::DataPixels copy(data);
+    EXPECT_TRUE(copy.IsReadOnly());
+    EXPECT_EQ(data.RowPtr(0), copy.RowPtr(0));
+
+    // First edit copies the data
+    auto dp = std::make_shared<paint::DataPixels>(data);
+    paint::Painter painter([]() {});
+    painter.AttachImageData(dp);
+    painter.InvertColors();
+
+    EXPECT_FALSE(dp->IsReadOnly());
+    EXPECT_NE(shared.get(), dp->RowPtr(0));
+    EXPECT_EQ(255 - 13, *reinterpret_cast<uint8_t *>(dp->at(2, 2)));
+    EXPECT_EQ(13, shared.get()[8 * 2 + 2]);
+
+    // Operations creating new data read the shared data directly
+    auto dp_rotated = std::make_shared<paint::DataPixels>(data);
+    painter.AttachImageData(dp_rotated);
+    EXPECT_NO_THROW(painter.Rotate(paint::Rotation::kClock));
+    EXPECT_FALSE(dp_rotated->IsReadOnly());
+    EXPECT_EQ(1, shared.get()[0]);
+}
+
+TEST(data_pixels, copy_on_write_chunks)
+{
+    for (auto layout : {paint::PixelLayout::kLinear, paint::PixelLayout::kTiled})
+    {
+        // 3 row bands (linear) or 3 x 3 tiles (tiled)
+        auto dp = std::make_shared<paint::DataPixels>(paint::Point{150, 150}, std::make_unique<paint::ColorRGB888>(0, 0, 0), layout);
+        FillRandom(*dp, 5);
+        EXPECT_EQ(0U, dp->GetSharedChunkCount());
+
+        // The history keeps a copy after each edit (same as Image::ImageEditCallback())
+        std::vector<std::shared_ptr<paint::DataPixels>> history;
+        paint::Painter painter([&]() { history.push_back(std::make_shared<paint::DataPixels>(*dp)); }, true);
+        painter.AttachImageData(dp);
+        history.push_back(std::make_shared<paint::DataPixels>(*dp));
+
+        size_t chunk_count = layout == paint::PixelLayout::kTiled ? 9U : 3U;
+        EXPECT_EQ(chunk_count, dp->GetSharedChunkCount());
+        EXPECT_FALSE(dp->IsReadOnly());
+
+        // A short line in the middle chunk clones only that chunk
+        painter.DrawLine(paint::PointPX(70, 80), paint::PointPX(80, 80), std::make_shared<paint::ColorRGB888>(1, 2, 3), 1);
+        ASSERT_EQ(2U, history.size());
+        EXPECT_EQ(chunk_count, dp->GetSharedChunkCount());
+
+        paint::DataPixels &before = *history[0];
+        paint::DataPixels &after = *history[1];
+        for (paint::Unit y = 0; y < 150; y += paint::DataPixels::kTileSize)
+        {
+            for (paint::Unit x = 0; x < 150; x += paint::DataPixels::kTileSize)
+            {
+                bool is_edited = (y >> paint::DataPixels::kTileSizeShift) == 1 &&
+                                 (layout == paint::PixelLayout::kLinear || (x >> paint::DataPixels::kTileSizeShift) == 1);
+                EXPECT_EQ(is_edited, before.at(x, y) != after.at(x, y));
+                EXPECT_EQ(after.at(x, y), dp->at(x, y));
+            }
+        }
+
+        // The old snapshot keeps the old pixels (the painter draws bottom up -> row 150 - 80)
+        paint::ColorRGB888 line_pixel(1, 2, 3);
+        EXPECT_EQ(0, std::memcmp(after.at(75, 70), line_pixel.GetData(), 3));
+        EXPECT_NE(0, std::memcmp(before.at(75, 70), line_pixel.GetData(), 3));
+
+        // Writing to the current image after the history is dropped needs no copy
+        history.clear();
+        EXPECT_EQ(0U, dp->GetSharedChunkCount());
+        void *chunk = dp->at(0, 0);
+        dp->MakeWritable();
+        EXPECT_EQ(chunk, dp->at(0, 0));
+    }
+}
+
+TEST(data_pixels, line_rasterizer)
+{
+    const paint::Point size{150, 70};
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<paint::Unit> distr_x(-20, size.x + 20);
+    std::uniform_int_distribution<paint::Unit> distr_y(-20, size.y + 20);
+
+    // Collects the pixels of the line
+    auto line_pixels = [&size](paint::Point start, paint::Point end, paint::Unit width) {
+        std::vector<bool> pixels(static_cast<size_t>(size.x) * size.y, false);
+        std::vector<paint::RowSpan> spans;
+        paint::LineRasterizer(start, end, width, size).GetSpans(spans);
+        for (auto [y, x_begin, x_end] : spans)
+        {
+            EXPECT_TRUE(0 <= y && y < size.y && 0 <= x_begin && x_end <= size.x);
+            for (paint::Unit x = x_begin; x < x_end; x++)
+            {
+                EXPECT_FALSE(pixels[y * size.x + x]) << "Pixel covered twice";
+                pixels[y * size.x + x] = true;
+            }
+        }
+        return pixels;
+    };
+
+    for (int i = 0; i < 200; i++)
+    {
+        paint::Point start{distr_x(gen), distr_y(gen)};
+        paint::Point end{distr_x(gen), distr_y(gen)};
+
+        // Both directions give the same pixels
+        for (paint::Unit width : {1, 2, 5})
+            ASSERT_EQ(line_pixels(start, end, width), line_pixels(end, start, width));
+
+        // 1px line (not clipped) has one run in each row and the runs of the neighbouring rows touch (8-connected)
+        std::vector<paint::RowSpan> spans;
+        paint::LineRasterizer(paint::Point{start.x + 20, start.y + 20}, paint::Point{end.x + 20, end.y + 20}, 1, paint::Point{1000, 1000}).GetSpans(spans);
+        ASSERT_EQ(static_cast<size_t>(std::abs(end.y - start.y) + 1), spans.size());
+        for (size_t s = 1; s < spans.size(); s++)
+        {
+            EXPECT_EQ(1, std::abs(spans[s].y - spans[s - 1].y));
+            EXPECT_TRUE(spans[s].x_begin <= spans[s - 1].x_end && spans[s - 1].x_begin <= spans[s].x_end);
+        }
+    }
+
+    // Both end points are drawn
+    auto steep = line_pixels(paint::Point{10, 0}, paint::Point{20, 69}, 1);
+    EXPECT_TRUE(steep[10] && steep[69 * size.x + 20]);
+    EXPECT_EQ(70, std::count(steep.begin(), steep.end(), true));
+
+    // Horizontal and vertical lines are width wide
+    for (paint::Unit width : {1, 2, 3, 4})
+    {
+        auto horizontal = line_pixels(paint::Point{10, 30}, paint::Point{100, 30}, width);
+        EXPECT_EQ(91 * width, std::count(horizontal.begin(), horizontal.end(), true));
+        auto vertical = line_pixels(paint::Point{50, 5}, paint::Point{50, 60}, width);
+        EXPECT_EQ(56 * width, std::count(vertical.begin(), vertical.end(), true));
+    }
+
+    // Antialiased line has full coverage along the middle and partial coverage on the edges
+    paint::Unit full = 0, partial = 0;
+    paint::LineRasterizer(paint::Point{10, 10}, paint::Point{130, 50}, 3, size, true).ForEachCoverageRow([&](paint::Unit, paint::Unit, const uint8_t *coverage, paint::Unit count) {
+        EXPECT_NE(0, coverage[0]);
+        EXPECT_NE(0, coverage[count - 1]);
+        full += std::count(coverage, coverage + count, 255);
+        partial += count - std::count(coverage, coverage + count, 255);
+    });
+    EXPECT_LT(120 * 2, full);
+    EXPECT_LT(0, partial);
+
+    // Antialiased line blends the edges with the background
+    auto data = std::make_shared<paint::DataPixels>(size, std::make_unique<paint::ColorGrayscale>(0));
+    paint::Painter painter([]() {});
+    painter.AttachImageData(data);
+    painter.ClearImage(std::make_shared<paint::ColorGrayscale>(0));
+    painter.DrawLine(paint::PointPX(10, 10), paint::PointPX(130, 50), std::make_shared<paint::ColorGrayscale>(255), 1, true);
+    EXPECT_EQ(255, reinterpret_cast<paint::PixelGrayscale *>(data->at(70, 30))->w);
+    size_t column_sum = 0;
+    for (paint::Unit y = 0; y < size.y; y++)
+        column_sum += reinterpret_cast<paint::PixelGrayscale *>(data->at(41, y))->w;
+    EXPECT_NEAR(255 * std::hypot(120.0, 40.0) / 120.0, column_sum, 20);
+}
+
+TEST(data_pixels, circle_rasterizer)
+{
+    const paint::Point size{150, 70};
+
+    // Border and inside of circles (clipped too) are the pixels at the right distance from the center
+    for (auto [center, radius, border_width] : {std::make_tuple(paint::Point{75, 35}, 20, 1),
+                                                std::make_tuple(paint::Point{75, 35}, 30, 6),
+                                                std::make_tuple(paint::Point{10, 60}, 41, 3),
+                                                std::make_tuple(paint::Point{-20, 80}, 70, 10),
+                                                std::make_tuple(paint::Point{75, 35}, 2, 9),
+                                                std::make_tuple(paint::Point{75, 35}, 0, 1),
+                                                std::make_tuple(paint::Point{75, 35}, 15, 0)})
+    {
+        std::vector<paint::RowSpan> border_spans, fill_spans;
+        paint::CircleRasterizer(center, radius, border_width, size).GetSpans(border_spans, fill_spans);
+
+        // 0 = outside, 1 = border, 2 = inside
+        std::vector<int> pixels(static_cast<size_t>(size.x) * size.y, 0);
+        for (auto [spans, value] : {std::make_pair(&border_spans, 1), std::make_pair(&fill_spans, 2)})
+        {
+            for (auto [y, x_begin, x_end] : *spans)
+            {
+                ASSERT_TRUE(0 <= y && y < size.y && 0 <= x_begin && x_end <= size.x);
+                for (paint::Unit x = x_begin; x < x_end; x++)
+                {
+                    EXPECT_EQ(0, pixels[y * size.x + x]) << "Pixel covered twice";
+                    pixels[y * size.x + x] = value;
+                }
+            }
+        }
+
+        const double outer = radius + border_width / 2.0;
+        const double inner = std::max(0.0, radius - border_width / 2.0);
+        for (paint::Unit y = 0; y < size.y; y++)
+        {
+            for (paint::Unit x = 0; x < size.x; x++)
+            {
+                const double distance = std::hypot(x - center.x, y - center.y);
+                const int expected = distance < inner ? 2 : (distance < outer ? 1 : 0);
+                ASSERT_EQ(expected, pixels[y * size.x + x]) << "at " << x << ", " << y << " radius " << radius;
+            }
+        }
+    }
+
+    // Filled circle without the border fills the disc, the painter draws the border over the inside
+    auto data = std::make_shared<paint::DataPixels>(size, std::make_unique<paint::ColorGrayscale>(0));
+    paint::Painter painter([]() {});
+    painter.AttachImageData(data);
+    painter.ClearImage(std::make_shared<paint::ColorGrayscale>(0));
+    painter.DrawCircle(paint::PointPX(75, 35), 20, true, std::make_shared<paint::ColorGrayscale>(100), std::make_shared<paint::ColorGrayscale>(255), 2);
+    EXPECT_EQ(100, reinterpret_cast<paint::PixelGrayscale *>(data->at(75, 35))->w);
+    EXPECT_EQ(255, reinterpret_cast<paint::PixelGrayscale *>(data->at(95, 35))->w);
+    EXPECT_EQ(255, reinterpret_cast<paint::PixelGrayscale *>(data->at(75, 15))->w);
+    EXPECT_EQ(0, reinterpret_cast<paint::PixelGrayscale *>(data->at(97, 35))->w);
+
+    // Huge circles are clipped without overflow
+    EXPECT_NO_THROW(painter.DrawCircle(paint::PointPX(75, 35), std::numeric_limits<paint::Unit>::max(), true));
+}
+
+TEST(data_pixels, flood_fill)
+{
+    const paint::Point size{150, 300};
+    const size_t pixel_count = static_cast<size_t>(size.x) * size.y;
+
+    for (auto &color : AllColorTypes())
+    {
+        // Random blobs of 2 colors (all bytes of a pixel are 0 or 255) with many regions
+        paint::DataPixels linear(size, std::unique_ptr<paint::Color>(color->clone()));
+        std::mt19937 gen(9);
+        std::bernoulli_distribution foreground(0.4);
+        std::vector<bool> is_foreground(pixel_count);
+        for (paint::Unit y = 0; y < size.y; y++)
+        {
+            for (paint::Unit x = 0; x < size.x; x++)
+            {
+                is_foreground[y * size.x + x] = foreground(gen);
+                std::memset(linear.at(x, y), is_foreground[y * size.x + x] ? 255 : 0, linear.GetColorType()->GetDataSize());
+            }
+        }
+
+        for (auto layout : {paint::PixelLayout::kLinear, paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar, paint::PixelLayout::kPacked})
+        {
+            if (!paint::DataPixels::IsLayoutSupported(layout, linear.GetColorFormat()))
+                continue;
+
+            paint::DataPixels data(linear);
+            data.ConvertLayout(layout);
+
+            // Scanline search, the parallel search of the strips (and the scanline search switching to it)
+            using Search = std::function<void(paint::DataPixels &, paint::Point, std::vector<paint::RowSpan> &)>;
+            std::vector<Search> searches{
+                [](paint::DataPixels &d, paint::Point seed, std::vector<paint::RowSpan> &spans) { paint::FindRegion(d, seed, spans); },
+                [](paint::DataPixels &d, paint::Point seed, std::vector<paint::RowSpan> &spans) { paint::FindRegionParallel(d, seed, spans, 0, 3); },
+                [](paint::DataPixels &d, paint::Point seed, std::vector<paint::RowSpan> &spans) { paint::FindRegion(d, seed, spans, 0, 0, 3); },
+            };
+
+            for (auto [search, seed] : {std::make_pair(0, paint::Point{0, 0}), std::make_pair(0, paint::Point{75, 135}), std::make_pair(0, paint::Point{149, 299}),
+                                        std::make_pair(1, paint::Point{13, 160}), std::make_pair(1, paint::Point{120, 5}), std::make_pair(1, paint::Point{75, 135}),
+                                        std::make_pair(2, paint::Point{0, 0}), std::make_pair(2, paint::Point{149, 299})})
+            {
+                std::vector<paint::RowSpan> spans;
+                searches[search](data, seed, spans);
+
+                // The runs are sorted and cover every pixel once
+                std::vector<bool> found(pixel_count, false);
+                for (size_t i = 0; i < spans.size(); i++)
+                {
+                    auto [y, x_begin, x_end] = spans[i];
+                    ASSERT_TRUE(0 <= y && y < size.y && 0 <= x_begin && x_begin < x_end && x_end <= size.x);
+                    if (i > 0)
+                    {
+                        ASSERT_TRUE(spans[i - 1].y < y || spans[i - 1].x_end < x_begin) << "Runs are not sorted or not whole";
+                    }
+                    for (paint::Unit x = x_begin; x < x_end; x++)
+                        found[y * size.x + x] = true;
+                }
+
+                // 4-connected region of the seed searched pixel by pixel
+                std::vector<bool> expected(pixel_count, false);
+                std::vector<paint::Point> stack{seed};
+                const bool seed_color = is_foreground[seed.y * size.x + seed.x];
+                expected[seed.y * size.x + seed.x] = true;
+                while (!stack.empty())
+                {
+                    const paint::Point p = stack.back();
+                    stack.pop_back();
+                    for (paint::Point n : {paint::Point{p.x - 1, p.y}, paint::Point{p.x + 1, p.y}, paint::Point{p.x, p.y - 1}, paint::Point{p.x, p.y + 1}})
+                    {
+                        if (n.x < 0 || n.y < 0 || n.x >= size.x || n.y >= size.y)
+                            continue;
+
+                        const size_t i = n.y * size.x + n.x;
+                        if (!expected[i] && is_foreground[i] == seed_color)
+                        {
+                            expected[i] = true;
+                            stack.push_back(n);
+                        }
+                    }
+                }
+
+                ASSERT_EQ(expected, found) << "search " << search << " layout " << static_cast<int>(layout) << " seed " << seed.x << ", " << seed.y;
+            }
+        }
+    }
+}
+
+TEST(data_pixels, color_match)
+{
+    const paint::Point size{150, 130};
+    const size_t pixel_count = static_cast<size_t>(size.x) * size.y;
+    const uint8_t tolerance = 20;
+
+    // Noisy blobs of 2 colors (a scanned background)
+    std::mt19937 gen(12);
+    std::bernoulli_distribution foreground(0.35);
+    std::uniform_int_distribution<int> noise(-12, 12);
+    std::vector<paint::PixelRGB888> rgb(pixel_count);
+    for (auto &pixel : rgb)
+    {
+        const int base = foreground(gen) ? 40 : 150;
+        pixel = paint::PixelRGB888{static_cast<uint8_t>(base + noise(gen)), static_cast<uint8_t>(base + 50 + noise(gen)), static_cast<uint8_t>(base + 20 + noise(gen))};
+    }
+
+    std::vector<std::shared_ptr<paint::DataPixels>> images;
+    for (paint::ColorFormat format : {paint::ColorFormat::kRGB565, paint::ColorFormat::kBGR565, paint::ColorFormat::kRGB888, paint::ColorFormat::kBGR888,
+                                      paint::ColorFormat::kGrayscale, paint::ColorFormat::kBW, paint::ColorFormat::kBGRA8888})
+    {
+        std::unique_ptr<paint::Color> color;
+        switch (format)
+        {
+        case paint::ColorFormat::kRGB565: color = std::make_unique<paint::ColorRGB565>(0, 0, 0); break;
+        case paint::ColorFormat::kBGR565: color = std::make_unique<paint::ColorBGR565>(0, 0, 0); break;
+        case paint::ColorFormat::kRGB888: color = std::make_unique<paint::ColorRGB888>(0, 0, 0); break;
+        case paint::ColorFormat::kBGR888: color = std::make_unique<paint::ColorBGR888>(0, 0, 0); break;
+        case paint::ColorFormat::kGrayscale: color = std::make_unique<paint::ColorGrayscale>(0); break;
+        case paint::ColorFormat::kBW: color = std::make_unique<paint::ColorBW>(0); break;
+        default: color = std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 255); break;
+        }
+
+        auto data = std::make_shared<paint::DataPixels>(size, std::move(color));
+        for (paint::Unit y = 0; y < size.y; y++)
+            paint::ConvertSpan(paint::ColorFormat::kRGB888, format, rgb.data() + y * size.x, data->RowPtr(y), size.x);
+        images.push_back(data);
+    }
+
+    // Indexed pixels are matched by the colors of the palette
+    auto indexed = std::make_shared<paint::DataPixels>(*images[2]);
+    paint::Painter painter([]() {}, true);
+    painter.AttachImageData(indexed);
+    painter.Quantize(32);
+    images.push_back(indexed);
+
+    const paint::SimdLevel supported = paint::SetSimdLevel(paint::SimdLevel::kAVX512);
+    for (auto &linear : images)
+    {
+        // A pixel matches if all its bytes (8-bit channels) or all its RGB888 channels are within the tolerance
+        const paint::ColorFormat format = linear->GetColorFormat();
+        const bool by_bytes = format == paint::ColorFormat::kRGB888 || format == paint::ColorFormat::kBGR888 || format == paint::ColorFormat::kGrayscale || format == paint::ColorFormat::kBGRA8888;
+        const size_t pixel_size = linear->GetColorType()->GetDataSize();
+        auto to_rgb = [&](const void *pixel) {
+            paint::PixelRGB888 color;
+            if (format == paint::ColorFormat::kIndexed8)
+                linear->GetPalette()->ConvertIndices(static_cast<const uint8_t *>(pixel), paint::ColorFormat::kRGB888, &color, 1);
+            else
+                paint::ConvertSpan(format, paint::ColorFormat::kRGB888, pixel, &color, 1);
+            return color;
+        };
+        auto matches = [&](paint::Point p, const uint8_t *pixel) {
+            const uint8_t *other = static_cast<const uint8_t *>(linear->at(p.x, p.y));
+            auto close = [tolerance](int a, int b) { return std::abs(a - b) <= tolerance; };
+            if (by_bytes)
+                return std::equal(other, other + pixel_size, pixel, close);
+
+            const paint::PixelRGB888 a = to_rgb(other);
+            const paint::PixelRGB888 b = to_rgb(pixel);
+            return close(a.r, b.r) && close(a.g, b.g) && close(a.b, b.b);
+        };
+
+        for (auto layout : {paint::PixelLayout::kLinear, paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar, paint::PixelLayout::kPacked})
+        {
+            if (!paint::DataPixels::IsLayoutSupported(layout, format))
+                continue;
+
+            paint::DataPixels data(*linear);
+            data.ConvertLayout(layout);
+
+            for (paint::Point seed : {paint::Point{0, 0}, paint::Point{75, 64}, paint::Point{149, 129}})
+            {
+                uint8_t pixel[4] = {};
+                std::memcpy(pixel, linear->at(seed.x, seed.y), pixel_size);
+
+                std::vector<bool> expected(pixel_count);
+                for (paint::Unit y = 0; y < size.y; y++)
+                    for (paint::Unit x = 0; x < size.x; x++)
+                        expected[y * size.x + x] = matches(paint::Point{x, y}, pixel);
+
+                // All the kernels match the same pixels, the bits after the row are clear
+                for (int level = 0; level <= static_cast<int>(supported); level++)
+                {
+                    paint::SetSimdLevel(static_cast<paint::SimdLevel>(level));
+                    paint::ColorMatcher matcher(data, pixel, tolerance);
+                    std::vector<uint8_t> bits(matcher.GetRowSize());
+                    for (paint::Unit y = 0; y < size.y; y++)
+                    {
+                        matcher.MatchRow(y, bits.data());
+                        for (paint::Unit x = 0; x < static_cast<paint::Unit>(bits.size() * 8); x++)
+                            ASSERT_EQ(x < size.x && expected[y * size.x + x], paint::GetPackedBit(bits.data(), x))
+                                << "format " << static_cast<int>(format) << " layout " << static_cast<int>(layout) << " level " << level << " at " << x << ", " << y;
+                    }
+                }
+                paint::SetSimdLevel(supported);
+
+                // The bucket fill finds the 4-connected matching pixels (by the scanline search and in parallel)
+                std::vector<bool> region(pixel_count, false);
+                std::vector<paint::Point> stack{seed};
+                region[seed.y * size.x + seed.x] = true;
+                while (!stack.empty())
+                {
+                    const paint::Point p = stack.back();
+                    stack.pop_back();
+                    for (paint::Point n : {paint::Point{p.x - 1, p.y}, paint::Point{p.x + 1, p.y}, paint::Point{p.x, p.y - 1}, paint::Point{p.x, p.y + 1}})
+                    {
+                        if (n.x < 0 || n.y < 0 || n.x >= size.x || n.y >= size.y)
+                            continue;
+
+                        const size_t i = n.y * size.x + n.x;
+                        if (!region[i] && expected[i])
+                        {
+                            region[i] = true;
+                            stack.push_back(n);
+                        }
+                    }
+                }
+
+                for (bool parallel : {false, true})
+                {
+                    std::vector<paint::RowSpan> spans;
+                    if (parallel)
+                        paint::FindRegionParallel(data, seed, spans, tolerance, 3);
+                    else
+                        paint::FindRegion(data, seed, spans, tolerance);
+
+                    std::vector<bool> found(pixel_count, false);
+                    for (auto [y, x_begin, x_end] : spans)
+                        for (paint::Unit x = x_begin; x < x_end; x++)
+                            found[y * size.x + x] = true;
+                    ASSERT_EQ(region, found) << "format " << static_cast<int>(format) << " layout " << static_cast<int>(layout) << " parallel " << parallel;
+                }
+            }
+        }
+    }
+
+    // Replacing the color changes exactly the matching pixels
+    auto replaced = std::make_shared<paint::DataPixels>(*images[2]);
+    int edits = 0;
+    paint::Painter replace_painter([&edits]() { edits++; }, true);
+    replace_painter.AttachImageData(replaced);
+    replace_painter.ReplaceColor(paint::ColorRGB888(150, 200, 170), std::make_shared<paint::ColorRGB888>(255, 0, 255), tolerance);
+    EXPECT_EQ(1, edits);
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        const paint::PixelRGB888 &before = rgb[i];
+        const paint::PixelRGB888 &after = *static_cast<const paint::PixelRGB888 *>(replaced->at(i % size.x, i / size.x));
+        const bool is_match = std::abs(before.r - 150) <= tolerance && std::abs(before.g - 200) <= tolerance && std::abs(before.b - 170) <= tolerance;
+        const paint::PixelRGB888 expected = is_match ? paint::PixelRGB888{255, 0, 255} : before;
+        ASSERT_EQ(expected, after) << "pixel " << i;
+    }
+
+    // No matching pixel is no edit
+    replace_painter.ReplaceColor(paint::ColorRGB888(1, 2, 3), std::nullopt, tolerance);
+    EXPECT_EQ(1, edits);
+}
+
+TEST(data_pixels, resample)
+{
+    const std::vector<paint::ResampleFilter> filters{paint::ResampleFilter::kBox, paint::ResampleFilter::kBilinear, paint::ResampleFilter::kBicubic, paint::ResampleFilter::kLanczos3};
+
+    // The weights of every pixel add up to one and stay in the source
+    for (auto filter : filters)
+    {
+        for (auto [src_size, dst_size] : {std::pair<paint::Unit, paint::Unit>{150, 61}, {61, 150}, {7, 1}, {1, 9}, {1000, 3}, {64, 64}})
+        {
+            paint::ResampleWeights weights(filter, src_size, dst_size);
+            ASSERT_EQ(static_cast<size_t>(dst_size), weights.first.size());
+            for (paint::Unit x = 0; x < dst_size; x++)
+            {
+                ASSERT_GE(weights.first[x], 0);
+                ASSERT_LE(weights.first[x] + weights.count[x], src_size);
+                ASSERT_LE(static_cast<size_t>(weights.count[x]), weights.taps);
+                int sum = 0;
+                for (size_t k = 0; k < weights.taps; k++)
+                    sum += weights.values[x * weights.taps + k];
+                ASSERT_EQ(1 << paint::ResampleWeights::kWeightBits, sum);
+            }
+        }
+    }
+
+    // Flat colors stay the same in every format
+    for (auto &color : AllColorTypes())
+    {
+        for (auto filter : filters)
+        {
+            auto data = std::make_shared<paint::DataPixels>(paint::Point{150, 70}, std::unique_ptr<paint::Color>(color->clone()));
+            paint::Painter painter([]() {}, true);
+            painter.AttachImageData(data);
+            painter.ClearImage(std::make_shared<paint::ColorRGB888>(200, 100, 50));
+            std::vector<uint8_t> expected(data->GetRowSize());
+            data->CopyRowTo(0, expected.data());
+
+            painter.Resize(paint::PointPX(61, 97), filter);
+            ASSERT_EQ((paint::Point{61, 97}), data->GetSize());
+            std::vector<uint8_t> row(data->GetRowSize());
+            expected.resize(row.size());
+            for (paint::Unit y = 0; y < 97; y++)
+            {
+                data->CopyRowTo(y, row.data());
+                ASSERT_EQ(expected, row) << "format " << static_cast<int>(color->GetColorFormat()) << " filter " << static_cast<int>(filter) << " row " << y;
+            }
+        }
+    }
+
+    // A target size without pixels leaves the image unchanged (the box filter does not divide by zero)
+    for (auto filter : {paint::ResampleFilter::kInterpolate, paint::ResampleFilter::kBox, paint::ResampleFilter::kBilinear, paint::ResampleFilter::kBicubic,
+                        paint::ResampleFilter::kLanczos3})
+    {
+        auto data = std::make_shared<paint::DataPixels>(paint::Point{72, 48}, std::make_unique<paint::ColorRGB888>(0, 0, 0));
+        FillRandom(*data, 25);
+        const std::vector<uint8_t> before(static_cast<uint8_t *>(data->RowPtr(0)), static_cast<uint8_t *>(data->RowPtr(0)) + data->GetDataSize());
+
+        int edits = 0;
+        paint::Painter painter([&edits]() { edits++; }, true);
+        painter.AttachImageData(data);
+        ASSERT_NO_THROW(painter.Resize(paint::PointPer(1, 1), filter)) << "filter " << static_cast<int>(filter);
+        ASSERT_NO_THROW(painter.Resize(paint::PointPX(0, 10), filter)) << "filter " << static_cast<int>(filter);
+        ASSERT_NO_THROW(painter.Resize(paint::PointPX(10, 0), filter)) << "filter " << static_cast<int>(filter);
+        ASSERT_EQ((paint::Point{72, 48}), data->GetSize());
+        ASSERT_EQ(0, edits);
+        ASSERT_EQ(before, std::vector<uint8_t>(static_cast<uint8_t *>(data->RowPtr(0)), static_cast<uint8_t *>(data->RowPtr(0)) + data->GetDataSize()));
+    }
+
+    // All the kernels give the same pixels (1, 3 and 4 channels)
+    const paint::SimdLevel supported = paint::SetSimdLevel(paint::SimdLevel::kAVX512);
+    std::vector<std::unique_ptr<paint::Color>> kernel_colors;
+    kernel_colors.push_back(std::make_unique<paint::ColorGrayscale>(0));
+    kernel_colors.push_back(std::make_unique<paint::ColorRGB888>(0, 0, 0));
+    kernel_colors.push_back(std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 255));
+    for (auto &color : kernel_colors)
+    {
+        for (auto filter : filters)
+        {
+            for (paint::Point new_size : {paint::Point{61, 33}, paint::Point{211, 157}})
+            {
+                paint::DataPixels data(paint::Point{150, 70}, std::unique_ptr<paint::Color>(color->clone()));
+                FillRandom(data, 5);
+
+                std::vector<std::vector<uint8_t>> results;
+                for (int level = 0; level <= static_cast<int>(supported); level++)
+                {
+                    paint::SetSimdLevel(static_cast<paint::SimdLevel>(level));
+                    paint::DataPixels new_data(new_size, std::unique_ptr<paint::Color>(color->clone()));
+                    paint::Resample(data, new_data, filter, false, 3);
+
+                    std::vector<uint8_t> pixels(new_data.GetRowSize() * new_size.y);
+                    for (paint::Unit y = 0; y < new_size.y; y++)
+                        new_data.CopyRowTo(y, pixels.data() + y * new_data.GetRowSize());
+                    results.push_back(std::move(pixels));
+                }
+
+                for (size_t level = 1; level < results.size(); level++)
+                    ASSERT_EQ(results[0], results[level]) << "filter " << static_cast<int>(filter) << " level " << level;
+            }
+        }
+    }
+    paint::SetSimdLevel(supported);
+
+    // Downscaled 1 pixel checkers are gray (not aliased), in linear light they have half of the light
+    for (bool linear_light : {false, true})
+    {
+        for (auto filter : filters)
+        {
+            auto data = std::make_shared<paint::DataPixels>(paint::Point{160, 80}, std::make_unique<paint::ColorGrayscale>(0));
+            for (paint::Unit y = 0; y < 80; y++)
+                for (paint::Unit x = 0; x < 160; x++)
+                    *static_cast<uint8_t *>(data->at(x, y)) = (x + y) % 2 ? 255 : 0;
+
+            paint::Painter painter([]() {}, true);
+            painter.SetLinearLight(linear_light);
+            painter.AttachImageData(data);
+            painter.Resize(paint::PointPX(20, 10), filter);
+
+            // The edge pixels repeat outside of the image, so only the inside is even
+            for (paint::Unit y = 1; y < 9; y++)
+                for (paint::Unit x = 1; x < 19; x++)
+                    ASSERT_NEAR(linear_light ? 188 : 128, *static_cast<uint8_t *>(data->at(x, y)), 2) << "filter " << static_cast<int>(filter) << " at " << x << ", " << y;
+        }
+    }
+
+    // The box filter of an integer factor averages the blocks exactly
+    paint::DataPixels data(paint::Point{150, 70}, std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 0));
+    FillRandom(data, 9);
+    for (paint::Unit y = 0; y < 70; y++)
+    {
+        // Premultiplied pixels
+        auto *row = static_cast<uint8_t *>(data.RowPtr(y));
+        for (paint::Unit x = 0; x < 150; x++)
+            for (size_t c = 0; c < 3; c++)
+                row[x * 4 + c] = std::min(row[x * 4 + c], row[x * 4 + 3]);
+    }
+    paint::DataPixels half(paint::Point{75, 35}, std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 0));
+    paint::Resample(data, half, paint::ResampleFilter::kBox, false);
+    for (paint::Unit y = 0; y < 35; y++)
+    {
+        for (paint::Unit x = 0; x < 75; x++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                int sum = 0;
+                for (paint::Point p : {paint::Point{2 * x, 2 * y}, paint::Point{2 * x + 1, 2 * y}, paint::Point{2 * x, 2 * y + 1}, paint::Point{2 * x + 1, 2 * y + 1}})
+                    sum += static_cast<const uint8_t *>(data.at(p.x, p.y))[c];
+                ASSERT_EQ((sum + 2) / 4, static_cast<const uint8_t *>(half.at(x, y))[c]) << "at " << x << ", " << y;
+            }
+        }
+    }
+}
+
+TEST(data_pixels, pyramid)
+{
+    std::vector<std::unique_ptr<paint::Color>> colors;
+    colors.push_back(std::make_unique<paint::ColorGrayscale>(0));
+    colors.push_back(std::make_unique<paint::ColorRGB888>(0, 0, 0));
+    colors.push_back(std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 255));
+    for (auto &color : colors)
+    {
+        paint::DataPixels data(paint::Point{150, 70}, std::unique_ptr<paint::Color>(color->clone()));
+        FillRandom(data, 11);
+        const size_t pixel_size = color->GetDataSize();
+        if (color->GetColorFormat() == paint::ColorFormat::kBGRA8888)
+        {
+            // Premultiplied pixels
+            for (paint::Unit y = 0; y < 70; y++)
+            {
+                auto *row = static_cast<uint8_t *>(data.RowPtr(y));
+                for (paint::Unit x = 0; x < 150; x++)
+                    for (size_t c = 0; c < 3; c++)
+                        row[x * 4 + c] = std::min(row[x * 4 + c], row[x * 4 + 3]);
+            }
+        }
+
+        // Only the levels at least 1 pixel high
+        auto levels = paint::MakePyramid(data, 10, false, 3);
+        ASSERT_EQ(6U, levels.size());
+
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            const paint::Unit block = paint::Unit{2} << level;
+            ASSERT_EQ((paint::Point{150 / block, 70 / block}), levels[level]->GetSize());
+            ASSERT_EQ(color->GetColorFormat(), levels[level]->GetColorFormat());
+
+            // Rounded average of the block
+            for (paint::Unit y = 0; y < 70 / block; y++)
+            {
+                for (paint::Unit x = 0; x < 150 / block; x++)
+                {
+                    for (size_t c = 0; c < pixel_size; c++)
+                    {
+                        int sum = 0;
+                        for (paint::Unit block_y = 0; block_y < block; block_y++)
+                            for (paint::Unit block_x = 0; block_x < block; block_x++)
+                                sum += static_cast<const uint8_t *>(data.at(x * block + block_x, y * block + block_y))[c];
+                        ASSERT_EQ((sum + block * block / 2) / (block * block), static_cast<const uint8_t *>(levels[level]->at(x, y))[c])
+                            << "format " << static_cast<int>(color->GetColorFormat()) << " level " << level << " at " << x << ", " << y;
+                    }
+                }
+            }
+        }
+
+        // The first level is the box filter, also in linear light
+        for (bool linear_light : {false, true})
+        {
+            auto level = paint::MakePyramid(data, 1, linear_light, 2);
+            paint::DataPixels half(paint::Point{75, 35}, std::unique_ptr<paint::Color>(color->clone()));
+            paint::Resample(data, half, paint::ResampleFilter::kBox, linear_light, 2);
+
+            ASSERT_EQ(1U, level.size());
+            std::vector<uint8_t> row(half.GetRowSize()), expected(half.GetRowSize());
+            for (paint::Unit y = 0; y < 35; y++)
+            {
+                level[0]->CopyRowTo(y, row.data());
+                half.CopyRowTo(y, expected.data());
+                ASSERT_EQ(expected, row) << "linear light " << linear_light << " row " << y;
+            }
+        }
+
+        // Other layouts give the same levels
+        for (auto layout : {paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar})
+        {
+            if (!paint::DataPixels::IsLayoutSupported(layout, color->GetColorFormat()))
+                continue;
+
+            paint::DataPixels converted(data);
+            converted.ConvertLayout(layout);
+            auto converted_levels = paint::MakePyramid(converted, 3, false, 3);
+            ASSERT_EQ(3U, converted_levels.size());
+
+            for (size_t level = 0; level < converted_levels.size(); level++)
+            {
+                ASSERT_EQ(layout, converted_levels[level]->GetLayout());
+                std::vector<uint8_t> row(levels[level]->GetRowSize()), expected(levels[level]->GetRowSize());
+                for (paint::Unit y = 0; y < levels[level]->GetSize().y; y++)
+                {
+                    converted_levels[level]->CopyRowTo(y, row.data());
+                    levels[level]->CopyRowTo(y, expected.data());
+                    ASSERT_EQ(expected, row) << "layout " << static_cast<int>(layout) << " level " << level << " row " << y;
+                }
+            }
+        }
+    }
+}
+
+TEST(data_pixels, translucent_drawing)
+{
+    const paint::ColorBGRA8888 color(40, 160, 240, 100);
+    auto overlay = std::make_shared<paint::DataPixels>(paint::Point{40, 20}, std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 0));
+    for (paint::Unit y = 0; y < 20; y++)
+        for (paint::Unit x = 0; x < 40; x++)
+            *reinterpret_cast<paint::PixelBGRA8888 *>(overlay->at(x, y)) = paint::PremultiplyPixel(paint::PixelBGRA8888{200, 10, 90, static_cast<uint8_t>(x * 6)});
+
+    using Operation = std::function<void(paint::Painter &)>;
+    std::vector<Operation> operations{
+        [&](paint::Painter &p) { p.ClearImage(std::make_shared<paint::ColorBGRA8888>(color)); },
+        [&](paint::Painter &p) { p.DrawLine(paint::PointPX(0, 3), paint::PointPX(149, 60), std::make_shared<paint::ColorBGRA8888>(color), 5); },
+        [&](paint::Painter &p) { p.DrawBucket(paint::PointPX(75, 35), std::make_shared<paint::ColorBGRA8888>(color)); },
+        [&](paint::Painter &p) { p.DrawOverlay(*overlay, paint::PointPX(125, 40)); },
+    };
+
+    for (size_t op = 0; op < operations.size(); op++)
+    {
+        auto &operation = operations[op];
+        const bool is_overlay = op == operations.size() - 1;
+
+        for (auto format : {paint::ColorFormat::kRGB888, paint::ColorFormat::kBGRA8888})
+        {
+            // Few distinct colors, so the bucket fills a region
+            std::unique_ptr<paint::Color> color_type = std::make_unique<paint::ColorRGB888>(0, 0, 0);
+            if (format == paint::ColorFormat::kBGRA8888)
+                color_type = std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 0);
+
+            auto original = std::make_shared<paint::DataPixels>(paint::Point{150, 70}, std::move(color_type));
+            paint::Painter painter([]() {}, true);
+            painter.AttachImageData(original);
+            painter.ClearImage(std::make_shared<paint::ColorRGB888>(0, 0, 0));
+            painter.DrawBucket(paint::PointPX(5, 5), std::make_shared<paint::ColorBGRA8888>(0, 0, 0, 128));
+            for (paint::Unit y = 20; y < 50; y++)
+                painter.DrawLine(paint::PointPX(40, y), paint::PointPX(100, y), std::make_shared<paint::ColorRGB888>(200, 200, 200), 1);
+
+            auto linear = std::make_shared<paint::DataPixels>(*original);
+            painter.AttachImageData(linear);
+            operation(painter);
+
+            // Every pixel is either kept or blended once
+            size_t blended_count = 0;
+            for (paint::Unit y = 0; y < linear->GetSize().y; y++)
+            {
+                for (paint::Unit x = 0; x < linear->GetSize().x; x++)
+                {
+                    auto before = original->GetColorType();
+                    auto after = linear->GetColorType();
+                    before->SetFromData(original->at(x, y));
+                    after->SetFromData(linear->at(x, y));
+
+                    const paint::PixelBGRA8888 kept = before->ToBGRA8888().GetPixel();
+                    const paint::PixelBGRA8888 result = after->ToBGRA8888().GetPixel();
+                    if (result == kept)
+                        continue;
+
+                    // The overlay rows are stored bottom up as the image rows (70 - 40 - 20 is the first row)
+                    const paint::PixelBGRA8888 src = is_overlay ? *reinterpret_cast<paint::PixelBGRA8888 *>(overlay->at(x - 125, y - 10)) : color.GetPixel();
+                    ASSERT_EQ(paint::ColorRGB888(paint::ColorBGRA8888(paint::BlendPixel(src, kept))), paint::ColorRGB888(*after)) << x << " " << y;
+                    blended_count++;
+                }
+            }
+            EXPECT_GT(blended_count, 0U);
+
+            // Same result in the other layouts
+            for (auto layout : {paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar})
+            {
+                if (!paint::DataPixels::IsLayoutSupported(layout, format))
+                    continue;
+
+                auto other = std::make_shared<paint::DataPixels>(*original);
+                other->ConvertLayout(layout);
+                painter.AttachImageData(other);
+                operation(painter);
+                other->ConvertLayout(paint::PixelLayout::kLinear);
+
+                for (paint::Unit y = 0; y < linear->GetSize().y; y++)
+                    ASSERT_EQ(0, std::memcmp(linear->at(0, y), other->at(0, y), linear->GetRowSize())) << "layout " << static_cast<int>(layout) << ", row " << y;
+            }
+        }
+    }
+}
+
+TEST(data_pixels, deferred_drawing)
+{
+    const paint::Point size{150, 300};
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<paint::Unit> distr_x(-30, size.x + 30);
+    std::uniform_int_distribution<paint::Unit> distr_y(-30, size.y + 30);
+    std::uniform_int_distribution<int> distr_width(0, 3);
+    std::uniform_int_distribution<int> distr_channel(0, 255);
+    std::bernoulli_distribution coin(0.3);
+
+    // Random lines of all widths, some antialiased and some translucent, and a few circles
+    // (around start with the radius |end.x - start.x| / 2, filled if antialias)
+    struct Line
+    {
+        paint::Point start, end;
+        paint::Unit width;
+        bool antialias;
+        std::shared_ptr<paint::Color> color;
+        bool circle;
+    };
+    std::vector<Line> lines;
+    for (int i = 0; i < 300; i++)
+    {
+        const paint::Unit widths[] = {1, 2, 5, 12};
+        auto b = static_cast<uint8_t>(distr_channel(gen)), g = static_cast<uint8_t>(distr_channel(gen)), r = static_cast<uint8_t>(distr_channel(gen));
+        std::shared_ptr<paint::Color> color = std::make_shared<paint::ColorRGB888>(r, g, b);
+        if (coin(gen))
+            color = std::make_shared<paint::ColorBGRA8888>(b, g, r, static_cast<uint8_t>(distr_channel(gen)));
+        lines.push_back(Line{paint::Point{distr_x(gen), distr_y(gen)}, paint::Point{distr_x(gen), distr_y(gen)}, widths[distr_width(gen)], coin(gen), color, i % 10 == 0});
+    }
+
+    auto color_types = AllColorTypes();
+    color_types.emplace_back(std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 0));
+
+    for (auto &color : color_types)
+    {
+        for (paint::PixelLayout layout : {paint::PixelLayout::kLinear, paint::PixelLayout::kTiled, paint::PixelLayout::kPlanar, paint::PixelLayout::kPacked})
+        {
+            if (!paint::DataPixels::IsLayoutSupported(layout, color->GetColorFormat()))
+                continue;
+
+            paint::DataPixels original(size, std::unique_ptr<paint::Color>(color->clone()));
+            FillRandom(original, 3);
+            auto immediate = std::make_shared<paint::DataPixels>(original);
+            immediate->ConvertLayout(layout);
+            auto deferred = std::make_shared<paint::DataPixels>(*immediate);
+            const paint::DataPixels before(*deferred);
+
+            size_t immediate_edits = 0, deferred_edits = 0;
+            paint::Painter immediate_painter([&]() { immediate_edits++; }, true);
+            immediate_painter.AttachImageData(immediate);
+            paint::Painter deferred_painter([&]() { deferred_edits++; }, true);
+            deferred_painter.AttachImageData(deferred);
+            deferred_painter.SetDeferredDrawing(true);
+
+            for (auto &line : lines)
+            {
+                for (paint::Painter *painter : {&immediate_painter, &deferred_painter})
+                {
+                    if (line.circle)
+                        painter->DrawCircle(paint::PointPX(line.start.x, line.start.y), std::abs(line.end.x - line.start.x) / 2, line.antialias, line.color, std::make_shared<paint::ColorRGB888>(1, 2, 3), line.width);
+                    else
+                        painter->DrawLine(paint::PointPX(line.start.x, line.start.y), paint::PointPX(line.end.x, line.end.y), line.color, line.width, line.antialias);
+                }
+            }
+
+            // Nothing is drawn until flushed, then the whole batch is a single edit
+            EXPECT_EQ(lines.size(), immediate_edits);
+            EXPECT_EQ(0U, deferred_edits);
+            deferred_painter.SetDeferredDrawing(false);
+            EXPECT_EQ(1U, deferred_edits);
+            deferred_painter.Flush();
+            EXPECT_EQ(1U, deferred_edits);
+
+            // Same pixels as drawing the lines one by one, the shared copy is unchanged
+            std::vector<uint8_t> row_immediate(size.x * 3), row_deferred(size.x * 3), row_before(size.x * 3), row_original(size.x * 3);
+            for (paint::Unit y = 0; y < size.y; y++)
+            {
+                immediate->ConvertRowTo(y, paint::ColorFormat::kRGB888, row_immediate.data());
+                deferred->ConvertRowTo(y, paint::ColorFormat::kRGB888, row_deferred.data());
+                ASSERT_EQ(row_immediate, row_deferred) << "row " << y;
+            }
+
+            for (paint::Unit y = 0; y < size.y; y++)
+            {
+                before.ConvertRowTo(y, paint::ColorFormat::kRGB888, row_before.data());
+                original.ConvertRowTo(y, paint::ColorFormat::kRGB888, row_original.data());
+                ASSERT_EQ(row_original, row_before) << "row " << y;
+            }
+        }
+    }
+
+    // One thread draws the same pixels as many threads
+    auto single = std::make_shared<paint::DataPixels>(size, std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 0), paint::PixelLayout::kTiled);
+    FillRandom(*single, 4);
+    auto multi = std::make_shared<paint::DataPixels>(*single);
+    multi->MakeWritable();
+
+    paint::DrawBatch batch;
+    for (unsigned thread_count : {1u, 8u})
+    {
+        paint::DataPixels &data = thread_count == 1 ? *single : *multi;
+        for (auto &line : lines)
+        {
+            if (line.circle)
+                batch.Add(paint::CirclePrimitive(data, line.start, std::abs(line.end.x - line.start.x) / 2, line.width, line.antialias, *line.color, paint::ColorRGB888(1, 2, 3)));
+            else
+                batch.Add(paint::LinePrimitive(data, line.start, line.end, line.width, line.antialias, *line.color));
+        }
+        EXPECT_EQ(lines.size(), batch.GetSize());
+
+        batch.Render(data, thread_count);
+        EXPECT_TRUE(batch.IsEmpty());
+    }
+
+    for (paint::Unit y = 0; y < size.y; y++)
+        for (paint::Unit x = 0; x < size.x; x++)
+            ASSERT_EQ(0, std::memcmp(single->at(x, y), multi->at(x, y), 4)) << "at " << x << ", " << y;
+}
+
+TEST(buffer_pool, size_class)
+{
+    EXPECT_EQ(64U, paint::BufferPool::GetSizeClass(1));
+    EXPECT_EQ(64U, paint::BufferPool::GetSizeClass(64));
+    EXPECT_EQ(80U, paint::BufferPool::GetSizeClass(65));
+    EXPECT_EQ(128U, paint::BufferPool::GetSizeClass(128));
+    EXPECT_EQ(1280U, paint::BufferPool::GetSizeClass(1025));
+    EXPECT_EQ(3U << 20, paint::BufferPool::GetSizeClass((3U << 20) - 1));
+
+    // Waste is at most 1/4 of the requested size
+    for (size_t size = 65; size < 100000; size += 97)
+    {
+        size_t size_class = paint::BufferPool::GetSizeClass(size);
+        EXPECT_LE(size, size_class);
+        EXPECT_LE(size_class - size, size / 4);
+    }
+}
+
+TEST(buffer_pool, reuse_and_capacity)
+{
+    auto pool = std::make_shared<paint::BufferPool>(1000);
+
+    auto buffer = pool->Allocate(500, 64);
+    uint8_t *data = buffer.get();
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(data) % 64);
+    buffer.reset();
+
+    // Same size class and alignment -> the same buffer
+    buffer = pool->Allocate(480, 64);
+    EXPECT_EQ(data, buffer.get());
+
+    // Different alignment -> new buffer
+    auto other = pool->Allocate(480, 128);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(other.get()) % 128);
+
+    auto statistics = pool->GetStatistics();
+    EXPECT_EQ(1U, statistics.hit_count);
+    EXPECT_EQ(2U, statistics.miss_count);
+    EXPECT_EQ(0U, statistics.cached_byte_count);
+
+    // Only one 512 B buffer fits into the pool
+    buffer.reset();
+    other.reset();
+    statistics = pool->GetStatistics();
+    EXPECT_EQ(2U, statistics.release_count);
+    EXPECT_EQ(1U, statistics.discard_count);
+    EXPECT_EQ(512U, statistics.cached_byte_count);
+
+    pool->ResetStatistics();
+    EXPECT_EQ(0U, pool->GetStatistics().release_count);
+    EXPECT_EQ(512U, pool->GetStatistics().cached_byte_count);
+
+    pool->SetCapacity(0);
+    EXPECT_EQ(0U, pool->GetStatistics().cached_byte_count);
+
+    // Buffers keep the pool alive
+    buffer = pool->Allocate(100, 16);
+    pool.reset();
+    buffer.reset();
+}
+
+TEST(buffer_pool, data_pixels_reuse)
+{
+    auto &pool = paint::BufferPool::GetDefault();
+    pool->Clear();
+    pool->ResetStatistics();
+
+    // 150 x 150 tiled -> 9 tiles
+    auto data = std::make_shared<paint::DataPixels>(paint::Point{150, 150}, std::make_unique<paint::ColorRGB888>(0, 0, 0), paint::PixelLayout::kTiled);
+    FillRandom(*data, 1);
+    EXPECT_EQ(9U, pool->GetStatistics().miss_count);
+
+    // Rotating allocates the new tiles from the pool, the old ones go back into the pool
+    paint::Painter painter([]() {});
+    painter.AttachImageData(data);
+    painter.Rotate(paint::Rotation::kClock);
+    painter.Rotate(paint::Rotation::kClock);
+    painter.Rotate(paint::Rotation::kClock);
+
+    auto statistics = pool->GetStatistics();
+    EXPECT_EQ(18U, statistics.miss_count);
+    EXPECT_EQ(18U, statistics.hit_count);
+    EXPECT_EQ(27U, statistics.release_count);
+}
+
+TEST(image_bmp, mmap_load)
+{
+    auto path = std::filesystem::temp_directory_path() / "paint_data_pixels_test_mmap.bmp";
+
+    // Create the test image
+    paint::image_bmp::ImageBMP created(path);
+    created.CreateImage(paint::Point{13, 7}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    created.painter.ClearImage(std::make_shared<paint::ColorRGB888>(10, 20, 30));
+    created.painter.DrawLine(paint::PointPX(0, 0), paint::PointPX(12, 6), std::make_shared<paint::ColorRGB888>(200, 100, 50), 1);
+    created.SaveImage();
+
+    paint::image_bmp::ImageBMP read(path);
+    read.LoadImage();
+    paint::image_bmp::ImageBMP mapped(path);
+    mapped.SetLoadMode(paint::LoadMode::kMap);
+    mapped.LoadImage();
+
+    // Edit both and save the mapped image over its own file
+    read.painter.InvertColors();
+    mapped.painter.InvertColors();
+    mapped.SaveImage();
+    read.SaveImage(path.string() + ".read.bmp");
+
+    paint::image_bmp::ImageBMP saved_mapped(path);
+    saved_mapped.LoadImage();
+    paint::image_bmp::ImageBMP saved_read(path.string() + ".read.bmp");
+    saved_read.LoadImage();
+
+    // Same pixels
+    std::filesystem::path dump_mapped = path.string() + ".mapped.bmp";
+    saved_mapped.SaveImage(dump_mapped);
+    std::ifstream f1(dump_mapped, std::ios::binary), f2(path.string() + ".read.bmp", std::ios::binary);
+    std::string content_mapped((std::istreambuf_iterator<char>(f1)), std::istreambuf_iterator<char>());
+    std::string content_read((std::istreambuf_iterator<char>(f2)), std::istreambuf_iterator<char>());
+    EXPECT_FALSE(content_read.empty());
+    EXPECT_EQ(content_read, content_mapped);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".read.bmp");
+    std::filesystem::remove(dump_mapped);
+}
+
+TEST(image_bmp, save_pyramid)
+{
+    auto path = std::filesystem::temp_directory_path() / "paint_data_pixels_test_pyramid.bmp";
+    auto level_path = [&path](size_t level) {
+        return path.parent_path() / ("paint_data_pixels_test_pyramid_" + std::to_string(level) + ".bmp");
+    };
+    auto read_file = [](const std::filesystem::path &file_path) {
+        std::ifstream f(file_path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    };
+
+    paint::image_bmp::ImageBMP created(path);
+    created.CreateImage(paint::Point{40, 22}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    created.painter.ClearImage(std::make_shared<paint::ColorRGB888>(10, 20, 30));
+    created.SavePyramid(2);
+
+    // The levels are the halved flat images
+    for (auto [level, size] : {std::pair<size_t, paint::Point>{1, paint::Point{20, 11}}, {2, paint::Point{10, 5}}})
+    {
+        std::string content = read_file(level_path(level));
+        ASSERT_FALSE(content.empty()) << "level " << level;
+        EXPECT_EQ(size.x, *reinterpret_cast<const int32_t *>(content.data() + 18));
+        EXPECT_EQ(size.y, *reinterpret_cast<const int32_t *>(content.data() + 22));
+
+        paint::image_bmp::ImageBMP flat(path.string() + ".flat.bmp");
+        flat.CreateImage(size, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+        flat.painter.ClearImage(std::make_shared<paint::ColorRGB888>(10, 20, 30));
+        flat.SaveImage();
+        // Same pixels (after the header)
+        EXPECT_EQ(read_file(path.string() + ".flat.bmp").substr(54), content.substr(54)) << "level " << level;
+    }
+    EXPECT_FALSE(std::filesystem::exists(level_path(3)));
+
+    // The image is still saved whole to its own file
+    created.SaveImage();
+    std::string content = read_file(path);
+    EXPECT_EQ(40, *reinterpret_cast<const int32_t *>(content.data() + 18));
+    EXPECT_EQ(22, *reinterpret_cast<const int32_t *>(content.data() + 22));
+
+    // A '*' name keeps the name of the output file
+    auto directory = path.parent_path() / "paint_data_pixels_test_pyramid_dir";
+    std::filesystem::create_directory(directory);
+    created.SavePyramid(1, directory / "*.bmp");
+    EXPECT_TRUE(std::filesystem::exists(directory / "paint_data_pixels_test_pyramid_1.bmp"));
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".flat.bmp");
+    std::filesystem::remove(level_path(1));
+    std::filesystem::remove(level_path(2));
+    std::filesystem::remove_all(directory);
+}
+
+TEST(image_bmp, mmap_load_rgb565)
+{
+    auto path = std::filesystem::temp_directory_path() / "paint_data_pixels_test_mmap_rgb565.bmp";
+    auto read_file = [](const std::filesystem::path &file_path) {
+        std::ifstream f(file_path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    };
+    auto same_pixels = [](const paint::DataPixels &a, const paint::DataPixels &b) {
+        std::vector<uint16_t> row_a(13), row_b(13);
+        for (paint::Unit y = 0; y < 7; y++)
+        {
+            a.CopyRowTo(y, row_a.data());
+            b.CopyRowTo(y, row_b.data());
+            if (row_a != row_b)
+                return false;
+        }
+        return true;
+    };
+
+    // Create the test image (odd width -> padded rows)
+    paint::image_bmp::ImageBMP created(path);
+    created.CreateImage(paint::Point{13, 7}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    created.painter.ClearImage(std::make_shared<paint::ColorRGB888>(10, 20, 30));
+    created.painter.DrawLine(paint::PointPX(0, 0), paint::PointPX(12, 6), std::make_shared<paint::ColorRGB888>(200, 100, 50), 1);
+    created.painter.ConvertToRGB565();
+    created.SaveImage();
+    const std::string content = read_file(path);
+
+    paint::image_bmp::ImageBMP read(path);
+    read.LoadImage();
+    paint::image_bmp::ImageBMP mapped(path);
+    mapped.SetLoadMode(paint::LoadMode::kMap);
+    ASSERT_NO_THROW(mapped.LoadImage());
+
+    // The mapped pixels are read from the file
+    ASSERT_EQ(paint::ColorFormat::kRGB565, mapped.GetImageData()->GetColorFormat());
+    EXPECT_TRUE(mapped.GetImageData()->IsReadOnly());
+    EXPECT_TRUE(same_pixels(*read.GetImageData(), *mapped.GetImageData()));
+
+    // The first edit copies the pixels, the file stays the same
+    read.painter.InvertColors();
+    mapped.painter.InvertColors();
+    EXPECT_FALSE(mapped.GetImageData()->IsReadOnly());
+    EXPECT_TRUE(same_pixels(*read.GetImageData(), *mapped.GetImageData()));
+    EXPECT_EQ(content, read_file(path));
+
+    // Undo returns the mapped pixels
+    mapped.Undo();
+    EXPECT_TRUE(mapped.GetImageData()->IsReadOnly());
+    EXPECT_TRUE(same_pixels(*created.GetImageData(), *mapped.GetImageData()));
+
+    std::filesystem::remove(path);
+}
+
+TEST(image_bmp, packed_bw_roundtrip)
+{
+    auto path = std::filesystem::temp_directory_path() / "paint_data_pixels_test_packed.bmp";
+
+    // BW image of width not a multiple of 32 (the BMP rows have padding bits)
+    paint::image_bmp::ImageBMP created(path);
+    created.CreateImage(paint::Point{45, 9}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    created.painter.ClearImage(std::make_shared<paint::ColorRGB888>(0, 0, 0));
+    created.painter.DrawLine(paint::PointPX(0, 0), paint::PointPX(44, 8), std::make_shared<paint::ColorRGB888>(255, 255, 255), 1);
+    created.painter.DrawLine(paint::PointPX(40, 0), paint::PointPX(44, 8), std::make_shared<paint::ColorRGB888>(255, 255, 255), 3);
+    created.painter.ConvertToBW();
+    created.SaveImage();
+
+    // BW pixels are loaded packed by default
+    paint::image_bmp::ImageBMP packed(path);
+    packed.LoadImage();
+    paint::image_bmp::ImageBMP linear(path);
+    linear.SetPixelLayout(paint::PixelLayout::kLinear);
+    linear.LoadImage();
+
+    std::filesystem::path path_packed = path.string() + ".packed.bmp";
+    std::filesystem::path path_linear = path.string() + ".linear.bmp";
+    packed.SaveImage(path_packed);
+    linear.SaveImage(path_linear);
+
+    std::ifstream f0(path, std::ios::binary), f1(path_packed, std::ios::binary), f2(path_linear, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(f0)), std::istreambuf_iterator<char>());
+    std::string content_packed((std::istreambuf_iterator<char>(f1)), std::istreambuf_iterator<char>());
+    std::string content_linear((std::istreambuf_iterator<char>(f2)), std::istreambuf_iterator<char>());
+    EXPECT_FALSE(content.empty());
+    EXPECT_EQ(content, content_packed);
+    EXPECT_EQ(content, content_linear);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path_packed);
+    std::filesystem::remove(path_linear);
+}
+
+TEST(image_bmp, rgb565_roundtrip)
+{
+    auto path = std::filesystem::temp_directory_path() / "paint_data_pixels_test_rgb565.bmp";
+    auto read_file = [](const std::filesystem::path &file_path) {
+        std::ifstream f(file_path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    };
+
+    // Odd width -> the rows are padded to 4 bytes
+    paint::image_bmp::ImageBMP created(path);
+    created.CreateImage(paint::Point{13, 7}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+    created.painter.ClearImage(std::make_shared<paint::ColorRGB888>(10, 20, 30));
+    created.painter.DrawLine(paint::PointPX(0, 0), paint::PointPX(12, 6), std::make_shared<paint::ColorRGB888>(200, 100, 50), 1);
+    created.painter.DrawLine(paint::PointPX(0, 6), paint::PointPX(12, 0), std::make_shared<paint::ColorRGB888>(255, 255, 255), 1);
+    created.painter.ConvertToRGB565();
+    created.SaveImage(path);
+
+    // 16 bits per pixel
+    std::string content = read_file(path);
+    EXPECT_EQ(16, *reinterpret_cast<const uint16_t *>(content.data() + 28));
+    EXPECT_EQ(static_cast<size_t>(0x36 + 28 * 7), content.size());
+
+    // Loaded as RGB565 with the same pixels and saved the same
+    paint::image_bmp::ImageBMP read(path);
+    ASSERT_NO_THROW(read.LoadImage());
+    auto created_data = created.GetImageData();
+    auto read_data = read.GetImageData();
+    ASSERT_EQ(paint::ColorFormat::kRGB565, read_data->GetColorFormat());
+    for (paint::Unit y = 0; y < 7; y++)
+    {
+        std::vector<uint16_t> row_created(13), row_read(13);
+        created_data->CopyRowTo(y, row_created.data());
+        read_data->CopyRowTo(y, row_read.data());
+        EXPECT_EQ(row_created, row_read) << "row " << y;
+    }
+
+    read.SaveImage(path.string() + ".read.bmp");
+    EXPECT_EQ(content, read_file(path.string() + ".read.bmp"));
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".read.bmp");
+}
+
+TEST(image_bmp, indexed_roundtrip)
+{
+    auto path = std::filesystem::temp_directory_path() / "paint_data_pixels_test_indexed.bmp";
+    auto read_file = [](const std::filesystem::path &file_path) {
+        std::ifstream f(file_path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    };
+
+    // 3 colors fit into 4 bits per pixel, 40 colors into 8 bits per pixel
+    for (int color_count : {3, 40})
+    {
+        paint::image_bmp::ImageBMP created(path);
+        created.CreateImage(paint::Point{45, 130}, std::make_unique<paint::ColorBGR888>(0, 0, 0));
+        created.painter.ClearImage(std::make_shared<paint::ColorRGB888>(10, 20, 30));
+        for (int i = 1; i < color_count; i++)
+            created.painter.DrawLine(paint::PointPX(0, i * 3), paint::PointPX(44, i * 3), std::make_shared<paint::ColorRGB888>(i % 8 * 32, i / 8 * 32, 100), 1);
+        created.SaveImage(path.string() + ".24.bmp");
+
+        created.painter.Quantize(256);
+        created.SaveImage(path);
+
+        std::string content = read_file(path);
+        std::string content_24 = read_file(path.string() + ".24.bmp");
+        const uint16_t bit_count = *reinterpret_cast<const uint16_t *>(content.data() + 28);
+        EXPECT_EQ(color_count <= 16 ? 4 : 8, bit_count);
+        EXPECT_LT(content.size() * 2, content_24.size());
+
+        // The indexed image is loaded with its palette (mapped as well) and saved the same
+        paint::image_bmp::ImageBMP read(path);
+        read.LoadImage();
+        read.SaveImage(path.string() + ".read.bmp");
+        EXPECT_EQ(content, read_file(path.string() + ".read.bmp"));
+
+        paint::image_bmp::ImageBMP mapped(path);
+        mapped.SetLoadMode(paint::LoadMode::kMap);
+        mapped.LoadImage();
+        mapped.SaveImage(path.string() + ".mapped.bmp");
+        EXPECT_EQ(content, read_file(path.string() + ".mapped.bmp"));
+
+        // Same colors as the 24-bit image
+        paint::image_bmp::ImageBMP read_24(path.string() + ".24.bmp");
+        read_24.LoadImage();
+        read.painter.ConvertToGrayscale();
+        read_24.painter.ConvertToGrayscale();
+        read.SaveImage(path.string() + ".read.bmp");
+        read_24.SaveImage(path.string() + ".mapped.bmp");
+        EXPECT_EQ(read_file(path.string() + ".mapped.bmp"), read_file(path.string() + ".read.bmp"));
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".24.bmp");
+    std::filesystem::remove(path.string() + ".read.bmp");
+    std::filesystem::remove(path.string() + ".mapped.bmp");
+}
+
+TEST(image_bmp, bgra_roundtrip)
+{
+    auto path = std::filesystem::temp_directory_path() / "paint_data_pixels_test_bgra.bmp";
+    auto read_file = [](const std::filesystem::path &file_path) {
+        std::ifstream f(file_path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    };
+
+    // Translucent pixels over transparent ones
+    paint::image_bmp::ImageBMP created(path);
+    created.CreateImage(paint::Point{13, 7}, std::make_unique<paint::ColorBGRA8888>(0, 0, 0, 0));
+    created.painter.ClearImage(std::make_shared<paint::ColorBGRA8888>(0, 0, 0, 0));
+    created.painter.DrawLine(paint::PointPX(0, 0), paint::PointPX(12, 6), std::make_shared<paint::ColorBGRA8888>(50, 100, 200, 77), 3);
+    created.painter.DrawLine(paint::PointPX(0, 6), paint::PointPX(12, 0), std::make_shared<paint::ColorRGB888>(1, 2, 3), 1);
+    created.SaveImage(path);
+
+    // 32 bits per pixel with straight alpha
+    std::string content = read_file(path);
+    EXPECT_EQ(32, *reinterpret_cast<const uint16_t *>(content.data() + 28));
+    EXPECT_EQ(static_cast<size_t>(0x36 + 13 * 7 * 4), content.size());
+
+    // Loaded premultiplied again and saved the same
+    paint::image_bmp::ImageBMP read(path);
+    read.LoadImage();
+    auto created_data = created.GetImageData();
+    auto read_data = read.GetImageData();
+    ASSERT_EQ(paint::ColorFormat::kBGRA8888, read_data->GetColorFormat());
+    for (paint::Unit y = 0; y < 7; y++)
+    {
+        std::vector<paint::PixelBGRA8888> row_created(13), row_read(13);
+        created_data->CopyRowTo(y, row_created.data());
+        read_data->CopyRowTo(y, row_read.data());
+        EXPECT_EQ(row_created, row_read) << "row " << y;
+    }
+
+    read.SaveImage(path.string() + ".read.bmp");
+    EXPECT_EQ(content, read_file(path.string() + ".read.bmp"));
+
+    // The 4th byte of BI_RGB files is often 0 -> all zero alpha is opaque
+    for (size_t i = 0x36 + 3; i < content.size(); i += 4)
+        content[i] = 0;
+    std::ofstream(path, std::ios::binary).write(content.data(), content.size());
+    paint::image_bmp::ImageBMP opaque(path);
+    opaque.LoadImage();
+    auto opaque_color = opaque.GetImageData()->GetColorType();
+    opaque.GetImageData()->CopyPixelTo(0, 0, opaque_color->GetData());
+    EXPECT_EQ(255, opaque_color->ToBGRA8888().GetAlpha());
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".read.bmp");
+}
+
+TEST(data_pixels, gigapixel_stress)
+{
+    // Allocates 2.6 GB -> runs only on request
+    if (!std::getenv("PAINT_GIGAPIXEL_TEST"))
+        GTEST_SKIP() << "Set PAINT_GIGAPIXEL_TEST to run the gigapixel stress test";
+
+    // More than 2^31 pixels, the product of the coordinates at the bottom right overflows 32 bits
+    const paint::Point size{65536, 40000};
+    auto data = std::make_shared<paint::DataPixels>(size, std::make_unique<paint::ColorGrayscale>(0), paint::PixelLayout::kLinear);
+    EXPECT_EQ(static_cast<size_t>(size.x) * size.y, data->GetPixelCount());
+    EXPECT_GT(data->GetPixelCount(), static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+
+    paint::Painter painter([]() {});
+    painter.AttachImageData(data);
+    painter.ClearImage(std::make_shared<paint::ColorGrayscale>(10));
+
+    // Linear index past 2^31
+    auto value_at = [&data](paint::Unit x, paint::Unit y) { return *reinterpret_cast<uint8_t *>(data->at(x, y)); };
+    size_t last = data->GetPixelCount() - 1;
+    EXPECT_EQ(data->at(size.x - 1, size.y - 1), (*data)[last]);
+    EXPECT_EQ(10, value_at(size.x - 1, size.y - 1));
+
+    // Bucket fills only the 3x3 block at the bottom right
+    for (paint::Unit y = size.y - 4; y < size.y - 1; y++)
+        std::memset(data->at(size.x - 4, y), 20, 3);
+    painter.DrawBucket(paint::PointPX(size.x - 3, size.y - 3), std::make_shared<paint::ColorGrayscale>(30));
+    EXPECT_EQ(30, value_at(size.x - 4, size.y - 4));
+    EXPECT_EQ(30, value_at(size.x - 2, size.y - 2));
+    EXPECT_EQ(10, value_at(size.x - 1, size.y - 2));
+    EXPECT_EQ(10, value_at(size.x - 5, size.y - 4));
+
+    // Horizontal line at the bottom of the image
+    painter.DrawLine(paint::PointPX(0, size.y - 2), paint::PointPX(size.x - 1, size.y - 2), std::make_shared<paint::ColorGrayscale>(40), 1);
+    EXPECT_EQ(40, value_at(size.x / 2, size.y - 2));
+    EXPECT_EQ(10, value_at(size.x / 2, size.y - 4));
+
+    // Crop the bottom right corner
+    painter.Crop(paint::PointPX(size.x - 8, size.y - 8), paint::PointPX(size.x, size.y));
+    ASSERT_EQ((paint::Point{8, 8}), data->GetSize());
+    EXPECT_EQ(30, value_at(4, 4));
+    EXPECT_EQ(40, value_at(0, 6));
+    EXPECT_EQ(10, value_at(0, 0));
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -71,6 +71,17 @@ TEST(parser_line_command, valid_commands)
      line << "LINE % " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen)
           << " {width: " << distr_unit(gen) << ", color: " << color.str() << "}";
      EXPECT_NO_THROW(paint::Parser::ParseLine(line.str())) << "Failed to parse valid command '" << line.str() << "'";
+
+     color.str(std::string());
+     color << "{r: " << distr_color(gen) << ", g: " << distr_color(gen) << ", b: " << distr_color(gen) << "}";
+     line.str(std::string());
+     line << "LINE PX " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen)
+          << " {antialias: true, width: " << distr_unit(gen) << ", color: " << color.str() << "}";
+     EXPECT_NO_THROW(paint::Parser::ParseLine(line.str())) << "Failed to parse valid command '" << line.str() << "'";
+
+     line.str(std::string());
+     line << "LINE % " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen) << " {antialias: false}";
+     EXPECT_NO_THROW(paint::Parser::ParseLine(line.str())) << "Failed to parse valid command '" << line.str() << "'";
 }
 
 TEST(parser_line_command, invalid_commands)
@@ -195,6 +206,12 @@ TEST(parser_line_command, invalid_commands)
           << "0"
           << ", color: " << color.str() << "}";
      EXPECT_THROW(paint::Parser::ParseLine(line.str()), paint::parse_error) << "Parsed invalid command (width is zero) '" << line.str() << "'";
+
+     // antialias value
+     line.str(std::string());
+     line << "LINE PX " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen) << " " << distr_unit(gen)
+          << " {antialias: yes}";
+     EXPECT_THROW(paint::Parser::ParseLine(line.str()), paint::parse_error) << "Parsed invalid command (antialias is not bool) '" << line.str() << "'";
 }
 
 int main(int argc, char *argv[])
@@ -3,6 +3,8 @@
 #include <gtest/gtest.h>
 
 #include "parser.h"
+#include "command.h"
+#include "colors.h"
 
 TEST(parser_error, throw_exception)
 {
@@ -113,6 +115,35 @@ namespace paint
         EXPECT_STREQ("border-color", args[2].first.c_str());
         EXPECT_STREQ("r: 0, g: 10, b: 255", args[2].second.c_str());
     }
+
+    TEST(parser, parse_color)
+    {
+        paint::Parser p;
+        std::shared_ptr<Color> color;
+
+        // Opaque colors are RGB888
+        ASSERT_NO_THROW(color = p.ParseColorVal("r: 10, g: 20, b: 30")) << "Failed to parse color";
+        EXPECT_EQ(ColorFormat::kRGB888, color->GetColorFormat());
+        EXPECT_EQ(ColorRGB888(10, 20, 30), color->ToRGB888());
+
+        ASSERT_NO_THROW(color = p.ParseColorVal("r: 10, g: 20, b: 30, a: 255")) << "Failed to parse color";
+        EXPECT_EQ(ColorFormat::kRGB888, color->GetColorFormat());
+
+        // Translucent colors keep the alpha
+        ASSERT_NO_THROW(color = p.ParseColorVal("r: 200, g: 100, b: 0, a: 51")) << "Failed to parse color";
+        ASSERT_EQ(ColorFormat::kBGRA8888, color->GetColorFormat());
+        EXPECT_EQ(ColorBGRA8888(0, 100, 200, 51), *std::dynamic_pointer_cast<ColorBGRA8888>(color));
+
+        EXPECT_THROW(p.ParseColorVal("r: 10, g: 20, b: 30, a: 256"), paint::parse_error) << "Invalid color passed (alpha out of range)";
+        EXPECT_THROW(p.ParseColorVal("r: 10, g: 20, b: 30, a:"), paint::parse_error) << "Invalid color passed (missing alpha)";
+
+        std::shared_ptr<ColorCommand> command;
+        ASSERT_NO_THROW(command = std::dynamic_pointer_cast<ColorCommand>(p.ParseLine("COLOR 1 2 3 4"))) << "Failed to parse ColorCommand";
+        ASSERT_TRUE(command);
+        ASSERT_NO_THROW(command = std::dynamic_pointer_cast<ColorCommand>(p.ParseLine("COLOR 1 2 3"))) << "Failed to parse ColorCommand";
+        ASSERT_TRUE(command);
+        EXPECT_THROW(p.ParseLine("COLOR 1 2 3 300"), paint::parse_error) << "Invalid ColorCommand passed (alpha out of range)";
+    }
 }
 
 TEST(parser, parse_circle)
@@ -188,6 +219,311 @@ TEST(parser, parse_circle)
     EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid CircleCommand passed (empty optional args): " << s;
 }
 
+TEST(parser, parse_load)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::LoadCommand> command;
+
+    s = "LOAD images/test.bmp";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LoadCommand>(p.ParseLine(s))) << "Failed to parse basic LoadCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ("images/test.bmp", command->FilePath().string());
+    EXPECT_EQ(paint::LoadMode::kRead, command->GetLoadMode());
+
+    s = "LOAD images/test.bmp {mode: mmap}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LoadCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'mode: mmap' of LoadCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ("images/test.bmp", command->FilePath().string());
+    EXPECT_EQ(paint::LoadMode::kMap, command->GetLoadMode());
+
+    s = "LOAD images/test.bmp {mode: read}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LoadCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'mode: read' of LoadCommand";
+    EXPECT_EQ(paint::LoadMode::kRead, command->GetLoadMode());
+
+    s = "LOAD images/test.bmp {mode: fast}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid LoadCommand passed (unknown mode): " << s;
+
+    s = "LOAD images/test.bmp {mode: mmap, mode: read}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid LoadCommand passed (duplicate parameter): " << s;
+
+    s = "LOAD images/test.bmp {layout: planar, mode: mmap}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LoadCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'layout: planar' of LoadCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::PixelLayout::kPlanar, command->GetPixelLayout());
+    EXPECT_EQ(paint::LoadMode::kMap, command->GetLoadMode());
+
+    s = "LOAD images/test.bmp {layout: tiled}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LoadCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'layout: tiled' of LoadCommand";
+    EXPECT_EQ(paint::PixelLayout::kTiled, command->GetPixelLayout());
+
+    s = "LOAD images/test.bmp {layout: packed}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LoadCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'layout: packed' of LoadCommand";
+    EXPECT_EQ(paint::PixelLayout::kPacked, command->GetPixelLayout());
+
+    s = "LOAD images/test.bmp";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LoadCommand>(p.ParseLine(s)));
+    EXPECT_FALSE(command->GetPixelLayout().has_value());
+
+    s = "LOAD images/test.bmp {layout: soa}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid LoadCommand passed (unknown layout): " << s;
+
+    s = "LOAD images/test.bmp {layout: linear, layout: tiled}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid LoadCommand passed (duplicate parameter): " << s;
+}
+
+TEST(parser, parse_resize)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::ResizeCommand> command;
+
+    s = "RESIZE PX 100 50";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::ResizeCommand>(p.ParseLine(s))) << "Failed to parse ResizeCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::ResampleFilter::kInterpolate, command->GetFilter());
+
+    s = "RESIZE % 50 50 {filter: lanczos3}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::ResizeCommand>(p.ParseLine(s))) << "Failed to parse ResizeCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::ResampleFilter::kLanczos3, command->GetFilter());
+
+    s = "RESIZE PX 100 50 {filter: box}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::ResizeCommand>(p.ParseLine(s))) << "Failed to parse ResizeCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::ResampleFilter::kBox, command->GetFilter());
+
+    s = "RESIZE PX 100 50 {filter: bicubic}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::ResizeCommand>(p.ParseLine(s))) << "Failed to parse ResizeCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::ResampleFilter::kBicubic, command->GetFilter());
+
+    s = "RESIZE PX 100 50 {filter: nearest}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid ResizeCommand passed (unknown filter): " << s;
+
+    s = "RESIZE PX 100 50 {filter: box, filter: bilinear}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid ResizeCommand passed (duplicate filter): " << s;
+}
+
+TEST(parser, parse_pyramid)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::PyramidCommand> command;
+
+    s = "PYRAMID 3";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::PyramidCommand>(p.ParseLine(s))) << "Failed to parse PyramidCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(3U, command->GetLevelCount());
+    EXPECT_TRUE(command->FilePath().empty());
+
+    s = "PYRAMID 2 ./thumbs/*.bmp";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::PyramidCommand>(p.ParseLine(s))) << "Failed to parse PyramidCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(2U, command->GetLevelCount());
+    EXPECT_EQ(std::filesystem::path("./thumbs/*.bmp"), command->FilePath());
+
+    s = "PYRAMID 0";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid PyramidCommand passed (no level): " << s;
+
+    s = "PYRAMID";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid PyramidCommand passed (no level count): " << s;
+}
+
+TEST(parser, parse_dither)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::DitherCommand> command;
+
+    s = "DITHER BW";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::DitherCommand>(p.ParseLine(s))) << "Failed to parse basic DitherCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::ColorFormat::kBW, command->GetTargetFormat());
+    EXPECT_EQ(paint::DitherMethod::kFloydSteinberg, command->GetDitherMethod());
+
+    s = "DITHER RGB565 {method: bayer}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::DitherCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'method: bayer' of DitherCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::ColorFormat::kRGB565, command->GetTargetFormat());
+    EXPECT_EQ(paint::DitherMethod::kBayer, command->GetDitherMethod());
+
+    s = "DITHER BW {method: atkinson}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::DitherCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'method: atkinson' of DitherCommand";
+    EXPECT_EQ(paint::DitherMethod::kAtkinson, command->GetDitherMethod());
+
+    s = "DITHER BW {method: floyd-steinberg}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::DitherCommand>(p.ParseLine(s))) << "Failed to parse optional parameter 'method: floyd-steinberg' of DitherCommand";
+    EXPECT_EQ(paint::DitherMethod::kFloydSteinberg, command->GetDitherMethod());
+
+    s = "DITHER RGB888";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid DitherCommand passed (unsupported format): " << s;
+
+    s = "DITHER BW {method: random}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid DitherCommand passed (unknown method): " << s;
+
+    s = "DITHER BW {method: bayer, method: atkinson}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid DitherCommand passed (duplicate parameter): " << s;
+}
+
+TEST(parser, parse_quantize)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::QuantizeCommand> command;
+
+    s = "QUANTIZE 16";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::QuantizeCommand>(p.ParseLine(s))) << "Failed to parse QuantizeCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(16u, command->GetMaxColors());
+
+    s = "QUANTIZE 256";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::QuantizeCommand>(p.ParseLine(s))) << "Failed to parse QuantizeCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(256u, command->GetMaxColors());
+
+    s = "QUANTIZE 0";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid QuantizeCommand passed (no colors): " << s;
+
+    s = "QUANTIZE 257";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid QuantizeCommand passed (too many colors): " << s;
+
+    s = "QUANTIZE";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid QuantizeCommand passed (missing number of colors): " << s;
+}
+
+TEST(parser, parse_linear_light)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::LinearLightCommand> command;
+
+    s = "LINEARLIGHT ON";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LinearLightCommand>(p.ParseLine(s))) << "Failed to parse LinearLightCommand";
+    ASSERT_TRUE(command);
+    EXPECT_TRUE(command->IsLinearLight());
+
+    s = "LINEARLIGHT OFF";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::LinearLightCommand>(p.ParseLine(s))) << "Failed to parse LinearLightCommand";
+    ASSERT_TRUE(command);
+    EXPECT_FALSE(command->IsLinearLight());
+
+    s = "LINEARLIGHT";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid LinearLightCommand passed (missing state): " << s;
+
+    s = "LINEARLIGHT on";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid LinearLightCommand passed (lowercase state): " << s;
+}
+
+TEST(parser, parse_defer)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::DeferCommand> command;
+
+    s = "DEFER ON";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::DeferCommand>(p.ParseLine(s))) << "Failed to parse DeferCommand";
+    ASSERT_TRUE(command);
+    EXPECT_TRUE(command->IsDeferredDrawing());
+
+    s = "DEFER OFF";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::DeferCommand>(p.ParseLine(s))) << "Failed to parse DeferCommand";
+    ASSERT_TRUE(command);
+    EXPECT_FALSE(command->IsDeferredDrawing());
+
+    s = "DEFER";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid DeferCommand passed (missing state): " << s;
+}
+
+TEST(parser, parse_bucket)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::BucketCommand> command;
+
+    s = "BUCKET PX 10 20 {color: {r: 0, g: 10, b: 255}, tolerance: 30}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::BucketCommand>(p.ParseLine(s))) << "Failed to parse BucketCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(30, command->GetTolerance());
+
+    s = "BUCKET % 50 50";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::BucketCommand>(p.ParseLine(s))) << "Failed to parse BucketCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(0, command->GetTolerance());
+
+    s = "BUCKET PX 10 20 {tolerance: 256}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid BucketCommand passed (tolerance over 255): " << s;
+
+    s = "BUCKET PX 10 20 {tolerance: 10, tolerance: 20}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid BucketCommand passed (duplicate tolerance): " << s;
+}
+
+TEST(parser, parse_replace_color)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::ReplaceColorCommand> command;
+
+    s = "REPLACECOLOR 255 255 255 {color: {r: 0, g: 10, b: 255}, tolerance: 12}";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::ReplaceColorCommand>(p.ParseLine(s))) << "Failed to parse ReplaceColorCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(paint::ColorRGB888(255, 255, 255), paint::ColorRGB888(command->GetColor()));
+    EXPECT_EQ(12, command->GetTolerance());
+
+    s = "REPLACECOLOR 0 0 0";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::ReplaceColorCommand>(p.ParseLine(s))) << "Failed to parse ReplaceColorCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(0, command->GetTolerance());
+
+    s = "REPLACECOLOR 0 256 0";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid ReplaceColorCommand passed (channel over 255): " << s;
+
+    s = "REPLACECOLOR 0 0 {tolerance: 10}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid ReplaceColorCommand passed (missing channel): " << s;
+
+    s = "REPLACECOLOR 0 0 0 {tolerance: -1}";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid ReplaceColorCommand passed (negative tolerance): " << s;
+}
+
+TEST(parser, parse_parallel_fill)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::ParallelFillCommand> command;
+
+    s = "PARALLELFILL 1000000";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::ParallelFillCommand>(p.ParseLine(s))) << "Failed to parse ParallelFillCommand";
+    ASSERT_TRUE(command);
+    EXPECT_EQ(1000000, command->GetParallelFillPixels());
+
+    s = "PARALLELFILL";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid ParallelFillCommand passed (missing number of pixels): " << s;
+
+    s = "PARALLELFILL -5";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid ParallelFillCommand passed (negative number of pixels): " << s;
+}
+
+TEST(parser, parse_overlay)
+{
+    paint::Parser p;
+    std::string s;
+    std::shared_ptr<paint::OverlayCommand> command;
+
+    s = "OVERLAY PX 10 20 ./overlays/logo.bmp";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::OverlayCommand>(p.ParseLine(s))) << "Failed to parse OverlayCommand";
+    ASSERT_TRUE(command);
+
+    s = "OVERLAY % 50 50 logo.bmp";
+    ASSERT_NO_THROW(command = std::dynamic_pointer_cast<paint::OverlayCommand>(p.ParseLine(s))) << "Failed to parse OverlayCommand";
+    ASSERT_TRUE(command);
+
+    s = "OVERLAY PX 10 logo.bmp";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid OverlayCommand passed (missing coordinate): " << s;
+
+    s = "OVERLAY PX 10 20";
+    EXPECT_THROW(p.ParseLine(s), paint::parse_error) << "Invalid OverlayCommand passed (missing file): " << s;
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);